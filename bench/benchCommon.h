@@ -0,0 +1,140 @@
+#ifndef _BENCHCOMMON_H_
+#define _BENCHCOMMON_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include "common.h"
+#include "tapeFormat.h"
+
+/*
+    Shared helpers for the micro benchmarks under bench/. Each benchmark is its
+    own binary linked against every module except main.cpp, so the symbols
+    main.cpp provides to the modules are defined here.
+*/
+std::atomic<bool> keepRunning(true);
+
+e_QuartzEventFlag UpdateEventFlagForQuartz(uint8_t evt_flag) {
+    return (e_QuartzEventFlag)evt_flag;
+}
+
+void sendBleDataPacket(BleDataPacket &bleDataPkt) {
+    (void)bleDataPkt;
+}
+
+#define BENCH_RUNS                                (7u)
+
+inline uint64_t getBenchTimeNsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* Runs fn(iterations) BENCH_RUNS times and returns the median cost per iteration in ns */
+template <typename Fn>
+double runBenchNsecsPerOp(uint32_t iterations, Fn fn) {
+    std::vector<double> runs;
+    for (uint32_t r = 0; r < BENCH_RUNS; r++) {
+        uint64_t start = getBenchTimeNsecs();
+        fn(iterations);
+        runs.push_back((double)(getBenchTimeNsecs() - start) / (double)iterations);
+    }
+    std::sort(runs.begin(), runs.end());
+    return runs[runs.size() / 2];
+}
+
+static std::mt19937 benchRng(12345);
+
+inline int16_t getRandomTemperature(void) {
+    /* As decoded: integer byte * 100 + fraction byte; mix in negative values for sign coverage */
+    if (benchRng() % 4 == 0) {
+        return (int16_t)((int)(benchRng() % 40000u) - 20000);
+    }
+    return (int16_t)((benchRng() & 0xFF) * TAPE_TEMP_CENTI_PER_DEGREE + (benchRng() & 0xFF));
+}
+
+/* Fills a parsed packet of the given type with random readings, as the BLE thread would queue it */
+inline void fillBenchPacket(BleDataPacket *blePkt, BlePacketType type) {
+    memset(blePkt, 0, sizeof(*blePkt));
+    blePkt->blePktType = type;
+    for (size_t i = 0; i < WHITE_TAPE_DATA_PACKET_LEN; i++) {
+        blePkt->bleBuff[i] = (uint8_t)benchRng();
+    }
+
+    char mac[20];
+    snprintf(mac, sizeof(mac), "%012llX", (unsigned long long)(benchRng() & 0xFFFFFFFFFFFFull) | 0xC00000000000ull);
+    switch (type) {
+        case QuartzSensor_TMP117: {
+            BlePacket_QuartzTMP117 *p = &blePkt->blePktStrct.blePkt_TMP117;
+            strcpy(p->mac_addr, mac);
+            p->evt_flag = (uint8_t)benchRng();
+            p->t0 = getRandomTemperature();
+            p->t0_ts = (uint16_t)benchRng();
+            p->t1 = getRandomTemperature();
+            p->t1_ts = (uint16_t)benchRng();
+            p->t2 = getRandomTemperature();
+            p->t2_ts = (uint16_t)benchRng();
+            p->pid = benchRng() & 0xFFFFFF;
+            p->seqId = (uint16_t)benchRng();
+            p->tapeId = 0xFFFC;
+            p->bat = (uint8_t)benchRng();
+            p->rssi = (int8_t)-(int)(benchRng() % 100);
+            break;
+        }
+        case QuartzSensor_OPT3110: {
+            BlePacket_QuartzOPT3110 *p = &blePkt->blePktStrct.blePkt_OPT3110;
+            strcpy(p->mac_addr, mac);
+            p->evt_flag = (uint8_t)benchRng();
+            p->t0 = getRandomTemperature();
+            p->t0_ts = (uint16_t)benchRng();
+            p->l0 = (uint16_t)benchRng();
+            p->l0_ts = (uint16_t)benchRng();
+            p->l1 = (uint16_t)benchRng();
+            p->l1_ts = (uint16_t)benchRng();
+            p->pid = benchRng() & 0xFFFFFF;
+            p->lime_bat = (uint8_t)benchRng();
+            p->seqId = (uint16_t)benchRng();
+            p->tapeId = 0xFFFA;
+            p->bat = (uint8_t)benchRng();
+            p->rssi = (int8_t)-(int)(benchRng() % 100);
+            break;
+        }
+        case QuartzSensor_IAT: {
+            BlePacket_IAT *p = &blePkt->blePktStrct.blePkt_IAT;
+            strcpy(p->mac_addr, mac);
+            p->evt_flag = (uint8_t)benchRng();
+            p->t0 = getRandomTemperature();
+            p->t1 = getRandomTemperature();
+            p->t1_ts = benchRng();
+            p->l0 = (uint16_t)benchRng();
+            p->l0_ts = benchRng();
+            p->a0_val = (int8_t)benchRng();
+            p->a0_count = (uint8_t)benchRng();
+            p->tapeId = 0xFFB1;
+            p->bat = (uint8_t)benchRng();
+            p->rssi = (int8_t)-(int)(benchRng() % 100);
+            break;
+        }
+        case QuartzSensor_DPD:
+        default: {
+            BlePacket_DPD *p = &blePkt->blePktStrct.blePkt_DPD;
+            strcpy(p->macId, mac);
+            p->evtFlag = (uint8_t)benchRng();
+            p->t0 = getRandomTemperature();
+            p->l0 = (uint16_t)benchRng();
+            p->l0Ts = benchRng();
+            p->ts = (uint16_t)benchRng();
+            p->tapeId = 0xFFB0;
+            p->bat = (uint8_t)benchRng();
+            p->rssi = (int8_t)-(int)(benchRng() % 100);
+            break;
+        }
+    }
+}
+
+#endif /* _BENCHCOMMON_H_ */
@@ -0,0 +1,125 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "benchCommon.h"
+#include "hexEncode.h"
+
+/*
+    Hex encoding benchmark, per G1 record: the 24 byte payload plus the 2 byte
+    st field, as one snprintf with 26 %02X conversions (the former URL
+    builder), the scalar table and the compiled in SIMD kernel. Before timing,
+    every input length up to BENCH_MAX_VERIFY_LEN is checked against snprintf
+    at every alignment.
+
+    Run with: make bench
+*/
+#define BENCH_RECORDS                             (4096u)
+#define BENCH_ITERATIONS                          (1000000u)
+#define BENCH_MAX_VERIFY_LEN                      (80u)
+#define BENCH_G1_LEN                              (24u)
+#define BENCH_ST_LEN                              (2u)
+
+using namespace std;
+
+static char *hexEncodeSnprintf(char *out, const uint8_t *bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        snprintf(out, 3, "%02X", bytes[i]);
+        out += 2;
+    }
+    return out;
+}
+
+static char *hexEncodeG1Snprintf(char *out, const uint8_t *b) {
+    int len = snprintf(out, 2 * (BENCH_G1_LEN + BENCH_ST_LEN) + 1,
+                       "%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
+                       "%02X%02X", b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11], b[12],
+                       b[13], b[14], b[15], b[16], b[17], b[18], b[19], b[20], b[21], b[22], b[23], b[0], b[1]);
+    return out + len;
+}
+
+static bool verifyHexEncode(mt19937 &rng) {
+    uint8_t bytes[BENCH_MAX_VERIFY_LEN + 16];
+    char expected[2 * sizeof(bytes) + 1];
+    char simd[2 * sizeof(bytes) + 1];
+    char scalar[2 * sizeof(bytes) + 1];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = (uint8_t)rng();
+    }
+    /* Every value, including those that straddle the '9'/'A' boundary */
+    for (size_t i = 0; i < 16; i++) {
+        bytes[i * 5 % sizeof(bytes)] = (uint8_t)(i * 0x11);
+    }
+
+    for (size_t align = 0; align < 16; align++) {
+        for (size_t len = 0; len <= BENCH_MAX_VERIFY_LEN; len++) {
+            memset(simd, '#', sizeof(simd));
+            memset(scalar, '#', sizeof(scalar));
+            hexEncodeSnprintf(expected, &bytes[align], len);
+            char *end = hexEncodeUpper(simd, &bytes[align], len);
+            char *scalarEnd = hexEncodeUpperScalar(scalar, &bytes[align], len);
+            if (end != simd + 2 * len || scalarEnd != scalar + 2 * len || simd[2 * len] != '#' ||
+                memcmp(simd, expected, 2 * len) != 0 || memcmp(scalar, expected, 2 * len) != 0) {
+                printf("MISMATCH at align %zu len %zu\n", align, len);
+                return false;
+            }
+        }
+    }
+
+    uint8_t bdaddr[6] = {0x36, 0x81, 0x92, 0x73, 0x0F, 0xDF};
+    char mac[HEX_ENCODE_MAC_STR_LEN + 1];
+    hexEncodeBdaddr(mac, bdaddr);
+    if (strcmp(mac, "DF0F73928136") != 0) {
+        printf("MISMATCH bdaddr: %s\n", mac);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    mt19937 rng(12345);
+    if (!verifyHexEncode(rng)) {
+        return 1;
+    }
+
+    vector<uint8_t> payloads(BENCH_RECORDS * BENCH_G1_LEN);
+    for (auto &b : payloads) {
+        b = (uint8_t)rng();
+    }
+
+    static char out[2 * (BENCH_G1_LEN + BENCH_ST_LEN) + 1];
+    size_t sink = 0;
+    auto runRecords = [&](char *(*encode)(char *, const uint8_t *, size_t)) {
+        return runBenchNsecsPerOp(BENCH_ITERATIONS, [&](uint32_t n) {
+            for (uint32_t i = 0; i < n; i++) {
+                const uint8_t *payload = &payloads[(i % BENCH_RECORDS) * BENCH_G1_LEN];
+                char *p = encode(out, payload, BENCH_G1_LEN);
+                encode(p, payload, BENCH_ST_LEN);
+                sink += (size_t)out[i % sizeof(out)];
+            }
+        });
+    };
+
+    double snprintfNs = runBenchNsecsPerOp(BENCH_ITERATIONS, [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            hexEncodeG1Snprintf(out, &payloads[(i % BENCH_RECORDS) * BENCH_G1_LEN]);
+            sink += (size_t)out[i % sizeof(out)];
+        }
+    });
+    double scalarNs = runRecords(hexEncodeUpperScalar);
+    double kernelNs = runRecords(hexEncodeUpper);
+    double macNs = runBenchNsecsPerOp(BENCH_ITERATIONS, [&](uint32_t n) {
+        char mac[HEX_ENCODE_MAC_STR_LEN + 1];
+        for (uint32_t i = 0; i < n; i++) {
+            hexEncodeBdaddr(mac, &payloads[(i % BENCH_RECORDS) * BENCH_G1_LEN]);
+            sink += (size_t)mac[i % HEX_ENCODE_MAC_STR_LEN];
+        }
+    });
+
+    printf("G1 hex (%u+%u bytes)  snprintf %7.1f ns/record   scalar %6.1f ns/record   %-6s %6.1f ns/record"
+           "   speedup %5.1fx\n", BENCH_G1_LEN, BENCH_ST_LEN, snprintfNs, scalarNs, getHexEncodeImpl(), kernelNs,
+           snprintfNs / kernelNs);
+    printf("MAC string            %6.1f ns  (%zu)\n", macNs, sink & 1);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include "benchCommon.h"
+
+/*
+    Logging benchmark: cost on the calling thread of one "Scanned MAC" line as
+    the former TRK_PRINTF wrote it (printf plus fflush) and as the
+    asynchronous logger captures it, plus a call site below the runtime
+    level. Output goes to /dev/null, so the printf figure leaves out the
+    pipe or terminal a gateway writes to and is a lower bound. Each timed
+    burst fits the thread's ring; the writer drains it between bursts.
+
+    Run with: make bench
+*/
+#define BENCH_LOG_BURST                           (512u)
+#define BENCH_DISABLED_ITERATIONS                 (10000000u)
+
+using namespace std;
+
+/* Median ns per message of BENCH_RUNS bursts, with the writer given time to drain between them */
+template <typename Fn>
+static double runBurstNsecsPerOp(Fn fn) {
+    vector<double> runs;
+    for (uint32_t r = 0; r < BENCH_RUNS; r++) {
+        uint64_t start = getBenchTimeNsecs();
+        fn(BENCH_LOG_BURST);
+        runs.push_back((double)(getBenchTimeNsecs() - start) / (double)BENCH_LOG_BURST);
+        usleep(4 * TRK_LOG_WRITER_POLL_MSECS * 1000);
+    }
+    sort(runs.begin(), runs.end());
+    return runs[runs.size() / 2];
+}
+
+int main(void) {
+    const char *mac = "DF0F73928136";
+    FILE *devNull = fopen("/dev/null", "w");
+    if (devNull == nullptr) {
+        return 1;
+    }
+
+    double printfNs = runBurstNsecsPerOp([&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            fprintf(devNull, "Scanned MAC: %s seq %u\n", mac, i);
+            fflush(devNull);
+        }
+    });
+
+    /* The writer thread writes to stdout: point it at /dev/null while the logger runs */
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    dup2(fileno(devNull), STDOUT_FILENO);
+    trkLogInit();
+    trkLogConfigure(TRK_LOG_LEVEL_INFO, 0);
+    double asyncNs = runBurstNsecsPerOp([&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            TRK_PRINTF("Scanned MAC: %s seq %u", mac, i);
+        }
+    });
+    double disabledNs = runBenchNsecsPerOp(BENCH_DISABLED_ITERATIONS, [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            TRK_LOG_DBG("Scanned MAC: %s seq %u", mac, i);
+        }
+    });
+    trkLogShutdown();
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    fclose(devNull);
+
+    printf("Log line  printf+fflush %7.1f ns   async %6.1f ns   speedup %5.1fx   disabled debug %5.2f ns\n",
+           printfNs, asyncNs, printfNs / asyncNs, disabledNs);
+    return 0;
+}
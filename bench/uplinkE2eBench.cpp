@@ -0,0 +1,255 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "benchCommon.h"
+#include "cloudComm.h"
+#include "config.h"
+#include "uplinkStream.h"
+#include "uplinkThrottle.h"
+#include "uplinkTransport.h"
+#include "urlBuilder.h"
+
+/*
+    End-to-end uplink benchmark against the local mock ingress (tools/mockIngress.cpp).
+    Generated packets go through the whole cloud path: URL extension builder,
+    URL assembly, the pooled curl connection and the HTTP round trip, either
+    one sendDataUrlToCloud() at a time or getUplinkConcurrency() at a time
+    through sendDataUrlsToCloud(), as the single mode uplink does. Each
+    scenario runs over the HTTP transport and the WebSocket stream
+    (uplink_transport), whose window then covers a round.
+
+    Reports packets/s, the per packet latency percentiles (a parallel round
+    counts for every packet in it), the application bytes on the wire per
+    packet (HTTP requests and responses, or stream frames and the upgrade;
+    TCP and TLS framing not included) and the gateway CPU time per packet; the
+    mock runs in its own process, so its CPU is not included. The gateway log
+    is sent to /dev/null while measuring, its formatting cost still counts.
+
+    The mock binary is taken from $MOCK_INGRESS (default build/tools/mockIngress).
+    Run with: make bench
+*/
+#define E2E_DEF_MOCK_PATH                         "build/tools/mockIngress"
+#define E2E_BASE_PORT                             (20000)
+#define E2E_MOCK_START_TIMEOUT_MSECS              (3000u)
+#define E2E_URL_BUFF_LEN                          (256u)
+
+using namespace std;
+
+typedef struct E2eScenario {
+    const char *name;
+    const char *transport;               /* uplink_transport */
+    bool parallel;                       /* sendDataUrlsToCloud rounds instead of sendDataUrlToCloud */
+    uint32_t packets;
+    uint32_t latencyMsecs;               /* Mock --latency-ms */
+    double errorRate;                    /* Mock --error-rate */
+    double maxRps;                       /* Mock --max-rps, 0 = unlimited */
+} E2eScenario;
+
+static const E2eScenario e2eScenarios[] = {
+    {"serial    0 ms", UPLINK_TRANSPORT_HTTP, false, 2000, 0, 0.0, 0.0},
+    {"parallel  0 ms", UPLINK_TRANSPORT_HTTP, true, 4000, 0, 0.0, 0.0},
+    {"serial   20 ms", UPLINK_TRANSPORT_HTTP, false, 200, 20, 0.0, 0.0},
+    {"parallel 20 ms", UPLINK_TRANSPORT_HTTP, true, 800, 20, 0.0, 0.0},
+    {"parallel 20 ms 5% err", UPLINK_TRANSPORT_HTTP, true, 800, 20, 0.05, 0.0},
+    {"parallel  0 ms 500 rps", UPLINK_TRANSPORT_HTTP, true, 1000, 0, 0.0, 500.0},
+    {"serial    0 ms", UPLINK_TRANSPORT_WEBSOCKET, false, 2000, 0, 0.0, 0.0},
+    {"parallel  0 ms", UPLINK_TRANSPORT_WEBSOCKET, true, 4000, 0, 0.0, 0.0},
+    {"serial   20 ms", UPLINK_TRANSPORT_WEBSOCKET, false, 200, 20, 0.0, 0.0},
+    {"parallel 20 ms", UPLINK_TRANSPORT_WEBSOCKET, true, 800, 20, 0.0, 0.0},
+    {"parallel 20 ms 5% err", UPLINK_TRANSPORT_WEBSOCKET, true, 800, 20, 0.05, 0.0},
+};
+
+static int mockPort = 0;
+static string mockInstance;
+
+static bool waitForMock(int port) {
+    for (uint32_t waited = 0; waited < E2E_MOCK_START_TIMEOUT_MSECS; waited += 10) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bool up = (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        close(fd);
+        if (up) {
+            return true;
+        }
+        usleep(10000);
+    }
+    return false;
+}
+
+static pid_t startMockIngress(const char *mockPath, const E2eScenario &sc) {
+    char port[16], latency[16], errorRate[16], maxRps[16];
+    snprintf(port, sizeof(port), "%d", mockPort);
+    snprintf(latency, sizeof(latency), "%u", sc.latencyMsecs);
+    snprintf(errorRate, sizeof(errorRate), "%.4f", sc.errorRate);
+    snprintf(maxRps, sizeof(maxRps), "%.1f", sc.maxRps);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        execl(mockPath, mockPath, "--port", port, "--latency-ms", latency, "--error-rate", errorRate,
+              "--max-rps", maxRps, (char *)nullptr);
+        _exit(127);
+    }
+    if (pid < 0 || !waitForMock(mockPort)) {
+        printf("%-24s mock ingress did not start\n", sc.name);
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        return -1;
+    }
+    return pid;
+}
+
+static void stopMockIngress(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+static double getCpuSecs(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+           (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+}
+
+/* Application bytes both ways so far, over both transports */
+static uint64_t getWireBytes(void) {
+    CurlConnStats connStats;
+    UplinkStreamStats streamStats;
+    getCurlConnStats(&connStats);
+    getUplinkStreamStats(&streamStats);
+    return connStats.bytesSent + connStats.bytesReceived + streamStats.bytesSent + streamStats.bytesReceived;
+}
+
+static double getPercentile(const vector<double> &sorted, double pct) {
+    size_t idx = (size_t)(pct / 100.0 * (double)(sorted.size() - 1) + 0.5);
+    return sorted[min(idx, sorted.size() - 1)];
+}
+
+static bool runScenario(const char *mockPath, const E2eScenario &sc, FILE *out) {
+    pid_t pid = startMockIngress(mockPath, sc);
+    if (pid < 0) {
+        return false;
+    }
+
+    vector<BleDataPacket> pkts(sc.packets);
+    for (size_t i = 0; i < pkts.size(); i++) {
+        fillBenchPacket(&pkts[i], (BlePacketType)(QuartzSensor_TMP117 + (int)(i % 4)));
+    }
+    vector<double> latenciesMsecs;
+    latenciesMsecs.reserve(sc.packets);
+    uint32_t okCount = 0;
+    uplinkCfg.transport = sc.transport;
+
+    /* The gateway log goes to /dev/null while measuring */
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+
+    uint64_t bytesStart = getWireBytes();
+    double cpuStart = getCpuSecs();
+    uint64_t wallStart = getBenchTimeNsecs();
+    if (!sc.parallel) {
+        char dataBuff[E2E_URL_BUFF_LEN];
+        for (auto &blePkt : pkts) {
+            createBleDataUrlExtension(dataBuff, sizeof(dataBuff), &blePkt);
+            uint64_t start = getBenchTimeNsecs();
+            okCount += (sendDataUrlToCloud(dataBuff, strlen(dataBuff) + 1) == 0) ? 1 : 0;
+            latenciesMsecs.push_back((double)(getBenchTimeNsecs() - start) / 1e6);
+        }
+    }
+    else {
+        char dataBuffs[CURL_MAX_PARALLEL_REQUESTS][E2E_URL_BUFF_LEN];
+        const char *urlExtensions[CURL_MAX_PARALLEL_REQUESTS];
+        long httpCodes[CURL_MAX_PARALLEL_REQUESTS];
+        for (size_t offset = 0; offset < pkts.size();) {
+            size_t count = min(getUplinkConcurrency(), pkts.size() - offset);
+            for (size_t i = 0; i < count; i++) {
+                createBleDataUrlExtension(dataBuffs[i], sizeof(dataBuffs[i]), &pkts[offset + i]);
+                urlExtensions[i] = dataBuffs[i];
+            }
+            uint64_t start = getBenchTimeNsecs();
+            sendDataUrlsToCloud(urlExtensions, count, httpCodes);
+            double roundMsecs = (double)(getBenchTimeNsecs() - start) / 1e6;
+            for (size_t i = 0; i < count; i++) {
+                okCount += (httpCodes[i] == 200) ? 1 : 0;
+                latenciesMsecs.push_back(roundMsecs);
+            }
+            offset += count;
+        }
+    }
+    double wallSecs = (double)(getBenchTimeNsecs() - wallStart) / 1e9;
+    double cpuSecs = getCpuSecs() - cpuStart;
+
+    /* Close the stream while its mock is still up */
+    wsUplinkTransport.cleanup();
+    uint64_t wireBytes = getWireBytes() - bytesStart;
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    stopMockIngress(pid);
+
+    sort(latenciesMsecs.begin(), latenciesMsecs.end());
+    fprintf(out, "%-9s %-24s %6u pkts  %8.0f pkts/s  p50 %7.2f  p90 %7.2f  p99 %7.2f  max %7.2f ms  %5.0f B/pkt"
+            "  cpu %6.1f us/pkt  ok %u\n", sc.transport, sc.name, sc.packets, (double)sc.packets / wallSecs,
+            getPercentile(latenciesMsecs, 50.0), getPercentile(latenciesMsecs, 90.0),
+            getPercentile(latenciesMsecs, 99.0), latenciesMsecs.back(), (double)wireBytes / (double)sc.packets,
+            cpuSecs * 1e6 / (double)sc.packets, okCount);
+
+    /* Without injected errors every packet must have been accepted */
+    return (sc.errorRate > 0.0 || okCount == sc.packets);
+}
+
+int main(void) {
+    const char *mockPath = getenv("MOCK_INGRESS");
+    if (mockPath == nullptr) {
+        mockPath = E2E_DEF_MOCK_PATH;
+    }
+    if (access(mockPath, X_OK) != 0) {
+        printf("Uplink end-to-end: %s not found, skipped (make mock-ingress)\n", mockPath);
+        return 0;
+    }
+
+    mockPort = E2E_BASE_PORT + (int)(getpid() % 10000);
+    mockInstance = "http://127.0.0.1:" + to_string(mockPort);
+    urlCfg.instance = mockInstance.c_str();
+    urlCfg.urlExtension = "/proxencoded";
+    urlCfg.urlAlive = "/heartbeat";
+    gwCfg.gwId = "D83ADD38A39C";
+    gwCfg.gwLat = "47.639722";
+    gwCfg.gwLon = "-122.128333";
+    gwCfg.curlReqFormat = "G1";
+    if (!urlBuilderInit()) {
+        printf("Uplink end-to-end: template compilation failed\n");
+        return 1;
+    }
+
+    printf("Uplink end-to-end against %s (G1, %u parallel)\n", mockInstance.c_str(), CURL_MAX_PARALLEL_REQUESTS);
+    bool ok = true;
+    for (const auto &sc : e2eScenarios) {
+        ok = runScenario(mockPath, sc, stdout) && ok;
+    }
+
+    cloudCommCleanup();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "benchCommon.h"
+#include "cloudComm.h"
+#include "config.h"
+#include "urlBuilder.h"
+
+/*
+    URL extension builder benchmark: compiled templates vs the snprintf path,
+    for the G1 and the formatted curl_req_format. Before timing, both paths are
+    run over every packet and the outputs compared (sequence numbers and the
+    G1 wall clock timestamp are masked, as each call advances/reads them), and
+    the fixed-point readings are checked against the former float decoding
+    printed with %.2f/%.3f for every possible advert byte.
+
+    Run with: make bench
+*/
+#define BENCH_PACKETS                             (4096u)
+#define BENCH_ITERATIONS                          (200000u)
+#define BENCH_URL_BUFF_LEN                        (256u)
+
+using namespace std;
+
+/* Blank out the value of key (up to the next '&'), it legitimately differs between two calls */
+static string maskUrlValue(string url, const char *key) {
+    size_t pos = url.find(key);
+    if (pos != string::npos) {
+        pos += strlen(key);
+        size_t end = url.find('&', pos);
+        url.replace(pos, (end == string::npos ? url.size() : end) - pos, "#");
+    }
+    return url;
+}
+
+/* The integer formatting matches the former float decoding for every advert byte value */
+static bool verifyFixedPoint(void) {
+    char expected[32];
+    char actual[32];
+    for (int hi = 0; hi < 256; hi++) {
+        for (int lo = 0; lo < 256; lo++) {
+            int16_t centi = (int16_t)(hi * TAPE_TEMP_CENTI_PER_DEGREE + lo);
+            snprintf(expected, sizeof(expected), "%.2f", (float)hi + (float)lo / 100.0f);
+            snprintf(actual, sizeof(actual), "%d.%02d", centi / 100, centi % 100);
+            if (strcmp(expected, actual) != 0) {
+                printf("MISMATCH temperature %d/%d: %s vs %s\n", hi, lo, expected, actual);
+                return false;
+            }
+        }
+
+        snprintf(expected, sizeof(expected), "%.3f", (float)hi / 10.0f);
+        snprintf(actual, sizeof(actual), "%d.%d00", hi / 10, hi % 10);
+        if (strcmp(expected, actual) != 0) {
+            printf("MISMATCH battery %d: %s vs %s\n", hi, expected, actual);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool verifyBuilders(vector<BleDataPacket> &pkts, bool isG1) {
+    char templateBuff[BENCH_URL_BUFF_LEN];
+    char snprintfBuff[BENCH_URL_BUFF_LEN];
+    for (auto &blePkt : pkts) {
+        memset(templateBuff, 0, sizeof(templateBuff));
+        createBleDataUrlExtension(templateBuff, sizeof(templateBuff), &blePkt);
+        createBleDataUrlExtensionSnprintf(snprintfBuff, sizeof(snprintfBuff), &blePkt);
+
+        string a = maskUrlValue(templateBuff, "&C=");
+        string b = maskUrlValue(snprintfBuff, "&C=");
+        if (isG1) {
+            a = maskUrlValue(a, "&ts=");
+            b = maskUrlValue(b, "&ts=");
+        }
+        if (a != b) {
+            printf("MISMATCH\n  template: %s\n  snprintf: %s\n", templateBuff, snprintfBuff);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool runUrlBuilderBench(const char *curlReqFormat) {
+    gwCfg.curlReqFormat = curlReqFormat;
+    if (!urlBuilderInit()) {
+        printf("%-10s template compilation failed\n", curlReqFormat);
+        return false;
+    }
+
+    vector<BleDataPacket> pkts(BENCH_PACKETS);
+    for (size_t i = 0; i < pkts.size(); i++) {
+        fillBenchPacket(&pkts[i], (BlePacketType)(QuartzSensor_TMP117 + (int)(i % 4)));
+    }
+
+    bool isG1 = (strcmp(curlReqFormat, "G1") == 0);
+    if (!verifyBuilders(pkts, isG1)) {
+        return false;
+    }
+
+    static char urlBuff[BENCH_URL_BUFF_LEN];
+    size_t sink = 0;
+    double snprintfNs = runBenchNsecsPerOp(BENCH_ITERATIONS, [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            createBleDataUrlExtensionSnprintf(urlBuff, sizeof(urlBuff), &pkts[i % BENCH_PACKETS]);
+            sink += (size_t)urlBuff[5];
+        }
+    });
+    double templateNs = runBenchNsecsPerOp(BENCH_ITERATIONS, [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            createBleDataUrlExtension(urlBuff, sizeof(urlBuff), &pkts[i % BENCH_PACKETS]);
+            sink += (size_t)urlBuff[5];
+        }
+    });
+
+    char fullUrl[MAX_URL_LEN];
+    size_t extLen = strlen(urlBuff);
+    double fullUrlNs = runBenchNsecsPerOp(BENCH_ITERATIONS, [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            sink += buildCloudDataUrl(fullUrl, sizeof(fullUrl), urlBuff, extLen, 0);
+        }
+    });
+
+    printf("%-10s snprintf %8.1f ns/record   template %8.1f ns/record   speedup %5.2fx   +base URL %6.1f ns  (%zu)\n",
+           curlReqFormat, snprintfNs, templateNs, snprintfNs / templateNs, fullUrlNs, sink & 1);
+    return true;
+}
+
+int main(void) {
+    gwCfg.gwId = "D83ADD38A39C";
+    gwCfg.gwLat = "47.639722";
+    gwCfg.gwLon = "-122.128333";
+    urlCfg.instance = "https://trk-mt-v2-ppe.azure-api.net/ingress/v1";
+    urlCfg.urlExtension = "/proxencoded";
+
+    if (!verifyFixedPoint()) {
+        return 1;
+    }
+
+    bool ok = runUrlBuilderBench("G1") && runUrlBuilderBench("Formatted");
+    return ok ? 0 : 1;
+}
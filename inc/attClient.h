@@ -0,0 +1,185 @@
+#ifndef _ATTCLIENT_H_
+#define _ATTCLIENT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+    Minimal ATT client that pulls the stored log of a connectable tape over
+    the ATT channel opened by the connection engine (bleConnEngine.h).
+
+    A session runs as a state machine on the non-blocking socket:
+
+        1. Exchange MTU (ATT_CLIENT_MTU), so one PDU carries up to MTU-3 bytes.
+        2. Read By Type over the characteristic declarations until the log
+           characteristic (ble_log_char_uuid) is found.
+        3. With the notify property: Find Information for its CCCD, enable
+           notifications, and take the log as back-to-back notifications.
+           ATT allows one outstanding request per bearer, so notifications are
+           what keeps the link busy: the tape streams every connection event
+           without waiting for a request. An empty notification, or
+           ATT_LOG_IDLE_MSECS without one, ends the log.
+        4. Without it: Read, then Read Blob at growing offsets until a short
+           response (at most the 512 byte attribute value limit).
+
+    The log value is a sequence of WHITE_TAPE_DATA_PACKET_LEN byte records,
+    the payload the tape advertises; records may span PDUs. Every complete
+    record is handed to the session's callback. The whole session must end
+    within ble_log_read_timeout_ms, the time a tape is expected in range.
+
+    A persistent session (ble_persistent_tapes) does not end with the log:
+    once subscribed it has no deadline and no idle time, and keeps handing
+    the notifications to the callback until the tape disconnects.
+
+    A write session (bleConfigPush.h) finds its characteristic the same way
+    and writes a value to it: one Write Request when the value fits the MTU,
+    otherwise Prepare Write Requests checked against their echo and an
+    Execute Write, so the tape applies a long value whole or not at all.
+
+    All functions are called from the BLE connect thread.
+*/
+#define ATT_CLIENT_MTU                            (247u)
+#define ATT_DEFAULT_MTU                           (23u)
+#define ATT_MAX_PDU_LEN                           (ATT_CLIENT_MTU + 1u)
+#define ATT_MAX_VALUE_LEN                         (512u)
+#define ATT_LOG_IDLE_MSECS                        (1000u)
+
+/* ATT opcodes (Bluetooth Core, Vol 3, Part F, 3.4.8) */
+#define ATT_OP_ERROR_RSP                          (0x01)
+#define ATT_OP_MTU_REQ                            (0x02)
+#define ATT_OP_MTU_RSP                            (0x03)
+#define ATT_OP_FIND_INFO_REQ                      (0x04)
+#define ATT_OP_FIND_INFO_RSP                      (0x05)
+#define ATT_OP_READ_BY_TYPE_REQ                   (0x08)
+#define ATT_OP_READ_BY_TYPE_RSP                   (0x09)
+#define ATT_OP_READ_REQ                           (0x0A)
+#define ATT_OP_READ_RSP                           (0x0B)
+#define ATT_OP_READ_BLOB_REQ                      (0x0C)
+#define ATT_OP_READ_BLOB_RSP                      (0x0D)
+#define ATT_OP_WRITE_REQ                          (0x12)
+#define ATT_OP_WRITE_RSP                          (0x13)
+#define ATT_OP_PREPARE_WRITE_REQ                  (0x16)
+#define ATT_OP_PREPARE_WRITE_RSP                  (0x17)
+#define ATT_OP_EXECUTE_WRITE_REQ                  (0x18)
+#define ATT_OP_EXECUTE_WRITE_RSP                  (0x19)
+#define ATT_OP_HANDLE_VALUE_NTF                   (0x1B)
+#define ATT_OP_HANDLE_VALUE_IND                   (0x1D)
+#define ATT_OP_HANDLE_VALUE_CFM                   (0x1E)
+#define ATT_OP_COMMAND_FLAG                       (0x40)
+
+#define ATT_ECODE_REQ_NOT_SUPPORTED               (0x06)
+#define ATT_ECODE_ATTR_NOT_FOUND                  (0x0A)
+
+#define ATT_EXEC_WRITE_CANCEL                     (0x00)
+#define ATT_EXEC_WRITE_COMMIT                     (0x01)
+
+#define GATT_UUID_PRIMARY_SERVICE                 (0x2800)
+#define GATT_UUID_SECONDARY_SERVICE               (0x2801)
+#define GATT_UUID_CHARACTERISTIC                  (0x2803)
+#define GATT_UUID_CCCD                            (0x2902)
+#define GATT_CHAR_PROP_READ                       (0x02)
+#define GATT_CHAR_PROP_WRITE                      (0x08)
+#define GATT_CHAR_PROP_NOTIFY                     (0x10)
+#define GATT_CCCD_NOTIFY                          (0x0001)
+
+typedef enum AttSessionState {
+    ATT_STATE_MTU,                       /* Exchange MTU request sent */
+    ATT_STATE_DISCOVER,                  /* Read By Type for characteristic declarations sent */
+    ATT_STATE_FIND_CCCD,                 /* Find Information after the log value handle sent */
+    ATT_STATE_SUBSCRIBE,                 /* CCCD write sent */
+    ATT_STATE_STREAM,                    /* Taking the log as notifications */
+    ATT_STATE_READ,                      /* Read / Read Blob sent */
+    ATT_STATE_WRITE,                     /* Write Request sent */
+    ATT_STATE_PREPARE,                   /* Prepare Write Request sent */
+    ATT_STATE_EXECUTE,                   /* Execute Write Request sent */
+    ATT_STATE_DONE,
+    ATT_STATE_FAILED
+} AttSessionState;
+
+/* Receives every complete log record */
+typedef void (*AttLogRecordCallback)(const std::string &macAddr, const uint8_t *record, size_t len);
+
+typedef struct AttSession {
+    std::string macAddr;
+    int sock;
+    AttSessionState state;
+    AttLogRecordCallback onRecord;
+    bool persistent;                     /* Keep streaming notifications after the log */
+    bool write;                          /* Write writeValue instead of reading the log */
+    const char *charUuid;                /* Characteristic of the session: the log, or the one written */
+    std::vector<uint8_t> writeValue;
+    uint16_t mtu;                        /* Negotiated ATT MTU */
+    uint16_t searchStart;                /* Next handle of the discovery */
+    uint16_t valueHandle;                /* Value handle of the log characteristic, 0 until found */
+    uint8_t properties;                  /* Properties of the log characteristic */
+    uint16_t valueOffset;                /* Offset of the next Read Blob or Prepare Write */
+    uint64_t startMsecs;
+    uint64_t deadlineMsecs;              /* The session fails if it has not ended by then */
+    uint64_t lastRxMsecs;                /* Last PDU received */
+    std::vector<uint8_t> partial;        /* Start of a record whose rest is in the next PDU */
+    uint32_t records;                    /* Complete records delivered */
+    uint64_t valueBytes;                 /* Log bytes received, or value bytes written */
+} AttSession;
+
+/* Log sessions counters */
+typedef struct AttClientStats {
+    uint64_t sessions;                   /* Sessions started */
+    uint64_t completed;                  /* Sessions that read the whole log */
+    uint64_t failed;                     /* Sessions that failed or timed out */
+    uint64_t streams;                    /* Persistent sessions that reached the notification stream */
+    uint64_t records;                    /* Log records delivered */
+    uint64_t valueBytes;                 /* Log bytes received */
+    double transferSecs;                 /* Time spent in completed sessions */
+    uint64_t writes;                     /* Write sessions that wrote their value */
+    uint64_t writeFailures;              /* Write sessions that failed or timed out */
+} AttClientStats;
+
+/**
+ * @brief Starts a log session on a connected ATT socket by sending the MTU exchange.
+ *
+ * @param session  Session to initialise.
+ * @param sock     Connected non-blocking ATT socket; the caller keeps ownership.
+ * @param macAddr  MAC address of the tape.
+ * @param onRecord   Receives every complete log record.
+ * @param persistent Keep streaming notifications until the tape disconnects.
+ * @return true if the session is running, false if it failed right away.
+ */
+bool attSessionStart(AttSession &session, int sock, const std::string &macAddr, AttLogRecordCallback onRecord,
+                     bool persistent);
+
+/**
+ * @brief Starts a write session on a connected ATT socket by sending the MTU exchange.
+ *
+ * @param session  Session to initialise.
+ * @param sock     Connected non-blocking ATT socket; the caller keeps ownership.
+ * @param macAddr  MAC address of the tape.
+ * @param charUuid UUID of the characteristic to write.
+ * @param value    Value to write, 1 to ATT_MAX_VALUE_LEN bytes.
+ * @return true if the session is running, false if it failed right away.
+ */
+bool attSessionStartWrite(AttSession &session, int sock, const std::string &macAddr, const char *charUuid,
+                          const std::vector<uint8_t> &value);
+
+/**
+ * @brief Reads the pending PDUs of the session's socket and advances it.
+ *
+ * @return true while the session is running, false once it is done or failed.
+ */
+bool attSessionProcess(AttSession &session);
+
+/**
+ * @brief Applies the session deadline and the end-of-log idle time.
+ *
+ * @return true while the session is running, false once it is done or failed.
+ */
+bool attSessionCheckTimeout(AttSession &session, uint64_t nowMsecs);
+
+/* Milliseconds until attSessionCheckTimeout() may end the session */
+uint32_t attSessionMsecsUntilTimeout(const AttSession &session, uint64_t nowMsecs);
+
+/* Copy the log session counters */
+void getAttClientStats(AttClientStats *stats);
+
+#endif /* _ATTCLIENT_H_ */
@@ -42,7 +42,6 @@ typedef struct {
     device_type_t deviceType;
 } BleScanRecord;
 
-extern std::condition_variable tapeListCondVar;
 typedef bool (*ScanResultCallback)(std::map<std::string, BleScanRecord> &);
 
 void startContinuousScan(uint32_t scanDurationSec, uint32_t sleepDurationSec);
@@ -59,25 +58,41 @@ bool isNotDuplicateBleData(le_advertising_info *info, map<string, BleScanRecord>
  * @brief Checks if a scanned BLE advertisement corresponds to a connectable tape.
  *
  * This function extracts the MAC address from the BLE advertising information (`le_advertising_info`)
- * and looks it up in the map of connectable tapes. If the tape is found and its cooldown period has
- * expired (i.e., enough time has passed since the last transmission), the function marks it as
- * "found" so that a BLE connection can be established later.
+ * and looks it up in the map of connectable tapes. If the tape is found, the sighting is handed to the
+ * connection scheduler (bleConnSched.h) without taking a lock; the scheduler connects once the tape's
+ * backoff and cooldown period have expired.
  *
  * @param[in] info Pointer to the BLE advertising information structure received during scanning.
  *                 Must contain a valid Blxuetooth address.
  *
- * @return true if the scanned device corresponds to a valid connectable tape and its cooldown period
- *         has expired; false otherwise.
+ * @return true if the scanned device corresponds to a connectable tape whose sighting was queued;
+ *         false otherwise (unknown tape, or a sighting of it is already queued).
  */
 bool checkIfConnectableTape(le_advertising_info* info);
 
+struct sockaddr_l2;
+
+/**
+ * @brief Opens an L2CAP socket bound to the gateway adapter on the ATT channel.
+ *
+ * @param[in] sec         Desired Bluetooth security level (BT_SECURITY_LOW, ...).
+ * @param[in] nonBlocking Open the socket with SOCK_NONBLOCK, for the connection engine.
+ *
+ * @return int Socket file descriptor, or -1 on failure (errno is kept).
+ */
+int openBleAttSocket(int sec, bool nonBlocking);
+
+/* Fill the ATT channel address of a remote BLE device */
+void fillBleAttAddr(struct sockaddr_l2 *dstaddr, const char *dstMacAddr, uint8_t dst_type);
+
 /**
  * @brief Initiates a Bluetooth LE connection to a remote BLE device by MAC address.
  *
  * This function establishes a BLE L2CAP connection on the ATT (Attribute) channel
  * using the specified Bluetooth MAC address of a remote device. It opens a BLE L2CAP
  * socket, binds it to the local adapter, applies the desired security level, and
- * connects to the remote device over the ATT CID (0x0004).
+ * connects to the remote device over the ATT CID (0x0004). The call blocks until the
+ * kernel connect timeout; the connect thread uses the non-blocking engine instead.
  *
  * @param[in] dstMacAddr MAC address of the destination BLE device in string format.
  *                       Must be a valid 17-character colon-separated address.
@@ -93,10 +108,14 @@ int connectToBleTape(const std::string dstMacAddr, uint8_t dst_type = BDADDR_LE_
 /**
  * @brief Thread function that attempts BLE connections to known connectable tapes.
  *
- * This function runs in a loop, waiting for connectable tapes to be marked (via `tapeFound`)
- * by the BLE scan thread. When a tape is ready, it attempts to establish a BLE connection.
- * Connection results update the tape's retry count, backoff delay, and last sent timestamp.
- * Uses a condition variable to efficiently sleep until new connection candidates are available.
+ * This function runs in a loop, taking the sightings the BLE scan thread hands over through the
+ * connection scheduler's lock-free queue, and connecting to the tapes in the order their backoff
+ * and cooldown expire (bleConnSched.h). Connects run in parallel on the non-blocking connection
+ * engine (bleConnEngine.h), up to ble_connect_max_parallel at once.
+ * Connection results update the tape's retry count, backoff delay, and next eligible time.
+ * The connections of persistent tapes (ble_persistent_tapes) stay open and stream notifications
+ * until the tape disconnects. The scan/connect arbiter (bleArbiter.h) decides when connects may
+ * start and how the scan yields to them.
  *
  * @note This function is intended to be run in its own thread.
  */
@@ -0,0 +1,119 @@
+#ifndef _BLEARBITER_H_
+#define _BLEARBITER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+    Scan/connect arbiter for the one controller shared by the scan thread
+    and the BLE connect thread.
+
+    The controller time-shares its radio between the scanner and the
+    initiator of a pending connect, so every connect costs scan time and
+    adverts are missed. ble_coex_policy decides how the two are coordinated:
+
+        concurrent  Connects start whenever a tape is due and the scan is
+                    left alone (the behaviour without an arbiter).
+        interleave  Connects only start in the first ble_coex_connect_window_ms
+                    of every ble_coex_period_ms, and while connects are
+                    pending the scan window shrinks to
+                    BLE_COEX_REDUCED_SCAN_WINDOW, leaving the initiator the
+                    rest of each scan interval.
+        priority    As interleave for routine tapes; the connects of the
+                    persistent tapes start at any time and pause the scan
+                    until they finish, at most ble_coex_max_pause_ms.
+        rotate      Cycles through the three every ble_coex_rotate_s, so
+                    their costs can be compared on the same site.
+
+    The cost is measured per policy. Every scan cycle reports how many
+    distinct tapes it heard and how much of its scan time was contended
+    (connects pending, scan reduced or paused); comparing the tapes heard in
+    contended and clean cycles gives the advert loss, i.e. the broadcast
+    coverage that connecting costs. The connect latency runs from the
+    moment a tape was due to the end of its connect, so it includes the
+    wait for a connect window.
+
+    The scan mode and the contended time are atomics, read by the scan
+    thread; the counters are guarded by the arbiter's mutex.
+*/
+#define BLE_COEX_POLICY_CONCURRENT                "concurrent"
+#define BLE_COEX_POLICY_INTERLEAVE                "interleave"
+#define BLE_COEX_POLICY_PRIORITY                  "priority"
+#define BLE_COEX_POLICY_ROTATE                    "rotate"
+
+/* Scan interval and windows in 0.625 ms units: 40 ms interval, 30 ms window at full duty, 10 ms reduced */
+#define BLE_COEX_SCAN_INTERVAL                    (0x0040)
+#define BLE_COEX_FULL_SCAN_WINDOW                 (0x0030)
+#define BLE_COEX_REDUCED_SCAN_WINDOW              (0x0010)
+
+/* The scan thread applies scan mode changes this often */
+#define BLE_COEX_SCAN_POLL_MSECS                  (100u)
+
+typedef enum BleCoexPolicy {
+    BLE_COEX_CONCURRENT = 0,
+    BLE_COEX_INTERLEAVE,
+    BLE_COEX_PRIORITY,
+    BLE_COEX_POLICY_COUNT
+} BleCoexPolicy;
+
+typedef enum BleScanMode {
+    BLE_SCAN_MODE_FULL = 0,
+    BLE_SCAN_MODE_REDUCED,
+    BLE_SCAN_MODE_PAUSED
+} BleScanMode;
+
+/* Costs measured under one policy */
+typedef struct BleArbiterStats {
+    uint64_t cleanCycles;                /* Scan cycles without contention */
+    uint64_t cleanTapes;                 /* Distinct tapes heard in them */
+    uint64_t busyCycles;                 /* Scan cycles with contended scan time */
+    uint64_t busyTapes;                  /* Distinct tapes heard in them */
+    uint64_t scanMsecs;                  /* Scan time */
+    uint64_t busyMsecs;                  /* Contended part of the scan time */
+    uint64_t connects;                   /* Connects that succeeded */
+    uint64_t connectFailures;            /* Connects that failed or timed out */
+    uint64_t latencyMsecsSum;            /* Due to connected, successful connects */
+    uint64_t latencyMsecsMax;
+    uint64_t pauses;                     /* Scan pauses for priority connects */
+} BleArbiterStats;
+
+/* Start the policy clock. Called by the connect thread before its loop. */
+void bleArbiterInit(uint64_t nowMsecs);
+
+/* Policy in force */
+BleCoexPolicy bleArbiterPolicy(void);
+
+/* Returns true if a connect may start now; highPriority for the persistent tapes */
+bool bleArbiterMayConnect(uint64_t nowMsecs, bool highPriority);
+
+/* Milliseconds until the next connect window opens, 0 while it is open */
+uint32_t bleArbiterMsecsUntilWindow(uint64_t nowMsecs);
+
+/**
+ * @brief Connect thread: sets the scan mode for the connects in flight and accounts the contended time.
+ *
+ * @param nowMsecs        Monotonic time.
+ * @param inFlight        Connects pending.
+ * @param priorityPending Connects of persistent tapes among them.
+ */
+void bleArbiterUpdate(uint64_t nowMsecs, size_t inFlight, size_t priorityPending);
+
+/* Connect thread: outcome of a connect, latencyMsecs from the moment the tape was due */
+void bleArbiterNoteConnect(uint64_t latencyMsecs, bool success);
+
+/* Scan thread: scan mode to apply */
+BleScanMode bleArbiterScanMode(void);
+
+/* Scan thread: contended milliseconds so far, to be diffed over a scan cycle */
+uint64_t bleArbiterBusyMsecs(void);
+
+/* Scan thread: a scan cycle ended */
+void bleArbiterNoteScanCycle(uint64_t scanMsecs, uint64_t busyMsecs, size_t distinctTapes);
+
+/* Copy the costs measured under a policy */
+void getBleArbiterStats(BleCoexPolicy policy, BleArbiterStats *stats);
+
+/* Log advert loss and connect latency of every policy that ran */
+void logBleArbiterStats(void);
+
+#endif /* _BLEARBITER_H_ */
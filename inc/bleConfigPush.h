@@ -0,0 +1,86 @@
+#ifndef _BLECONFIGPUSH_H_
+#define _BLECONFIGPUSH_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "config.h"
+
+/*
+    Bulk configuration push of the BLE connect thread.
+
+    A job writes one value (ble_config_push_value) to one characteristic
+    (ble_config_push_char_uuid) of every target tape. The targets are
+    ordinary entries of tapeList, so the job rides on the connect path that
+    already exists: the scan thread reports their sightings, the scheduler
+    orders them, the connection engine connects up to
+    ble_connect_max_parallel of them at once and the arbiter fits the
+    connects around the scan. A connected target gets a write session
+    (attClient.h) instead of the log read. A warehouse of tapes is written
+    as fast as the tapes come into range, in parallel, instead of one
+    blocking connect after the other.
+
+    A failed connect or write counts as an attempt and the tape waits a
+    backoff before the next one: the connect backoff after a failed connect,
+    the backoff of the target's own attempt count after a failed write; after ble_config_push_max_attempts
+    the tape is given up. Each target is pending, done or failed.
+
+    The state of every target is kept in ble_config_push_state_file, one
+    "<mac> <state> <attempts>" line each after a "job <id>" line, where the
+    id hashes the UUID and the value. The file is replaced (written to a
+    temporary file, synced and renamed) at most every
+    BLE_PUSH_STATE_FLUSH_MSECS while targets change, and when the thread
+    exits. A restart with the same job resumes it: done and failed targets
+    are not written again. A crash loses at most the last flush interval,
+    whose tapes are written a second time with the same value.
+
+    All functions are called from the BLE connect thread.
+*/
+#define BLE_PUSH_STATE_FLUSH_MSECS                (1000u)
+#define BLE_PUSH_STATE_PATH_LEN                   (256u)
+
+typedef enum BlePushState {
+    BLE_PUSH_PENDING = 0,
+    BLE_PUSH_DONE,
+    BLE_PUSH_FAILED
+} BlePushState;
+
+/* Progress of the job */
+typedef struct BlePushStats {
+    size_t targets;                      /* Tapes of the job */
+    size_t done;                         /* Tapes written */
+    size_t failed;                       /* Tapes given up after ble_config_push_max_attempts */
+    size_t resumed;                      /* Tapes already done or failed in the state file */
+    uint64_t attempts;                   /* Connects and writes since the start */
+    uint64_t elapsedMsecs;               /* Time since the start */
+} BlePushStats;
+
+/* Decode the job, resume it from the state file and mark the pending targets. Returns false without a job. */
+bool bleConfigPushInit(uint64_t nowMsecs);
+
+/* Value the job writes */
+const std::vector<uint8_t> &bleConfigPushValue(void);
+
+/**
+ * @brief Records the outcome of a connect or write to a target of the job.
+ *
+ * @param tape     Target tape; a tape the job does not write is ignored.
+ * @param success  True if the value was written.
+ * @param nowMsecs Monotonic time of the outcome.
+ * @return true if the tape stays pending and is retried after the connect backoff.
+ */
+bool bleConfigPushNoteResult(tapeConfig *tape, bool success, uint64_t nowMsecs);
+
+/* Connects and writes of the tape for the job so far, 0 for a tape the job does not write */
+int bleConfigPushAttempts(const tapeConfig *tape);
+
+/* Replace the state file if targets changed, at most every BLE_PUSH_STATE_FLUSH_MSECS unless forced */
+void bleConfigPushFlush(uint64_t nowMsecs, bool force);
+
+/* Copy the progress of the job */
+void getBleConfigPushStats(BlePushStats *stats, uint64_t nowMsecs);
+
+/* Log the progress, the write rate and the time left at that rate */
+void logBleConfigPushStats(uint64_t nowMsecs);
+
+#endif /* _BLECONFIGPUSH_H_ */
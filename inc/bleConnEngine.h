@@ -0,0 +1,102 @@
+#ifndef _BLECONNENGINE_H_
+#define _BLECONNENGINE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+    Non-blocking L2CAP connection engine of the BLE connect thread.
+
+    Connects to the ATT channel of the connectable tapes are started on
+    non-blocking sockets and completed through one epoll instance, so an
+    unreachable tape only occupies one of the ble_connect_max_parallel slots
+    (set it to the LE connection slots of the controller) until its
+    ble_connect_timeout_ms expires, instead of stalling every other tape.
+    A timed out attempt is aborted by closing its socket, which also cancels
+    the pending LE connection in the kernel.
+
+    A connected socket is handed to the caller, still non-blocking, who owns
+    and closes it; the engine closes the sockets of failed, timed out and
+    abandoned attempts. The caller may add connected sockets to the epoll
+    instance (bleConnEngineWatch()), so one wait covers the pending connects
+    and the traffic on the established connections.
+
+    All functions are called from the BLE connect thread.
+*/
+#define BLE_CONN_MAX_PARALLEL                     (16u)
+#define BLE_CONN_MAX_EVENTS                       (32u)
+#define BLE_CONN_POLL_MSECS                       (100u)
+#define BLE_CONN_STATS_LOG_SECS                   (60u)
+#define BLE_CONN_HIST_BUCKETS                     (8u)
+
+/* Upper bounds in ms of the time-to-connect histogram buckets; the last bucket has no bound */
+#define BLE_CONN_HIST_BOUNDS_MSECS                {100u, 250u, 500u, 1000u, 2000u, 5000u, 10000u, UINT32_MAX}
+
+/* Outcome of a finished connection attempt */
+typedef struct BleConnResult {
+    std::string macAddr;
+    int sock;                            /* Connected socket, owned by the caller; -1 on failure */
+    int err;                             /* 0, errno of the failed connect, or ETIMEDOUT */
+    uint32_t connectMsecs;               /* Time from the start of the attempt to its outcome */
+} BleConnResult;
+
+/* Connection engine counters */
+typedef struct BleConnStats {
+    uint64_t attempts;                   /* Connects started */
+    uint64_t connected;                  /* Connects that succeeded */
+    uint64_t failed;                     /* Connects refused or failed before the timeout */
+    uint64_t timedOut;                   /* Connects aborted after ble_connect_timeout_ms */
+    uint64_t connectHist[BLE_CONN_HIST_BUCKETS];   /* Time to connect of the successful connects */
+    size_t inFlight;                     /* Connects pending right now */
+} BleConnStats;
+
+/* Create the epoll instance. Returns false on failure. */
+bool bleConnEngineInit(void);
+
+/* Returns true while another connect can be started */
+bool bleConnEngineHasFreeSlot(void);
+
+/* Returns true while a connect to macAddr is pending */
+bool bleConnEngineIsPending(const std::string &macAddr);
+
+/* Number of connects pending */
+size_t bleConnEngineInFlight(void);
+
+/**
+ * @brief Starts a non-blocking connect to the ATT channel of a tape.
+ *
+ * @param macAddr  Colon-separated MAC address of the tape.
+ * @param dstType  Address type of the tape (BDADDR_LE_PUBLIC or BDADDR_LE_RANDOM).
+ * @param secLevel Bluetooth security level (BT_SECURITY_LOW, ...).
+ * @param results  Receives the outcome if the attempt finishes right away (immediate connect or error).
+ * @return true if the attempt was started or finished, false if no slot is free or it is already pending.
+ */
+bool bleConnEngineStart(const std::string &macAddr, uint8_t dstType, int secLevel,
+                        std::vector<BleConnResult> &results);
+
+/* Report a connected socket in the readyFds of bleConnEnginePoll() while it is readable */
+bool bleConnEngineWatch(int sock);
+
+/* Stop watching a connected socket; call before closing it */
+void bleConnEngineUnwatch(int sock);
+
+/**
+ * @brief Waits up to timeoutMsecs, bounded by the nearest attempt timeout, and collects the
+ *        attempts that finished or timed out and the watched sockets that are readable.
+ *
+ * @return Number of results appended.
+ */
+size_t bleConnEnginePoll(uint32_t timeoutMsecs, std::vector<BleConnResult> &results, std::vector<int> &readyFds);
+
+/* Copy the connection engine counters */
+void getBleConnStats(BleConnStats *stats);
+
+/* Log connects/sec since the last call and the time-to-connect histogram */
+void logBleConnStats(void);
+
+/* Abort the pending connects and close the epoll instance. Called once when the thread exits. */
+void bleConnEngineClose(void);
+
+#endif /* _BLECONNENGINE_H_ */
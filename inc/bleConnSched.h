@@ -0,0 +1,81 @@
+#ifndef _BLECONNSCHED_H_
+#define _BLECONNSCHED_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "config.h"
+
+/*
+    Deadline-ordered connection scheduler of the BLE connect thread.
+
+    The scan thread reports sightings of connectable tapes through
+    bleConnSchedNoteSighting(): it only looks the tape up in tapeList, whose
+    entries are created before the threads start and never added or removed
+    afterwards, and pushes the entry onto a single-producer single-consumer
+    ring, then wakes the connect thread through an eventfd. A tape with a
+    sighting already in the ring (tapeFound set) is not pushed again, so the
+    ring, sized to the tape count, cannot overflow. The scan thread never
+    takes a lock.
+
+    The connect thread owns every other field of the entries. It drains the
+    ring into a min-heap keyed by each tape's next eligible time, and pops
+    the tapes that are due while the connection engine has a free slot:
+    O(log n) per sighting and per connect, whatever the number of tapes.
+    Persistent tapes have a heap of their own, so the scan/connect arbiter
+    (bleArbiter.h) can let them connect outside the connect windows.
+    A due tape that has not been seen for BLE_CONN_SCHED_SIGHTING_TTL_MSECS
+    has left the range and is dropped until its next sighting.
+
+    After a failed connect the tape waits an exponential backoff with
+    jitter, random in [c/2, c] with
+    c = min(ble_connect_backoff_max_ms, ble_connect_backoff_base_ms * 2^(failures - 1)),
+    so tapes that failed together do not retry in lockstep. Any attempt also
+    holds the tape back for ble_read_tape_again_delay.
+*/
+#define BLE_CONN_SCHED_SIGHTING_TTL_MSECS         (10000u)
+#define BLE_CONN_SCHED_MAX_WAIT_MSECS             (1000u)
+
+/* Connection scheduler counters */
+typedef struct BleConnSchedStats {
+    uint64_t sightings;                  /* Sightings handed over by the scan thread */
+    uint64_t dropped;                    /* Sightings lost because the ring was full */
+    uint64_t scheduled;                  /* Tapes put on the heap */
+    uint64_t expired;                    /* Due tapes dropped because they were no longer seen */
+    uint64_t started;                    /* Due tapes handed out for a connect */
+    size_t heapSize;                     /* Tapes waiting on the heap right now */
+} BleConnSchedStats;
+
+/* Create the ring and the wakeup eventfd. Called from the connect thread once tapeList is loaded. */
+bool bleConnSchedInit(void);
+
+/* Eventfd that becomes readable when sightings are waiting; watched by the connection engine */
+int bleConnSchedWakeFd(void);
+
+/* Wake the connect thread; async-signal-safe, used on shutdown */
+void bleConnSchedWake(void);
+
+/* Scan thread: report a sighting of a connectable tape. Returns false if it was already queued or dropped. */
+bool bleConnSchedNoteSighting(tapeConfig *tape);
+
+/* Move the queued sightings onto the heap. Returns the number of sightings taken. */
+size_t bleConnSchedDrain(uint64_t nowMsecs);
+
+/* Pop the next due tape, persistent tapes first, marked busy; nullptr if none of the included ones is due */
+tapeConfig *bleConnSchedPopDue(uint64_t nowMsecs, bool includePriority, bool includeNormal);
+
+/* Milliseconds until the next persistent (priority) or routine tape is due, at most maxMsecs */
+uint32_t bleConnSchedMsecsUntilDue(uint64_t nowMsecs, uint32_t maxMsecs, bool priority);
+
+/* Jittered backoff in ms after retryCount consecutive failed connects */
+int bleConnSchedBackoffMsecs(int retryCount);
+
+/* The connect or log read of a busy tape ended; its next sighting schedules it again */
+void bleConnSchedRelease(tapeConfig *tape);
+
+/* Copy the scheduler counters */
+void getBleConnSchedStats(BleConnSchedStats *stats);
+
+/* Close the wakeup eventfd. Called once after the scan and connect threads are joined. */
+void bleConnSchedClose(void);
+
+#endif /* _BLECONNSCHED_H_ */
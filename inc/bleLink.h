@@ -0,0 +1,103 @@
+#ifndef _BLELINK_H_
+#define _BLELINK_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "config.h"
+
+/*
+    Link layer tuning of the tape connections, over the HCI device.
+
+    Once a tape is connected the connect thread asks its controller for the
+    LE 2M PHY (LE Set PHY) and for the largest link layer payload (LE Set
+    Data Length, 251 bytes), each only when the gateway's controller
+    supports the feature. The tape's controller accepts, or answers with
+    what it supports: a tape without 2M stays on 1M, a tape without Data
+    Length Extension keeps 27 byte payloads, and the connection works either
+    way. LE Connection Update requests of the persistent tapes go through
+    the same HCI device. These commands are sent without waiting for the
+    controller, so tuning a tape never blocks the connect thread; a refusal
+    comes back as a Command Status or Command Complete event and is logged
+    against the tape that was tuned.
+
+    The outcome is read from the LE Data Length Change and LE PHY Update
+    Complete events on a raw HCI socket, watched by the connection engine's
+    epoll instance. A Connection Complete event resets the link of its
+    handle, so the events the controller raises before the connect thread
+    sees the socket are kept, and the link stays readable after the
+    disconnection until the handle is reused. The socket also gets every LE
+    advertising report while the scan runs; those are counted and dropped
+    before anything else.
+
+    All functions are called from the BLE connect thread.
+*/
+#define BLE_LINK_CMD_TIMEOUT_MSECS                (1000)     /* Only for reading the features at init */
+#define BLE_LINK_MAX_PENDING_CMDS                 (16u)
+#define BLE_LINK_MAX_TX_OCTETS                    (251u)
+#define BLE_LINK_MAX_TX_TIME_USECS                (2120u)
+#define BLE_LINK_DEF_OCTETS                       (27u)
+
+/* PHY values of LE Set PHY and LE PHY Update Complete */
+#define BLE_LINK_PHY_1M                           (1u)
+#define BLE_LINK_PHY_2M                           (2u)
+#define BLE_LINK_PHY_CODED                        (3u)
+
+/* HCI LE commands and LE meta subevents missing from the BlueZ headers */
+#define BLE_LINK_OCF_LE_SET_DATA_LENGTH           (0x0022)
+#define BLE_LINK_OCF_LE_SET_PHY                   (0x0032)
+#define BLE_LINK_EVT_LE_DATA_LENGTH_CHANGE        (0x07)
+#define BLE_LINK_EVT_LE_ENH_CONN_COMPLETE         (0x0A)
+#define BLE_LINK_EVT_LE_EXT_ADV_REPORT            (0x0D)
+#define BLE_LINK_EVT_LE_PHY_UPDATE_COMPLETE       (0x0C)
+
+/* LE feature bits of the gateway's controller */
+#define BLE_LINK_FEATURE_DLE                      (1u << 5)
+#define BLE_LINK_FEATURE_2M_PHY                   (1u << 8)
+
+/* Link of a connection as the controllers agreed on it */
+typedef struct BleLinkParams {
+    uint16_t txOctets;                   /* Largest link layer payload sent */
+    uint16_t rxOctets;                   /* Largest link layer payload received */
+    uint8_t txPhy;                       /* BLE_LINK_PHY_* */
+    uint8_t rxPhy;
+} BleLinkParams;
+
+/* Link negotiation counters */
+typedef struct BleLinkStats {
+    uint64_t dleRequested;               /* LE Set Data Length sent */
+    uint64_t dleChanged;                 /* Data Length Change events to more than 27 bytes */
+    uint64_t phyRequested;               /* LE Set PHY sent */
+    uint64_t phy2M;                      /* PHY updates that ended on 2M both ways */
+    uint64_t phyFallback;                /* PHY updates refused or left on 1M */
+    uint64_t cmdFailed;                  /* Commands not sent or rejected by the gateway's controller */
+    uint64_t advDropped;                 /* LE advertising reports read from the event socket and dropped */
+} BleLinkStats;
+
+/* Open the HCI device and the event socket, and read the controller's LE features */
+bool bleLinkInit(void);
+
+/* Raw HCI event socket, watched by the connection engine; -1 if it could not be opened */
+int bleLinkEventFd(void);
+
+/* Read the pending HCI events */
+void bleLinkProcessEvents(void);
+
+/* Connection handle of a connected ATT socket. Returns false if the kernel does not report it. */
+bool bleLinkGetHandle(int sock, uint16_t *handle);
+
+/* Ask for the 2M PHY and the longest data length, as far as the gateway's controller supports them */
+void bleLinkNegotiate(uint16_t handle, const tapeConfig *tape);
+
+/* Request the LE connection parameters of a persistent tape; nothing if it has none */
+void bleLinkUpdateConnParams(uint16_t handle, const tapeConfig *tape);
+
+/* Link of a connection, 1M / 27 bytes until the controller reports otherwise. Returns false if unknown. */
+bool bleLinkGetParams(uint16_t handle, BleLinkParams *params);
+
+/* Copy the link negotiation counters */
+void getBleLinkStats(BleLinkStats *stats);
+
+/* Close the HCI device and the event socket. Called once when the connect thread exits. */
+void bleLinkClose(void);
+
+#endif /* _BLELINK_H_ */
@@ -3,16 +3,141 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <string>
 
 #define CURL_REQUEST_TIMEOUT_SECS                 (30)
 #define CURL_REQUEST_DNS_CACHE_TIMEOUT_SECS       (600L)
+#define CURL_MAX_PARALLEL_REQUESTS                (8u)
+#define CURL_MULTI_POLL_TIMEOUT_MSECS             (1000)
+#define CURL_CONN_STATS_LOG_INTERVAL              (100u)
 #define MAX_URL_LEN                               (512)
+#define CLOUD_RESPONSE_MAX_LEN                    (4096u)
+
+/* Throttling hints a response may carry as HTTP headers (see uplinkThrottle.h) */
+#define CLOUD_HINT_HDR_RETRY_AFTER                "Retry-After"
+#define CLOUD_HINT_HDR_CONCURRENCY                "X-Trk-Concurrency"
+#define CLOUD_HINT_HDR_BATCH_MAX                  "X-Trk-Batch-Max"
+#define CLOUD_HINT_HDR_REPORT_INTERVAL            "X-Trk-Report-Interval"
+
+/* The same hints as key=value pairs in the response body, e.g. "ok;concurrency=2;retry_after=60" */
+#define CLOUD_HINT_KEY_RETRY_AFTER                "retry_after="
+#define CLOUD_HINT_KEY_CONCURRENCY                "concurrency="
+#define CLOUD_HINT_KEY_BATCH_MAX                  "batch_max="
+#define CLOUD_HINT_KEY_REPORT_INTERVAL            "report_interval="
 
 #define FACTORY_INSTANCE                          "https://trksbxmanuf.azure-api.net/internal"
 #define URL_CREATE_SUCCESS                        (1)
 
-/* Send the data URL to the cloud */
+/* Throttling hints of one response; -1 when the response did not carry the hint */
+typedef struct CloudResponseHints {
+    int32_t retryAfterSecs = -1;         /* Seconds to pause the whole uplink */
+    int32_t concurrency = -1;            /* Parallel requests the server accepts */
+    int32_t batchMaxRecords = -1;        /* Records per batch the server accepts */
+    int32_t reportIntervalSecs = -1;     /* Seconds between two uploads of the same tape */
+} CloudResponseHints;
+
+/*
+    A single request handed to the connection manager. The caller owns the
+    URL buffer; the result fields are filled in once the transfer finishes.
+*/
+typedef struct CloudRequest {
+    const char *url = nullptr;           /* Full request URL */
+    const char *body = nullptr;          /* POST body, nullptr for a GET request */
+    size_t bodyLen = 0;                  /* Length of the POST body */
+    const char *contentType = nullptr;   /* Content-Type header of the POST body */
+    const char *contentEncoding = nullptr; /* Content-Encoding header of the POST body, if compressed */
+    const char *heartbeat = nullptr;     /* Heartbeat report piggybacked as a request header, if any */
+    int endpoint = -1;                   /* Uplink endpoint the URL points to, -1 for none */
+    bool headOnly = false;               /* HEAD request without a body (endpoint probe) */
+    long httpCode = 0;                   /* HTTP response code, 0 if no response */
+    int curlCode = 0;                    /* CURLcode of the transfer */
+    double totalTimeSecs = 0.0;          /* Total transfer time */
+    std::string response;                /* Response body, truncated at CLOUD_RESPONSE_MAX_LEN */
+    CloudResponseHints hints;            /* Throttling hints from the response headers and body */
+} CloudRequest;
+
+/* Connection reuse statistics maintained by the connection manager */
+typedef struct CurlConnStats {
+    uint64_t totalRequests;              /* Transfers completed (success or failure) */
+    uint64_t failedRequests;             /* Transfers that ended with a curl error */
+    uint64_t newConnections;             /* Transfers that had to open a new connection */
+    uint64_t reusedConnections;          /* Transfers that rode on a pooled connection */
+    uint64_t http2Requests;              /* Transfers that were carried over HTTP/2 */
+    double handshakeSecsTotal;           /* DNS + TCP + TLS time spent on new connections */
+    uint64_t bytesSent;                  /* HTTP request bytes (headers and body), without TCP/TLS */
+    uint64_t bytesReceived;              /* HTTP response bytes (headers and body), without TCP/TLS */
+} CurlConnStats;
+
+/* Send the data URL to the cloud through the configured transport (uplinkTransport.h) */
 int sendDataUrlToCloud(const char *packetDataBuff, size_t packetDataLen);
+
+/**
+ * @brief Sends several data URL extensions to the cloud concurrently.
+ *
+ * The configured transport carries them: over HTTP all requests are multiplexed on the
+ * pooled (HTTP/2 when negotiated) connection; readings a streaming transport could not
+ * deliver are sent that way as well.
+ *
+ * @param packetDataBuffs Array of URL extensions (query strings) to send.
+ * @param count           Number of entries in packetDataBuffs.
+ * @param httpCodes       Optional array of count entries that receives each HTTP response code.
+ * @return Number of requests that failed at the transport level.
+ */
+int sendDataUrlsToCloud(const char *const *packetDataBuffs, size_t count, long *httpCodes = nullptr);
+
+/**
+ * @brief Posts a batch body to the configured batch URL over the pooled connection.
+ *
+ * @param req         Request object that receives the result.
+ * @param body        Batch body; must stay valid until the call returns.
+ * @param bodyLen     Length of the batch body.
+ * @param contentType Content-Type of the batch body.
+ * @param contentEncoding Content-Encoding of the batch body, nullptr if not compressed.
+ * @return 0 if the transfer completed, 1 on a transport failure, -1 on invalid input.
+ */
+int postDataBatchToCloud(CloudRequest *req, const char *body, size_t bodyLen, const char *contentType,
+                         const char *contentEncoding);
+
+/**
+ * @brief Runs a set of requests through the shared connection pool.
+ *
+ * Connections, the DNS cache and TLS sessions survive transfer failures; only
+ * the failing request is reported back through its CloudRequest.
+ *
+ * @return Number of requests that failed at the transport level, -1 on setup failure.
+ */
+int performCloudRequests(CloudRequest *reqs, size_t count);
+
+/**
+ * @brief Sends a heartbeat report to url_alive as a GET request on the pooled connection.
+ *
+ * @param report Heartbeat query string (without the leading '?').
+ * @return HTTP response code, 0 if the request got no response, -1 on invalid input.
+ */
+long sendHeartbeatToCloud(const char *report);
+
+/**
+ * @brief Probes the uplink endpoints that are due for a health check: a HEAD request
+ *        on url_alive, where any HTTP response below 500 counts as healthy.
+ */
+void probeCloudEndpoints(void);
+
+/* Copy the connection reuse statistics */
+void getCurlConnStats(CurlConnStats *stats);
+
+/* Release the connection pool. Called once on shutdown. */
+void cloudCommCleanup(void);
+
+/**
+ * @brief Finds a key of a key=value response body, e.g. findCloudBodyKey(body, "nack=").
+ *
+ * A key only counts at the start of the body or right after '&', ';', a newline or whitespace,
+ * so "concurrency=" does not match inside "max_concurrency=".
+ *
+ * @return Offset of the value in body, std::string::npos if the body has no such key.
+ */
+size_t findCloudBodyKey(const std::string &body, const char *key);
+
 const char* getGwId(void);
 
-#endif /* _CLOUDCOMM_H_ */
\ No newline at end of file
+#endif /* _CLOUDCOMM_H_ */
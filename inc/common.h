@@ -10,6 +10,7 @@
 #include <condition_variable>
 #include <atomic>
 #include "tapeFormat.h"
+#include "trkLog.h"
 
 using namespace std;
 
@@ -29,12 +30,8 @@ using namespace std;
 #define SLEEP_MSECS(ms)                           (usleep(ms * 1000))
 #define SLEEP_SECS(s)                             (sleep(s))
 
-#define TRK_PRINTF(fmt, ...)          \
-  do {                                \
-    printf(fmt "\n", ##__VA_ARGS__);  \
-    fflush(stdout);                   \
-  } while (0)
-//
+/* Informational message through the asynchronous logger (trkLog.h) */
+#define TRK_PRINTF(fmt, ...)          TRK_LOG_INFO(fmt, ##__VA_ARGS__)
 
 /* Quartz BLE Data Packet Size: 24 bytes; Byte 25: RSSI
    Total packet size: 25 bytes */
@@ -91,6 +88,13 @@ inline time_t getEpochTimeSecs(void) {
   return time(nullptr);
 }
 
+/* Monotonic time for intervals and deadlines; unaffected by wall-clock changes */
+inline uint64_t getMonotonicTimeMsecs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000u) + ((uint64_t)ts.tv_nsec / 1000000u);
+}
+
 /* ----------------------------- Function Declarations ----------------------------- */
 //void printBlePacketData(BleDataPacket *bleData);
 //void createBleDataUrlExtension(char *urlDataBuff, uint16_t urlDataBuffLen, BleDataPacket *blePkt);
@@ -5,6 +5,8 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <vector>
 #include <cctype>
 
 extern int totalConnectableTapes;
@@ -15,10 +17,35 @@ extern int totalConnectableTapes;
 typedef struct tapeConfig {
     std::string macAddr;                 /* MAC address string */
     uint32_t lastSentTimeSecs = 0;       /* Time in seconds since last send */
-    bool tapeFound = false;              /* Flag to indicate if tape was seen in latest scan */
+    std::atomic<bool> tapeFound{false};  /* Set by the scan thread while a sighting waits in the scheduler's queue */
     bool tapeConnected = false;          /* Connection status */
     int retryCount = 0;                  /* Number of connection retries */
-    int backOffSecs = 0;                 /* Backoff time in seconds */
+    int backOffMsecs = 0;                /* Backoff time in milliseconds */
+
+    /* Owned by the BLE connect thread (bleConnSched.h) */
+    uint64_t lastSeenMsecs = 0;          /* Monotonic time of the latest sighting */
+    uint64_t nextEligibleMsecs = 0;      /* Monotonic time from which the tape may be connected again */
+    uint64_t dueMsecs = 0;               /* Monotonic time the tape became due, for the connect latency */
+    bool scheduled = false;              /* Waiting in the scheduler's heap */
+    bool busy = false;                   /* Connect or log read in progress */
+
+    /* Persistent connection (ble_persistent_tapes); a 0 parameter keeps the controller's choice */
+    bool persistent = false;             /* Keep the connection open and stream notifications */
+    uint16_t connIntervalMsecs = 0;      /* Connection interval */
+    uint16_t connLatency = 0;            /* Connection events the tape may skip */
+    uint16_t supervisionTimeoutMsecs = 0; /* Link loss timeout */
+
+    /* Link of the latest connection (bleLink.h) and the throughput of its log read */
+    uint16_t connHandle = 0;             /* HCI connection handle while connected */
+    uint16_t linkTxOctets = 0;           /* Negotiated link layer payload, 27 without Data Length Extension */
+    uint16_t linkRxOctets = 0;
+    uint8_t linkTxPhy = 0;               /* Negotiated PHY, BLE_LINK_PHY_* */
+    uint8_t linkRxPhy = 0;
+    double logKBytesPerSec = 0.0;        /* Log bytes over the session time */
+
+    /* Configuration push job (bleConfigPush.h) */
+    std::atomic<bool> configPushPending{false}; /* The job still has to write this tape; read by the scan thread */
+    bool configPushOnly = false;         /* Listed only as a push target, connected for the push alone */
 
     /* Default constructor */
     tapeConfig() = default;
@@ -29,21 +56,159 @@ typedef struct tapeConfig {
                bool found,
                bool connected,
                int rCount,
-               int bSecs)
+               int bMsecs)
         : macAddr(addr),
           lastSentTimeSecs(time),
           tapeFound(found),
           tapeConnected(connected),
           retryCount(rCount),
-          backOffSecs(bSecs) {}
+          backOffMsecs(bMsecs) {}
 } tapeConfig;
 
 typedef struct urlConfig {
     const char *urlAlive;
     const char *urlExtension;
     const char *instance;
+    std::vector<const char *> instances; /* Uplink endpoints: instance first, then instance_alternates */
 } urlConfig;
 
+/* Uplink modes */
+#define UPLINK_MODE_SINGLE                  "single"
+#define UPLINK_MODE_BATCH                   "batch"
+
+/* Uplink batching defaults, used when the keys are absent from sysConfig.ini */
+#define UPLINK_BATCH_DEF_MAX_RECORDS        (50)
+#define UPLINK_BATCH_DEF_MAX_BYTES          (16384)
+#define UPLINK_BATCH_DEF_MAX_DELAY_MSECS    (2000)
+
+/* Streaming transport defaults (uplink_transport = "websocket", see uplinkStream.h) */
+#define UPLINK_STREAM_DEF_PATH              "/proxencoded/stream"
+#define UPLINK_STREAM_DEF_WINDOW            (32)
+
+/* Coalescing of unsent routine readings per tape (uplinkQueue.h) */
+#define UPLINK_DEF_COALESCE                 (true)
+
+typedef struct uplinkConfig {
+    const char *uplinkMode;              /* "single" (one GET per reading) or "batch" (one POST per batch) */
+    const char *urlBatchExtension;       /* Page URL the batches are posted to */
+    int batchMaxRecords;                 /* Flush once the batch holds this many records */
+    int batchMaxBytes;                   /* Flush before the body would grow past this size */
+    int batchMaxDelayMsecs;              /* Flush once the oldest record has waited this long */
+    const char *compression;             /* Uplink payload compression: "none", "deflate" or "zstd" */
+    const char *transport;               /* Single mode transport: "http" or "websocket" (uplinkTransport.h) */
+    const char *streamPath;              /* Path of the WebSocket stream on each endpoint instance */
+    int streamWindow;                    /* Readings in flight on the stream before waiting for an ack */
+    bool coalesce;                       /* A routine reading replaces the unsent one of the same tape */
+} uplinkConfig;
+
+/* Uplink spool defaults, used when the keys are absent from sysConfig.ini */
+#define SPOOL_DEF_SEGMENT_BYTES             (1024 * 1024)
+#define SPOOL_DEF_MAX_BYTES                 (64 * 1024 * 1024)
+#define SPOOL_DEF_FSYNC_INTERVAL_MSECS      (500)
+#define SPOOL_DEF_REPLAY_RATE               (20)
+
+typedef struct spoolConfig {
+    const char *spoolDir;                /* Spool directory, empty disables the spool */
+    int segmentBytes;                    /* Roll over to a new segment file at this size */
+    int maxBytes;                        /* Oldest segments are dropped beyond this total size */
+    int fsyncIntervalMsecs;              /* Appends are made durable at most this late */
+    int replayRate;                      /* Backlog records replayed per second */
+} spoolConfig;
+
+/* Uplink retry defaults, used when the keys are absent from sysConfig.ini */
+#define RETRY_DEF_MAX_ATTEMPTS              (5)
+#define RETRY_DEF_BASE_MSECS                (500)
+#define RETRY_DEF_MAX_MSECS                 (60000)
+#define RETRY_DEF_QUEUE_MAX                 (512)
+#define RETRY_DEF_BREAKER_THRESHOLD         (5)
+#define RETRY_DEF_BREAKER_OPEN_MSECS        (5000)
+#define RETRY_DEF_BREAKER_MAX_OPEN_MSECS    (300000)
+
+typedef struct retryConfig {
+    int maxAttempts;                     /* Sends per packet before it is dropped */
+    int baseMsecs;                       /* Backoff before the first retry, doubled per attempt */
+    int maxMsecs;                        /* Upper bound of the retry backoff */
+    int queueMax;                        /* Packets held in memory for their retry */
+    int breakerThreshold;                /* Consecutive failures that open the circuit breaker */
+    int breakerOpenMsecs;                /* First open period, doubled on every failed probe */
+    int breakerMaxOpenMsecs;             /* Upper bound of the open period */
+} retryConfig;
+
+/* Heartbeat defaults, used when the keys are absent from sysConfig.ini */
+#define HEARTBEAT_DEF_INTERVAL_SECS         (60)
+#define HEARTBEAT_DEF_MIN_INTERVAL_SECS     (15)
+#define HEARTBEAT_DEF_MAX_INTERVAL_SECS     (300)
+
+typedef struct heartbeatConfig {
+    int intervalSecs;                    /* Heartbeat interval while packets flow, 0 disables heartbeats */
+    int minIntervalSecs;                 /* Interval while the pipeline is unhealthy */
+    int maxIntervalSecs;                 /* Longest interval while the gateway is idle */
+} heartbeatConfig;
+
+/* Throttle defaults, used when the keys are absent from sysConfig.ini */
+#define THROTTLE_DEF_REPORT_INTERVAL_SECS   (30)
+#define THROTTLE_DEF_HINT_TTL_SECS          (900)
+#define THROTTLE_DEF_MAX_HOLD_SECS          (3600)
+
+typedef struct throttleConfig {
+    int tapeReportIntervalSecs;          /* Shortest interval between two uploads of the same tape */
+    int hintTtlSecs;                     /* Server hints revert to the configured values after this long */
+    int maxHoldSecs;                     /* Upper bound of a server Retry-After */
+} throttleConfig;
+
+/* Rate limit defaults (packets per minute and bucket depth), used when the keys are absent from sysConfig.ini.
+   A rate of 0 leaves that level unlimited. */
+#define RATE_DEF_GLOBAL_PER_MIN             (0)
+#define RATE_DEF_GLOBAL_BURST               (60)
+#define RATE_DEF_TYPE_PER_MIN               (0)
+#define RATE_DEF_TYPE_BURST                 (30)
+#define RATE_DEF_TAPE_PER_MIN               (0)
+#define RATE_DEF_TAPE_BURST                 (3)
+
+typedef struct rateLimitConfig {
+    int globalPerMin;                    /* Packets per minute for the whole gateway */
+    int globalBurst;                     /* Packets the gateway may send at once after a quiet period */
+    int typePerMin;                      /* Packets per minute for each device type */
+    int typeBurst;
+    int tapePerMin;                      /* Packets per minute for each tape */
+    int tapeBurst;
+} rateLimitConfig;
+
+/* Uplink endpoint defaults, used when the keys are absent from sysConfig.ini */
+#define UPLINK_MAX_ENDPOINTS                (4u)
+#define ENDPOINT_DEF_FAIL_THRESHOLD         (3)
+#define ENDPOINT_DEF_PROBE_INTERVAL_SECS    (30)
+#define ENDPOINT_DEF_SPREAD_PCT             (20)
+
+typedef struct endpointConfig {
+    int failThreshold;                   /* Consecutive failures that take an endpoint out of rotation */
+    int probeIntervalSecs;               /* Health/latency probe interval of unused or failed endpoints */
+    int spreadPct;                       /* Endpoints this close to the fastest one share the traffic */
+} endpointConfig;
+
+/* Metrics endpoint default (metrics.h): disabled */
+#define METRICS_DEF_LISTEN                  ""
+
+typedef struct metricsConfig {
+    const char *listen;                  /* "host:port", "unix:/path", or empty to disable the endpoint */
+} metricsConfig;
+
+/* Packet trace default (pktTrace.h) */
+#define TRACE_DEF_SLOW_MSECS                (2000)
+
+typedef struct traceConfig {
+    int slowMsecs;                       /* Packets slower end to end are kept as traces, 0 to keep none */
+} traceConfig;
+
+/* Logger defaults (trkLog.h) */
+#define LOG_DEF_LEVEL                       "info"
+#define LOG_DEF_RATE_LIMIT                  (20)
+
+typedef struct logConfig {
+    int level;                           /* TRK_LOG_LEVEL_* below which messages are dropped at the call site */
+    int rateLimit;                       /* Messages per second per call site, 0 for no limit */
+} logConfig;
+
 typedef struct gatewayConfig {
     const char *gwId;
     const char *gwLat;
@@ -53,9 +218,58 @@ typedef struct gatewayConfig {
     const char *curlReqFormat;
 } gatewayConfig;
 
+/* BLE connection engine defaults, used when the keys are absent from sysConfig.ini */
+#define BLE_CONN_DEF_MAX_PARALLEL           (4)
+#define BLE_CONN_DEF_TIMEOUT_MSECS          (5000)
+#define BLE_CONN_DEF_BACKOFF_BASE_MSECS     (5000)
+#define BLE_CONN_DEF_BACKOFF_MAX_MSECS      (60000)
+
+/* Scan/connect arbiter defaults (bleArbiter.h) */
+#define BLE_COEX_DEF_POLICY                 "interleave"
+#define BLE_COEX_DEF_PERIOD_MSECS           (1000)
+#define BLE_COEX_DEF_CONNECT_WINDOW_MSECS   (250)
+#define BLE_COEX_DEF_MAX_PAUSE_MSECS        (2000)
+#define BLE_COEX_DEF_ROTATE_SECS            (600)
+
+/* Limits of the LE connection parameters of the persistent tapes (Bluetooth Core, Vol 4, Part E, 7.8.18) */
+#define BLE_CONN_INTERVAL_MIN_MSECS         (8)
+#define BLE_CONN_INTERVAL_MAX_MSECS         (4000)
+#define BLE_CONN_LATENCY_MAX                (499)
+#define BLE_SUPERVISION_TIMEOUT_MIN_MSECS   (100)
+#define BLE_SUPERVISION_TIMEOUT_MAX_MSECS   (32000)
+
+/* Tape log retrieval defaults (attClient.h); the log characteristic is the Nordic UART TX characteristic */
+#define BLE_LOG_DEF_CHAR_UUID               "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
+#define BLE_LOG_DEF_READ_TIMEOUT_MSECS      (10000)
+
+/* Tape configuration push defaults (bleConfigPush.h); the value goes to the Nordic UART RX characteristic */
+#define BLE_PUSH_DEF_CHAR_UUID              "6E400002-B5A3-F393-E0A9-E50E24DCCA9E"
+#define BLE_PUSH_DEF_STATE_FILE             "/var/lib/trk/configPush.state"
+#define BLE_PUSH_DEF_MAX_ATTEMPTS           (5)
+
+typedef struct configPushConfig {
+    const char *charUuid;                /* UUID of the characteristic written */
+    const char *value;                   /* Hex encoded value to write, empty for no job */
+    const char *stateFile;               /* Progress of the job, so a restart resumes it */
+    int maxAttempts;                     /* Connects and writes per tape before it is given up */
+    std::vector<std::string> targets;    /* Colon formatted MAC addresses of the tapes to write */
+} configPushConfig;
+
 typedef struct bleConnectConfig {
+    bool connectEnabled;                 /* Run the BLE connect thread */
     int totalConnectableTapes;
     int readTapeAgainDelaySecs;
+    int maxParallelConnects;             /* Connects pending at once, at most the controller's LE connection slots */
+    int connectTimeoutMsecs;             /* A connect not finished within this time is aborted */
+    int backoffBaseMsecs;                /* Backoff ceiling after the first failed connect */
+    int backoffMaxMsecs;                 /* Upper bound of the backoff ceiling */
+    const char *coexPolicy;              /* Scan/connect arbitration: concurrent, interleave, priority or rotate */
+    int coexPeriodMsecs;                 /* Connect windows repeat with this period */
+    int coexConnectWindowMsecs;          /* Routine connects start in this first part of every period */
+    int coexMaxPauseMsecs;               /* Longest scan pause for a priority connect */
+    int coexRotateSecs;                  /* Time on each policy when rotating */
+    const char *logCharUuid;             /* UUID of the tape's log characteristic, empty to skip the log read */
+    int logReadTimeoutMsecs;             /* A log read not finished within this time is abandoned */
     char gwBleMacId[BLE_MAC_ADDR_LEN + 1];
     std::map<std::string, std::unique_ptr<tapeConfig>> tapeList;
 } bleConnectConfig;
@@ -63,6 +277,17 @@ typedef struct bleConnectConfig {
 extern bleConnectConfig bleConnectCfg;
 extern urlConfig urlCfg;
 extern gatewayConfig gwCfg;
+extern uplinkConfig uplinkCfg;
+extern spoolConfig spoolCfg;
+extern retryConfig retryCfg;
+extern heartbeatConfig heartbeatCfg;
+extern throttleConfig throttleCfg;
+extern rateLimitConfig rateLimitCfg;
+extern endpointConfig endpointCfg;
+extern metricsConfig metricsCfg;
+extern traceConfig traceCfg;
+extern logConfig logCfg;
+extern configPushConfig configPushCfg;
 
 /* Function to format a MAC address as "11:22:33:44:55:66" */
 char *formatMacAddress(const char *mac);
@@ -142,4 +367,18 @@ bool getIfaceMacAddress(const char* interface = "wlan0");
 */
 bool isCurlReqFormatG1(void);
 
+/**
+* @brief Checks if the curl request format is the compact binary B1 format.
+*
+* @return true if curl request format is B1, false otherwise
+*/
+bool isCurlReqFormatB1(void);
+
+/**
+* @brief Checks if readings are uploaded in batches (one POST per batch).
+*
+* @return true if the uplink mode is batch, false otherwise
+*/
+bool isUplinkBatchMode(void);
+
 #endif /* _CONFIG_H_ */
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _HEARTBEAT_H_
+#define _HEARTBEAT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/*
+    Gateway heartbeat and pipeline telemetry.
+
+    The report is a query string, e.g.
+        gw=<id>&up=<secs>&q=<depth>&qmax=<peak>&pps=<rate>&dedup=<ratio>&p50=<ms>&p99=<ms>&kdrop=<n>&kdrop_total=<n>&...
+
+    When a heartbeat is due it rides on the next data request (single GET or
+    batch POST) as the HEARTBEAT_HEADER_NAME header. Only if no data request
+    goes out within HEARTBEAT_PIGGYBACK_GRACE_MSECS is it sent on its own as a
+    GET to url_alive, on the same pooled connection.
+
+    The interval adapts to the pipeline: heartbeat_min_interval_s while it is
+    unhealthy (kernel drops, open circuit breaker, queued retries),
+    heartbeat_interval_s while packets flow, and doubling up to
+    heartbeat_max_interval_s while the gateway is idle.
+*/
+#define HEARTBEAT_HEADER_NAME                     "X-Trk-Heartbeat"
+#define HEARTBEAT_PIGGYBACK_GRACE_MSECS           (5000u)
+#define HEARTBEAT_LATENCY_SAMPLES                 (1024u)
+/* Scan socket reads between two kernel drop counter samples */
+#define HEARTBEAT_DROP_SAMPLE_READS               (256u)
+
+/* Starts the heartbeat clock. Called once the configuration is loaded. */
+void heartbeatInit(void);
+
+/* Returns true if heartbeats are enabled (heartbeat_interval_s > 0 and url_alive set) */
+bool isHeartbeatEnabled(void);
+
+/**
+ * @brief Counts a scanned white tape advertisement. Thread safe.
+ *
+ * @param unique true if it passed the dups check, false if it was dropped as a duplicate.
+ */
+void heartbeatNoteAdvert(bool unique);
+
+/* Counts a packet queued for the uplink and records the queue depth. Thread safe. */
+void heartbeatNotePacketQueued(size_t queueDepth);
+
+/* Records the uplink queue depth, e.g. after the cloud thread drained it. Thread safe. */
+void heartbeatNoteQueueDepth(size_t queueDepth);
+
+/* Records the latency of a completed uplink request. Thread safe. */
+void heartbeatNoteUplinkLatency(double totalTimeSecs);
+
+/**
+ * @brief Samples the kernel drop counter (SO_MEMINFO) of the scan socket.
+ *
+ * @param fd      Scan HCI socket.
+ * @param closing true right before the socket is closed, so its drops are carried over.
+ */
+void heartbeatSampleKernelDrops(int fd, bool closing);
+
+/* Returns true once the next heartbeat is due */
+bool heartbeatIsDue(void);
+
+/**
+ * @brief Builds the heartbeat report and starts the next interval.
+ *
+ * @param report Receives the report query string (without a leading '?').
+ * @return true if a heartbeat was due and the report was built.
+ */
+bool heartbeatTakeReport(std::string &report);
+
+/* Milliseconds until the heartbeat must be sent on its own (not before an open
+   circuit breaker probes again), UINT32_MAX if disabled */
+uint32_t heartbeatMsecsUntilStandalone(void);
+
+/**
+ * @brief Sends the heartbeat to url_alive if it is overdue and no data request carried it.
+ *        Called from the cloud communication thread.
+ */
+void heartbeatProcess(void);
+
+#endif /* _HEARTBEAT_H_ */
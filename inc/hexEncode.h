@@ -0,0 +1,42 @@
+#ifndef _HEXENCODE_H_
+#define _HEXENCODE_H_
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+    Bulk upper case hex encoding, the equivalent of one %02X per byte.
+
+    The kernel is picked at compile time: SSE2 on x86-64, NEON on ARM, and a
+    256 entry byte-to-digit-pair table otherwise. The SIMD paths encode 16
+    bytes (or an 8 byte tail) per step and finish the remainder with the table,
+    so a 24 byte G1 payload takes one 16 byte and one 8 byte step.
+*/
+#define HEX_ENCODE_MAC_STR_LEN                    (12u)
+
+/**
+ * @brief Writes 2 * len upper case hex digits; out is not NUL terminated.
+ *
+ * @param out   Output, at least 2 * len bytes.
+ * @param bytes Input bytes.
+ * @param len   Number of input bytes.
+ * @return Position after the last digit written.
+ */
+char *hexEncodeUpper(char *out, const uint8_t *bytes, size_t len);
+
+/* Table only version of hexEncodeUpper(), the reference for the SIMD kernels */
+char *hexEncodeUpperScalar(char *out, const uint8_t *bytes, size_t len);
+
+/**
+ * @brief Formats a bdaddr_t as the 12 digit MAC string used in URLs and the tape
+ *        tables: ba2str() without the ':' separators.
+ *
+ * @param out    Output, at least HEX_ENCODE_MAC_STR_LEN + 1 bytes; NUL terminated.
+ * @param bdaddr The 6 address bytes, least significant first (bdaddr_t::b).
+ */
+void hexEncodeBdaddr(char *out, const uint8_t *bdaddr);
+
+/* Name of the compiled in kernel: "sse2", "neon" or "scalar" */
+const char *getHexEncodeImpl(void);
+
+#endif /* _HEXENCODE_H_ */
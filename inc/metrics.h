@@ -0,0 +1,99 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <time.h>
+
+/*
+    Pipeline metrics registry with a Prometheus text endpoint.
+
+    The metric set is fixed at compile time: counters, gauges and fixed-bucket
+    histograms, each named by an enum below. Counters and histograms are
+    sharded per thread: the first update of a thread claims one of
+    METRICS_MAX_SHARDS cache-line aligned shards with one atomic increment,
+    and every later update is a relaxed load and store on the thread's own
+    shard, with no lock and no contended cache line. Threads beyond
+    METRICS_MAX_SHARDS share an overflow shard updated with atomic adds. A
+    gauge is one atomic, set by whoever knows the value.
+
+    A scrape sums the shards, so a reading may miss the updates made while it
+    runs; every counter is still monotonic. Histogram values are recorded in
+    nanoseconds and exposed in seconds.
+
+    metrics_listen selects the endpoint: "host:port" for TCP or
+    "unix:/path" for a Unix socket, empty to disable it. The metrics thread
+    answers one plain HTTP GET at a time with the text exposition format
+    (version 0.0.4); "/" and "/metrics" both return the metrics, "/traces"
+    the slow packet traces (pktTrace.h).
+*/
+#define METRICS_MAX_SHARDS                        (16u)
+#define METRICS_HIST_BUCKETS                      (12u)
+#define METRICS_POLL_MSECS                        (1000)
+#define METRICS_REQUEST_TIMEOUT_MSECS             (1000)
+#define METRICS_REQUEST_MAX_LEN                   (2048u)
+#define METRICS_UNIX_PREFIX                       "unix:"
+
+typedef enum MetricCounter {
+    METRIC_HCI_EVENTS_READ = 0,          /* HCI events read from the scan socket */
+    METRIC_ADVERTS_WHITE_TAPE,           /* Advertising reports classified as white tapes */
+    METRIC_ADVERTS_OTHER,                /* Advertising reports of other devices */
+    METRIC_ADVERTS_DUPLICATE,            /* White tape reports dropped by the dups check */
+    METRIC_PACKETS_QUEUED,               /* Packets queued for the uplink */
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+typedef enum MetricGauge {
+    METRIC_GAUGE_QUEUE_DEPTH = 0,        /* Packets waiting in the uplink queue */
+    METRIC_GAUGE_COUNT
+} MetricGauge;
+
+typedef enum MetricHistogram {
+    METRIC_HIST_PARSE = 0,               /* Advert to BleDataPacket */
+    METRIC_HIST_URL_BUILD,               /* BleDataPacket to URL extension */
+    METRIC_HIST_HTTP_LATENCY,            /* Uplink HTTP request total time */
+    METRIC_HIST_STREAM_ACK,              /* Uplink stream reading to its ack */
+    METRIC_HIST_STAGE_CLASSIFY,          /* Packet stages (pktTrace.h), each from the stage before it */
+    METRIC_HIST_STAGE_DEDUP,
+    METRIC_HIST_STAGE_PARSE,
+    METRIC_HIST_STAGE_ENQUEUE,
+    METRIC_HIST_STAGE_DEQUEUE,
+    METRIC_HIST_STAGE_URL_BUILD,
+    METRIC_HIST_STAGE_SEND,
+    METRIC_HIST_STAGE_ACK,
+    METRIC_HIST_PACKET_E2E,              /* HCI read to ack */
+    METRIC_HISTOGRAM_COUNT
+} MetricHistogram;
+
+/* Monotonic clock for the histograms, in nanoseconds */
+inline uint64_t metricsNowNsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* Add to a counter. Lock free. */
+void metricsCounterAdd(MetricCounter counter, uint64_t n);
+
+/* Set a gauge. Lock free. */
+void metricsGaugeSet(MetricGauge gauge, int64_t value);
+
+/* Record a duration in nanoseconds. Lock free. */
+void metricsObserveNsecs(MetricHistogram histogram, uint64_t nsecs);
+
+/* Record a duration measured from startNsecs (metricsNowNsecs()) to now */
+inline void metricsObserveSince(MetricHistogram histogram, uint64_t startNsecs) {
+    metricsObserveNsecs(histogram, metricsNowNsecs() - startNsecs);
+}
+
+/* Append every metric in the Prometheus text exposition format */
+void metricsRender(std::string &out);
+
+/* Open the metrics_listen endpoint. Returns false if it is disabled or cannot be opened. */
+bool metricsServerInit(void);
+
+/* Serve scrapes until keepRunning drops. Run in its own thread after metricsServerInit() succeeded. */
+void metricsServerThreadFunc(void);
+
+#endif /* _METRICS_H_ */
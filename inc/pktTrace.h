@@ -0,0 +1,87 @@
+#ifndef _PKTTRACE_H_
+#define _PKTTRACE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <time.h>
+
+/*
+    End-to-end latency trace of an uplink packet.
+
+    Every BleDataPacket carries a PktTrace: the monotonic time in
+    nanoseconds of the HCI read that delivered its advert, and the time
+    each later stage was done. The scan thread stamps classify, dedup,
+    parse and enqueue; the cloud thread stamps dequeue, URL build (the
+    record built or put into a batch), send and ack. A packet replayed from
+    the spool carries no trace: its capture time belongs to another run.
+
+    When a packet is acknowledged, each stage's time since the stage before
+    it and the capture-to-ack total are recorded in the metrics histograms
+    (trk_packet_stage_seconds, trk_packet_e2e_seconds). A packet slower
+    than trace_slow_ms end to end is kept with its stage times, the last
+    PKT_TRACE_SLOW_KEEP of them, served on /traces of the metrics endpoint
+    and logged.
+
+    A resent packet keeps its first dequeue stamp and gets new URL build
+    and send stamps, so its URL build stage includes the retry wait.
+*/
+#define PKT_TRACE_SLOW_KEEP                       (64u)
+
+typedef enum PktTraceStage {
+    PKT_STAGE_CAPTURE = 0,               /* HCI event read from the scan socket */
+    PKT_STAGE_CLASSIFY,                  /* Advert recognised as a white tape */
+    PKT_STAGE_DEDUP,                     /* Dups check passed */
+    PKT_STAGE_PARSE,                     /* Advert parsed into the packet */
+    PKT_STAGE_ENQUEUE,                   /* Packet in the uplink queue, after any rate limit hold */
+    PKT_STAGE_DEQUEUE,                   /* Packet taken by the cloud thread */
+    PKT_STAGE_URL_BUILD,                 /* URL extension or batch record built */
+    PKT_STAGE_SEND,                      /* Request or batch handed to the transport */
+    PKT_STAGE_ACK,                       /* Acknowledged by the server */
+    PKT_STAGE_COUNT
+} PktTraceStage;
+
+typedef struct PktTrace {
+    uint64_t stampNsecs[PKT_STAGE_COUNT]; /* Monotonic time per stage, 0 if not reached; no capture, no trace */
+} PktTrace;
+
+struct BleDataPacket;
+
+/* Monotonic clock of the stamps, in nanoseconds */
+inline uint64_t pktTraceNowNsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* Start the trace of a packet whose advert was read at captureNsecs */
+inline void pktTraceBegin(PktTrace *trace, uint64_t captureNsecs) {
+    memset(trace, 0, sizeof(*trace));
+    trace->stampNsecs[PKT_STAGE_CAPTURE] = captureNsecs;
+}
+
+/* Drop the trace; later stamps are ignored */
+inline void pktTraceClear(PktTrace *trace) {
+    memset(trace, 0, sizeof(*trace));
+}
+
+/* Stamp a stage of a traced packet */
+inline void pktTraceStamp(PktTrace *trace, PktTraceStage stage, uint64_t nsecs) {
+    if (trace->stampNsecs[PKT_STAGE_CAPTURE] != 0) {
+        trace->stampNsecs[stage] = nsecs;
+    }
+}
+
+inline void pktTraceStampNow(PktTrace *trace, PktTraceStage stage) {
+    if (trace->stampNsecs[PKT_STAGE_CAPTURE] != 0) {
+        trace->stampNsecs[stage] = pktTraceNowNsecs();
+    }
+}
+
+/* Stamp the ack of a traced packet, record its stage times and keep it if it was slow. Cloud thread. */
+void pktTraceFinish(const BleDataPacket &blePkt);
+
+/* Append the kept slow traces, newest first, one line each */
+void pktTraceRender(std::string &out);
+
+#endif /* _PKTTRACE_H_ */
@@ -12,6 +12,7 @@ extern "C" {
 
 /* Defined header files */
 #include "common.h"
+#include "pktTrace.h"
 
 //#define FEATURE_G1_URL_STR_FORMAT
 //#define FEATURE_ENAHNCED_URL_STR_FORMAT
@@ -95,6 +96,11 @@ extern "C" {
 #define EVT_WHITE_TAPE_TEMP_VIOLATION_MODE                     (51)
 #define EVT_WHITE_TAPE_CONFIG_MODE                             (56)
 
+/* Decoded readings are fixed-point integers: temperatures in hundredths of a
+   degree C, battery voltages in tenths of a volt */
+#define TAPE_TEMP_CENTI_PER_DEGREE                             (100)
+#define TAPE_BAT_DECI_PER_VOLT                                 (10)
+
 #define WHITE_TAPE_DATA_PACKET_LEN                             (24u)
 #define WHITE_TAPE_BLE_ADV_INFO_LEN                            (31u)
 #define WHITE_TAPE_DATA_EVENT_FLAG_OFFSET                      (9u)
@@ -137,17 +143,17 @@ typedef struct BlePacket_QuartzTMP117 {
     char mac_addr[20];      // White Tape MAC Address
     uint16_t fid;           // Byte [0:1]: FID
     uint8_t evt_flag;       // Byte [2]: Event Flag
-    float t0;               // Byte [3:4]: Current Temp (3:t0 exponent (int8_t); 4:t0 fraction (uint8_t))
+    int16_t t0;             // Byte [3:4]: Current Temp in 0.01 C (3:t0 exponent (int8_t); 4:t0 fraction (uint8_t))
     uint16_t t0_ts;         // Byte [5:6]: Current Timestamp (t0)
-    float t1;               // Byte [7:8]: Min Temp (7:t1 exponent (int8_t); 8:t1 fraction (uint8_t))
+    int16_t t1;             // Byte [7:8]: Min Temp in 0.01 C (7:t1 exponent (int8_t); 8:t1 fraction (uint8_t))
     uint16_t t1_ts;         // Byte [9:10]: Timestamp t1
-    float t2;               // Byte [11:12]: Min Temp (11:t1 exponent (int8_t); 12:t1 fraction (uint8_t))
+    int16_t t2;             // Byte [11:12]: Min Temp in 0.01 C (11:t1 exponent (int8_t); 12:t1 fraction (uint8_t))
     uint16_t t2_ts;         // Byte [13:14]: Timestamp t2
     uint32_t pid;           // Byte [15:17]: 4th, 5th and 6th bytes of LIME
     uint8_t lime_bat;       // Byte [18]: Battery of LIME
     uint16_t seqId;         // Byte [19:20]: Record Sequence
     uint16_t tapeId;        // Byte [21:22]: Tape ID (0xFFFC)
-    float bat;              // Byte [23]: Battery voltage of white tape
+    uint8_t bat;            // Byte [23]: Battery voltage of white tape in 0.1 V
     int8_t rssi;            // Byte [24]: RSSI
 } BlePacket_QuartzTMP117;
 
@@ -185,7 +191,7 @@ typedef struct BlePacket_QuartzOPT3110 {
     char mac_addr[20];      // White Tape MAC Address
     uint16_t fid;           // Byte [0:1]: FID
     uint8_t evt_flag;       // Byte [2]: Event Flag
-    float t0;               // Byte [3:4]: Current Temp (3:t0 exponent (int8_t); 4:t0 fraction (uint8_t))
+    int16_t t0;             // Byte [3:4]: Current Temp in 0.01 C (3:t0 exponent (int8_t); 4:t0 fraction (uint8_t))
     uint16_t t0_ts;         // Byte [5:6]: Current Timestamp (t0)
     uint16_t l0;            // Byte [7:8]: light l0
     uint16_t l0_ts;         // Byte [9:10]: Timestamp t_l0
@@ -195,7 +201,7 @@ typedef struct BlePacket_QuartzOPT3110 {
     uint8_t lime_bat;       // Byte [18]: Battery of LIME
     uint16_t seqId;         // Byte [19:20]: Record Sequence
     uint16_t tapeId;        // Byte [21:22]: Tape ID (0xFFFA)
-    float bat;              // Byte [23]: Battery voltage of white tape
+    uint8_t bat;            // Byte [23]: Battery voltage of white tape in 0.1 V
     int8_t rssi;            // Byte [24]: RSSI
 } BlePacket_QuartzOPT3110;
 
@@ -234,8 +240,8 @@ typedef struct BlePacket_IAT {
     char mac_addr[20];      // White Tape MAC Address
     uint16_t fid;           // Byte [0:1]: FID
     uint8_t evt_flag;       // Byte [2]: Event Flag
-    float t0;               // Byte [3]: Current Temp t0
-    float t1;               // Byte [4]: Temperature T1 (latest violation)
+    int16_t t0;             // Byte [3]: Current Temp t0 in 0.01 C
+    int16_t t1;             // Byte [4]: Temperature T1 (latest violation) in 0.01 C
     uint32_t t1_ts;         // Byte [5:8]: Current Timestamp (t0)
     uint16_t l0;            // Byte [9:10]: light l0 (Violation)
     uint32_t l0_ts;         // Byte [11:14]: Timestamp t_l0
@@ -243,7 +249,7 @@ typedef struct BlePacket_IAT {
     uint8_t a0_count;       // Byte [16]: Acceleration a0 count
     uint32_t ts;            // Byte [17:20]: Timestamp ts
     uint16_t tapeId;        // Byte [21:22]: Tape ID (0xFFB1)
-    float bat;              // Byte [23]: Battery voltage of white tape
+    uint8_t bat;            // Byte [23]: Battery voltage of white tape in 0.1 V
     int8_t rssi;            // Byte [24]: RSSI
 } BlePacket_IAT;
 
@@ -283,12 +289,12 @@ typedef struct BlePacket_DPD {
     uint16_t fid;           // Byte [0:1]: FID
     uint8_t evtFlag;        // Byte [2]: Event Flag
     uint8_t tagMacId[6];    // Byte [3:8]: tag MAC Address
-    float t0;               // Byte [9]: Current Temp t0
+    int16_t t0;             // Byte [9]: Current Temp t0 in 0.01 C
     uint16_t l0;            // Byte [10:11]: light l0
     uint32_t l0Ts;          // Byte [12:15]: Timestamp t_l0
     uint16_t ts;            // Byte [16:19]: Timestamp ts
     uint16_t tapeId;        // Byte [20:21]: Tape ID (0xFFB3)
-    float bat;              // Byte [22:23]: Battery voltage of white tape (integer + fraction byte)
+    uint8_t bat;            // Byte [22:23]: Battery voltage of white tape in 0.1 V
     int8_t rssi;            // Byte [24]: RSSI
 } BlePacket_DPD;
 
@@ -297,12 +303,12 @@ typedef struct BlePacket_IOS_SensorADV {
     uint16_t fid;           // Byte [0:1]: FID
     uint8_t evtFlag;        // Byte [2]: Event Flag
     uint8_t tagMacId[6];    // Byte [3:8]: tag MAC Address
-    float t0;               // Byte [9]: Current Temp t0
-    float h0;               // Byte [10]: Humidity h0
+    int16_t t0;             // Byte [9]: Current Temp t0 in 0.01 C
+    uint8_t h0;             // Byte [10]: Humidity h0
     uint16_t l0;            // Byte [11:12]: light l0
     uint16_t a0;            // Byte [13:14]: Acceleration a0
     uint16_t ts;            // Byte [15:18]: Timestamp ts
-    float bat;              // Byte [19]: Battery voltage of white tape (integer + fraction byte)
+    uint8_t bat;            // Byte [19]: Battery voltage of white tape in 0.1 V
     uint8_t uuidFiledLen;   // Byte [20]: 0x03
     uint8_t uuidFiledLenList;// Byte [21]: 0x03
     uint8_t uuidLSB;        // Byte [22]: 0xFF
@@ -347,14 +353,44 @@ typedef union BleDataPacketStruct {
     Super structure that is used as queue objects to exchange BLE data
     between the BLE thread and the cloud communication thread.
 */
+/* BleDataPacket pktFlags */
+#define BLE_PKT_FLAG_BACKFILL               (0x01u)   /* Tape log record: not rate limited, never coalesced */
+
 typedef struct BleDataPacket {
     BleDataPacketStruct blePktStrct;
     uint8_t bleBuff[WHITE_TAPE_DATA_PACKET_LEN];
     BlePacketType blePktType;
+    uint64_t spoolId;       // Uplink spool record id, 0 if the packet is not spooled
+    uint32_t sendAttempts;  // Uplink sends that failed with a transient error
+    uint32_t pktFlags;      // BLE_PKT_FLAG_*, cleared by parseBleDataPacket()
+    uint32_t captureTs;     // Epoch seconds when the gateway received the reading, set by parseBleDataPacket()
+    PktTrace trace;         // Capture and stage times for the latency histograms (pktTrace.h)
 } BleDataPacket;
 
 /* Inline Functions */
 
+/* MAC string of a parsed packet, nullptr for an unknown type */
+inline const char *getBlePacketMacAddr(const BleDataPacket &blePkt) {
+    switch (blePkt.blePktType) {
+        case QuartzSensor_TMP117:  return blePkt.blePktStrct.blePkt_TMP117.mac_addr;
+        case QuartzSensor_OPT3110: return blePkt.blePktStrct.blePkt_OPT3110.mac_addr;
+        case QuartzSensor_IAT:     return blePkt.blePktStrct.blePkt_IAT.mac_addr;
+        case QuartzSensor_DPD:     return blePkt.blePktStrct.blePkt_DPD.macId;
+        default:                   return nullptr;
+    }
+}
+
+/* Event flag (e_QuartzEventFlag) of a parsed packet, 0 for an unknown type */
+inline uint8_t getBlePacketEvtFlag(const BleDataPacket &blePkt) {
+    switch (blePkt.blePktType) {
+        case QuartzSensor_TMP117:  return blePkt.blePktStrct.blePkt_TMP117.evt_flag;
+        case QuartzSensor_OPT3110: return blePkt.blePktStrct.blePkt_OPT3110.evt_flag;
+        case QuartzSensor_IAT:     return blePkt.blePktStrct.blePkt_IAT.evt_flag;
+        case QuartzSensor_DPD:     return blePkt.blePktStrct.blePkt_DPD.evtFlag;
+        default:                   return 0;
+    }
+}
+
 inline uint16_t getTimestampU16(le_advertising_info *info, uint8_t byteOffset) {
     uint8_t startIdx = QUARTZ_BLE_ADV_PKT_DATA_START_IDX + byteOffset;
     return (((uint16_t)info->data[startIdx] << 8) |
@@ -369,10 +405,11 @@ inline uint32_t getTimestampU32(le_advertising_info *info, uint8_t byteOffset) {
            ((uint32_t)info->data[startIdx + 3]));
 }
 
-inline float getTemperatureData(le_advertising_info *info, uint8_t byteOffset) {
+/* Integer byte + fraction byte in hundredths, as 0.01 C */
+inline int16_t getTemperatureData(le_advertising_info *info, uint8_t byteOffset) {
     uint8_t startIdx = QUARTZ_BLE_ADV_PKT_DATA_START_IDX + byteOffset;
-    return ((float)(info->data[startIdx]) + 
-            ((float)(info->data[startIdx + 1]))/100.0f);
+    return (int16_t)(((int32_t)info->data[startIdx] * TAPE_TEMP_CENTI_PER_DEGREE) +
+                     (int32_t)info->data[startIdx + 1]);
 }
 
 inline uint32_t getLimePid(le_advertising_info *info, uint8_t byteOffset) {
@@ -388,9 +425,10 @@ inline uint16_t getFid(le_advertising_info *info) {
             ((uint16_t)info->data[startIdx + 1]));
 }
 
-inline float getBatVoltage(le_advertising_info *info) {
+/* Battery voltage in 0.1 V */
+inline uint8_t getBatVoltage(le_advertising_info *info) {
     uint8_t startIdx = QUARTZ_BLE_ADV_PKT_DATA_START_IDX + QUARTZ_BLE_ADV_PKT_BAT_VOLT_OFFSET;
-    return (((float)info->data[startIdx])/10.0f);
+    return info->data[startIdx];
 }
 
 inline int8_t getTapeRssi(le_advertising_info *info) {
@@ -415,6 +453,8 @@ inline uint16_t getLightData(le_advertising_info *info, uint8_t byteOffset) {
 
 /* Exposed Function Declarations */
 void parseBleDataPacket(le_advertising_info *info, BleDataPacket *bleDataPkt);
+/* Queue a parsed packet for the uplink (main.cpp) */
+void sendBleDataPacket(BleDataPacket &bleDataPkt);
 uint8_t getQaurtzEventFlag(le_advertising_info *info);
 BlePacketType getBlePacketType(le_advertising_info *info);
 
@@ -0,0 +1,203 @@
+#ifndef _TRKLOG_H_
+#define _TRKLOG_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
+#include <time.h>
+
+/*
+    Asynchronous leveled logger behind TRK_PRINTF and the TRK_LOG_* macros.
+
+    A call site below the compile-time ceiling (TRK_LOG_MAX_LEVEL, make
+    TRK_LOG_MAX_LEVEL=n) or the runtime level (log_level) costs one relaxed
+    load and a branch; its arguments are not evaluated. An enabled call
+    captures the format pointer and its arguments in binary form (integers,
+    doubles, pointers, and copies of the strings) into a ring of the calling
+    thread. Each thread that logs gets its own single-producer
+    single-consumer ring on its first message, so the hot path takes no lock
+    and makes no system call. The writer thread drains the rings every
+    TRK_LOG_WRITER_POLL_MSECS, formats the messages in time order and
+    writes them to stdout in one go.
+
+    A full ring drops the message instead of blocking; the writer reports
+    the count. Each call site may emit log_rate_limit messages per second;
+    the rest are counted and the next message of the site says how many
+    were suppressed. Before trkLogInit(), after trkLogShutdown(), and for
+    threads beyond TRK_LOG_MAX_RINGS, messages are written synchronously.
+
+    Output lines are the formatted messages, as printf wrote them before.
+*/
+#define TRK_LOG_LEVEL_ERROR                       (0)
+#define TRK_LOG_LEVEL_WARN                        (1)
+#define TRK_LOG_LEVEL_INFO                        (2)
+#define TRK_LOG_LEVEL_DEBUG                       (3)
+
+#ifndef TRK_LOG_MAX_LEVEL
+#define TRK_LOG_MAX_LEVEL                         TRK_LOG_LEVEL_DEBUG
+#endif
+
+#define TRK_LOG_MAX_RINGS                         (16u)
+#define TRK_LOG_RING_BYTES                        (64u * 1024u)
+#define TRK_LOG_MAX_STR_LEN                       (2048u)
+#define TRK_LOG_WRITER_POLL_MSECS                 (50)
+#define TRK_LOG_RATE_WINDOW_SECS                  (1u)
+
+/* One call site; static storage in the macro, shared by every thread that runs it */
+typedef struct TrkLogSite {
+    const char *fmt;
+    int level;
+    std::atomic<uint32_t> windowSecs;    /* Start of the current rate limit window */
+    std::atomic<uint32_t> windowCount;   /* Messages emitted or suppressed in the window */
+    std::atomic<uint32_t> suppressed;    /* Messages suppressed since the last one emitted */
+} TrkLogSite;
+
+/* Argument tags of the binary records */
+typedef enum TrkLogArgType {
+    TRK_LOG_ARG_INT = 0,
+    TRK_LOG_ARG_UINT,
+    TRK_LOG_ARG_DOUBLE,
+    TRK_LOG_ARG_PTR,
+    TRK_LOG_ARG_STR
+} TrkLogArgType;
+
+extern std::atomic<int> trkLogLevel;
+
+/* Start the writer thread; messages are asynchronous from here on */
+void trkLogInit(void);
+
+/* Drain the rings, stop the writer thread and return to synchronous writes. Also runs at exit. */
+void trkLogShutdown(void);
+
+/* Apply log_level and log_rate_limit (messages per second per call site, 0 for no limit) */
+void trkLogConfigure(int level, int rateLimit);
+
+/* "error", "warn", "info" or "debug" to its level; -1 if unknown */
+int trkLogLevelFromName(const char *name);
+
+/* Rate limit check of a call site; fills the suppressed count the message carries */
+bool trkLogAdmit(TrkLogSite *site, uint32_t *suppressed);
+
+/* Reserve len bytes for a record of the calling thread: its ring, or a scratch buffer for a synchronous write.
+   Returns nullptr if the message is dropped. */
+uint8_t *trkLogReserve(size_t len);
+
+/* Publish the record written to the last reservation, or format and write it now */
+void trkLogCommit(void);
+
+/* Compile-time printf format check of the call sites; never called */
+__attribute__((format(printf, 1, 2))) inline void trkLogCheckFormat(const char *, ...) {}
+
+/* Record header, followed by the arguments: a tag byte and the value each */
+typedef struct TrkLogRecord {
+    uint32_t len;                        /* Whole record, multiple of 8; TRK_LOG_RECORD_PAD marks a wrap */
+    uint32_t suppressed;
+    const TrkLogSite *site;
+    uint64_t nsecs;
+    uint32_t argsLen;
+    uint32_t reserved;
+} TrkLogRecord;
+
+#define TRK_LOG_RECORD_PAD                        (0x80000000u)
+#define TRK_LOG_NULL_STR                          (0xFFFFFFFFu)
+
+inline uint64_t trkLogNowNsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+/* ----------------- Argument capture ---------------------- */
+template <typename T>
+inline size_t trkLogArgLen(const T &arg) {
+    using U = typename std::decay<T>::type;
+    if constexpr (std::is_same<U, char *>::value || std::is_same<U, const char *>::value) {
+        const char *str = arg;
+        return 1 + sizeof(uint32_t) + ((str != nullptr) ? strnlen(str, TRK_LOG_MAX_STR_LEN) : 0);
+    }
+    else {
+        return 1 + sizeof(uint64_t);
+    }
+}
+
+template <typename T>
+inline uint8_t *trkLogArgPut(uint8_t *p, const T &arg) {
+    using U = typename std::decay<T>::type;
+    if constexpr (std::is_same<U, char *>::value || std::is_same<U, const char *>::value) {
+        const char *str = arg;
+        uint32_t len = (str != nullptr) ? (uint32_t)strnlen(str, TRK_LOG_MAX_STR_LEN) : TRK_LOG_NULL_STR;
+        *p++ = TRK_LOG_ARG_STR;
+        memcpy(p, &len, sizeof(len));
+        p += sizeof(len);
+        if (str == nullptr) {
+            return p;
+        }
+        memcpy(p, str, len);
+        return p + len;
+    }
+    else {
+        uint64_t bits = 0;
+        if constexpr (std::is_floating_point<U>::value) {
+            double value = (double)arg;
+            *p = TRK_LOG_ARG_DOUBLE;
+            memcpy(&bits, &value, sizeof(bits));
+        }
+        else if constexpr (std::is_pointer<U>::value) {
+            *p = TRK_LOG_ARG_PTR;
+            bits = (uint64_t)(uintptr_t)arg;
+        }
+        else if constexpr (std::is_enum<U>::value || std::is_signed<U>::value) {
+            *p = TRK_LOG_ARG_INT;
+            bits = (uint64_t)(int64_t)arg;
+        }
+        else {
+            static_assert(std::is_integral<U>::value, "TRK_LOG: unsupported argument type");
+            *p = TRK_LOG_ARG_UINT;
+            bits = (uint64_t)arg;
+        }
+        memcpy(p + 1, &bits, sizeof(bits));
+        return p + 1 + sizeof(bits);
+    }
+}
+
+template <typename... Args>
+inline void trkLogWrite(TrkLogSite *site, const Args &... args) {
+    uint32_t suppressed = 0;
+    if (!trkLogAdmit(site, &suppressed)) {
+        return;
+    }
+
+    size_t argsLen = (trkLogArgLen(args) + ... + (size_t)0);
+    size_t len = (sizeof(TrkLogRecord) + argsLen + 7u) & ~(size_t)7u;
+    uint8_t *record = trkLogReserve(len);
+    if (record == nullptr) {
+        return;
+    }
+
+    TrkLogRecord header = {(uint32_t)len, suppressed, site, trkLogNowNsecs(), (uint32_t)argsLen, 0};
+    memcpy(record, &header, sizeof(header));
+    uint8_t *p = record + sizeof(header);
+    ((p = trkLogArgPut(p, args)), ...);
+    (void)p;
+    trkLogCommit();
+}
+
+#define TRK_LOG(lvl, fmt, ...)                                                          \
+  do {                                                                                  \
+    if ((lvl) <= TRK_LOG_MAX_LEVEL && (lvl) <= trkLogLevel.load(std::memory_order_relaxed)) { \
+      static TrkLogSite trkLogSite_ = {fmt, (lvl), {0}, {0}, {0}};                      \
+      if (false) {                                                                      \
+        trkLogCheckFormat(fmt, ##__VA_ARGS__);                                          \
+      }                                                                                 \
+      trkLogWrite(&trkLogSite_, ##__VA_ARGS__);                                         \
+    }                                                                                   \
+  } while (0)
+
+#define TRK_LOG_ERR(fmt, ...)         TRK_LOG(TRK_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define TRK_LOG_WARN(fmt, ...)        TRK_LOG(TRK_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define TRK_LOG_INFO(fmt, ...)        TRK_LOG(TRK_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define TRK_LOG_DBG(fmt, ...)         TRK_LOG(TRK_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+#endif /* _TRKLOG_H_ */
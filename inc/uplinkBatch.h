@@ -0,0 +1,69 @@
+#ifndef _UPLINKBATCH_H_
+#define _UPLINKBATCH_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "tapeFormat.h"
+#include "uplinkRetry.h"
+
+/* Text batches are posted as plain text, one G1/formatted record (query string without '?') per line.
+   B1 batches carry a binary header followed by the binary records (see uplinkCodec.h). */
+#define UPLINK_BATCH_CONTENT_TYPE                 "text/plain"
+#define UPLINK_BATCH_RECORD_SEPARATOR             '\n'
+/* Optional key in the batch response listing the 0-based indices of rejected records, e.g. "nack=1,5" */
+#define UPLINK_BATCH_NACK_KEY                     "nack="
+
+/* Per-record acknowledgement handed back to the pipeline once a batch completes */
+typedef void (*UplinkAckCallback)(const BleDataPacket &blePkt, UplinkResult result);
+
+/**
+ * @brief Initializes the uplink batch and registers the per-record acknowledgement callback.
+ *
+ * @param ackCb Callback invoked once per record after its batch has been sent.
+ */
+void uplinkBatchInit(UplinkAckCallback ackCb);
+
+/**
+ * @brief Appends a record to the current batch.
+ *
+ * If the record would push the body past uplink_batch_max_bytes, the pending
+ * batch is flushed first.
+ *
+ * @param record    Record text (query string without the leading '?').
+ * @param recordLen Length of the record text.
+ * @param blePkt    Packet the record was built from, returned through the ack callback.
+ * @return true if the record was added, false if it can never fit in a batch.
+ */
+bool uplinkBatchAddRecord(const char *record, size_t recordLen, const BleDataPacket &blePkt);
+
+/**
+ * @brief Appends a packet to the current batch as a binary B1 record.
+ *
+ * @param blePkt Parsed packet carrying the raw tape payload.
+ * @return true if the record was added, false otherwise.
+ */
+bool uplinkBatchAddPacket(const BleDataPacket &blePkt);
+
+/* Returns true while batches are sent in the binary B1 format (not rejected by the server) */
+bool uplinkBatchUsesBinary(void);
+
+/* Returns true if the batch has hit its record count, size or delay limit */
+bool uplinkBatchIsDue(void);
+
+/* Milliseconds until the oldest pending record reaches uplink_batch_max_delay_ms */
+uint32_t uplinkBatchMsecsUntilDue(void);
+
+/* Number of records waiting in the current batch */
+size_t uplinkBatchRecordCount(void);
+
+/**
+ * @brief Posts the pending batch to the cloud and acknowledges every record.
+ *
+ * While the circuit breaker is open the batch is not sent; its records are
+ * handed to the retry engine without counting a send attempt.
+ *
+ * @return 0 on HTTP 200, 1 on failure, -1 if there was nothing to send.
+ */
+int uplinkBatchFlush(void);
+
+#endif /* _UPLINKBATCH_H_ */
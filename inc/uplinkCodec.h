@@ -0,0 +1,85 @@
+#ifndef _UPLINKCODEC_H_
+#define _UPLINKCODEC_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "tapeFormat.h"
+
+/*
+    B1 binary batch format (curl_req_format = "B1"). All multi-byte integers are
+    LEB128 varints; signed values are zigzag encoded first.
+
+    Batch header (sent once per batch):
+        'T' 'B'                  magic
+        u8                       version (B1_FORMAT_VERSION)
+        varint + bytes           gateway ID
+        zigzag varint            gateway latitude  (micro-degrees)
+        zigzag varint            gateway longitude (micro-degrees)
+        varint                   base timestamp (capture epoch seconds of the first record)
+        varint                   record count
+
+    Record:
+        6 bytes                  tape MAC address
+        zigzag varint            timestamp delta to the previous record (first: to base)
+        varint                   per sensor type sequence number, shared with the text records (G1 "C")
+        u8                       BlePacketType
+        i8                       RSSI
+        24 bytes                 raw tape payload (G1 bytes)
+*/
+#define B1_MAGIC_0                                ('T')
+#define B1_MAGIC_1                                ('B')
+#define B1_FORMAT_VERSION                         (1u)
+#define B1_CONTENT_TYPE                           "application/vnd.trk.b1"
+#define B1_MAX_RECORD_LEN                         (6u + 5u + 5u + 1u + 1u + WHITE_TAPE_DATA_PACKET_LEN)
+
+/* Uplink payload compression (uplink_compression in sysConfig.ini) */
+typedef enum {
+    UPLINK_COMPRESSION_NONE,
+    UPLINK_COMPRESSION_DEFLATE,
+    UPLINK_COMPRESSION_ZSTD,
+} UplinkCompression;
+
+/* Varint helpers; return the number of bytes written */
+size_t encodeVarintU32(uint8_t *out, uint32_t value);
+size_t encodeVarintS32(uint8_t *out, int32_t value);
+
+/**
+ * @brief Encodes the B1 batch header.
+ *
+ * @param out          Output string the header is appended to.
+ * @param baseTs       Timestamp of the first record in the batch.
+ * @param recordCount  Number of records that follow the header.
+ */
+void encodeB1BatchHeader(std::string &out, uint32_t baseTs, uint32_t recordCount);
+
+/**
+ * @brief Encodes one B1 record.
+ *
+ * @param out     Output buffer of at least B1_MAX_RECORD_LEN bytes.
+ * @param blePkt  Parsed packet; its bleBuff must hold the raw tape payload.
+ * @param ts      Capture timestamp of the reading (BleDataPacket captureTs).
+ * @param prevTs  Timestamp of the previous record (or the batch base timestamp).
+ * @return Number of bytes written, 0 if the packet type is not supported.
+ */
+size_t encodeB1Record(uint8_t *out, const BleDataPacket &blePkt, uint32_t ts, uint32_t prevTs);
+
+/* Parses "none"/"deflate"/"zstd"; unknown values map to none */
+UplinkCompression parseUplinkCompression(const char *name);
+
+/* Content-Encoding header value for the compression, nullptr for none */
+const char *getUplinkContentEncoding(UplinkCompression compression);
+
+/**
+ * @brief Compresses an uplink payload.
+ *
+ * @param compression Requested compression. zstd falls back to deflate when the
+ *                    firmware is built without UPLINK_HAVE_ZSTD.
+ * @param in          Payload to compress.
+ * @param out         Compressed payload.
+ * @return The compression actually applied; UPLINK_COMPRESSION_NONE if the payload
+ *         is left as is (out is then unchanged).
+ */
+UplinkCompression compressUplinkPayload(UplinkCompression compression, const std::string &in, std::string &out);
+
+#endif /* _UPLINKCODEC_H_ */
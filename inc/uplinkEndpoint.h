@@ -0,0 +1,61 @@
+#ifndef _UPLINKENDPOINT_H_
+#define _UPLINKENDPOINT_H_
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+    Health and latency scoring of the uplink endpoints (instance and
+    instance_alternates in sysConfig.ini).
+
+    Every response updates its endpoint: the latency of a response feeds an
+    exponentially weighted average, and endpoint_fail_threshold consecutive
+    failures (no response or HTTP 5xx) take the endpoint out of rotation.
+    Requests go to the fastest healthy endpoint; endpoints within
+    endpoint_spread_pct of it take turns. With more than one endpoint, the
+    ones that failed or carried no traffic for endpoint_probe_interval_s are
+    probed, which is how a failed endpoint rejoins. When every endpoint has
+    failed, the one that failed longest ago is used.
+
+    All functions are called from the cloud communication thread.
+*/
+#define UPLINK_ENDPOINT_NONE                      (-1)
+#define UPLINK_ENDPOINT_LATENCY_WEIGHT            (0.2)
+
+/* Build the endpoint list from urlCfg.instances. Called once after readSysConfigFile(). */
+void uplinkEndpointInit(void);
+
+size_t getUplinkEndpointCount(void);
+
+/* Instance URL of an endpoint, nullptr for an invalid index */
+const char *getUplinkEndpointInstance(int endpoint);
+
+/* Endpoint for the next request, UPLINK_ENDPOINT_NONE if none is configured */
+int uplinkEndpointSelect(void);
+
+/* Best healthy endpoint other than the one that just failed, UPLINK_ENDPOINT_NONE if there is none */
+int uplinkEndpointSelectFailover(int failedEndpoint);
+
+/**
+ * @brief Records the outcome of a request or probe.
+ *
+ * @param endpoint      Endpoint the request went to.
+ * @param curlCode      CURLcode of the transfer.
+ * @param httpCode      HTTP response code, 0 if no response.
+ * @param totalTimeSecs Transfer time.
+ */
+void uplinkEndpointReport(int endpoint, int curlCode, long httpCode, double totalTimeSecs);
+
+/* Returns true for a response that counts against the endpoint's health */
+bool isUplinkEndpointFailure(int curlCode, long httpCode);
+
+/* Endpoint whose probe is due, UPLINK_ENDPOINT_NONE if none */
+int uplinkEndpointProbeDue(void);
+
+/* Milliseconds until the next probe is due, UINT32_MAX if probing is off (single endpoint) */
+uint32_t uplinkEndpointMsecsUntilProbe(void);
+
+/* Log the state of every endpoint */
+void logUplinkEndpoints(void);
+
+#endif /* _UPLINKENDPOINT_H_ */
@@ -0,0 +1,63 @@
+#ifndef _UPLINKQUEUE_H_
+#define _UPLINKQUEUE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "tapeFormat.h"
+
+/*
+    Uplink queue between the BLE scan thread and the cloud communication
+    thread: a last-value cache keyed by tape MAC + device type.
+
+    With uplink_coalesce enabled, a routine reading (event flag NormalMode,
+    HeartbeatMode or TemperatureHeartbeatMode) replaces the unsent routine
+    reading of the same tape and takes over its place in line, so the sender
+    always gets the freshest value and a backlog of routine readings is bounded
+    by the number of tapes instead of by the length of the outage. Event and
+    violation readings are always queued on their own and never replaced.
+    The sender leaves the readings here while the circuit breaker is open or
+    a server Retry-After is in effect, so an outage is ridden out in the
+    coalescing queue rather than in the retry queue and the spool replay.
+
+    The queue is not locked itself; main.cpp calls every function with
+    bleQueueMutex held.
+*/
+#define UPLINK_QUEUE_LOG_INTERVAL                 (100u)
+
+/* Uplink queue counters */
+typedef struct UplinkQueueStats {
+    uint64_t queued;                     /* Readings added to the queue */
+    uint64_t coalesced;                  /* Unsent routine readings replaced by a newer one of the same tape */
+    uint64_t taken;                      /* Readings handed to the sender */
+    size_t depth;                        /* Readings waiting right now */
+    size_t maxDepth;                     /* Largest depth seen */
+} UplinkQueueStats;
+
+/* Periodic reading that a newer reading of the same tape makes obsolete; mode
+   changes, resets, violations and backfilled log records are never superseded */
+bool isRoutineBlePacket(const BleDataPacket &blePkt);
+
+/**
+ * @brief Adds a reading to the queue, replacing the unsent routine reading of the same tape.
+ *
+ * @param blePkt     Reading to queue.
+ * @param superseded Receives the replaced reading, so that its spool record can be acknowledged.
+ * @return true if a queued reading was replaced, false if blePkt was appended.
+ */
+bool uplinkQueuePush(const BleDataPacket &blePkt, BleDataPacket *superseded);
+
+/**
+ * @brief Moves up to maxCount readings to blePkts, oldest slot first.
+ *
+ * @return Number of readings moved.
+ */
+size_t uplinkQueueTake(std::vector<BleDataPacket> &blePkts, size_t maxCount);
+
+/* Number of readings waiting to be sent */
+size_t uplinkQueueDepth(void);
+
+/* Copy the uplink queue counters */
+void getUplinkQueueStats(UplinkQueueStats *stats);
+
+#endif /* _UPLINKQUEUE_H_ */
@@ -0,0 +1,76 @@
+#ifndef _UPLINKRATELIMIT_H_
+#define _UPLINKRATELIMIT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "tapeFormat.h"
+
+/*
+    Hierarchical token bucket rate limiting of the uplink, applied before a
+    packet is spooled and queued.
+
+    A packet needs a token from three buckets: the gateway's, its device
+    type's and its tape's (uplink_rate_* in sysConfig.ini). When any of them
+    is empty the packet is held instead of dropped. Only the newest routine
+    reading per tape and device type is held: a newer one replaces the held
+    one, so a burst costs one upload per tape once the buckets refill. Event
+    and violation readings are held each on their own and never replaced.
+    Tape log records (BLE_PKT_FLAG_BACKFILL) bypass the limits, so a log
+    read is never cut short. Packets are spooled before they reach the
+    limiter, so a held packet survives a restart. Held packets are released
+    oldest first by the cloud communication thread. Past the per-tape or the
+    gateway hold cap a packet is not held in memory; it is left in the spool
+    and sent by the spool replay.
+*/
+#define UPLINK_RATE_LOG_INTERVAL                  (100u)
+#define UPLINK_RATE_MAX_HELD_PER_KEY              (32u)
+#define UPLINK_RATE_MAX_HELD                      (2048u)
+
+/* What became of a packet offered to the rate limiter */
+typedef enum UplinkRateVerdict {
+    UPLINK_RATE_ADMITTED = 0,            /* Tokens taken, queue it now */
+    UPLINK_RATE_HELD,                    /* Held until the buckets refill */
+    UPLINK_RATE_SPILLED                  /* Over the hold caps, left to the spool replay */
+} UplinkRateVerdict;
+
+/* Rate limiter counters */
+typedef struct UplinkRateLimitStats {
+    uint64_t admitted;                   /* Packets that got their tokens on arrival */
+    uint64_t held;                       /* Packets held for lack of tokens */
+    uint64_t coalesced;                  /* Held routine readings replaced by a newer one of the same tape */
+    uint64_t released;                   /* Held packets sent once the buckets refilled */
+    uint64_t spilled;                    /* Packets over the hold caps, left to the spool replay */
+    size_t pending;                      /* Packets held right now */
+} UplinkRateLimitStats;
+
+/* Fill the buckets from the rate limit configuration. Called once after readSysConfigFile(). */
+void uplinkRateLimitInit(void);
+
+/**
+ * @brief Takes the tokens for a new packet, or holds the packet if any bucket is empty.
+ *        Called from the BLE scan thread.
+ *
+ * @param blePkt     Parsed packet, already spooled.
+ * @param superseded Receives the held routine reading blePkt replaced, so that its spool record can be
+ *                   acknowledged; its spoolId is 0 if none was replaced.
+ * @return UPLINK_RATE_ADMITTED if the packet may be queued now, UPLINK_RATE_HELD if it is held,
+ *         UPLINK_RATE_SPILLED if the hold caps are reached and its spool record should be released to the replay.
+ */
+UplinkRateVerdict uplinkRateLimitAdmit(const BleDataPacket &blePkt, BleDataPacket *superseded);
+
+/**
+ * @brief Moves the held packets whose buckets have refilled to blePkts, oldest first.
+ *        Called from the cloud communication thread.
+ *
+ * @return Number of packets released.
+ */
+size_t uplinkRateLimitRelease(std::vector<BleDataPacket> &blePkts);
+
+/* Milliseconds until a held packet may be released, UINT32_MAX while none is held */
+uint32_t uplinkRateLimitMsecsUntilRelease(void);
+
+/* Copy the rate limiter counters */
+void getUplinkRateLimitStats(UplinkRateLimitStats *stats);
+
+#endif /* _UPLINKRATELIMIT_H_ */
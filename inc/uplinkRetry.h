@@ -0,0 +1,130 @@
+#ifndef _UPLINKRETRY_H_
+#define _UPLINKRETRY_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "tapeFormat.h"
+
+/*
+    Retry engine for the uplink.
+
+    Every request result is classified as acknowledged, retryable (no response,
+    HTTP 408/429/5xx) or rejected (any other status). Retryable packets wait
+    in a bounded in-memory queue for a jittered exponential backoff
+    (random in [0, min(retry_max_ms, retry_base_ms * 2^attempt)]) and are
+    dropped once they used up retry_max_attempts. Spooled packets get the
+    same backoff and expiry: their attempt count is kept in the spool record,
+    an expired one is acknowledged in the spool, and one that does not fit in
+    the queue or was held back unsent is left to the spool replay.
+
+    A circuit breaker opens after breaker_threshold consecutive retryable
+    failures. While open no request is sent; once the open period expires a
+    single probe request is let through (half-open) and its result closes the
+    circuit or opens it again for twice as long.
+
+    A server Retry-After holds all requests back the same way until it
+    expires, without counting as a failure.
+
+    All functions are called from the cloud communication thread only.
+*/
+
+/* Result of an uplink request for one packet */
+typedef enum UplinkResult {
+    UPLINK_RESULT_ACKED = 0,             /* Delivered */
+    UPLINK_RESULT_RETRY,                 /* Transient failure, send again later */
+    UPLINK_RESULT_REJECTED               /* Permanent failure, the server will never accept it */
+} UplinkResult;
+
+typedef enum UplinkCircuitState {
+    UPLINK_CIRCUIT_CLOSED = 0,
+    UPLINK_CIRCUIT_OPEN,
+    UPLINK_CIRCUIT_HALF_OPEN
+} UplinkCircuitState;
+
+typedef struct UplinkRetryStats {
+    uint64_t retried;                    /* Packets handed back for a retry */
+    uint64_t expired;                    /* Packets dropped after retry_max_attempts */
+    uint64_t overflowed;                 /* Unspooled packets dropped because the retry queue was full */
+    uint64_t circuitOpens;               /* Times the circuit breaker opened */
+    uint64_t serverHolds;                /* Times a server Retry-After held requests back */
+    size_t queued;                       /* Packets currently waiting in the retry queue */
+    UplinkCircuitState circuitState;
+} UplinkRetryStats;
+
+/**
+ * @brief Classifies an uplink response.
+ *
+ * @param httpCode HTTP response code, 0 if the request got no response (timeout, connection failure).
+ * @return Acknowledged, retryable or rejected.
+ */
+UplinkResult classifyUplinkResponse(long httpCode);
+
+/**
+ * @brief Full-jitter exponential backoff.
+ *
+ * @param attempt    Number of failed sends so far (0 for the first retry).
+ * @param baseMsecs  Backoff ceiling of the first retry.
+ * @param maxMsecs   Upper bound of the backoff ceiling.
+ * @return Random delay in [0, min(maxMsecs, baseMsecs * 2^attempt)].
+ */
+uint32_t getRetryBackoffMsecs(uint32_t attempt, uint32_t baseMsecs, uint32_t maxMsecs);
+
+/**
+ * @brief Asks the circuit breaker for permission to send a request.
+ *
+ * In the half-open state only the first caller gets the probe; the probe stays
+ * outstanding until its result is reported through uplinkCircuitReport().
+ *
+ * @return true if the request may be sent.
+ */
+bool uplinkCircuitAllowRequest(void);
+
+/* Reports the result of a request sent with the breaker's permission */
+void uplinkCircuitReport(UplinkResult result);
+
+/**
+ * @brief Holds every request back for holdMsecs, as asked by a server Retry-After.
+ *        A shorter hold than the one in effect is ignored.
+ */
+void uplinkCircuitHoldOff(uint32_t holdMsecs);
+
+/* Returns true if backlog traffic may be sent: the circuit is closed and the last
+   request succeeded, or the open circuit is due for its probe */
+bool uplinkCircuitAllowsBacklog(void);
+
+/* Milliseconds until the open circuit lets a probe through or the server hold
+   expires, 0 if requests are allowed */
+uint32_t uplinkCircuitMsecsUntilProbe(void);
+
+/**
+ * @brief Hands a packet back for a later retry.
+ *
+ * The packet joins the bounded retry queue, or is dropped once it used up
+ * retry_max_attempts. A full queue gives up its oldest routine reading, or its
+ * oldest packet if it holds none and blePkt is an event; a routine blePkt is
+ * given up itself rather than an event. A spooled packet held back unsent, or
+ * given up by the full queue, is released to the spool replay instead.
+ *
+ * @param blePkt Packet to retry.
+ * @param sent   true if the packet was sent and failed, false if it was held back
+ *               without being sent (open circuit); only sends count as attempts.
+ */
+void uplinkRetryDefer(const BleDataPacket &blePkt, bool sent);
+
+/**
+ * @brief Moves the retry queue packets whose backoff has expired to out.
+ *
+ * @param out      Due packets are appended here.
+ * @param maxCount Upper bound on the packets returned by this call.
+ * @return Number of packets appended to out.
+ */
+size_t uplinkRetryTakeDue(std::vector<BleDataPacket> &out, size_t maxCount);
+
+/* Milliseconds until the next queued retry is due, UINT32_MAX if the queue is empty */
+uint32_t uplinkRetryMsecsUntilDue(void);
+
+/* Copy the retry statistics */
+void getUplinkRetryStats(UplinkRetryStats *stats);
+
+#endif /* _UPLINKRETRY_H_ */
@@ -0,0 +1,90 @@
+#ifndef _UPLINKSPOOL_H_
+#define _UPLINKSPOOL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "tapeFormat.h"
+
+/*
+    Crash-safe store-and-forward spool for uplink packets.
+
+    Packets are appended to append-only segment files (spool_dir/seg_<n>.log)
+    before they are queued for upload. Appends are plain write() calls; the
+    cloud thread makes them durable with one fdatasync per spool_fsync_interval_ms.
+    Acknowledged packets advance a low-water mark (spool_dir/spool.ack) and
+    fully acknowledged segments are deleted. Unacknowledged packets, from a
+    previous run or rejected in this run, are replayed at spool_replay_rate.
+    Only the low-water mark is persisted, so packets acknowledged out of order
+    above it may be sent again after a restart (at-least-once delivery).
+
+    Segment record frame:
+        u32 payload length | u32 crc32(id + payload) | u64 record id | u32 send attempts | u32 reserved |
+        payload (BleDataPacket)
+
+    The send attempts of a record are rewritten in place after each failed
+    send, so a replayed record keeps counting towards retry_max_attempts,
+    also across restarts.
+*/
+#define SPOOL_SEGMENT_MAGIC                       (0x4C4F5053u)   /* "SPOL" */
+#define SPOOL_SEGMENT_VERSION                     (6u)
+#define SPOOL_REPLAY_SCAN_LIMIT                   (256u)
+
+/**
+ * @brief Opens the spool directory, recovers existing segments and the ack mark.
+ *
+ * Torn records at the tail of the last segment (crash during append) are truncated.
+ *
+ * @return true if the spool is enabled and ready, false if disabled or on failure.
+ */
+bool uplinkSpoolInit(void);
+
+/* Returns true if the spool is enabled */
+bool isUplinkSpoolEnabled(void);
+
+/**
+ * @brief Appends a packet to the spool. Thread safe; called before the packet is queued.
+ *
+ * @param blePkt Packet to store. Its spoolId is set to the assigned record id.
+ * @return true if the packet was stored.
+ */
+bool uplinkSpoolAppend(BleDataPacket &blePkt);
+
+/**
+ * @brief Reports the upload result of a spooled packet.
+ *
+ * @param spoolId Record id assigned by uplinkSpoolAppend.
+ * @param acked   true on HTTP 200; false leaves the record in the spool for replay.
+ */
+void uplinkSpoolAck(uint64_t spoolId, bool acked);
+
+/**
+ * @brief Records the failed sends of a spooled packet in its record, for the replay.
+ *
+ * @param spoolId      Record id assigned by uplinkSpoolAppend.
+ * @param sendAttempts Failed sends so far.
+ */
+void uplinkSpoolSetAttempts(uint64_t spoolId, uint32_t sendAttempts);
+
+/**
+ * @brief Periodic spool maintenance: batched fdatasync, ack mark persistence and
+ *        segment trimming. Called from the cloud thread.
+ */
+void uplinkSpoolSync(void);
+
+/**
+ * @brief Reads the next unacknowledged records to replay, honouring spool_replay_rate.
+ *
+ * @param out      Replayed packets are appended here.
+ * @param maxCount Upper bound on the records returned by this call.
+ * @return Number of records appended to out.
+ */
+size_t uplinkSpoolReplay(std::vector<BleDataPacket> &out, size_t maxCount);
+
+/* Returns true while unacknowledged records are waiting to be replayed */
+bool uplinkSpoolHasBacklog(void);
+
+/* Syncs and closes the spool. Called once on shutdown. */
+void uplinkSpoolClose(void);
+
+#endif /* _UPLINKSPOOL_H_ */
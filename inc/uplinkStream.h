@@ -0,0 +1,58 @@
+#ifndef _UPLINKSTREAM_H_
+#define _UPLINKSTREAM_H_
+
+#include <cstdint>
+
+/*
+    WebSocket streaming transport of the single mode readings
+    (uplink_transport = "websocket").
+
+    One persistent connection to uplink_stream_path on the selected endpoint:
+    libcurl opens the TCP (and for https:// instances the TLS) connection, the
+    WebSocket upgrade and the RFC 6455 framing are done here, so no libcurl
+    WebSocket support is needed. Every reading is a text frame "<seq> <query>",
+    the URL extension without its leading '?', with a sequence number that
+    grows for the lifetime of the gateway process. The server answers with
+    text frames:
+
+        "ack <seq>"          every reading up to seq is accepted (HTTP 200)
+        "nack <seq> <code>"  reading seq got status code (e.g. 400 or 503)
+
+    Acknowledgements are cumulative, so the server may acknowledge a whole
+    window with one frame. At most uplink_stream_window readings are in flight
+    before the stream waits for an acknowledgement.
+
+    The upgrade is accepted only if Sec-WebSocket-Accept matches the key that
+    was sent. A reading too long for a UPLINK_STREAM_MAX_FRAME_LEN frame is
+    left to HTTP and the stream stays up.
+
+    A reading that is not acknowledged within UPLINK_STREAM_ACK_TIMEOUT_MSECS,
+    or whose connection drops, reports status 0 and the connection is closed;
+    sendDataUrlsToCloud() then sends it over HTTP. Failed connects back off
+    from UPLINK_STREAM_RECONNECT_MIN_MSECS to UPLINK_STREAM_RECONNECT_MAX_MSECS,
+    with HTTP carrying the readings meanwhile.
+
+    All functions are called from the cloud communication thread.
+*/
+#define UPLINK_STREAM_ACK_TIMEOUT_MSECS           (10000u)
+#define UPLINK_STREAM_RECONNECT_MIN_MSECS         (1000u)
+#define UPLINK_STREAM_RECONNECT_MAX_MSECS         (60000u)
+#define UPLINK_STREAM_MAX_FRAME_LEN               (512u)
+#define UPLINK_STREAM_LOG_INTERVAL                (1000u)
+
+/* Streaming transport counters; bytes are the upgrade and the WebSocket frames, without TCP/TLS */
+typedef struct UplinkStreamStats {
+    uint64_t connects;                   /* Successful WebSocket upgrades */
+    uint64_t connectFailures;            /* Failed connects or upgrades */
+    uint64_t disconnects;                /* Connections closed after an error or ack timeout */
+    uint64_t readings;                   /* Readings sent as frames */
+    uint64_t acked;                      /* Readings acknowledged (ack or nack) */
+    uint64_t bytesSent;                  /* Bytes sent, frame headers and masks included */
+    uint64_t bytesReceived;              /* Bytes received, frame headers included */
+    double ackSecsTotal;                 /* Sum of the send-to-ack times of the acknowledged readings */
+} UplinkStreamStats;
+
+/* Copy the streaming transport counters */
+void getUplinkStreamStats(UplinkStreamStats *stats);
+
+#endif /* _UPLINKSTREAM_H_ */
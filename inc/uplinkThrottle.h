@@ -0,0 +1,41 @@
+#ifndef _UPLINKTHROTTLE_H_
+#define _UPLINKTHROTTLE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "cloudComm.h"
+
+/*
+    Server-directed throttling of the uplink.
+
+    Every cloud response may carry hints, as HTTP headers or as keys in the
+    response body (see cloudComm.h):
+        Retry-After              pause the whole uplink (capped at throttle_max_hold_s)
+        concurrency              parallel requests in single mode
+        batch_max                records per batch in batch mode
+        report_interval          seconds between two uploads of the same tape
+
+    Hints only ever make the gateway send less: the concurrency and batch size
+    are capped at CURL_MAX_PARALLEL_REQUESTS and uplink_batch_max_records, and
+    the report interval is floored at tape_report_interval_s. A hint of 0
+    clears it, and all hints revert to the configured values once no response
+    repeated them for throttle_hint_ttl_s.
+*/
+
+/**
+ * @brief Applies the hints of a cloud response. Called from the cloud communication thread.
+ *
+ * @param hints Hints parsed from the response headers and body.
+ */
+void uplinkThrottleApplyHints(const CloudResponseHints &hints);
+
+/* Parallel requests per round in single mode, 1..CURL_MAX_PARALLEL_REQUESTS */
+size_t getUplinkConcurrency(void);
+
+/* Records per batch in batch mode, 1..uplink_batch_max_records */
+size_t getUplinkBatchMaxRecords(void);
+
+/* Seconds between two uploads of the same tape. Thread safe (read by the scan thread). */
+uint32_t getTapeReportIntervalSecs(void);
+
+#endif /* _UPLINKTHROTTLE_H_ */
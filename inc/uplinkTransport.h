@@ -0,0 +1,43 @@
+#ifndef _UPLINKTRANSPORT_H_
+#define _UPLINKTRANSPORT_H_
+
+#include <cstddef>
+
+/*
+    Transport of the single mode readings (uplink_transport in sysConfig.ini).
+
+    sendDataUrlToCloud() and sendDataUrlsToCloud() hand the URL extensions to
+    the configured transport: "http" sends one GET per reading over the pooled
+    connection (the default), "websocket" streams them over one persistent
+    connection (see uplinkStream.h). Readings a streaming transport could not
+    deliver are sent over HTTP in the same call, so switching transports never
+    costs data. Batches, heartbeats and probes always go over HTTP.
+*/
+#define UPLINK_TRANSPORT_HTTP               "http"
+#define UPLINK_TRANSPORT_WEBSOCKET          "websocket"
+
+typedef struct UplinkTransport {
+    const char *name;
+
+    /**
+     * @brief Sends URL extensions (query strings with the leading '?') to the cloud.
+     *
+     * @param urlExtensions Readings to send.
+     * @param count         Number of entries in urlExtensions.
+     * @param httpCodes     count entries that receive each HTTP (or HTTP equivalent) status,
+     *                      0 for a reading that got no answer.
+     * @return Number of readings that got no answer, -1 on invalid input.
+     */
+    int (*sendDataUrls)(const char *const *urlExtensions, size_t count, long *httpCodes);
+
+    /* Close the transport's connections. Called once on shutdown. */
+    void (*cleanup)(void);
+} UplinkTransport;
+
+extern const UplinkTransport httpUplinkTransport;
+extern const UplinkTransport wsUplinkTransport;
+
+/* Transport selected by uplink_transport, HTTP when unset or unknown */
+const UplinkTransport *getUplinkTransport(void);
+
+#endif /* _UPLINKTRANSPORT_H_ */
@@ -0,0 +1,62 @@
+#ifndef _URLBUILDER_H_
+#define _URLBUILDER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "tapeFormat.h"
+
+/*
+    Allocation-free builder for the per-packet data URL extension.
+
+    Every packet type has a G1 and a formatted URL template, e.g.
+        ?rid={gw}&C={seq}&id={mac}&type={gw}&ts={t0_ts}&rssi={rssi}&...&clat={lat}&clon={lon}&st=5258
+    The templates are compiled once after the configuration is loaded: the
+    gateway constants ({gw}, {lat}, {lon}) are resolved and pre-joined with the
+    surrounding text, leaving a short list of ops that copy a constant segment
+    or write one packet field with a specialized integer, hex or fixed-point
+    formatter. The output is byte for byte the one of the snprintf formats.
+
+    Placeholders available to every packet type:
+        {gw} {lat} {lon}    gateway id and location (constants)
+        {seq}               per packet type sequence number
+        {now}               current epoch seconds
+        {g1}                raw tape payload, 24 bytes as upper case hex
+        {st}                first two payload bytes as upper case hex
+*/
+#define URL_TEMPLATE_MAX_OPS                      (48u)
+#define URL_TEMPLATE_MAX_LITERALS                 (512u)
+
+/**
+ * @brief Compiles the URL templates for the configured gateway and curl_req_format.
+ *        Called once after readSysConfigFile().
+ *
+ * @return true on success; on failure createBleDataUrlExtension() keeps using snprintf.
+ */
+bool urlBuilderInit(void);
+
+/**
+ * @brief Creates the URL extension (query string with the leading '?') for a BLE data packet.
+ *
+ * @param urlDataBuff    Output buffer.
+ * @param urlDataBuffLen Size of the output buffer, at least 128 bytes.
+ * @param blePkt         Parsed packet.
+ * @return URL_CREATE_SUCCESS, -1 on invalid input or a too small buffer, -2 for an unknown packet type.
+ */
+int createBleDataUrlExtension(char *urlDataBuff, size_t urlDataBuffLen, BleDataPacket *blePkt);
+
+/* The original snprintf based implementation, kept as the fallback and the benchmark baseline */
+int createBleDataUrlExtensionSnprintf(char *urlDataBuff, size_t urlDataBuffLen, BleDataPacket *blePkt);
+
+/* Next per packet type sequence number ("C"), shared by the text and the B1 records. Cloud thread only. */
+int getNextUplinkSeqNumber(BlePacketType blePktType);
+
+/**
+ * @brief Writes the full data URL: the pre-joined instance + url_extension followed by the extension.
+ *
+ * @param endpoint Uplink endpoint (index into urlCfg.instances) whose instance is used.
+ * @return Length of the URL, or 0 if it does not fit in urlBuffLen (including the terminator).
+ */
+size_t buildCloudDataUrl(char *urlBuff, size_t urlBuffLen, const char *urlExtension, size_t urlExtensionLen,
+                         int endpoint);
+
+#endif /* _URLBUILDER_H_ */
@@ -0,0 +1,567 @@
+#include <cerrno>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include "common.h"
+#include "config.h"
+#include "attClient.h"
+
+using namespace std;
+
+/* Bluetooth Base UUID 00000000-0000-1000-8000-00805F9B34FB, little-endian as on the air */
+static const uint8_t bluetoothBaseUuid[16] = {0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80,
+                                              0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static AttClientStats attStats = {0};
+
+static inline void putLe16(uint8_t *buff, uint16_t value);
+static inline uint16_t getLe16(const uint8_t *buff);
+static bool parseUuid(const char *str, uint8_t uuid[16]);
+static bool sendPdu(AttSession &session, const uint8_t *pdu, size_t len);
+static bool sendDiscover(AttSession &session);
+static bool sendFindCccd(AttSession &session, uint16_t startHandle);
+static bool sendRead(AttSession &session);
+static bool sendWrite(AttSession &session);
+static void finishSession(AttSession &session, AttSessionState state, const char *reason);
+static void deliverValue(AttSession &session, const uint8_t *value, size_t len);
+static void startLogTransfer(AttSession &session);
+static void enterStream(AttSession &session);
+static void handleDiscoverRsp(AttSession &session, const uint8_t *pdu, size_t len);
+static void handleFindInfoRsp(AttSession &session, const uint8_t *pdu, size_t len);
+static void handlePrepareWriteRsp(AttSession &session, const uint8_t *pdu, size_t len);
+static void handleErrorRsp(AttSession &session, const uint8_t *pdu, size_t len);
+static bool beginSession(AttSession &session, int sock, const string &macAddr);
+static void handlePdu(AttSession &session, const uint8_t *pdu, size_t len);
+
+/* ----------------- Function Definitions ---------------------- */
+static inline void putLe16(uint8_t *buff, uint16_t value) {
+    buff[0] = (uint8_t)(value & 0xFF);
+    buff[1] = (uint8_t)(value >> 8);
+}
+
+static inline uint16_t getLe16(const uint8_t *buff) {
+    return (uint16_t)(buff[0] | ((uint16_t)buff[1] << 8));
+}
+
+/* "6E400003-B5A3-F393-E0A9-E50E24DCCA9E" or a 16-bit "2A1C", to the little-endian 128-bit form */
+static bool parseUuid(const char *str, uint8_t uuid[16]) {
+    uint8_t bigEndian[16] = {0};
+    size_t digits = 0;
+    if (str == nullptr) {
+        return false;
+    }
+    for (const char *p = str; *p != '\0'; p++) {
+        if (*p == '-') {
+            continue;
+        }
+        if (!isxdigit((unsigned char)*p) || digits >= 32) {
+            return false;
+        }
+        uint8_t nibble = (uint8_t)(isdigit((unsigned char)*p) ? (*p - '0') : (toupper((unsigned char)*p) - 'A' + 10));
+        bigEndian[digits / 2] = (uint8_t)((bigEndian[digits / 2] << 4) | nibble);
+        digits++;
+    }
+
+    if (digits == 4) {
+        memcpy(uuid, bluetoothBaseUuid, 16);
+        uuid[12] = bigEndian[1];
+        uuid[13] = bigEndian[0];
+        return true;
+    }
+    if (digits != 32) {
+        return false;
+    }
+    for (size_t i = 0; i < 16; i++) {
+        uuid[i] = bigEndian[15 - i];
+    }
+    return true;
+}
+
+static bool sendPdu(AttSession &session, const uint8_t *pdu, size_t len) {
+    if (send(session.sock, pdu, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        finishSession(session, ATT_STATE_FAILED, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/* Read By Type for the characteristic declarations from searchStart on */
+static bool sendDiscover(AttSession &session) {
+    uint8_t pdu[7] = {ATT_OP_READ_BY_TYPE_REQ};
+    putLe16(&pdu[1], session.searchStart);
+    putLe16(&pdu[3], 0xFFFF);
+    putLe16(&pdu[5], GATT_UUID_CHARACTERISTIC);
+    session.state = ATT_STATE_DISCOVER;
+    return sendPdu(session, pdu, sizeof(pdu));
+}
+
+static bool sendFindCccd(AttSession &session, uint16_t startHandle) {
+    uint8_t pdu[5] = {ATT_OP_FIND_INFO_REQ};
+    putLe16(&pdu[1], startHandle);
+    putLe16(&pdu[3], 0xFFFF);
+    session.state = ATT_STATE_FIND_CCCD;
+    return sendPdu(session, pdu, sizeof(pdu));
+}
+
+/* Read at offset 0, Read Blob after that */
+static bool sendRead(AttSession &session) {
+    uint8_t pdu[5] = {0};
+    size_t len = 3;
+    pdu[0] = (session.valueOffset == 0) ? ATT_OP_READ_REQ : ATT_OP_READ_BLOB_REQ;
+    putLe16(&pdu[1], session.valueHandle);
+    if (session.valueOffset > 0) {
+        putLe16(&pdu[3], session.valueOffset);
+        len = 5;
+    }
+    session.state = ATT_STATE_READ;
+    return sendPdu(session, pdu, len);
+}
+
+/* Write Request when the value fits one PDU, otherwise the Prepare Write at valueOffset */
+static bool sendWrite(AttSession &session) {
+    uint8_t pdu[ATT_MAX_PDU_LEN];
+    size_t valueLen = session.writeValue.size();
+    putLe16(&pdu[1], session.valueHandle);
+    if (valueLen <= (size_t)(session.mtu - 3)) {
+        pdu[0] = ATT_OP_WRITE_REQ;
+        memcpy(&pdu[3], session.writeValue.data(), valueLen);
+        session.state = ATT_STATE_WRITE;
+        return sendPdu(session, pdu, 3 + valueLen);
+    }
+
+    size_t partLen = min(valueLen - session.valueOffset, (size_t)(session.mtu - 5));
+    pdu[0] = ATT_OP_PREPARE_WRITE_REQ;
+    putLe16(&pdu[3], session.valueOffset);
+    memcpy(&pdu[5], &session.writeValue[session.valueOffset], partLen);
+    session.state = ATT_STATE_PREPARE;
+    return sendPdu(session, pdu, 5 + partLen);
+}
+
+static void finishSession(AttSession &session, AttSessionState state, const char *reason) {
+    if (session.state == ATT_STATE_DONE || session.state == ATT_STATE_FAILED) {
+        return;
+    }
+    uint64_t elapsedMsecs = getMonotonicTimeMsecs() - session.startMsecs;
+    if (session.write) {
+        session.state = state;
+        if (state == ATT_STATE_DONE) {
+            attStats.writes++;
+            TRK_PRINTF("ATT_Write: %s wrote %zu bytes (mtu %u) in %llu ms", session.macAddr.c_str(),
+                       session.writeValue.size(), session.mtu, (unsigned long long)elapsedMsecs);
+        }
+        else {
+            attStats.writeFailures++;
+            TRK_PRINTF("ATT_Write: %s failed after %llu bytes (%s)", session.macAddr.c_str(),
+                       (unsigned long long)session.valueBytes, reason);
+        }
+        return;
+    }
+    attStats.records += session.records;
+    attStats.valueBytes += session.valueBytes;
+    if (session.persistent && session.state == ATT_STATE_STREAM) {
+        /* A persistent stream only ends with the connection */
+        session.state = ATT_STATE_DONE;
+        attStats.completed++;
+        attStats.transferSecs += (double)elapsedMsecs / 1000.0;
+        TRK_PRINTF("ATT_Log: %s stream ended after %u records in %llu s (%s)", session.macAddr.c_str(),
+                   session.records, (unsigned long long)(elapsedMsecs / 1000u), reason ? reason : "closed");
+        return;
+    }
+
+    session.state = state;
+    if (state == ATT_STATE_DONE) {
+        attStats.completed++;
+        attStats.transferSecs += (double)elapsedMsecs / 1000.0;
+        double kbPerSec = (elapsedMsecs > 0) ? ((double)session.valueBytes / (double)elapsedMsecs) : 0.0;
+        TRK_PRINTF("ATT_Log: %s read %u records (%llu bytes, mtu %u) in %llu ms, %.1f kB/s",
+                   session.macAddr.c_str(), session.records, (unsigned long long)session.valueBytes,
+                   session.mtu, (unsigned long long)elapsedMsecs, kbPerSec);
+    }
+    else {
+        attStats.failed++;
+        TRK_PRINTF("ATT_Log: %s failed after %u records (%s)", session.macAddr.c_str(), session.records, reason);
+    }
+}
+
+/* Split the log bytes into records; a record cut by the PDU boundary waits for the next PDU */
+static void deliverValue(AttSession &session, const uint8_t *value, size_t len) {
+    session.valueBytes += len;
+    while (len > 0) {
+        if (session.partial.empty() && len >= WHITE_TAPE_DATA_PACKET_LEN) {
+            session.onRecord(session.macAddr, value, WHITE_TAPE_DATA_PACKET_LEN);
+            session.records++;
+            value += WHITE_TAPE_DATA_PACKET_LEN;
+            len -= WHITE_TAPE_DATA_PACKET_LEN;
+            continue;
+        }
+
+        size_t take = min(len, WHITE_TAPE_DATA_PACKET_LEN - session.partial.size());
+        session.partial.insert(session.partial.end(), value, value + take);
+        value += take;
+        len -= take;
+        if (session.partial.size() == WHITE_TAPE_DATA_PACKET_LEN) {
+            session.onRecord(session.macAddr, session.partial.data(), session.partial.size());
+            session.records++;
+            session.partial.clear();
+        }
+    }
+}
+
+/* The characteristic is known: write it, or stream the log if it notifies and read it otherwise */
+static void startLogTransfer(AttSession &session) {
+    if (session.write) {
+        if (session.properties & GATT_CHAR_PROP_WRITE) {
+            sendWrite(session);
+        }
+        else {
+            finishSession(session, ATT_STATE_FAILED, "characteristic is not writable");
+        }
+    }
+    else if (session.properties & GATT_CHAR_PROP_NOTIFY) {
+        sendFindCccd(session, (uint16_t)(session.valueHandle + 1));
+    }
+    else if (session.properties & GATT_CHAR_PROP_READ) {
+        sendRead(session);
+    }
+    else {
+        finishSession(session, ATT_STATE_FAILED, "log characteristic is neither readable nor notifying");
+    }
+}
+
+/* Subscribed: a persistent session streams from now on without a deadline */
+static void enterStream(AttSession &session) {
+    if (session.state == ATT_STATE_STREAM) {
+        return;
+    }
+    session.state = ATT_STATE_STREAM;
+    if (session.persistent) {
+        session.deadlineMsecs = UINT64_MAX;
+        attStats.streams++;
+        TRK_PRINTF("ATT_Log: %s streaming notifications (mtu %u)", session.macAddr.c_str(), session.mtu);
+    }
+}
+
+static void handleDiscoverRsp(AttSession &session, const uint8_t *pdu, size_t len) {
+    uint8_t wantedUuid[16];
+    if (!parseUuid(session.charUuid, wantedUuid)) {
+        finishSession(session, ATT_STATE_FAILED, "invalid characteristic UUID");
+        return;
+    }
+
+    size_t entryLen = (len >= 2) ? pdu[1] : 0;
+    /* Declaration handle, properties, value handle and a 16 or 128-bit UUID */
+    if (entryLen != 7 && entryLen != 21) {
+        finishSession(session, ATT_STATE_FAILED, "malformed Read By Type response");
+        return;
+    }
+
+    uint16_t lastHandle = session.searchStart;
+    for (size_t offset = 2; offset + entryLen <= len; offset += entryLen) {
+        const uint8_t *entry = &pdu[offset];
+        uint8_t uuid[16];
+        if (entryLen == 7) {
+            memcpy(uuid, bluetoothBaseUuid, 16);
+            uuid[12] = entry[5];
+            uuid[13] = entry[6];
+        }
+        else {
+            memcpy(uuid, &entry[5], 16);
+        }
+
+        lastHandle = getLe16(&entry[0]);
+        if (memcmp(uuid, wantedUuid, 16) == 0) {
+            session.properties = entry[2];
+            session.valueHandle = getLe16(&entry[3]);
+            startLogTransfer(session);
+            return;
+        }
+    }
+
+    if (lastHandle == 0xFFFF) {
+        finishSession(session, ATT_STATE_FAILED, "characteristic not found");
+        return;
+    }
+    session.searchStart = (uint16_t)(lastHandle + 1);
+    sendDiscover(session);
+}
+
+static void handleFindInfoRsp(AttSession &session, const uint8_t *pdu, size_t len) {
+    /* Format 1: handle + 16-bit UUID, format 2: handle + 128-bit UUID */
+    size_t entryLen = (len >= 2 && pdu[1] == 1) ? 4 : 18;
+    uint16_t lastHandle = session.valueHandle;
+    for (size_t offset = 2; offset + entryLen <= len; offset += entryLen) {
+        uint16_t handle = getLe16(&pdu[offset]);
+        lastHandle = handle;
+        if (entryLen != 4) {
+            continue;
+        }
+
+        uint16_t uuid = getLe16(&pdu[offset + 2]);
+        if (uuid == GATT_UUID_CCCD) {
+            uint8_t write[5] = {ATT_OP_WRITE_REQ};
+            putLe16(&write[1], handle);
+            putLe16(&write[3], GATT_CCCD_NOTIFY);
+            session.state = ATT_STATE_SUBSCRIBE;
+            sendPdu(session, write, sizeof(write));
+            return;
+        }
+        if (uuid == GATT_UUID_CHARACTERISTIC || uuid == GATT_UUID_PRIMARY_SERVICE ||
+            uuid == GATT_UUID_SECONDARY_SERVICE) {
+            /* Past the descriptors of the log characteristic without a CCCD */
+            session.properties &= (uint8_t)~GATT_CHAR_PROP_NOTIFY;
+            startLogTransfer(session);
+            return;
+        }
+    }
+
+    if (lastHandle == 0xFFFF) {
+        session.properties &= (uint8_t)~GATT_CHAR_PROP_NOTIFY;
+        startLogTransfer(session);
+        return;
+    }
+    sendFindCccd(session, (uint16_t)(lastHandle + 1));
+}
+
+/* The tape echoes every part it queued; a part that comes back different cancels the whole write */
+static void handlePrepareWriteRsp(AttSession &session, const uint8_t *pdu, size_t len) {
+    size_t partLen = (len > 5) ? (len - 5) : 0;
+    if (partLen == 0 || getLe16(&pdu[1]) != session.valueHandle || getLe16(&pdu[3]) != session.valueOffset ||
+        session.valueOffset + partLen > session.writeValue.size() ||
+        memcmp(&pdu[5], &session.writeValue[session.valueOffset], partLen) != 0) {
+        uint8_t cancel[2] = {ATT_OP_EXECUTE_WRITE_REQ, ATT_EXEC_WRITE_CANCEL};
+        if (sendPdu(session, cancel, sizeof(cancel))) {
+            finishSession(session, ATT_STATE_FAILED, "prepared write not echoed");
+        }
+        return;
+    }
+
+    session.valueOffset = (uint16_t)(session.valueOffset + partLen);
+    session.valueBytes += partLen;
+    if (session.valueOffset < session.writeValue.size()) {
+        sendWrite(session);
+        return;
+    }
+    uint8_t execute[2] = {ATT_OP_EXECUTE_WRITE_REQ, ATT_EXEC_WRITE_COMMIT};
+    session.state = ATT_STATE_EXECUTE;
+    sendPdu(session, execute, sizeof(execute));
+}
+
+static void handleErrorRsp(AttSession &session, const uint8_t *pdu, size_t len) {
+    uint8_t reqOpcode = (len >= 5) ? pdu[1] : 0;
+    uint8_t errCode = (len >= 5) ? pdu[4] : 0;
+
+    if (session.state == ATT_STATE_MTU) {
+        /* The server keeps the default MTU */
+        session.mtu = ATT_DEFAULT_MTU;
+        sendDiscover(session);
+    }
+    else if (session.state == ATT_STATE_FIND_CCCD && errCode == ATT_ECODE_ATTR_NOT_FOUND) {
+        session.properties &= (uint8_t)~GATT_CHAR_PROP_NOTIFY;
+        startLogTransfer(session);
+    }
+    else if (session.state == ATT_STATE_READ && reqOpcode == ATT_OP_READ_BLOB_REQ) {
+        /* Invalid offset or attribute not long: the value ended exactly at the last response */
+        finishSession(session, ATT_STATE_DONE, nullptr);
+    }
+    else {
+        char reason[64];
+        snprintf(reason, sizeof(reason), "ATT error 0x%02X on request 0x%02X", errCode, reqOpcode);
+        finishSession(session, ATT_STATE_FAILED, reason);
+    }
+}
+
+static void handlePdu(AttSession &session, const uint8_t *pdu, size_t len) {
+    uint8_t opcode = pdu[0];
+    session.lastRxMsecs = getMonotonicTimeMsecs();
+
+    switch (opcode) {
+        case ATT_OP_ERROR_RSP:
+            handleErrorRsp(session, pdu, len);
+            return;
+        case ATT_OP_MTU_RSP:
+            if (session.state == ATT_STATE_MTU && len >= 3) {
+                uint16_t serverMtu = getLe16(&pdu[1]);
+                session.mtu = max((uint16_t)ATT_DEFAULT_MTU, min(serverMtu, (uint16_t)ATT_CLIENT_MTU));
+                sendDiscover(session);
+            }
+            return;
+        case ATT_OP_READ_BY_TYPE_RSP:
+            if (session.state == ATT_STATE_DISCOVER) {
+                handleDiscoverRsp(session, pdu, len);
+            }
+            return;
+        case ATT_OP_FIND_INFO_RSP:
+            if (session.state == ATT_STATE_FIND_CCCD) {
+                handleFindInfoRsp(session, pdu, len);
+            }
+            return;
+        case ATT_OP_WRITE_RSP:
+            if (session.state == ATT_STATE_SUBSCRIBE) {
+                enterStream(session);
+            }
+            else if (session.state == ATT_STATE_WRITE) {
+                session.valueBytes = session.writeValue.size();
+                finishSession(session, ATT_STATE_DONE, nullptr);
+            }
+            return;
+        case ATT_OP_PREPARE_WRITE_RSP:
+            if (session.state == ATT_STATE_PREPARE) {
+                handlePrepareWriteRsp(session, pdu, len);
+            }
+            return;
+        case ATT_OP_EXECUTE_WRITE_RSP:
+            if (session.state == ATT_STATE_EXECUTE) {
+                finishSession(session, ATT_STATE_DONE, nullptr);
+            }
+            return;
+        case ATT_OP_READ_RSP:
+        case ATT_OP_READ_BLOB_RSP:
+            if (session.state == ATT_STATE_READ) {
+                size_t valueLen = len - 1;
+                deliverValue(session, &pdu[1], valueLen);
+                session.valueOffset = (uint16_t)(session.valueOffset + valueLen);
+                /* A short response is the end of the value */
+                if (valueLen < (size_t)(session.mtu - 1) || session.valueOffset >= ATT_MAX_VALUE_LEN) {
+                    finishSession(session, ATT_STATE_DONE, nullptr);
+                }
+                else {
+                    sendRead(session);
+                }
+            }
+            return;
+        case ATT_OP_HANDLE_VALUE_IND:
+        case ATT_OP_HANDLE_VALUE_NTF:
+            if (opcode == ATT_OP_HANDLE_VALUE_IND) {
+                uint8_t confirm = ATT_OP_HANDLE_VALUE_CFM;
+                if (!sendPdu(session, &confirm, 1)) {
+                    return;
+                }
+            }
+            /* Notifications may overtake the write response */
+            if ((session.state == ATT_STATE_STREAM || session.state == ATT_STATE_SUBSCRIBE) && len >= 3 &&
+                getLe16(&pdu[1]) == session.valueHandle) {
+                enterStream(session);
+                if (len == 3) {
+                    /* An empty notification ends the log; a persistent session waits for new readings */
+                    if (!session.persistent) {
+                        finishSession(session, ATT_STATE_DONE, nullptr);
+                    }
+                }
+                else {
+                    deliverValue(session, &pdu[3], len - 3);
+                }
+            }
+            return;
+        case ATT_OP_MTU_REQ: {
+            uint8_t rsp[3] = {ATT_OP_MTU_RSP};
+            putLe16(&rsp[1], ATT_CLIENT_MTU);
+            sendPdu(session, rsp, sizeof(rsp));
+            return;
+        }
+        default:
+            break;
+    }
+
+    /* Requests have even opcodes; this client serves none of them */
+    if ((opcode & ATT_OP_COMMAND_FLAG) == 0 && (opcode & 1) == 0 && opcode != ATT_OP_HANDLE_VALUE_CFM) {
+        uint8_t rsp[5] = {ATT_OP_ERROR_RSP, opcode, 0, 0, ATT_ECODE_REQ_NOT_SUPPORTED};
+        sendPdu(session, rsp, sizeof(rsp));
+    }
+}
+
+/* Reset the session and send the MTU exchange; the caller has set the kind of session */
+static bool beginSession(AttSession &session, int sock, const string &macAddr) {
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    uint32_t timeoutMsecs = (bleConnectCfg.logReadTimeoutMsecs > 0) ? (uint32_t)bleConnectCfg.logReadTimeoutMsecs :
+                                                                      BLE_LOG_DEF_READ_TIMEOUT_MSECS;
+    session.macAddr = macAddr;
+    session.sock = sock;
+    session.state = ATT_STATE_MTU;
+    session.mtu = ATT_DEFAULT_MTU;
+    session.searchStart = 0x0001;
+    session.valueHandle = 0;
+    session.properties = 0;
+    session.valueOffset = 0;
+    session.startMsecs = nowMsecs;
+    session.deadlineMsecs = nowMsecs + timeoutMsecs;
+    session.lastRxMsecs = nowMsecs;
+    session.partial.clear();
+    session.records = 0;
+    session.valueBytes = 0;
+    attStats.sessions++;
+
+    uint8_t pdu[3] = {ATT_OP_MTU_REQ};
+    putLe16(&pdu[1], ATT_CLIENT_MTU);
+    return sendPdu(session, pdu, sizeof(pdu));
+}
+
+bool attSessionStart(AttSession &session, int sock, const string &macAddr, AttLogRecordCallback onRecord,
+                     bool persistent) {
+    session.onRecord = onRecord;
+    session.persistent = persistent;
+    session.write = false;
+    session.charUuid = bleConnectCfg.logCharUuid;
+    session.writeValue.clear();
+    return beginSession(session, sock, macAddr);
+}
+
+bool attSessionStartWrite(AttSession &session, int sock, const string &macAddr, const char *charUuid,
+                          const vector<uint8_t> &value) {
+    session.onRecord = nullptr;
+    session.persistent = false;
+    session.write = true;
+    session.charUuid = charUuid;
+    session.writeValue = value;
+    return beginSession(session, sock, macAddr);
+}
+
+bool attSessionProcess(AttSession &session) {
+    uint8_t pdu[ATT_MAX_PDU_LEN];
+    while (session.state != ATT_STATE_DONE && session.state != ATT_STATE_FAILED) {
+        ssize_t len = recv(session.sock, pdu, sizeof(pdu), MSG_DONTWAIT);
+        if (len > 0) {
+            handlePdu(session, pdu, (size_t)len);
+        }
+        else if (len == 0) {
+            finishSession(session, ATT_STATE_FAILED, "disconnected");
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            break;
+        }
+        else {
+            finishSession(session, ATT_STATE_FAILED, strerror(errno));
+        }
+    }
+    return (session.state != ATT_STATE_DONE && session.state != ATT_STATE_FAILED);
+}
+
+bool attSessionCheckTimeout(AttSession &session, uint64_t nowMsecs) {
+    if (session.state == ATT_STATE_STREAM && !session.persistent &&
+        nowMsecs >= session.lastRxMsecs + ATT_LOG_IDLE_MSECS) {
+        /* The tape has nothing more to send */
+        finishSession(session, ATT_STATE_DONE, nullptr);
+    }
+    else if (nowMsecs >= session.deadlineMsecs) {
+        finishSession(session, ATT_STATE_FAILED, "ble_log_read_timeout_ms expired");
+    }
+    return (session.state != ATT_STATE_DONE && session.state != ATT_STATE_FAILED);
+}
+
+uint32_t attSessionMsecsUntilTimeout(const AttSession &session, uint64_t nowMsecs) {
+    uint64_t dueMsecs = session.deadlineMsecs;
+    if (session.state == ATT_STATE_STREAM && !session.persistent) {
+        dueMsecs = min(dueMsecs, session.lastRxMsecs + ATT_LOG_IDLE_MSECS);
+    }
+    return (dueMsecs > nowMsecs) ? (uint32_t)min(dueMsecs - nowMsecs, (uint64_t)UINT32_MAX) : 0;
+}
+
+void getAttClientStats(AttClientStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    *stats = attStats;
+}
@@ -1,3 +1,4 @@
+#include <cerrno>
 #include <cstring>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -5,22 +6,32 @@
 #include "ble.h"
 #include "common.h"
 #include "config.h"
+#include "bleConnEngine.h"
+#include "bleConnSched.h"
+#include "bleLink.h"
+#include "bleArbiter.h"
+#include "bleConfigPush.h"
+#include "attClient.h"
 #include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/l2cap.h>
 
 #define ATT_CID                             (4)
 
-/* ----------------- BLE Synchronization Primitives ---------------------- */
-/* Protects concurrent access to tapeList map across BLE scan and connect threads. */
-std::mutex tapeListMutex;
-/* Signals BLE connect thread when a connectable tape is marked (tapeFound = true). */
-std::condition_variable tapeListCondVar; 
-
 /* ----------------- Static Functions and Variables ---------------------- */
 static bool verboseLogging  = true;
 static inline std::string getBleMacIdFromAdvInfo(le_advertising_info *info);
-static void updateTapeConnectionStatus(tapeConfig* tape, bool success);
+static void updateTapeConnectionStatus(tapeConfig* tape, bool success, uint64_t nowMsecs);
+static void backOffTapeConfigPush(tapeConfig *tape, uint64_t nowMsecs);
+static void onTapeLogRecord(const std::string &macAddr, const uint8_t *record, size_t len);
+static bool startTapeLogRead(std::map<int, AttSession> &attSessions, const BleConnResult &result, tapeConfig *tape);
+static bool startTapeConfigPush(std::map<int, AttSession> &attSessions, const BleConnResult &result,
+                                tapeConfig *tape);
+static void tuneTapeLink(int sock, tapeConfig *tape);
+static void endTapeSession(tapeConfig *tape, const AttSession *session, uint64_t nowMsecs);
+static void logBleConnSchedStats(void);
+static void logBleLinkStats(void);
 
 /* -------- BLE Initialization Functions (called from the main thread) -------- */
 void convertBdAddrToStr(bdaddr_t *addr, char *output) {
@@ -56,9 +67,9 @@ int getGatewayBLEMacAddress(char *macAddress) {
     if (macAddress == nullptr) {
         stat = 1;
     }
-    TRK_PRINTF("DBG: Converting BD Addr to Str. Stat:%d ", stat);
+    TRK_LOG_DBG("DBG: Converting BD Addr to Str. Stat:%d ", stat);
 	convertBdAddrToStr(&bdaddr, macAddress);
-    TRK_PRINTF("DBG: Converted BD Addr to Str");
+    TRK_LOG_DBG("DBG: Converted BD Addr to Str");
     return 0;
 }
 
@@ -73,74 +84,55 @@ static inline std::string getBleMacIdFromAdvInfo(le_advertising_info *info) {
  * @brief Checks if a scanned BLE advertisement corresponds to a connectable tape.
  *
  * This function extracts the MAC address from the BLE advertising information (`le_advertising_info`)
- * and looks it up in the map of connectable tapes. If the tape is found and its cooldown period has
- * expired (i.e., enough time has passed since the last transmission), the function marks it as
- * "found" so that a BLE connection can be established later.
+ * and looks it up in the map of connectable tapes. If the tape is found, the sighting is handed to the
+ * connection scheduler (bleConnSched.h) without taking a lock; the scheduler connects once the tape's
+ * backoff and cooldown period have expired.
  *
  * @param[in] info Pointer to the BLE advertising information structure received during scanning.
  *                 Must contain a valid Bluetooth address.
  *
- * @return true if the scanned device corresponds to a valid connectable tape and its cooldown period
- *         has expired; false otherwise.
+ * @return true if the scanned device corresponds to a connectable tape whose sighting was queued;
+ *         false otherwise (unknown tape, or a sighting of it is already queued).
  */
 bool checkIfConnectableTape(le_advertising_info* info) {
     std::string scannedMacAddress = getBleMacIdFromAdvInfo(info);
     /* Check and format the scanned MAC address */
     formatMacAddrStr(scannedMacAddress);
-    /* Check if the scanned device MAC address exists in the connectable tape list */
+    /* tapeList is not modified once the threads run, so the lookup needs no lock */
     auto it  = bleConnectCfg.tapeList.find(scannedMacAddress);
-    if (it != bleConnectCfg.tapeList.end()) {
-        time_t now = time(nullptr);
-
-        // Check retry backoff
-        if (now - it->second->lastSentTimeSecs >= it->second->backOffSecs &&
-            now - it->second->lastSentTimeSecs >= bleConnectCfg.readTapeAgainDelaySecs)
-        {
-            it->second->tapeFound = true;
-            /* Notify the BLE connector thread */
-            tapeListCondVar.notify_one();
-            return true;
-        }
+    if (it == bleConnectCfg.tapeList.end()) {
+        return false;
     }
-    return false;
+    /* A tape listed only for the configuration push is left alone once the push is over */
+    if (it->second->configPushOnly && !it->second->configPushPending.load()) {
+        return false;
+    }
+    return bleConnSchedNoteSighting(it->second.get());
 }
 
 /* ----------------------- BLE Connect Thread Functions ------------------------- */
 
 /**
- * @brief Initiates a Bluetooth LE connection to a remote BLE device by MAC address.
+ * @brief Opens an L2CAP socket bound to the gateway adapter on the ATT channel.
  *
- * This function establishes a BLE L2CAP connection on the ATT (Attribute) channel
- * using the specified Bluetooth MAC address of a remote device. It opens a BLE L2CAP
- * socket, binds it to the local adapter, applies the desired security level, and
- * connects to the remote device over the ATT CID (0x0004).
+ * @param[in] sec         Desired Bluetooth security level (BT_SECURITY_LOW, ...).
+ * @param[in] nonBlocking Open the socket with SOCK_NONBLOCK, for the connection engine.
  *
- * @param[in] dstMacAddr MAC address of the destination BLE device in string format.
- *                       Must be a valid 17-character colon-separated address.
- * @param[in] dst_type Address type of the destination device (default: BDADDR_LE_RANDOM).
- *                     Use 0 for public or 1 for random.
- * @param[in] sec Desired Bluetooth security level (default: BT_SECURITY_LOW).
- *                Options include BT_SECURITY_LOW, BT_SECURITY_MEDIUM, or BT_SECURITY_HIGH.
- *
- * @return int Socket file descriptor if the connection is successful, or -1 on failure.
+ * @return int Socket file descriptor, or -1 on failure (errno is kept).
  */
-int connectToBleTape(const std::string dstMacAddr, uint8_t dst_type, int sec) {
+int openBleAttSocket(int sec, bool nonBlocking) {
 	int sock;
 	struct sockaddr_l2 srcaddr;
-    struct sockaddr_l2 dstaddr;
 	struct bt_security btsec;
 
-	if (verboseLogging == true) {
-		TRK_PRINTF("CONNECTABLE_BLE: Opening L2CAP LE connection on ATT "
-            "channel:\n\t src: %s\n\tdest: %s\n", bleConnectCfg.gwBleMacId, dstMacAddr.c_str());
-	}
-
-	sock = socket(PF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
+	sock = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_CLOEXEC | (nonBlocking ? SOCK_NONBLOCK : 0), BTPROTO_L2CAP);
 	if (sock < 0) {
+		int err = errno;
 		perror("Failed to create L2CAP socket");
         if (verboseLogging == true) {
-            TRK_PRINTF("ERROR: Failed to create L2CAP socket");
+            TRK_LOG_ERR("ERROR: Failed to create L2CAP socket");
         }
+		errno = err;
 		return -1;
 	}
 
@@ -152,11 +144,13 @@ int connectToBleTape(const std::string dstMacAddr, uint8_t dst_type, int sec) {
     str2ba(bleConnectCfg.gwBleMacId, &srcaddr.l2_bdaddr);
 
 	if (bind(sock, (struct sockaddr *)&srcaddr, sizeof(srcaddr)) < 0) {
+		int err = errno;
 		perror("Failed to bind L2CAP socket");
         if (verboseLogging == true) {
-            TRK_PRINTF("ERROR: Failed to bind L2CAP socket");
+            TRK_LOG_ERR("ERROR: Failed to bind L2CAP socket");
         }
 		close(sock);
+		errno = err;
 		return -1;
 	}
 
@@ -165,20 +159,61 @@ int connectToBleTape(const std::string dstMacAddr, uint8_t dst_type, int sec) {
 	btsec.level = sec;
 	if (setsockopt(sock, SOL_BLUETOOTH, BT_SECURITY, &btsec,
 							sizeof(btsec)) != 0) {
+		int err = errno;
 		fprintf(stderr, "Failed to set L2CAP security level\n");
         if (verboseLogging == true) {
-            TRK_PRINTF("ERROR: Failed to set L2CAP security level");
+            TRK_LOG_ERR("ERROR: Failed to set L2CAP security level");
         }
 		close(sock);
+		errno = err;
+		return -1;
+	}
+	return sock;
+}
+
+/* Fill the ATT channel address of a remote BLE device */
+void fillBleAttAddr(struct sockaddr_l2 *dstaddr, const char *dstMacAddr, uint8_t dst_type) {
+	memset(dstaddr, 0, sizeof(*dstaddr));
+	dstaddr->l2_family = AF_BLUETOOTH;
+	dstaddr->l2_cid = htobs(ATT_CID);
+	dstaddr->l2_bdaddr_type = dst_type;
+	str2ba(dstMacAddr, &dstaddr->l2_bdaddr);
+}
+
+/**
+ * @brief Initiates a Bluetooth LE connection to a remote BLE device by MAC address.
+ *
+ * This function establishes a BLE L2CAP connection on the ATT (Attribute) channel
+ * using the specified Bluetooth MAC address of a remote device. It opens a BLE L2CAP
+ * socket, binds it to the local adapter, applies the desired security level, and
+ * connects to the remote device over the ATT CID (0x0004). The call blocks until the
+ * kernel connect timeout; the connect thread uses the non-blocking engine instead.
+ *
+ * @param[in] dstMacAddr MAC address of the destination BLE device in string format.
+ *                       Must be a valid 17-character colon-separated address.
+ * @param[in] dst_type Address type of the destination device (default: BDADDR_LE_RANDOM).
+ *                     Use 0 for public or 1 for random.
+ * @param[in] sec Desired Bluetooth security level (default: BT_SECURITY_LOW).
+ *                Options include BT_SECURITY_LOW, BT_SECURITY_MEDIUM, or BT_SECURITY_HIGH.
+ *
+ * @return int Socket file descriptor if the connection is successful, or -1 on failure.
+ */
+int connectToBleTape(const std::string dstMacAddr, uint8_t dst_type, int sec) {
+	int sock;
+    struct sockaddr_l2 dstaddr;
+
+	if (verboseLogging == true) {
+		TRK_PRINTF("CONNECTABLE_BLE: Opening L2CAP LE connection on ATT "
+            "channel:\n\t src: %s\n\tdest: %s\n", bleConnectCfg.gwBleMacId, dstMacAddr.c_str());
+	}
+
+	sock = openBleAttSocket(sec, false);
+	if (sock < 0) {
 		return -1;
 	}
 
 	/* Set up destination address */
-	memset(&dstaddr, 0, sizeof(dstaddr));
-	dstaddr.l2_family = AF_BLUETOOTH;
-	dstaddr.l2_cid = htobs(ATT_CID);
-	dstaddr.l2_bdaddr_type = dst_type;
-	str2ba(dstMacAddr.c_str(), &dstaddr.l2_bdaddr);
+	fillBleAttAddr(&dstaddr, dstMacAddr.c_str(), dst_type);
 
 	TRK_PRINTF("Connecting to device ...");
 	fflush(stdout);
@@ -194,73 +229,321 @@ int connectToBleTape(const std::string dstMacAddr, uint8_t dst_type, int sec) {
 }
 
 /**
- * @brief Updates the connection status, retry count, backoff delay, and timestamp for a tape.
+ * @brief Updates the connection status, retry count, backoff delay, and next eligible time for a tape.
  *
- * @param tape    Pointer to the tapeConfig struct to update.
- * @param success True if the BLE connection was successful; false otherwise.
+ * @param tape     Pointer to the tapeConfig struct to update.
+ * @param success  True if the BLE connection was successful; false otherwise.
+ * @param nowMsecs Monotonic time of the connection result.
  */
-static void updateTapeConnectionStatus(tapeConfig* tape, bool success) {
+static void updateTapeConnectionStatus(tapeConfig* tape, bool success, uint64_t nowMsecs) {
     tape->lastSentTimeSecs = time(nullptr);
 
     if (success) {
         tape->tapeConnected = true;
         tape->retryCount = 0;
-        tape->backOffSecs = 0;
+        tape->backOffMsecs = 0;
     } else {
         tape->tapeConnected = false;
         tape->retryCount++;
-        /* linear backoff capped at 60s */
-        tape->backOffSecs = std::min(60, tape->retryCount * 5);  
+        /* exponential backoff with jitter, capped at ble_connect_backoff_max_ms */
+        tape->backOffMsecs = bleConnSchedBackoffMsecs(tape->retryCount);
+    }
+    tape->nextEligibleMsecs = nowMsecs + (uint64_t)std::max(tape->backOffMsecs,
+                                                             bleConnectCfg.readTapeAgainDelaySecs * 1000);
+}
+
+/* A failed write backs off by the push attempts of the tape: the connect that preceded it succeeded and
+   reset retryCount, which would retry a tape that keeps failing the write at the base backoff */
+static void backOffTapeConfigPush(tapeConfig *tape, uint64_t nowMsecs) {
+    tape->backOffMsecs = bleConnSchedBackoffMsecs(bleConfigPushAttempts(tape));
+    tape->nextEligibleMsecs = nowMsecs + (uint64_t)std::max(tape->backOffMsecs,
+                                                             bleConnectCfg.readTapeAgainDelaySecs * 1000);
+}
+
+/* Hands a tape log record to the uplink pipeline as if the tape had advertised it, as a backfill record
+   that the rate limits and the coalescing of routine readings leave alone */
+static void onTapeLogRecord(const std::string &macAddr, const uint8_t *record, size_t len) {
+    uint8_t infoBuff[sizeof(le_advertising_info) + WHITE_TAPE_BLE_ADV_INFO_LEN + 1] = {0};
+    le_advertising_info *info = (le_advertising_info *)infoBuff;
+    BleDataPacket blePkt;
+
+    memset(&blePkt, 0, sizeof(blePkt));
+    str2ba(macAddr.c_str(), &info->bdaddr);
+    memcpy(&info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX], record, std::min(len, (size_t)WHITE_TAPE_DATA_PACKET_LEN));
+    /* The RSSI byte after the data stays 0, it is not measured over a connection */
+    info->length = WHITE_TAPE_BLE_ADV_INFO_LEN;
+
+    parseBleDataPacket(info, &blePkt);
+    blePkt.pktFlags |= BLE_PKT_FLAG_BACKFILL;
+    if (blePkt.blePktType != QuartzSensor_Unknown) {
+        sendBleDataPacket(blePkt);
+    }
+}
+
+/* Start reading the log of a connected tape, or close the connection if there is nothing to read */
+static bool startTapeLogRead(std::map<int, AttSession> &attSessions, const BleConnResult &result, tapeConfig *tape) {
+    if (bleConnectCfg.logCharUuid == nullptr || bleConnectCfg.logCharUuid[0] == '\0') {
+        close(result.sock);
+        return false;
+    }
+
+    tuneTapeLink(result.sock, tape);
+    AttSession &session = attSessions[result.sock];
+    if (!bleConnEngineWatch(result.sock) ||
+        !attSessionStart(session, result.sock, result.macAddr, onTapeLogRecord, tape->persistent)) {
+        bleConnEngineUnwatch(result.sock);
+        attSessions.erase(result.sock);
+        close(result.sock);
+        return false;
     }
+    return true;
+}
+
+/* Write the value of the configuration push job to a connected tape */
+static bool startTapeConfigPush(std::map<int, AttSession> &attSessions, const BleConnResult &result,
+                                tapeConfig *tape) {
+    tuneTapeLink(result.sock, tape);
+    AttSession &session = attSessions[result.sock];
+    if (!bleConnEngineWatch(result.sock) ||
+        !attSessionStartWrite(session, result.sock, result.macAddr, configPushCfg.charUuid, bleConfigPushValue())) {
+        bleConnEngineUnwatch(result.sock);
+        attSessions.erase(result.sock);
+        close(result.sock);
+        return false;
+    }
+    return true;
+}
+
+/* Negotiate 2M PHY and Data Length Extension, and the connection parameters of a persistent tape */
+static void tuneTapeLink(int sock, tapeConfig *tape) {
+    if (!bleLinkGetHandle(sock, &tape->connHandle)) {
+        TRK_PRINTF("BLE_Link: %s connection handle unknown: %s", tape->macAddr.c_str(), strerror(errno));
+        return;
+    }
+    bleLinkNegotiate(tape->connHandle, tape);
+    if (tape->persistent) {
+        bleLinkUpdateConnParams(tape->connHandle, tape);
+    }
+}
+
+static void logBleLinkStats(void) {
+    BleLinkStats stats;
+    getBleLinkStats(&stats);
+    TRK_PRINTF("BLE_Link: dle_requested=%llu dle_changed=%llu phy_requested=%llu phy_2m=%llu phy_fallback=%llu "
+               "cmd_failed=%llu adv_dropped=%llu", (unsigned long long)stats.dleRequested,
+               (unsigned long long)stats.dleChanged, (unsigned long long)stats.phyRequested,
+               (unsigned long long)stats.phy2M, (unsigned long long)stats.phyFallback,
+               (unsigned long long)stats.cmdFailed, (unsigned long long)stats.advDropped);
+}
+
+/* The connection of a tape closed; record its link, a persistent tape may reconnect at its next sighting */
+static void endTapeSession(tapeConfig *tape, const AttSession *session, uint64_t nowMsecs) {
+    BleLinkParams link;
+    if (session != nullptr && bleLinkGetParams(tape->connHandle, &link)) {
+        uint64_t elapsedMsecs = nowMsecs - session->startMsecs;
+        tape->linkTxOctets = link.txOctets;
+        tape->linkRxOctets = link.rxOctets;
+        tape->linkTxPhy = link.txPhy;
+        tape->linkRxPhy = link.rxPhy;
+        tape->logKBytesPerSec = (elapsedMsecs > 0) ? ((double)session->valueBytes / (double)elapsedMsecs) : 0.0;
+        TRK_PRINTF("BLE_Link: %s phy=%uM/%uM data_len=%u/%u att_mtu=%u %s=%llu bytes %.1f kB/s",
+                   tape->macAddr.c_str(), link.txPhy, link.rxPhy, link.txOctets, link.rxOctets, session->mtu,
+                   session->write ? "write" : "log", (unsigned long long)session->valueBytes,
+                   tape->logKBytesPerSec);
+    }
+    tape->tapeConnected = false;
+    /* A persistent tape reconnects at once, unless a failed config write set a backoff */
+    if (tape->persistent && tape->backOffMsecs == 0) {
+        tape->nextEligibleMsecs = nowMsecs;
+    }
+    bleConnSchedRelease(tape);
+}
+
+static void logBleConnSchedStats(void) {
+    BleConnSchedStats stats;
+    getBleConnSchedStats(&stats);
+    TRK_PRINTF("BLE_Sched: sightings=%llu dropped=%llu scheduled=%llu expired=%llu started=%llu waiting=%zu",
+               (unsigned long long)stats.sightings, (unsigned long long)stats.dropped,
+               (unsigned long long)stats.scheduled, (unsigned long long)stats.expired,
+               (unsigned long long)stats.started, stats.heapSize);
 }
 
 /**
  * @brief Thread function that attempts BLE connections to known connectable tapes.
  *
- * This function runs in a loop, waiting for connectable tapes to be marked (via `tapeFound`)
- * by the BLE scan thread. When a tape is ready, it attempts to establish a BLE connection.
- * Connection results update the tape's retry count, backoff delay, and last sent timestamp.
- * Uses a condition variable to efficiently sleep until new connection candidates are available.
+ * This function runs in a loop, taking the sightings the BLE scan thread hands over through the
+ * connection scheduler's lock-free queue, and connecting to the tapes in the order their backoff
+ * and cooldown expire (bleConnSched.h). Connects run on the non-blocking connection engine, up to
+ * ble_connect_max_parallel at once. A connected tape's stored log is then read by an ATT session
+ * (attClient.h) on the same epoll instance, which also watches the scheduler's wakeup eventfd.
+ * Connection results update the tape's retry count, backoff delay, and next eligible time.
+ * The connections of persistent tapes (ble_persistent_tapes) stay open and stream notifications
+ * until the tape disconnects. Targets of the configuration push job (bleConfigPush.h) get a write
+ * session instead of the log read, and are retried with the connect backoff. When connects may
+ * start, and how the scan yields to them, is up to the scan/connect arbiter (bleArbiter.h).
+ * No lock is shared with the scan thread.
  *
  * @note This function is intended to be run in its own thread.
  */
 void bleConnectThreadFunc() {
-    while (keepRunning) {
-        std::unique_lock<std::mutex> bleConnectLock(tapeListMutex);
+    if (!bleConnEngineInit()) {
+        return;
+    }
+    if (!bleConnSchedInit() || !bleConnEngineWatch(bleConnSchedWakeFd())) {
+        bleConnEngineClose();
+        return;
+    }
+    /* Without the HCI device the tapes connect on the default link */
+    if (bleLinkInit() && bleLinkEventFd() >= 0) {
+        bleConnEngineWatch(bleLinkEventFd());
+    }
 
-        /* Wait until at least one tape is marked for connection */
-        tapeListCondVar.wait(bleConnectLock, [] {
-            for (const auto& entry : bleConnectCfg.tapeList) {
-                if (entry.second->tapeFound) return true;
+    std::vector<BleConnResult> results;
+    std::vector<int> readyFds;
+    /* Log reads in progress, by socket */
+    std::map<int, AttSession> attSessions;
+    /* Connects of persistent tapes in flight, for the priority policy */
+    size_t priorityPending = 0;
+    bleArbiterInit(getMonotonicTimeMsecs());
+    bool configPush = bleConfigPushInit(getMonotonicTimeMsecs());
+    uint64_t statsLogDueMsecs = getMonotonicTimeMsecs() + BLE_CONN_STATS_LOG_SECS * 1000u;
+    while (keepRunning) {
+        uint64_t nowMsecs = getMonotonicTimeMsecs();
+        bleConnSchedDrain(nowMsecs);
+
+        /* Start connects to the due tapes the arbiter lets through while slots are free */
+        results.clear();
+        bool priorityOk = bleArbiterMayConnect(nowMsecs, true);
+        bool normalOk = bleArbiterMayConnect(nowMsecs, false);
+        tapeConfig *tape;
+        while (keepRunning && bleConnEngineHasFreeSlot() &&
+               (tape = bleConnSchedPopDue(nowMsecs, priorityOk, normalOk)) != nullptr) {
+            TRK_PRINTF("Initiating connection to the BLE device: %s", tape->macAddr.c_str());
+            if (tape->persistent) {
+                priorityPending++;
             }
-            return false;
-        });
-
-        for (auto it = bleConnectCfg.tapeList.begin(); it != bleConnectCfg.tapeList.end(); ++it) {
-            auto& tapeCfg = it->second;
-            const std::string& tapeMacAddr = it->first;
+            bleConnEngineStart(tape->macAddr, BDADDR_LE_RANDOM, BT_SECURITY_LOW, results);
+        }
+        bleArbiterUpdate(nowMsecs, bleConnEngineInFlight(), priorityPending);
+
+        /* Wait for the connects, the log reads, new sightings and the next due tape or connect window */
+        uint32_t waitMsecs = BLE_CONN_SCHED_MAX_WAIT_MSECS;
+        if (bleConnEngineHasFreeSlot()) {
+            uint32_t windowMsecs = bleArbiterMsecsUntilWindow(nowMsecs);
+            uint32_t priorityMsecs = bleConnSchedMsecsUntilDue(nowMsecs, waitMsecs, true);
+            uint32_t normalMsecs = bleConnSchedMsecsUntilDue(nowMsecs, waitMsecs, false);
+            if (priorityMsecs < waitMsecs) {
+                waitMsecs = std::min(waitMsecs, priorityOk ? priorityMsecs : std::max(priorityMsecs, windowMsecs));
+            }
+            if (normalMsecs < BLE_CONN_SCHED_MAX_WAIT_MSECS) {
+                waitMsecs = std::min(waitMsecs, normalOk ? normalMsecs : std::max(normalMsecs, windowMsecs));
+            }
+        }
+        for (const auto& entry : attSessions) {
+            waitMsecs = std::min(waitMsecs, attSessionMsecsUntilTimeout(entry.second, nowMsecs));
+        }
+        readyFds.clear();
+        bleConnEnginePoll(waitMsecs, results, readyFds);
 
-            /* Do not try to establish connection for the connectable tapes not found while scanning */
-            if (tapeCfg->tapeFound == false)
+        for (int sock : readyFds) {
+            if (sock == bleLinkEventFd()) {
+                bleLinkProcessEvents();
                 continue;
+            }
+            auto sessionIt = attSessions.find(sock);
+            if (sessionIt != attSessions.end()) {
+                attSessionProcess(sessionIt->second);
+            }
+        }
+        nowMsecs = getMonotonicTimeMsecs();
+        for (auto sessionIt = attSessions.begin(); sessionIt != attSessions.end();) {
+            if (attSessionCheckTimeout(sessionIt->second, nowMsecs)) {
+                ++sessionIt;
+                continue;
+            }
+            auto it = bleConnectCfg.tapeList.find(sessionIt->second.macAddr);
+            if (it != bleConnectCfg.tapeList.end()) {
+                const AttSession &session = sessionIt->second;
+                if (session.write &&
+                    bleConfigPushNoteResult(it->second.get(), session.state == ATT_STATE_DONE, nowMsecs)) {
+                    backOffTapeConfigPush(it->second.get(), nowMsecs);
+                }
+                endTapeSession(it->second.get(), &sessionIt->second, nowMsecs);
+            }
+            bleConnEngineUnwatch(sessionIt->first);
+            close(sessionIt->first);
+            sessionIt = attSessions.erase(sessionIt);
+        }
 
-            /* Set the tape found flag as false to disable multiple connection attempts going forward */
-            tapeCfg->tapeFound = false;
-            bleConnectLock.unlock();
-
-            TRK_PRINTF("Initiating connection to the BLE device: %s", tapeMacAddr.c_str());
-            bool isTapeConnected = connectToBleTape(tapeMacAddr);
-
-            bleConnectLock.lock();
-
-            updateTapeConnectionStatus(tapeCfg.get(), isTapeConnected);
-
-            if (isTapeConnected) {
-                TRK_PRINTF("Connected successfully to: %s", tapeMacAddr.c_str());
+        for (auto& result : results) {
+            auto it = bleConnectCfg.tapeList.find(result.macAddr);
+            if (it == bleConnectCfg.tapeList.end()) {
+                if (result.sock >= 0) {
+                    close(result.sock);
+                }
+                continue;
+            }
+            if (it->second->persistent && priorityPending > 0) {
+                priorityPending--;
+            }
+            bleArbiterNoteConnect(nowMsecs - std::min(nowMsecs, it->second->dueMsecs), result.sock >= 0);
+            updateTapeConnectionStatus(it->second.get(), result.sock >= 0, nowMsecs);
+            if (result.sock >= 0) {
+                TRK_PRINTF("Connected successfully to: %s (%u ms)", result.macAddr.c_str(), result.connectMsecs);
             } else {
-                TRK_PRINTF("Connection failed: %s, retry=%d, backoff=%d",
-                            tapeMacAddr.c_str(), tapeCfg->retryCount, tapeCfg->backOffSecs);
+                TRK_PRINTF("Connection failed: %s (%s), retry=%d, backoff=%d ms", result.macAddr.c_str(),
+                           strerror(result.err), it->second->retryCount, it->second->backOffMsecs);
+            }
+            if (result.sock < 0) {
+                if (it->second->configPushPending.load()) {
+                    bleConfigPushNoteResult(it->second.get(), false, nowMsecs);
+                }
+                bleConnSchedRelease(it->second.get());
             }
+            else if (it->second->configPushPending.load()) {
+                if (!startTapeConfigPush(attSessions, result, it->second.get())) {
+                    if (bleConfigPushNoteResult(it->second.get(), false, nowMsecs)) {
+                        backOffTapeConfigPush(it->second.get(), nowMsecs);
+                    }
+                    endTapeSession(it->second.get(), nullptr, nowMsecs);
+                }
+            }
+            else if (!startTapeLogRead(attSessions, result, it->second.get())) {
+                endTapeSession(it->second.get(), nullptr, nowMsecs);
+            }
+        }
+        if (!results.empty()) {
+            bleArbiterUpdate(nowMsecs, bleConnEngineInFlight(), priorityPending);
         }
+        if (configPush) {
+            bleConfigPushFlush(nowMsecs, false);
+        }
+
+        if (getMonotonicTimeMsecs() >= statsLogDueMsecs) {
+            logBleConnStats();
+            logBleConnSchedStats();
+            logBleLinkStats();
+            logBleArbiterStats();
+            logBleConfigPushStats(getMonotonicTimeMsecs());
+            statsLogDueMsecs = getMonotonicTimeMsecs() + BLE_CONN_STATS_LOG_SECS * 1000u;
+        }
+    }
+
+    for (auto& entry : attSessions) {
+        bleConnEngineUnwatch(entry.first);
+        close(entry.first);
+    }
+    logBleConnStats();
+    logBleConnSchedStats();
+    logBleArbiterStats();
+    if (configPush) {
+        logBleConfigPushStats(getMonotonicTimeMsecs());
+        bleConfigPushFlush(getMonotonicTimeMsecs(), true);
+    }
+    bleConnEngineUnwatch(bleConnSchedWakeFd());
+    if (bleLinkEventFd() >= 0) {
+        bleConnEngineUnwatch(bleLinkEventFd());
     }
+    bleConnEngineClose();
+    bleLinkClose();
 }
@@ -0,0 +1,179 @@
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "common.h"
+#include "config.h"
+#include "bleArbiter.h"
+
+using namespace std;
+
+static const char *policyNames[BLE_COEX_POLICY_COUNT] = {BLE_COEX_POLICY_CONCURRENT, BLE_COEX_POLICY_INTERLEAVE,
+                                                         BLE_COEX_POLICY_PRIORITY};
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static atomic<int> currentPolicy(BLE_COEX_INTERLEAVE);
+static atomic<int> scanMode(BLE_SCAN_MODE_FULL);
+static atomic<uint64_t> busyMsecsTotal(0);
+static bool rotatePolicies = false;
+static uint64_t epochMsecs = 0;
+static uint64_t policyStartMsecs = 0;
+static uint64_t lastUpdateMsecs = 0;
+static bool lastContended = false;
+static uint64_t pauseStartMsecs = 0;
+static bool pausing = false;
+
+static mutex arbiterStatsMutex;
+static BleArbiterStats policyStats[BLE_COEX_POLICY_COUNT];
+
+static BleCoexPolicy parsePolicy(const char *name);
+
+/* ----------------- Function Definitions ---------------------- */
+static BleCoexPolicy parsePolicy(const char *name) {
+    for (int i = 0; i < BLE_COEX_POLICY_COUNT; i++) {
+        if (name != nullptr && strcmp(name, policyNames[i]) == 0) {
+            return (BleCoexPolicy)i;
+        }
+    }
+    return BLE_COEX_INTERLEAVE;
+}
+
+void bleArbiterInit(uint64_t nowMsecs) {
+    const char *policy = bleConnectCfg.coexPolicy;
+    rotatePolicies = (policy != nullptr && strcmp(policy, BLE_COEX_POLICY_ROTATE) == 0);
+    currentPolicy.store(rotatePolicies ? BLE_COEX_CONCURRENT : parsePolicy(policy));
+    scanMode.store(BLE_SCAN_MODE_FULL);
+    epochMsecs = nowMsecs;
+    policyStartMsecs = nowMsecs;
+    lastUpdateMsecs = nowMsecs;
+    lastContended = false;
+    pausing = false;
+    TRK_PRINTF("BLE_Coex: policy %s%s, connect window %d of %d ms", policyNames[currentPolicy.load()],
+               rotatePolicies ? " (rotating)" : "", bleConnectCfg.coexConnectWindowMsecs,
+               bleConnectCfg.coexPeriodMsecs);
+}
+
+BleCoexPolicy bleArbiterPolicy(void) {
+    return (BleCoexPolicy)currentPolicy.load();
+}
+
+bool bleArbiterMayConnect(uint64_t nowMsecs, bool highPriority) {
+    BleCoexPolicy policy = bleArbiterPolicy();
+    if (policy == BLE_COEX_CONCURRENT || (policy == BLE_COEX_PRIORITY && highPriority)) {
+        return true;
+    }
+    return (bleArbiterMsecsUntilWindow(nowMsecs) == 0);
+}
+
+uint32_t bleArbiterMsecsUntilWindow(uint64_t nowMsecs) {
+    if (bleArbiterPolicy() == BLE_COEX_CONCURRENT) {
+        return 0;
+    }
+    uint64_t period = (uint64_t)bleConnectCfg.coexPeriodMsecs;
+    uint64_t phase = (nowMsecs - epochMsecs) % period;
+    return (phase < (uint64_t)bleConnectCfg.coexConnectWindowMsecs) ? 0 : (uint32_t)(period - phase);
+}
+
+void bleArbiterUpdate(uint64_t nowMsecs, size_t inFlight, size_t priorityPending) {
+    /* The time since the last update counts as contended if it was */
+    if (lastContended) {
+        busyMsecsTotal.fetch_add(nowMsecs - lastUpdateMsecs);
+    }
+    lastUpdateMsecs = nowMsecs;
+
+    if (rotatePolicies && nowMsecs - policyStartMsecs >= (uint64_t)bleConnectCfg.coexRotateSecs * 1000u) {
+        int next = (currentPolicy.load() + 1) % BLE_COEX_POLICY_COUNT;
+        currentPolicy.store(next);
+        policyStartMsecs = nowMsecs;
+        TRK_PRINTF("BLE_Coex: policy %s", policyNames[next]);
+    }
+
+    BleCoexPolicy policy = bleArbiterPolicy();
+    BleScanMode mode = BLE_SCAN_MODE_FULL;
+    if (policy == BLE_COEX_PRIORITY && priorityPending > 0) {
+        if (!pausing) {
+            pausing = true;
+            pauseStartMsecs = nowMsecs;
+            lock_guard<mutex> lock(arbiterStatsMutex);
+            policyStats[policy].pauses++;
+        }
+        /* A pause never outlasts ble_coex_max_pause_ms; the scan then only shrinks */
+        mode = (nowMsecs - pauseStartMsecs < (uint64_t)bleConnectCfg.coexMaxPauseMsecs) ? BLE_SCAN_MODE_PAUSED :
+                                                                                          BLE_SCAN_MODE_REDUCED;
+    }
+    else {
+        pausing = false;
+        if (policy != BLE_COEX_CONCURRENT && inFlight > 0) {
+            mode = BLE_SCAN_MODE_REDUCED;
+        }
+    }
+    scanMode.store(mode);
+    lastContended = (inFlight > 0 || mode != BLE_SCAN_MODE_FULL);
+}
+
+void bleArbiterNoteConnect(uint64_t latencyMsecs, bool success) {
+    lock_guard<mutex> lock(arbiterStatsMutex);
+    BleArbiterStats &stats = policyStats[bleArbiterPolicy()];
+    if (success) {
+        stats.connects++;
+        stats.latencyMsecsSum += latencyMsecs;
+        stats.latencyMsecsMax = max(stats.latencyMsecsMax, latencyMsecs);
+    }
+    else {
+        stats.connectFailures++;
+    }
+}
+
+BleScanMode bleArbiterScanMode(void) {
+    return (BleScanMode)scanMode.load();
+}
+
+uint64_t bleArbiterBusyMsecs(void) {
+    return busyMsecsTotal.load();
+}
+
+void bleArbiterNoteScanCycle(uint64_t scanMsecs, uint64_t busyMsecs, size_t distinctTapes) {
+    lock_guard<mutex> lock(arbiterStatsMutex);
+    BleArbiterStats &stats = policyStats[bleArbiterPolicy()];
+    stats.scanMsecs += scanMsecs;
+    stats.busyMsecs += min(busyMsecs, scanMsecs);
+    if (busyMsecs > 0) {
+        stats.busyCycles++;
+        stats.busyTapes += distinctTapes;
+    }
+    else {
+        stats.cleanCycles++;
+        stats.cleanTapes += distinctTapes;
+    }
+}
+
+void getBleArbiterStats(BleCoexPolicy policy, BleArbiterStats *stats) {
+    if (stats == nullptr || policy >= BLE_COEX_POLICY_COUNT) {
+        return;
+    }
+    lock_guard<mutex> lock(arbiterStatsMutex);
+    *stats = policyStats[policy];
+}
+
+void logBleArbiterStats(void) {
+    for (int i = 0; i < BLE_COEX_POLICY_COUNT; i++) {
+        BleArbiterStats stats;
+        getBleArbiterStats((BleCoexPolicy)i, &stats);
+        if (stats.cleanCycles + stats.busyCycles == 0 && stats.connects + stats.connectFailures == 0) {
+            continue;
+        }
+
+        /* Tapes heard per contended cycle against per clean cycle; unknown until both kinds ran */
+        double cleanAvg = stats.cleanCycles ? ((double)stats.cleanTapes / (double)stats.cleanCycles) : 0.0;
+        double busyAvg = stats.busyCycles ? ((double)stats.busyTapes / (double)stats.busyCycles) : 0.0;
+        double lossPct = (cleanAvg > 0.0 && stats.busyCycles > 0) ? (100.0 * (1.0 - busyAvg / cleanAvg)) : 0.0;
+        double busyPct = stats.scanMsecs ? (100.0 * (double)stats.busyMsecs / (double)stats.scanMsecs) : 0.0;
+        double latencyAvg = stats.connects ? ((double)stats.latencyMsecsSum / (double)stats.connects) : 0.0;
+
+        TRK_PRINTF("BLE_Coex: %s cycles=%llu/%llu tapes/cycle=%.1f/%.1f advert_loss=%.1f%% contended=%.1f%% "
+                   "connects=%llu failed=%llu latency_ms avg=%.0f max=%llu pauses=%llu", policyNames[i],
+                   (unsigned long long)stats.cleanCycles, (unsigned long long)stats.busyCycles, cleanAvg, busyAvg,
+                   lossPct, busyPct, (unsigned long long)stats.connects, (unsigned long long)stats.connectFailures,
+                   latencyAvg, (unsigned long long)stats.latencyMsecsMax, (unsigned long long)stats.pauses);
+    }
+}
@@ -0,0 +1,283 @@
+#include <cerrno>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common.h"
+#include "config.h"
+#include "attClient.h"
+#include "bleConfigPush.h"
+
+using namespace std;
+
+static const char *pushStateNames[] = {"pending", "done", "failed"};
+
+typedef struct PushTarget {
+    tapeConfig *tape;
+    BlePushState state;
+    int attempts;
+} PushTarget;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static vector<uint8_t> pushValue;
+static vector<PushTarget> pushTargets;
+static map<const tapeConfig *, size_t> pushTargetIndex;
+static uint64_t pushJobId = 0;
+static bool pushActive = false;
+static bool pushDirty = false;
+static bool pushFinishedLogged = false;
+static uint64_t pushStartMsecs = 0;
+static uint64_t pushLastFlushMsecs = 0;
+static BlePushStats pushStats = {0};
+
+static bool decodeHexValue(const char *hex, vector<uint8_t> &value);
+static uint64_t getJobId(const char *charUuid, const vector<uint8_t> &value);
+static void readStateFile(void);
+static bool writeStateFile(void);
+static void checkJobFinished(uint64_t nowMsecs);
+
+/* ----------------- Function Definitions ---------------------- */
+/* Hex digits to bytes, ' ' and ':' allowed between bytes */
+static bool decodeHexValue(const char *hex, vector<uint8_t> &value) {
+    value.clear();
+    int high = -1;
+    for (const char *p = hex; *p != '\0'; p++) {
+        if ((*p == ' ' || *p == ':') && high < 0) {
+            continue;
+        }
+        if (!isxdigit((unsigned char)*p)) {
+            return false;
+        }
+        int nibble = isdigit((unsigned char)*p) ? (*p - '0') : (toupper((unsigned char)*p) - 'A' + 10);
+        if (high < 0) {
+            high = nibble;
+        }
+        else {
+            value.push_back((uint8_t)((high << 4) | nibble));
+            high = -1;
+        }
+    }
+    return (high < 0);
+}
+
+/* FNV-1a over the UUID and the value: a new value or characteristic is a new job */
+static uint64_t getJobId(const char *charUuid, const vector<uint8_t> &value) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char *p = charUuid; *p != '\0'; p++) {
+        hash = (hash ^ (uint8_t)toupper((unsigned char)*p)) * 0x100000001B3ull;
+    }
+    for (uint8_t byte : value) {
+        hash = (hash ^ byte) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/* Take the state of the targets from a state file of the same job; anything else starts afresh */
+static void readStateFile(void) {
+    FILE *fp = fopen(configPushCfg.stateFile, "r");
+    if (fp == nullptr) {
+        return;
+    }
+
+    unsigned long long jobId = 0;
+    if (fscanf(fp, "job %llx", &jobId) != 1 || (uint64_t)jobId != pushJobId) {
+        TRK_PRINTF("BLE_Push: %s belongs to another job, starting afresh", configPushCfg.stateFile);
+        fclose(fp);
+        return;
+    }
+
+    char mac[BLE_MAC_ADDR_LEN + 1];
+    char state[16];
+    int attempts = 0;
+    while (fscanf(fp, "%17s %15s %d", mac, state, &attempts) == 3) {
+        auto it = bleConnectCfg.tapeList.find(mac);
+        if (it == bleConnectCfg.tapeList.end()) {
+            continue;
+        }
+        auto indexIt = pushTargetIndex.find(it->second.get());
+        if (indexIt == pushTargetIndex.end()) {
+            continue;
+        }
+
+        PushTarget &target = pushTargets[indexIt->second];
+        target.attempts = max(0, attempts);
+        for (int i = BLE_PUSH_PENDING; i <= BLE_PUSH_FAILED; i++) {
+            if (strcmp(state, pushStateNames[i]) == 0) {
+                target.state = (BlePushState)i;
+            }
+        }
+        /* A larger ble_config_push_max_attempts gives failed tapes another chance */
+        if (target.state == BLE_PUSH_FAILED && target.attempts < configPushCfg.maxAttempts) {
+            target.state = BLE_PUSH_PENDING;
+        }
+        if (target.state != BLE_PUSH_PENDING) {
+            pushStats.resumed++;
+        }
+    }
+    fclose(fp);
+}
+
+/* Write the state to a temp file and rename it over the old one */
+static bool writeStateFile(void) {
+    char tmpPath[BLE_PUSH_STATE_PATH_LEN];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", configPushCfg.stateFile);
+
+    FILE *fp = fopen(tmpPath, "w");
+    if (fp == nullptr) {
+        TRK_LOG_ERR("ERROR: BLE_Push: state file could not be written: %s", strerror(errno));
+        return false;
+    }
+
+    fprintf(fp, "job %016llx\n", (unsigned long long)pushJobId);
+    for (const PushTarget &target : pushTargets) {
+        fprintf(fp, "%s %s %d\n", target.tape->macAddr.c_str(), pushStateNames[target.state], target.attempts);
+    }
+    bool ok = (fflush(fp) == 0) && (fdatasync(fileno(fp)) == 0);
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmpPath, configPushCfg.stateFile) != 0) {
+        TRK_LOG_ERR("ERROR: BLE_Push: state file update failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void checkJobFinished(uint64_t nowMsecs) {
+    if (pushFinishedLogged || pushStats.done + pushStats.failed < pushStats.targets) {
+        return;
+    }
+    pushFinishedLogged = true;
+    TRK_PRINTF("BLE_Push: job finished: %zu written, %zu failed of %zu tapes in %llu s", pushStats.done,
+               pushStats.failed, pushStats.targets, (unsigned long long)((nowMsecs - pushStartMsecs) / 1000u));
+}
+
+bool bleConfigPushInit(uint64_t nowMsecs) {
+    pushActive = false;
+    if (configPushCfg.value == nullptr || configPushCfg.value[0] == '\0' || configPushCfg.targets.empty()) {
+        return false;
+    }
+    if (!decodeHexValue(configPushCfg.value, pushValue) || pushValue.empty() ||
+        pushValue.size() > ATT_MAX_VALUE_LEN) {
+        TRK_LOG_ERR("ERROR: BLE_Push: ble_config_push_value must be 1 to %u hex encoded bytes", ATT_MAX_VALUE_LEN);
+        return false;
+    }
+
+    pushJobId = getJobId(configPushCfg.charUuid, pushValue);
+    pushTargets.clear();
+    pushTargetIndex.clear();
+    pushStats = {0};
+    for (const string &macAddr : configPushCfg.targets) {
+        auto it = bleConnectCfg.tapeList.find(macAddr);
+        if (it == bleConnectCfg.tapeList.end() || pushTargetIndex.count(it->second.get()) != 0) {
+            continue;
+        }
+        pushTargetIndex[it->second.get()] = pushTargets.size();
+        pushTargets.push_back({it->second.get(), BLE_PUSH_PENDING, 0});
+    }
+    readStateFile();
+
+    for (const PushTarget &target : pushTargets) {
+        if (target.state == BLE_PUSH_DONE) {
+            pushStats.done++;
+        }
+        else if (target.state == BLE_PUSH_FAILED) {
+            pushStats.failed++;
+        }
+        target.tape->configPushPending.store(target.state == BLE_PUSH_PENDING);
+    }
+    pushStats.targets = pushTargets.size();
+    pushStartMsecs = nowMsecs;
+    pushLastFlushMsecs = nowMsecs;
+    pushActive = true;
+    pushDirty = true;
+    pushFinishedLogged = false;
+    TRK_PRINTF("BLE_Push: job %016llx writes %zu bytes to %zu tapes, %zu resumed from %s",
+               (unsigned long long)pushJobId, pushValue.size(), pushStats.targets, pushStats.resumed,
+               configPushCfg.stateFile);
+    checkJobFinished(nowMsecs);
+    return true;
+}
+
+const vector<uint8_t> &bleConfigPushValue(void) {
+    return pushValue;
+}
+
+bool bleConfigPushNoteResult(tapeConfig *tape, bool success, uint64_t nowMsecs) {
+    auto indexIt = pushTargetIndex.find(tape);
+    if (!pushActive || indexIt == pushTargetIndex.end()) {
+        return false;
+    }
+    PushTarget &target = pushTargets[indexIt->second];
+    if (target.state != BLE_PUSH_PENDING) {
+        return false;
+    }
+
+    target.attempts++;
+    pushStats.attempts++;
+    pushDirty = true;
+    if (success) {
+        target.state = BLE_PUSH_DONE;
+        pushStats.done++;
+    }
+    else if (target.attempts >= configPushCfg.maxAttempts) {
+        target.state = BLE_PUSH_FAILED;
+        pushStats.failed++;
+    }
+    tape->configPushPending.store(target.state == BLE_PUSH_PENDING);
+
+    TRK_PRINTF("BLE_Push: %s %s after %d attempt(s), %zu/%zu done", tape->macAddr.c_str(),
+               (target.state == BLE_PUSH_PENDING) ? "retry" : pushStateNames[target.state], target.attempts,
+               pushStats.done + pushStats.failed, pushStats.targets);
+    checkJobFinished(nowMsecs);
+    return (target.state == BLE_PUSH_PENDING);
+}
+
+int bleConfigPushAttempts(const tapeConfig *tape) {
+    auto indexIt = pushTargetIndex.find(tape);
+    if (!pushActive || indexIt == pushTargetIndex.end()) {
+        return 0;
+    }
+    return pushTargets[indexIt->second].attempts;
+}
+
+void bleConfigPushFlush(uint64_t nowMsecs, bool force) {
+    if (!pushActive || !pushDirty) {
+        return;
+    }
+    if (!force && nowMsecs - pushLastFlushMsecs < BLE_PUSH_STATE_FLUSH_MSECS) {
+        return;
+    }
+    pushLastFlushMsecs = nowMsecs;
+    if (writeStateFile()) {
+        pushDirty = false;
+    }
+}
+
+void getBleConfigPushStats(BlePushStats *stats, uint64_t nowMsecs) {
+    if (stats == nullptr) {
+        return;
+    }
+    *stats = pushStats;
+    stats->elapsedMsecs = pushActive ? (nowMsecs - pushStartMsecs) : 0;
+}
+
+void logBleConfigPushStats(uint64_t nowMsecs) {
+    if (!pushActive) {
+        return;
+    }
+    BlePushStats stats;
+    getBleConfigPushStats(&stats, nowMsecs);
+
+    /* Tapes finished in this run per minute, and the time the pending ones take at that rate */
+    size_t finished = stats.done + stats.failed;
+    size_t finishedNow = finished - stats.resumed;
+    size_t pending = stats.targets - finished;
+    double perMin = (stats.elapsedMsecs > 0) ? (60000.0 * (double)finishedNow / (double)stats.elapsedMsecs) : 0.0;
+    double etaMin = (perMin > 0.0) ? ((double)pending / perMin) : 0.0;
+    TRK_PRINTF("BLE_Push: done=%zu failed=%zu pending=%zu of %zu attempts=%llu rate=%.1f tapes/min eta=%.1f min",
+               stats.done, stats.failed, pending, stats.targets, (unsigned long long)stats.attempts, perMin, etaMin);
+}
@@ -0,0 +1,257 @@
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+#include "ble.h"
+#include "common.h"
+#include "config.h"
+#include "bleConnEngine.h"
+
+using namespace std;
+
+typedef struct PendingConnect {
+    string macAddr;
+    int sock;
+    uint64_t startMsecs;
+    uint64_t deadlineMsecs;
+} PendingConnect;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static int connEpollFd = -1;
+static vector<PendingConnect> pendingConnects;
+static BleConnStats connStats = {0};
+static const uint32_t connHistBounds[BLE_CONN_HIST_BUCKETS] = BLE_CONN_HIST_BOUNDS_MSECS;
+static uint64_t statsLoggedMsecs = 0;
+static uint64_t statsLoggedConnected = 0;
+
+static size_t getMaxParallelConnects(void);
+static void finishConnect(size_t idx, int err, uint64_t nowMsecs, vector<BleConnResult> &results);
+
+/* ----------------- Function Definitions ---------------------- */
+static size_t getMaxParallelConnects(void) {
+    size_t maxParallel = (bleConnectCfg.maxParallelConnects > 0) ? (size_t)bleConnectCfg.maxParallelConnects :
+                                                                   BLE_CONN_DEF_MAX_PARALLEL;
+    return min(maxParallel, (size_t)BLE_CONN_MAX_PARALLEL);
+}
+
+/* Report the outcome of pendingConnects[idx] and remove it; the socket goes to the caller on success */
+static void finishConnect(size_t idx, int err, uint64_t nowMsecs, vector<BleConnResult> &results) {
+    PendingConnect &pending = pendingConnects[idx];
+    uint32_t connectMsecs = (uint32_t)(nowMsecs - pending.startMsecs);
+    int sock = -1;
+
+    epoll_ctl(connEpollFd, EPOLL_CTL_DEL, pending.sock, nullptr);
+    if (err == 0) {
+        sock = pending.sock;
+        connStats.connected++;
+        for (size_t i = 0; i < BLE_CONN_HIST_BUCKETS; i++) {
+            if (connectMsecs <= connHistBounds[i]) {
+                connStats.connectHist[i]++;
+                break;
+            }
+        }
+    }
+    else {
+        close(pending.sock);
+        if (err == ETIMEDOUT) {
+            connStats.timedOut++;
+        }
+        else {
+            connStats.failed++;
+        }
+    }
+
+    results.push_back({pending.macAddr, sock, err, connectMsecs});
+    pendingConnects.erase(pendingConnects.begin() + idx);
+}
+
+bool bleConnEngineInit(void) {
+    if (connEpollFd >= 0) {
+        return true;
+    }
+    connEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (connEpollFd < 0) {
+        TRK_PRINTF("BLE_Conn: epoll_create1 failed: %s", strerror(errno));
+        return false;
+    }
+    statsLoggedMsecs = getMonotonicTimeMsecs();
+    TRK_PRINTF("BLE_Conn: up to %zu parallel connects, timeout %d ms", getMaxParallelConnects(),
+               bleConnectCfg.connectTimeoutMsecs);
+    return true;
+}
+
+bool bleConnEngineHasFreeSlot(void) {
+    return (pendingConnects.size() < getMaxParallelConnects());
+}
+
+bool bleConnEngineIsPending(const string &macAddr) {
+    for (const auto &pending : pendingConnects) {
+        if (pending.macAddr == macAddr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t bleConnEngineInFlight(void) {
+    return pendingConnects.size();
+}
+
+bool bleConnEngineStart(const string &macAddr, uint8_t dstType, int secLevel, vector<BleConnResult> &results) {
+    if (connEpollFd < 0 || !bleConnEngineHasFreeSlot() || bleConnEngineIsPending(macAddr)) {
+        return false;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    connStats.attempts++;
+
+    int sock = openBleAttSocket(secLevel, true);
+    if (sock < 0) {
+        connStats.failed++;
+        results.push_back({macAddr, -1, errno, 0});
+        return true;
+    }
+
+    struct sockaddr_l2 dstaddr;
+    fillBleAttAddr(&dstaddr, macAddr.c_str(), dstType);
+    uint32_t timeoutMsecs = (bleConnectCfg.connectTimeoutMsecs > 0) ? (uint32_t)bleConnectCfg.connectTimeoutMsecs :
+                                                                      BLE_CONN_DEF_TIMEOUT_MSECS;
+    pendingConnects.push_back({macAddr, sock, nowMsecs, nowMsecs + timeoutMsecs});
+
+    if (connect(sock, (struct sockaddr *)&dstaddr, sizeof(dstaddr)) == 0) {
+        /* The epoll entry does not exist yet, finishConnect() tolerates that */
+        finishConnect(pendingConnects.size() - 1, 0, nowMsecs, results);
+        return true;
+    }
+    if (errno != EINPROGRESS) {
+        finishConnect(pendingConnects.size() - 1, errno, nowMsecs, results);
+        return true;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLOUT;
+    event.data.fd = sock;
+    if (epoll_ctl(connEpollFd, EPOLL_CTL_ADD, sock, &event) < 0) {
+        finishConnect(pendingConnects.size() - 1, errno, nowMsecs, results);
+    }
+    return true;
+}
+
+bool bleConnEngineWatch(int sock) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = sock;
+    return (connEpollFd >= 0 && epoll_ctl(connEpollFd, EPOLL_CTL_ADD, sock, &event) == 0);
+}
+
+void bleConnEngineUnwatch(int sock) {
+    if (connEpollFd >= 0) {
+        epoll_ctl(connEpollFd, EPOLL_CTL_DEL, sock, nullptr);
+    }
+}
+
+size_t bleConnEnginePoll(uint32_t timeoutMsecs, vector<BleConnResult> &results, vector<int> &readyFds) {
+    if (connEpollFd < 0) {
+        return 0;
+    }
+
+    size_t resultCount = results.size();
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    uint64_t waitMsecs = timeoutMsecs;
+    for (const auto &pending : pendingConnects) {
+        waitMsecs = min(waitMsecs, (pending.deadlineMsecs > nowMsecs) ? (pending.deadlineMsecs - nowMsecs) : 0);
+    }
+
+    struct epoll_event events[BLE_CONN_MAX_EVENTS];
+    int ready = epoll_wait(connEpollFd, events, BLE_CONN_MAX_EVENTS, (int)waitMsecs);
+    if (ready < 0 && errno != EINTR) {
+        TRK_PRINTF("BLE_Conn: epoll_wait failed: %s", strerror(errno));
+    }
+
+    nowMsecs = getMonotonicTimeMsecs();
+    for (int i = 0; i < ready; i++) {
+        bool pending = false;
+        for (size_t idx = 0; idx < pendingConnects.size(); idx++) {
+            if (pendingConnects[idx].sock != events[i].data.fd) {
+                continue;
+            }
+            /* The connect finished; SO_ERROR tells how */
+            int err = 0;
+            socklen_t errLen = sizeof(err);
+            if (getsockopt(pendingConnects[idx].sock, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0) {
+                err = errno;
+            }
+            finishConnect(idx, err, nowMsecs, results);
+            pending = true;
+            break;
+        }
+        if (!pending) {
+            readyFds.push_back(events[i].data.fd);
+        }
+    }
+
+    for (size_t idx = 0; idx < pendingConnects.size();) {
+        if (nowMsecs >= pendingConnects[idx].deadlineMsecs) {
+            finishConnect(idx, ETIMEDOUT, nowMsecs, results);
+        }
+        else {
+            idx++;
+        }
+    }
+    return results.size() - resultCount;
+}
+
+void getBleConnStats(BleConnStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    *stats = connStats;
+    stats->inFlight = pendingConnects.size();
+}
+
+void logBleConnStats(void) {
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    double elapsedSecs = (double)(nowMsecs - statsLoggedMsecs) / 1000.0;
+    double connectsPerSec = (elapsedSecs > 0.0) ?
+                            ((double)(connStats.connected - statsLoggedConnected) / elapsedSecs) : 0.0;
+    statsLoggedMsecs = nowMsecs;
+    statsLoggedConnected = connStats.connected;
+
+    TRK_PRINTF("BLE_Conn: attempts=%llu connected=%llu failed=%llu timed_out=%llu in_flight=%zu connects/s=%.2f",
+               (unsigned long long)connStats.attempts, (unsigned long long)connStats.connected,
+               (unsigned long long)connStats.failed, (unsigned long long)connStats.timedOut,
+               pendingConnects.size(), connectsPerSec);
+
+    char histBuff[256] = {0};
+    size_t len = 0;
+    for (size_t i = 0; i < BLE_CONN_HIST_BUCKETS && len < sizeof(histBuff); i++) {
+        if (connHistBounds[i] == UINT32_MAX) {
+            len += snprintf(&histBuff[len], sizeof(histBuff) - len, " inf=%llu",
+                            (unsigned long long)connStats.connectHist[i]);
+        }
+        else {
+            len += snprintf(&histBuff[len], sizeof(histBuff) - len, " le%u=%llu", connHistBounds[i],
+                            (unsigned long long)connStats.connectHist[i]);
+        }
+    }
+    TRK_PRINTF("BLE_Conn: time to connect (ms):%s", histBuff);
+}
+
+void bleConnEngineClose(void) {
+    for (const auto &pending : pendingConnects) {
+        close(pending.sock);
+    }
+    pendingConnects.clear();
+    if (connEpollFd >= 0) {
+        close(connEpollFd);
+        connEpollFd = -1;
+    }
+}
@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <random>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "common.h"
+#include "config.h"
+#include "bleConnSched.h"
+
+using namespace std;
+
+typedef struct SchedEntry {
+    uint64_t dueMsecs;
+    tapeConfig *tape;
+
+    bool operator>(const SchedEntry &other) const {
+        return dueMsecs > other.dueMsecs;
+    }
+} SchedEntry;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+/* Sighting ring: written by the scan thread at ringTail, read by the connect thread at ringHead */
+static vector<tapeConfig *> sightingRing;
+static size_t ringMask = 0;
+static atomic<size_t> ringHead(0);
+static atomic<size_t> ringTail(0);
+static atomic<bool> schedReady(false);
+static atomic<int> wakeFd(-1);
+static atomic<uint64_t> sightingsDropped(0);
+
+/* Due tapes, persistent (high priority) ones apart so the arbiter can let them through alone */
+static priority_queue<SchedEntry, vector<SchedEntry>, greater<SchedEntry>> dueHeaps[2];
+static BleConnSchedStats schedStats = {0};
+static mt19937 schedRng(random_device{}());
+
+static size_t getRingSize(size_t tapeCount);
+
+/* ----------------- Function Definitions ---------------------- */
+/* Smallest power of two that holds a sighting of every tape */
+static size_t getRingSize(size_t tapeCount) {
+    size_t size = 1;
+    while (size < tapeCount) {
+        size <<= 1;
+    }
+    return size;
+}
+
+bool bleConnSchedInit(void) {
+    if (schedReady.load(memory_order_acquire)) {
+        return true;
+    }
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        TRK_PRINTF("BLE_Sched: eventfd failed: %s", strerror(errno));
+        return false;
+    }
+
+    sightingRing.assign(getRingSize(bleConnectCfg.tapeList.size()), nullptr);
+    ringMask = sightingRing.size() - 1;
+    wakeFd.store(fd);
+    schedReady.store(true, memory_order_release);
+    TRK_PRINTF("BLE_Sched: %zu connectable tapes, backoff %d..%d ms", bleConnectCfg.tapeList.size(),
+               bleConnectCfg.backoffBaseMsecs, bleConnectCfg.backoffMaxMsecs);
+    return true;
+}
+
+int bleConnSchedWakeFd(void) {
+    return wakeFd.load();
+}
+
+void bleConnSchedWake(void) {
+    int fd = wakeFd.load();
+    if (fd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+bool bleConnSchedNoteSighting(tapeConfig *tape) {
+    if (tape == nullptr || !schedReady.load(memory_order_acquire)) {
+        return false;
+    }
+    /* One sighting per tape in the ring; the connect thread clears the flag when it takes it */
+    if (tape->tapeFound.exchange(true, memory_order_acq_rel)) {
+        return false;
+    }
+
+    size_t tail = ringTail.load(memory_order_relaxed);
+    if (tail - ringHead.load(memory_order_acquire) > ringMask) {
+        tape->tapeFound.store(false, memory_order_release);
+        sightingsDropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    sightingRing[tail & ringMask] = tape;
+    ringTail.store(tail + 1, memory_order_release);
+    bleConnSchedWake();
+    return true;
+}
+
+size_t bleConnSchedDrain(uint64_t nowMsecs) {
+    int fd = wakeFd.load();
+    if (fd >= 0) {
+        uint64_t count;
+        ssize_t readLen = read(fd, &count, sizeof(count));
+        (void)readLen;
+    }
+
+    size_t head = ringHead.load(memory_order_relaxed);
+    size_t tail = ringTail.load(memory_order_acquire);
+    size_t taken = tail - head;
+    for (; head != tail; head++) {
+        tapeConfig *tape = sightingRing[head & ringMask];
+        tape->tapeFound.store(false, memory_order_release);
+        tape->lastSeenMsecs = nowMsecs;
+        schedStats.sightings++;
+        if (tape->busy || tape->scheduled) {
+            continue;
+        }
+        /* The due time of a scheduled tape cannot change: eligibility only moves after a connect */
+        tape->scheduled = true;
+        tape->dueMsecs = max(nowMsecs, tape->nextEligibleMsecs);
+        dueHeaps[tape->persistent ? 1 : 0].push({tape->dueMsecs, tape});
+        schedStats.scheduled++;
+    }
+    ringHead.store(head, memory_order_release);
+    return taken;
+}
+
+tapeConfig *bleConnSchedPopDue(uint64_t nowMsecs, bool includePriority, bool includeNormal) {
+    for (int priority = 1; priority >= 0; priority--) {
+        auto &dueHeap = dueHeaps[priority];
+        if ((priority == 1) ? !includePriority : !includeNormal) {
+            continue;
+        }
+        while (!dueHeap.empty() && dueHeap.top().dueMsecs <= nowMsecs) {
+            tapeConfig *tape = dueHeap.top().tape;
+            dueHeap.pop();
+            tape->scheduled = false;
+            if (nowMsecs - tape->lastSeenMsecs > BLE_CONN_SCHED_SIGHTING_TTL_MSECS) {
+                schedStats.expired++;
+                continue;
+            }
+            tape->busy = true;
+            schedStats.started++;
+            return tape;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t bleConnSchedMsecsUntilDue(uint64_t nowMsecs, uint32_t maxMsecs, bool priority) {
+    const auto &dueHeap = dueHeaps[priority ? 1 : 0];
+    if (dueHeap.empty()) {
+        return maxMsecs;
+    }
+    uint64_t dueMsecs = dueHeap.top().dueMsecs;
+    return (dueMsecs > nowMsecs) ? (uint32_t)min((uint64_t)maxMsecs, dueMsecs - nowMsecs) : 0;
+}
+
+int bleConnSchedBackoffMsecs(int retryCount) {
+    if (retryCount <= 0) {
+        return 0;
+    }
+    uint64_t ceilingMsecs = (uint64_t)bleConnectCfg.backoffBaseMsecs << min(retryCount - 1, 20);
+    ceilingMsecs = min(ceilingMsecs, (uint64_t)bleConnectCfg.backoffMaxMsecs);
+    uniform_int_distribution<uint32_t> jitter(0, (uint32_t)(ceilingMsecs / 2));
+    return (int)(ceilingMsecs - ceilingMsecs / 2 + jitter(schedRng));
+}
+
+void bleConnSchedRelease(tapeConfig *tape) {
+    if (tape != nullptr) {
+        tape->busy = false;
+    }
+}
+
+void getBleConnSchedStats(BleConnSchedStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    *stats = schedStats;
+    stats->dropped = sightingsDropped.load(memory_order_relaxed);
+    stats->heapSize = dueHeaps[0].size() + dueHeaps[1].size();
+}
+
+void bleConnSchedClose(void) {
+    schedReady.store(false, memory_order_release);
+    int fd = wakeFd.exchange(-1);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
@@ -0,0 +1,362 @@
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+#include <bluetooth/l2cap.h>
+#include "common.h"
+#include "config.h"
+#include "bleLink.h"
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static int hciCmdFd = -1;
+static int hciEvtFd = -1;
+static uint32_t localFeatures = 0;
+static map<uint16_t, BleLinkParams> linkParams;
+static BleLinkStats linkStats = {0};
+
+/* A command sent without waiting, until its Command Status or Command Complete comes in */
+typedef struct PendingLinkCmd {
+    uint16_t opcode;
+    string macAddr;
+} PendingLinkCmd;
+
+static deque<PendingLinkCmd> pendingCmds;
+
+static inline void putLe16(uint8_t *buff, uint16_t value);
+static inline uint16_t getLe16(const uint8_t *buff);
+static bool sendLinkCmd(uint16_t ocf, void *cparam, int clen, int event, void *rparam, int rlen);
+static bool sendLinkCmdAsync(uint16_t ocf, uint8_t *cparam, uint8_t clen, const tapeConfig *tape);
+static const char *getLinkCmdName(uint16_t opcode);
+static void handleCmdResult(uint16_t opcode, uint8_t status);
+static void readLocalFeatures(void);
+static void openEventSocket(void);
+static void handleLeMetaEvent(const uint8_t *data, size_t len);
+
+/* ----------------- Function Definitions ---------------------- */
+static inline void putLe16(uint8_t *buff, uint16_t value) {
+    buff[0] = (uint8_t)(value & 0xFF);
+    buff[1] = (uint8_t)(value >> 8);
+}
+
+static inline uint16_t getLe16(const uint8_t *buff) {
+    return (uint16_t)(buff[0] | ((uint16_t)buff[1] << 8));
+}
+
+/* Send an LE controller command and wait for its Command Complete or Command Status. Only used at init. */
+static bool sendLinkCmd(uint16_t ocf, void *cparam, int clen, int event, void *rparam, int rlen) {
+    struct hci_request req;
+    memset(&req, 0, sizeof(req));
+    req.ogf = OGF_LE_CTL;
+    req.ocf = ocf;
+    req.event = event;
+    req.cparam = cparam;
+    req.clen = clen;
+    req.rparam = rparam;
+    req.rlen = rlen;
+    if (hciCmdFd < 0 || hci_send_req(hciCmdFd, &req, BLE_LINK_CMD_TIMEOUT_MSECS) < 0) {
+        linkStats.cmdFailed++;
+        return false;
+    }
+    /* Both Command Complete and Command Status parameters of these commands start with the status */
+    if (((uint8_t *)rparam)[0] != 0) {
+        linkStats.cmdFailed++;
+        return false;
+    }
+    return true;
+}
+
+/* Send an LE controller command to tune a tape's link; the result comes in on the event socket */
+static bool sendLinkCmdAsync(uint16_t ocf, uint8_t *cparam, uint8_t clen, const tapeConfig *tape) {
+    uint16_t opcode = cmd_opcode_pack(OGF_LE_CTL, ocf);
+    if (hciCmdFd < 0 || hci_send_cmd(hciCmdFd, OGF_LE_CTL, ocf, clen, cparam) < 0) {
+        linkStats.cmdFailed++;
+        TRK_PRINTF("BLE_Link: %s %s not sent: %s", tape->macAddr.c_str(), getLinkCmdName(opcode), strerror(errno));
+        return false;
+    }
+    if (pendingCmds.size() >= BLE_LINK_MAX_PENDING_CMDS) {
+        /* The controller never answered the oldest one */
+        pendingCmds.pop_front();
+    }
+    pendingCmds.push_back({opcode, tape->macAddr});
+    return true;
+}
+
+static const char *getLinkCmdName(uint16_t opcode) {
+    if (opcode == cmd_opcode_pack(OGF_LE_CTL, BLE_LINK_OCF_LE_SET_PHY)) {
+        return "LE Set PHY";
+    }
+    if (opcode == cmd_opcode_pack(OGF_LE_CTL, BLE_LINK_OCF_LE_SET_DATA_LENGTH)) {
+        return "LE Set Data Length";
+    }
+    if (opcode == cmd_opcode_pack(OGF_LE_CTL, OCF_LE_CONN_UPDATE)) {
+        return "LE Connection Update";
+    }
+    return "HCI command";
+}
+
+/* Command Status or Command Complete of a command; the ones sent by other sockets are not pending here */
+static void handleCmdResult(uint16_t opcode, uint8_t status) {
+    auto it = find_if(pendingCmds.begin(), pendingCmds.end(),
+                      [opcode](const PendingLinkCmd &cmd) { return cmd.opcode == opcode; });
+    if (it == pendingCmds.end()) {
+        return;
+    }
+    if (status != 0) {
+        linkStats.cmdFailed++;
+        TRK_PRINTF("BLE_Link: %s %s refused (0x%02X)", it->macAddr.c_str(), getLinkCmdName(opcode), status);
+    }
+    pendingCmds.erase(it);
+}
+
+static void readLocalFeatures(void) {
+    le_read_local_supported_features_rp rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    if (!sendLinkCmd(OCF_LE_READ_LOCAL_SUPPORTED_FEATURES, nullptr, 0, EVT_CMD_COMPLETE, &rsp, sizeof(rsp))) {
+        TRK_PRINTF("BLE_Link: reading the LE features failed, no link negotiation");
+        return;
+    }
+    localFeatures = (uint32_t)rsp.features[0] | ((uint32_t)rsp.features[1] << 8);
+}
+
+static void openEventSocket(void) {
+    struct sockaddr_hci addr;
+    struct hci_filter filter;
+
+    hciEvtFd = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, BTPROTO_HCI);
+    if (hciEvtFd < 0) {
+        TRK_PRINTF("BLE_Link: HCI event socket failed: %s", strerror(errno));
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.hci_family = AF_BLUETOOTH;
+    addr.hci_dev = HCI_DEV_ID;
+    addr.hci_channel = HCI_CHANNEL_RAW;
+    hci_filter_clear(&filter);
+    hci_filter_set_ptype(HCI_EVENT_PKT, &filter);
+    hci_filter_set_event(EVT_LE_META_EVENT, &filter);
+    hci_filter_set_event(EVT_CMD_STATUS, &filter);
+    hci_filter_set_event(EVT_CMD_COMPLETE, &filter);
+    if (bind(hciEvtFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(hciEvtFd, SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) < 0) {
+        TRK_PRINTF("BLE_Link: HCI event socket setup failed: %s", strerror(errno));
+        close(hciEvtFd);
+        hciEvtFd = -1;
+    }
+}
+
+static void handleLeMetaEvent(const uint8_t *data, size_t len) {
+    if (len < 1) {
+        return;
+    }
+    uint8_t subevent = data[0];
+    data++;
+    len--;
+
+    switch (subevent) {
+        case EVT_LE_CONN_COMPLETE:
+        case BLE_LINK_EVT_LE_ENH_CONN_COMPLETE:
+            /* Status, handle: a new connection starts on the defaults */
+            if (len >= 3 && data[0] == 0) {
+                linkParams[getLe16(&data[1])] = {BLE_LINK_DEF_OCTETS, BLE_LINK_DEF_OCTETS, BLE_LINK_PHY_1M,
+                                                 BLE_LINK_PHY_1M};
+            }
+            break;
+        case BLE_LINK_EVT_LE_DATA_LENGTH_CHANGE:
+            /* Handle, max TX octets, max TX time, max RX octets, max RX time */
+            if (len >= 10) {
+                BleLinkParams &params = linkParams[getLe16(&data[0])];
+                params.txOctets = getLe16(&data[2]);
+                params.rxOctets = getLe16(&data[6]);
+                if (params.txPhy == 0) {
+                    params.txPhy = params.rxPhy = BLE_LINK_PHY_1M;
+                }
+                if (params.txOctets > BLE_LINK_DEF_OCTETS || params.rxOctets > BLE_LINK_DEF_OCTETS) {
+                    linkStats.dleChanged++;
+                }
+            }
+            break;
+        case BLE_LINK_EVT_LE_PHY_UPDATE_COMPLETE:
+            /* Status, handle, TX PHY, RX PHY */
+            if (len >= 5) {
+                BleLinkParams &params = linkParams[getLe16(&data[1])];
+                if (params.txOctets == 0) {
+                    params.txOctets = params.rxOctets = BLE_LINK_DEF_OCTETS;
+                }
+                if (data[0] == 0) {
+                    params.txPhy = data[3];
+                    params.rxPhy = data[4];
+                }
+                if (data[0] == 0 && params.txPhy == BLE_LINK_PHY_2M && params.rxPhy == BLE_LINK_PHY_2M) {
+                    linkStats.phy2M++;
+                }
+                else {
+                    linkStats.phyFallback++;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool bleLinkInit(void) {
+    if (hciCmdFd >= 0) {
+        return true;
+    }
+    hciCmdFd = hci_open_dev(HCI_DEV_ID);
+    if (hciCmdFd < 0) {
+        TRK_PRINTF("BLE_Link: opening HCI device failed: %s", strerror(errno));
+        return false;
+    }
+    readLocalFeatures();
+    openEventSocket();
+    TRK_PRINTF("BLE_Link: controller DLE=%s 2M=%s", (localFeatures & BLE_LINK_FEATURE_DLE) ? "yes" : "no",
+               (localFeatures & BLE_LINK_FEATURE_2M_PHY) ? "yes" : "no");
+    return true;
+}
+
+int bleLinkEventFd(void) {
+    return hciEvtFd;
+}
+
+void bleLinkProcessEvents(void) {
+    uint8_t buff[HCI_MAX_EVENT_SIZE + 1];
+    while (hciEvtFd >= 0) {
+        ssize_t len = read(hciEvtFd, buff, sizeof(buff));
+        if (len <= 0) {
+            if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                TRK_PRINTF("BLE_Link: HCI event read failed: %s", strerror(errno));
+            }
+            return;
+        }
+        /* Packet type, event code, parameter length, parameters */
+        if (len < 1 + HCI_EVENT_HDR_SIZE || buff[0] != HCI_EVENT_PKT) {
+            continue;
+        }
+        const uint8_t *data = &buff[1 + HCI_EVENT_HDR_SIZE];
+        size_t dataLen = min((size_t)buff[2], (size_t)len - (1 + HCI_EVENT_HDR_SIZE));
+        if (buff[1] == EVT_LE_META_EVENT) {
+            /* Every advertisement the scan sees comes here too, the scan thread has its own copy */
+            if (dataLen >= 1 && (data[0] == EVT_LE_ADVERTISING_REPORT || data[0] == BLE_LINK_EVT_LE_EXT_ADV_REPORT)) {
+                linkStats.advDropped++;
+                continue;
+            }
+            handleLeMetaEvent(data, dataLen);
+        }
+        else if (buff[1] == EVT_CMD_STATUS && dataLen >= 4) {
+            /* Status, command credits, opcode */
+            handleCmdResult(getLe16(&data[2]), data[0]);
+        }
+        else if (buff[1] == EVT_CMD_COMPLETE && dataLen >= 4) {
+            /* Command credits, opcode, return parameters starting with the status */
+            handleCmdResult(getLe16(&data[1]), data[3]);
+        }
+    }
+}
+
+bool bleLinkGetHandle(int sock, uint16_t *handle) {
+    struct l2cap_conninfo connInfo;
+    socklen_t infoLen = sizeof(connInfo);
+
+    memset(&connInfo, 0, sizeof(connInfo));
+    if (getsockopt(sock, SOL_L2CAP, L2CAP_CONNINFO, &connInfo, &infoLen) < 0) {
+        return false;
+    }
+    *handle = connInfo.hci_handle;
+    return true;
+}
+
+void bleLinkNegotiate(uint16_t handle, const tapeConfig *tape) {
+    if (linkParams.find(handle) == linkParams.end()) {
+        linkParams[handle] = {BLE_LINK_DEF_OCTETS, BLE_LINK_DEF_OCTETS, BLE_LINK_PHY_1M, BLE_LINK_PHY_1M};
+    }
+
+    if (localFeatures & BLE_LINK_FEATURE_2M_PHY) {
+        /* Handle, all PHYs (no preference: 0), TX PHYs, RX PHYs, PHY options */
+        uint8_t cmd[7] = {0};
+        putLe16(&cmd[0], handle);
+        cmd[3] = 1u << (BLE_LINK_PHY_2M - 1);
+        cmd[4] = 1u << (BLE_LINK_PHY_2M - 1);
+        linkStats.phyRequested++;
+        sendLinkCmdAsync(BLE_LINK_OCF_LE_SET_PHY, cmd, sizeof(cmd), tape);
+    }
+
+    if (localFeatures & BLE_LINK_FEATURE_DLE) {
+        /* Handle, TX octets, TX time */
+        uint8_t cmd[6] = {0};
+        putLe16(&cmd[0], handle);
+        putLe16(&cmd[2], BLE_LINK_MAX_TX_OCTETS);
+        putLe16(&cmd[4], BLE_LINK_MAX_TX_TIME_USECS);
+        linkStats.dleRequested++;
+        sendLinkCmdAsync(BLE_LINK_OCF_LE_SET_DATA_LENGTH, cmd, sizeof(cmd), tape);
+    }
+}
+
+void bleLinkUpdateConnParams(uint16_t handle, const tapeConfig *tape) {
+    if (tape->connIntervalMsecs == 0 && tape->supervisionTimeoutMsecs == 0) {
+        return;
+    }
+    if (tape->connIntervalMsecs == 0 || tape->supervisionTimeoutMsecs == 0) {
+        TRK_PRINTF("BLE_Link: %s needs both conn_interval_ms and supervision_timeout_ms", tape->macAddr.c_str());
+        return;
+    }
+    if (hciCmdFd < 0) {
+        return;
+    }
+
+    /* Handle, min and max interval in 1.25 ms units, latency, supervision timeout in 10 ms units,
+       min and max CE length as hci_le_conn_update() sends them */
+    uint8_t cmd[14] = {0};
+    uint16_t interval = (uint16_t)((tape->connIntervalMsecs * 4u) / 5u);
+    putLe16(&cmd[0], handle);
+    putLe16(&cmd[2], interval);
+    putLe16(&cmd[4], interval);
+    putLe16(&cmd[6], tape->connLatency);
+    putLe16(&cmd[8], (uint16_t)(tape->supervisionTimeoutMsecs / 10u));
+    putLe16(&cmd[10], 1);
+    putLe16(&cmd[12], 1);
+    if (!sendLinkCmdAsync(OCF_LE_CONN_UPDATE, cmd, sizeof(cmd), tape)) {
+        return;
+    }
+    TRK_PRINTF("BLE_Link: %s interval=%u ms latency=%u timeout=%u ms requested", tape->macAddr.c_str(),
+               tape->connIntervalMsecs, tape->connLatency, tape->supervisionTimeoutMsecs);
+}
+
+bool bleLinkGetParams(uint16_t handle, BleLinkParams *params) {
+    auto it = linkParams.find(handle);
+    if (it == linkParams.end() || params == nullptr) {
+        return false;
+    }
+    *params = it->second;
+    return true;
+}
+
+void getBleLinkStats(BleLinkStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    *stats = linkStats;
+}
+
+void bleLinkClose(void) {
+    if (hciEvtFd >= 0) {
+        close(hciEvtFd);
+        hciEvtFd = -1;
+    }
+    if (hciCmdFd >= 0) {
+        hci_close_dev(hciCmdFd);
+        hciCmdFd = -1;
+    }
+    linkParams.clear();
+    pendingCmds.clear();
+}
@@ -1,11 +1,23 @@
+#include <cctype>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <strings.h>
 #include <curl/curl.h>
 #include <iostream>
+#include <array>
+#include <vector>
+#include <mutex>
 #include "common.h"
 #include "cloudComm.h"
 #include "config.h"
+#include "heartbeat.h"
+#include "urlBuilder.h"
+#include "metrics.h"
+#include "uplinkThrottle.h"
+#include "uplinkEndpoint.h"
+#include "uplinkTransport.h"
 
 using namespace std;
 
@@ -16,7 +28,7 @@ static int addBleDataToBaseUrl(char* urlBuff, size_t urlBuffLen, const char* dat
 /* Function to append pageUrl to instance and store in buffer */
 static int createBaseUrlLink(char* urlBuff, size_t urlBuffLen, const char* instance, const char* pageUrl) {
     if (instance == nullptr || pageUrl == nullptr || urlBuff == nullptr) {
-        TRK_PRINTF("ERROR: URL link could not be created!");
+        TRK_LOG_ERR("ERROR: URL link could not be created!");
         return -1;
     }
 
@@ -24,7 +36,7 @@ static int createBaseUrlLink(char* urlBuff, size_t urlBuffLen, const char* insta
     size_t len2 = strlen(pageUrl);
 
     if (len1 + len2 + 1 > urlBuffLen) {
-        TRK_PRINTF("ERROR: URL Buffer too small! Required: %zu, Provided: %zu", len1 + len2 + 1, urlBuffLen);
+        TRK_LOG_ERR("ERROR: URL Buffer too small! Required: %zu, Provided: %zu", len1 + len2 + 1, urlBuffLen);
         return -1;
     }
 
@@ -37,13 +49,13 @@ static int createBaseUrlLink(char* urlBuff, size_t urlBuffLen, const char* insta
 /* Function to append dataBuff to urlBuff (mutable!) */
 static int addBleDataToBaseUrl(char* urlBuff, size_t urlBuffLen, const char* dataBuff, size_t dataBuffLen) {
     if (urlBuff == nullptr || dataBuff == nullptr) {
-        TRK_PRINTF("ERROR: Invalid params - URL Data link could not be created!");
+        TRK_LOG_ERR("ERROR: Invalid params - URL Data link could not be created!");
         return -1;
     }
 
     size_t len1 = strlen(urlBuff);
     if (len1 + dataBuffLen + 1 > urlBuffLen) {
-        TRK_PRINTF("ERROR: URL Buffer too small! Required: %zu, Provided: %zu", len1 + dataBuffLen + 1, urlBuffLen);
+        TRK_LOG_ERR("ERROR: URL Buffer too small! Required: %zu, Provided: %zu", len1 + dataBuffLen + 1, urlBuffLen);
         return -1;
     }
 
@@ -54,144 +66,734 @@ static int addBleDataToBaseUrl(char* urlBuff, size_t urlBuffLen, const char* dat
 /* Master function to create full URL with data */
 static void createCloudDataUrl(char* urlBuff, size_t urlBuffLen, const char* instance, const char* pageUrl, const char* dataBuff, size_t dataBuffLen) {
     if (dataBuff == nullptr || dataBuffLen == 0) {
-        TRK_PRINTF("ERROR: Invalid params, could not create cloud packets");
+        TRK_LOG_ERR("ERROR: Invalid params, could not create cloud packets");
         return;
     }
 
     if (createBaseUrlLink(urlBuff, urlBuffLen, instance, pageUrl) != 0) {
-        TRK_PRINTF("ERROR: Failed to create the base URL.");
+        TRK_LOG_ERR("ERROR: Failed to create the base URL.");
         return;
     }
 
     if (addBleDataToBaseUrl(urlBuff, urlBuffLen, dataBuff, dataBuffLen) != 0) {
-        TRK_PRINTF("ERROR: Failed to add BLE data to the URL.");
+        TRK_LOG_ERR("ERROR: Failed to add BLE data to the URL.");
         return;
     }
 }
 
+/* Keeps at most CLOUD_RESPONSE_MAX_LEN bytes of the body; the rest is drained, not failed */
 static size_t curlReqWriteCb(void *respData, size_t size, size_t nmemb, void *userp) {
     size_t totalSize = size * nmemb;
-    strncat((char *)userp, (char *)respData, totalSize);
+    string &response = static_cast<CloudRequest *>(userp)->response;
+    if (response.size() < CLOUD_RESPONSE_MAX_LEN) {
+        response.append((const char *)respData, min(totalSize, CLOUD_RESPONSE_MAX_LEN - response.size()));
+    }
     return totalSize;
 }
 
-const char* getGwId(void) {
-    return gwCfg.gwId;
+/* Decimal hint value, -1 if it is not a plain number */
+static int32_t parseHintValue(const char *p, size_t len) {
+    int32_t value = 0;
+    size_t digits = 0;
+    while (digits < len && p[digits] >= '0' && p[digits] <= '9') {
+        value = min(value * 10 + (p[digits] - '0'), (int32_t)1000000);
+        digits++;
+    }
+    return (digits == 0) ? -1 : value;
 }
 
-/* Send the data URL to the cloud */
-int sendDataUrlToCloud(const char *packetDataBuff, size_t packetDataLen) {
-    if (packetDataBuff == nullptr || packetDataLen == 0) {
-        TRK_PRINTF("ERROR: Invalid input params - Send URL to cloud failed");
+/* Retry-After is either delay-seconds or an HTTP-date */
+static int32_t parseRetryAfter(const char *p, size_t len) {
+    int32_t secs = parseHintValue(p, len);
+    if (secs >= 0) {
+        return secs;
+    }
+
+    char date[64];
+    len = min(len, sizeof(date) - 1);
+    memcpy(date, p, len);
+    date[len] = '\0';
+    time_t until = curl_getdate(date, nullptr);
+    if (until < 0) {
         return -1;
     }
-    static CURL* curl = nullptr;
-    static bool initialized = false;
-    static uint32_t curlProcessCount = 0;
-    int err_ret;    
-    /* Retrieve and print the transfer time and DNS lookup time */
-    double total_time = 0.0;
-    //char CallString[1024];
-    char urlBuff[MAX_URL_LEN];
-    memset(urlBuff, 0, MAX_URL_LEN);
+    time_t now = time(nullptr);
+    return (until > now) ? (int32_t)min(until - now, (time_t)1000000) : 0;
+}
+
+/* Returns the value of a "Name: value" header line if it carries the given header */
+static bool getHeaderValue(const char *line, size_t len, const char *name, const char **value, size_t *valueLen) {
+    size_t nameLen = strlen(name);
+    if (len <= nameLen || line[nameLen] != ':' || strncasecmp(line, name, nameLen) != 0) {
+        return false;
+    }
 
-    /* Create the Cloud Data URL that contains the BLE data. */
-    createCloudDataUrl(urlBuff, MAX_URL_LEN, urlCfg.instance, urlCfg.urlExtension, packetDataBuff, packetDataLen);
+    const char *p = line + nameLen + 1;
+    const char *end = line + len;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    while (end > p && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ')) {
+        end--;
+    }
+    *value = p;
+    *valueLen = (size_t)(end - p);
+    return true;
+}
 
-    /* Response data container */
-    string response_data;
+static size_t curlReqHeaderCb(char *line, size_t size, size_t nmemb, void *userp) {
+    size_t len = size * nmemb;
+    CloudResponseHints &hints = static_cast<CloudRequest *>(userp)->hints;
+    const char *value = nullptr;
+    size_t valueLen = 0;
 
-    if (!initialized) {
-        err_ret = curl_global_init(CURL_GLOBAL_DEFAULT);
-        if (err_ret != 0) {
-            TRK_PRINTF("Curl_Proc: failed curl_global_init");
-            return 1;
-        }
+    /* A new status line (redirect, 100-continue) starts a new header block */
+    if (len > 5 && strncmp(line, "HTTP/", 5) == 0) {
+        hints = CloudResponseHints();
+    }
+    else if (getHeaderValue(line, len, CLOUD_HINT_HDR_RETRY_AFTER, &value, &valueLen)) {
+        hints.retryAfterSecs = parseRetryAfter(value, valueLen);
+    }
+    else if (getHeaderValue(line, len, CLOUD_HINT_HDR_CONCURRENCY, &value, &valueLen)) {
+        hints.concurrency = parseHintValue(value, valueLen);
+    }
+    else if (getHeaderValue(line, len, CLOUD_HINT_HDR_BATCH_MAX, &value, &valueLen)) {
+        hints.batchMaxRecords = parseHintValue(value, valueLen);
+    }
+    else if (getHeaderValue(line, len, CLOUD_HINT_HDR_REPORT_INTERVAL, &value, &valueLen)) {
+        hints.reportIntervalSecs = parseHintValue(value, valueLen);
+    }
+    return len;
+}
 
-        curl = curl_easy_init();
-        if (!curl) {
-            curl_global_cleanup();
-            TRK_PRINTF("Curl_Proc: failed curl_easy_init");
-            return 1;
+size_t findCloudBodyKey(const string &body, const char *key) {
+    size_t keyLen = strlen(key);
+    for (size_t pos = body.find(key); pos != string::npos; pos = body.find(key, pos + 1)) {
+        if (pos == 0 || body[pos - 1] == '&' || body[pos - 1] == ';' || isspace((unsigned char)body[pos - 1])) {
+            return pos + keyLen;
         }
+    }
+    return string::npos;
+}
 
-        /* Set the DNS cache timeout */
-        curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, CURL_REQUEST_DNS_CACHE_TIMEOUT_SECS);
+/* Body keys fill in the hints the headers did not carry */
+static void parseBodyHint(const string &response, const char *key, int32_t *hint) {
+    size_t pos = 0;
+    if (*hint >= 0 || (pos = findCloudBodyKey(response, key)) == string::npos) {
+        return;
+    }
+    *hint = parseHintValue(response.c_str() + pos, response.size() - pos);
+}
+
+static void parseResponseHints(CloudRequest *req) {
+    parseBodyHint(req->response, CLOUD_HINT_KEY_RETRY_AFTER, &req->hints.retryAfterSecs);
+    parseBodyHint(req->response, CLOUD_HINT_KEY_CONCURRENCY, &req->hints.concurrency);
+    parseBodyHint(req->response, CLOUD_HINT_KEY_BATCH_MAX, &req->hints.batchMaxRecords);
+    parseBodyHint(req->response, CLOUD_HINT_KEY_REPORT_INTERVAL, &req->hints.reportIntervalSecs);
+}
+
+const char* getGwId(void) {
+    return gwCfg.gwId;
+}
+
+/* ------------------------- Curl Connection Manager ------------------------- */
+/* The share handle keeps the DNS cache and TLS sessions alive across transfers and
+   across transfer failures; the multi handle owns the connection pool. Only setup
+   failures tear them down. */
+static CURLSH* curlShare = nullptr;
+static CURLM* curlMulti = nullptr;
+static CURL* curlEasyPool[CURL_MAX_PARALLEL_REQUESTS] = {nullptr};
+static bool curlInitialized = false;
+static uint32_t curlProcessCount = 0;
+static CurlConnStats curlConnStats = {0};
+static mutex curlConnStatsMutex;
+static mutex curlShareMutex[CURL_LOCK_DATA_LAST];
+
+static void curlShareLockCb(CURL *handle, curl_lock_data data, curl_lock_access access, void *userp) {
+    (void)handle; (void)access; (void)userp;
+    curlShareMutex[data].lock();
+}
+
+static void curlShareUnlockCb(CURL *handle, curl_lock_data data, void *userp) {
+    (void)handle; (void)userp;
+    curlShareMutex[data].unlock();
+}
 
-        initialized = true;
+static CURL* createCurlEasyHandle(void) {
+    CURL* curl = curl_easy_init();
+    if (curl == nullptr) {
+        TRK_PRINTF("Curl_Proc: failed curl_easy_init");
+        return nullptr;
     }
 
-    TRK_PRINTF("Curl_Proc %d: curl rqst going=%s", ++curlProcessCount, urlBuff);
-    err_ret = curl_easy_setopt(curl, CURLOPT_URL, urlBuff);
-    if (err_ret != 0) {
-        TRK_PRINTF("Curl_Proc: failed set CURLOPT_URL");
+    if (curl_easy_setopt(curl, CURLOPT_SHARE, curlShare) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, CURL_REQUEST_DNS_CACHE_TIMEOUT_SECS) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)CURL_REQUEST_TIMEOUT_SECS) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlReqWriteCb) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, curlReqHeaderCb) != CURLE_OK) {
+        TRK_PRINTF("Curl_Proc: failed to configure the easy handle");
         curl_easy_cleanup(curl);
-        curl_global_cleanup();
-        initialized = false;
-        curl = nullptr;
-        return 1;
+        return nullptr;
     }
 
-    err_ret = curl_easy_setopt(curl, CURLOPT_TIMEOUT, CURL_REQUEST_TIMEOUT_SECS);
-    if (err_ret != 0) {
-        TRK_PRINTF("Curl_Proc: failed set CURLOPT_TIMEOUT");
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
-        initialized = false;
-        curl = nullptr;
-        return 1;
+    /* HTTP/2 over TLS lets parallel requests share one connection. PIPEWAIT makes
+       new transfers wait for the multiplexed connection instead of opening another.
+       Older libcurl builds without nghttp2 fall back to HTTP/1.1 keep-alive. */
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+
+    return curl;
+}
+
+static bool initCurlConnMgr(void) {
+    if (curlInitialized) {
+        return true;
     }
 
-    err_ret = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlReqWriteCb);
-    if (err_ret != 0) {
-        TRK_PRINTF("Curl_Proc: failed set CURLOPT_WRITEFUNCTION");
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
-        initialized = false;
-        curl = nullptr;
-        return 1;
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0) {
+        TRK_PRINTF("Curl_Proc: failed curl_global_init");
+        return false;
     }
 
-    err_ret = curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-    if (err_ret != 0) {
-        TRK_PRINTF("Curl_Proc: failed set CURLOPT_WRITEDATA");
-        curl_easy_cleanup(curl);
+    curlShare = curl_share_init();
+    if (curlShare == nullptr) {
+        TRK_PRINTF("Curl_Proc: failed curl_share_init");
         curl_global_cleanup();
-        initialized = false;
-        curl = nullptr;
-        return 1;
+        return false;
     }
+    curl_share_setopt(curlShare, CURLSHOPT_LOCKFUNC, curlShareLockCb);
+    curl_share_setopt(curlShare, CURLSHOPT_UNLOCKFUNC, curlShareUnlockCb);
+    curl_share_setopt(curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    curlMulti = curl_multi_init();
+    if (curlMulti == nullptr) {
+        TRK_PRINTF("Curl_Proc: failed curl_multi_init");
+        curl_share_cleanup(curlShare);
+        curlShare = nullptr;
+        curl_global_cleanup();
+        return false;
+    }
+    curl_multi_setopt(curlMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
 
-    /* Perform the request */
-    CURLcode res = curl_easy_perform(curl);
+    uplinkEndpointInit();
+    curlInitialized = true;
+    return true;
+}
 
-    /* Check if the curl request was sucessful or not */
+/* Drop a single easy handle that could not be configured; the pool and share stay intact */
+static void resetCurlEasyHandle(size_t idx) {
+    if (curlEasyPool[idx] != nullptr) {
+        curl_easy_cleanup(curlEasyPool[idx]);
+        curlEasyPool[idx] = nullptr;
+    }
+}
+
+static void updateCurlConnStats(CURL* curl, CURLcode res) {
+    long numConnects = 0;
+    long httpVersion = 0;
+    double connectTime = 0.0;
+    double appConnectTime = 0.0;
+    long requestSize = 0;
+    long headerSize = 0;
+    curl_off_t downloadSize = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &numConnects);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &httpVersion);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connectTime);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appConnectTime);
+    curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &requestSize);
+    curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &headerSize);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloadSize);
+
+    lock_guard<mutex> lock(curlConnStatsMutex);
+    curlConnStats.totalRequests++;
+    curlConnStats.bytesSent += (uint64_t)requestSize;
+    curlConnStats.bytesReceived += (uint64_t)headerSize + (uint64_t)downloadSize;
     if (res != CURLE_OK) {
-        TRK_PRINTF("Curl_Proc: curl_easy_perform() failed: %s", curl_easy_strerror(res));
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
-        initialized = false;
-        curl = nullptr;
-        return 1;
+        curlConnStats.failedRequests++;
+    }
+
+    if (numConnects > 0) {
+        curlConnStats.newConnections++;
+        /* APPCONNECT covers DNS + TCP + TLS; it is zero for plain HTTP */
+        curlConnStats.handshakeSecsTotal += (appConnectTime > 0.0) ? appConnectTime : connectTime;
+    }
+    else if (res == CURLE_OK) {
+        curlConnStats.reusedConnections++;
+    }
+
+    if (httpVersion == CURL_HTTP_VERSION_2_0) {
+        curlConnStats.http2Requests++;
+    }
+}
+
+static void logCurlConnStats(void) {
+    CurlConnStats stats;
+    getCurlConnStats(&stats);
+
+    double avgHandshakeSecs = (stats.newConnections > 0) ?
+                              (stats.handshakeSecsTotal / (double)stats.newConnections) : 0.0;
+    double reusePct = (stats.totalRequests > 0) ?
+                      (100.0 * (double)stats.reusedConnections / (double)stats.totalRequests) : 0.0;
+
+    TRK_PRINTF("Curl_Conn: requests=%llu, failed=%llu, new_conns=%llu, reused=%llu (%.1f%%), http2=%llu, "
+               "avg_handshake=%.3f s, est_saved=%.3f s",
+               (unsigned long long)stats.totalRequests, (unsigned long long)stats.failedRequests,
+               (unsigned long long)stats.newConnections, (unsigned long long)stats.reusedConnections,
+               reusePct, (unsigned long long)stats.http2Requests, avgHandshakeSecs,
+               avgHandshakeSecs * (double)stats.reusedConnections);
+    if (getUplinkEndpointCount() > 1) {
+        logUplinkEndpoints();
+    }
+}
+
+void getCurlConnStats(CurlConnStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    lock_guard<mutex> lock(curlConnStatsMutex);
+    *stats = curlConnStats;
+}
+
+/* Configure the easy handle for a GET or, when the request carries a body, a POST */
+static bool setCurlRequestMethod(CURL* curl, CloudRequest *req, struct curl_slist **headers) {
+    if (req->heartbeat != nullptr) {
+        string heartbeatHdr = string(HEARTBEAT_HEADER_NAME) + ": " + req->heartbeat;
+        *headers = curl_slist_append(*headers, heartbeatHdr.c_str());
+    }
+
+    /* HTTPGET also clears a NOBODY left over from a probe on this handle */
+    if (req->body == nullptr) {
+        return (curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L) == CURLE_OK &&
+                curl_easy_setopt(curl, CURLOPT_NOBODY, req->headOnly ? 1L : 0L) == CURLE_OK &&
+                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, *headers) == CURLE_OK);
+    }
+
+    if (req->contentType != nullptr) {
+        char contentTypeHdr[128];
+        snprintf(contentTypeHdr, sizeof(contentTypeHdr), "Content-Type: %s", req->contentType);
+        *headers = curl_slist_append(*headers, contentTypeHdr);
+    }
+
+    if (req->contentEncoding != nullptr) {
+        char contentEncodingHdr[64];
+        snprintf(contentEncodingHdr, sizeof(contentEncodingHdr), "Content-Encoding: %s", req->contentEncoding);
+        *headers = curl_slist_append(*headers, contentEncodingHdr);
     }
-    else {
-        long response_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
 
-        if (response_code == 200) {
-            TRK_PRINTF("Curl_Proc %d: Received HTTP 200 OK", curlProcessCount);
+    return (curl_easy_setopt(curl, CURLOPT_NOBODY, 0L) == CURLE_OK &&
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req->body) == CURLE_OK &&
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)req->bodyLen) == CURLE_OK &&
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, *headers) == CURLE_OK);
+}
+
+/* Run up to CURL_MAX_PARALLEL_REQUESTS transfers on the multi handle */
+static int performCloudRequestChunk(CloudRequest *reqs, size_t count) {
+    int failedCount = 0;
+    size_t added = 0;
+    struct curl_slist *reqHeaders[CURL_MAX_PARALLEL_REQUESTS] = {nullptr};
+    bool pending[CURL_MAX_PARALLEL_REQUESTS] = {false};
+
+    for (size_t i = 0; i < count; i++) {
+        if (curlEasyPool[i] == nullptr) {
+            curlEasyPool[i] = createCurlEasyHandle();
+        }
+
+        CURL* curl = curlEasyPool[i];
+        reqs[i].response.clear();
+        reqs[i].hints = CloudResponseHints();
+        if (curl == nullptr || !setCurlRequestMethod(curl, &reqs[i], &reqHeaders[i]) ||
+            curl_easy_setopt(curl, CURLOPT_URL, reqs[i].url) != CURLE_OK ||
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &reqs[i]) != CURLE_OK ||
+            curl_easy_setopt(curl, CURLOPT_HEADERDATA, &reqs[i]) != CURLE_OK ||
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, &reqs[i]) != CURLE_OK ||
+            curl_multi_add_handle(curlMulti, curl) != CURLM_OK) {
+            TRK_PRINTF("Curl_Proc: failed to queue request %zu", i);
+            resetCurlEasyHandle(i);
+            reqs[i].curlCode = CURLE_FAILED_INIT;
+            reqs[i].httpCode = 0;
+            failedCount++;
+            continue;
+        }
+
+        TRK_LOG_DBG("Curl_Proc %d: curl rqst going=%s", ++curlProcessCount, reqs[i].url);
+        pending[i] = true;
+        added++;
+    }
+
+    int stillRunning = (added > 0) ? 1 : 0;
+    while (stillRunning) {
+        CURLMcode mc = curl_multi_perform(curlMulti, &stillRunning);
+        if (mc == CURLM_OK && stillRunning) {
+            mc = curl_multi_poll(curlMulti, nullptr, 0, CURL_MULTI_POLL_TIMEOUT_MSECS, nullptr);
+        }
+        if (mc != CURLM_OK) {
+            TRK_PRINTF("Curl_Proc: curl multi failed: %s", curl_multi_strerror(mc));
+            break;
+        }
+    }
+
+    /* Collect the results of the finished transfers */
+    CURLMsg *msg = nullptr;
+    int msgsLeft = 0;
+    while ((msg = curl_multi_info_read(curlMulti, &msgsLeft)) != nullptr) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        CURL* curl = msg->easy_handle;
+        CloudRequest *req = nullptr;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&req);
+        if (req == nullptr) {
+            continue;
+        }
+
+        pending[req - reqs] = false;
+        req->curlCode = msg->data.result;
+        req->httpCode = 0;
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &req->totalTimeSecs);
+        updateCurlConnStats(curl, msg->data.result);
+
+        if (msg->data.result != CURLE_OK) {
+            TRK_LOG_WARN("Curl_Proc: curl request failed: %s", curl_easy_strerror(msg->data.result));
+            uplinkEndpointReport(req->endpoint, req->curlCode, 0, req->totalTimeSecs);
+            failedCount++;
+            continue;
+        }
+
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &req->httpCode);
+        uplinkEndpointReport(req->endpoint, req->curlCode, req->httpCode, req->totalTimeSecs);
+        heartbeatNoteUplinkLatency(req->totalTimeSecs);
+        metricsObserveNsecs(METRIC_HIST_HTTP_LATENCY, (uint64_t)(req->totalTimeSecs * 1e9));
+        if (req->httpCode == 200) {
+            TRK_LOG_DBG("Curl_Proc: Received HTTP 200 OK");
         }
         else {
-            TRK_PRINTF("Curl_Proc %d: Received HTTP response code: %ld", curlProcessCount, response_code);
+            TRK_LOG_WARN("Curl_Proc: Received HTTP response code: %ld", req->httpCode);
         }
-        //TRK_PRINTF("Curl_Proc: Curl rqst %d successful, Response: %s", curlProcessCount, response_data.c_str());
+
+        /* Print the response data along with timings in one line */
+        TRK_LOG_DBG("Curl_Proc: Response data: %s, Total transfer time: %.3f seconds",
+                    req->response.c_str(), req->totalTimeSecs);
+
+        parseResponseHints(req);
+        uplinkThrottleApplyHints(req->hints);
     }
 
-    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
-    /* Print the response data along with timings in one line */
-    TRK_PRINTF("Curl_Proc %d: Response data: %s, Total transfer time: %.3f seconds", 
-    curlProcessCount, response_data.c_str(), total_time);
+    /* Transfers left unfinished by a multi failure have no result: fail them */
+    for (size_t i = 0; i < count; i++) {
+        if (!pending[i]) {
+            continue;
+        }
+        reqs[i].curlCode = CURLE_ABORTED_BY_CALLBACK;
+        reqs[i].httpCode = 0;
+        reqs[i].totalTimeSecs = 0.0;
+        updateCurlConnStats(curlEasyPool[i], CURLE_ABORTED_BY_CALLBACK);
+        uplinkEndpointReport(reqs[i].endpoint, reqs[i].curlCode, 0, 0.0);
+        failedCount++;
+    }
 
-    return 0;
+    /* Detach the handles but keep them (and their connections) for the next round */
+    for (size_t i = 0; i < count; i++) {
+        if (curlEasyPool[i] != nullptr) {
+            curl_multi_remove_handle(curlMulti, curlEasyPool[i]);
+        }
+        curl_slist_free_all(reqHeaders[i]);
+    }
+
+    return failedCount;
+}
+
+int performCloudRequests(CloudRequest *reqs, size_t count) {
+    if (reqs == nullptr || count == 0) {
+        TRK_LOG_ERR("ERROR: Invalid input params - Cloud requests not sent");
+        return -1;
+    }
+
+    if (!initCurlConnMgr()) {
+        return -1;
+    }
+
+    /* A due heartbeat rides on the first request instead of costing a request of its own */
+    string heartbeatReport;
+    if (reqs[0].heartbeat == nullptr && heartbeatTakeReport(heartbeatReport)) {
+        TRK_PRINTF("Heartbeat: %s", heartbeatReport.c_str());
+        reqs[0].heartbeat = heartbeatReport.c_str();
+    }
+
+    CurlConnStats prevStats;
+    getCurlConnStats(&prevStats);
+    int failedCount = 0;
+    /* The server may ask for fewer parallel requests; re-read per chunk so a hint applies at once */
+    for (size_t offset = 0; offset < count;) {
+        size_t chunk = min(getUplinkConcurrency(), count - offset);
+        failedCount += performCloudRequestChunk(&reqs[offset], chunk);
+        offset += chunk;
+    }
+
+    CurlConnStats stats;
+    getCurlConnStats(&stats);
+    if ((stats.totalRequests / CURL_CONN_STATS_LOG_INTERVAL) !=
+        (prevStats.totalRequests / CURL_CONN_STATS_LOG_INTERVAL)) {
+        logCurlConnStats();
+    }
+
+    if (reqs[0].heartbeat == heartbeatReport.c_str()) {
+        reqs[0].heartbeat = nullptr;
+    }
+    return failedCount;
 }
 
+/*
+    Runs uplink requests on the selected endpoint. Requests that failed there
+    (no response or HTTP 5xx) are sent once more to the next best healthy
+    endpoint, so a failing endpoint does not cost the data a retry backoff.
+    buildUrl(req, idx, endpoint) points req.url at the request's URL for an
+    endpoint and returns false if it could not be built.
+*/
+template <typename BuildUrlFn>
+static int performUplinkRequests(CloudRequest *reqs, size_t count, BuildUrlFn buildUrl) {
+    if (!initCurlConnMgr()) {
+        return -1;
+    }
+
+    int endpoint = uplinkEndpointSelect();
+    for (size_t i = 0; i < count; i++) {
+        reqs[i].endpoint = endpoint;
+        if (!buildUrl(reqs[i], i, endpoint)) {
+            return -1;
+        }
+    }
+
+    int failed = performCloudRequests(reqs, count);
+    int failover = uplinkEndpointSelectFailover(endpoint);
+    if (failed < 0 || failover == UPLINK_ENDPOINT_NONE) {
+        return failed;
+    }
+
+    vector<size_t> retryIdx;
+    vector<CloudRequest> retryReqs;
+    for (size_t i = 0; i < count; i++) {
+        if (isUplinkEndpointFailure(reqs[i].curlCode, reqs[i].httpCode) && buildUrl(reqs[i], i, failover)) {
+            retryIdx.push_back(i);
+            retryReqs.push_back(reqs[i]);
+            retryReqs.back().endpoint = failover;
+        }
+    }
+    if (retryReqs.empty()) {
+        return failed;
+    }
+
+    TRK_PRINTF("Uplink_Endpoint: resending %zu of %zu requests to %s", retryReqs.size(), count,
+               getUplinkEndpointInstance(failover));
+    performCloudRequests(retryReqs.data(), retryReqs.size());
+    failed = 0;
+    for (size_t k = 0; k < retryIdx.size(); k++) {
+        reqs[retryIdx[k]] = retryReqs[k];
+    }
+    for (size_t i = 0; i < count; i++) {
+        failed += (reqs[i].curlCode != CURLE_OK) ? 1 : 0;
+    }
+    return failed;
+}
+
+/* Full data URL for an endpoint; the instance + url_extension prefix is pre-joined by the URL builder */
+static void createEndpointDataUrl(char *urlBuff, const char *packetDataBuff, size_t dataLen, int endpoint) {
+    memset(urlBuff, 0, MAX_URL_LEN);
+    if (buildCloudDataUrl(urlBuff, MAX_URL_LEN, packetDataBuff, dataLen, endpoint) == 0) {
+        createCloudDataUrl(urlBuff, MAX_URL_LEN, getUplinkEndpointInstance(endpoint), urlCfg.urlExtension,
+                           packetDataBuff, dataLen + 1);
+    }
+}
+
+/* Send several data URLs to the cloud, multiplexed on the pooled connection */
+static int sendHttpDataUrls(const char *const *packetDataBuffs, size_t count, long *httpCodes) {
+    vector<array<char, MAX_URL_LEN>> urlBuffs(count);
+    vector<CloudRequest> reqs(count);
+    int failed = performUplinkRequests(reqs.data(), count, [&](CloudRequest &req, size_t i, int endpoint) {
+        urlBuffs[i].fill(0);
+        if (packetDataBuffs[i] != nullptr) {
+            createEndpointDataUrl(urlBuffs[i].data(), packetDataBuffs[i], strlen(packetDataBuffs[i]), endpoint);
+        }
+        req.url = urlBuffs[i].data();
+        return true;
+    });
+    if (httpCodes != nullptr) {
+        for (size_t i = 0; i < count; i++) {
+            httpCodes[i] = reqs[i].httpCode;
+        }
+    }
+    return failed;
+}
+
+const UplinkTransport httpUplinkTransport = {UPLINK_TRANSPORT_HTTP, sendHttpDataUrls, nullptr};
+
+const UplinkTransport *getUplinkTransport(void) {
+    if (uplinkCfg.transport != nullptr && strcmp(uplinkCfg.transport, UPLINK_TRANSPORT_WEBSOCKET) == 0) {
+        return &wsUplinkTransport;
+    }
+    return &httpUplinkTransport;
+}
+
+/* Send several data URLs through the configured transport; what a stream could not deliver goes over HTTP */
+int sendDataUrlsToCloud(const char *const *packetDataBuffs, size_t count, long *httpCodes) {
+    if (packetDataBuffs == nullptr || count == 0) {
+        TRK_LOG_ERR("ERROR: Invalid input params - Send URLs to cloud failed");
+        return -1;
+    }
+
+    const UplinkTransport *transport = getUplinkTransport();
+    if (transport == &httpUplinkTransport) {
+        return sendHttpDataUrls(packetDataBuffs, count, httpCodes);
+    }
+    if (!initCurlConnMgr()) {
+        return -1;
+    }
+
+    vector<long> codes(count, 0);
+    int failed = transport->sendDataUrls(packetDataBuffs, count, codes.data());
+    if (failed > 0) {
+        vector<size_t> retryIdx;
+        vector<const char *> retryBuffs;
+        for (size_t i = 0; i < count; i++) {
+            if (codes[i] == 0 && packetDataBuffs[i] != nullptr) {
+                retryIdx.push_back(i);
+                retryBuffs.push_back(packetDataBuffs[i]);
+            }
+        }
+
+        vector<long> retryCodes(retryBuffs.size(), 0);
+        failed = retryBuffs.empty() ? 0 : sendHttpDataUrls(retryBuffs.data(), retryBuffs.size(), retryCodes.data());
+        for (size_t k = 0; k < retryIdx.size(); k++) {
+            codes[retryIdx[k]] = retryCodes[k];
+        }
+    }
+
+    if (httpCodes != nullptr) {
+        copy(codes.begin(), codes.end(), httpCodes);
+    }
+    return failed;
+}
+
+/* Post a batch of records to the batch URL */
+int postDataBatchToCloud(CloudRequest *req, const char *body, size_t bodyLen, const char *contentType,
+                         const char *contentEncoding) {
+    if (req == nullptr || body == nullptr || bodyLen == 0) {
+        TRK_LOG_ERR("ERROR: Invalid input params - Send batch to cloud failed");
+        return -1;
+    }
+
+    char urlBuff[MAX_URL_LEN];
+    req->body = body;
+    req->bodyLen = bodyLen;
+    req->contentType = contentType;
+    req->contentEncoding = contentEncoding;
+    int failed = performUplinkRequests(req, 1, [&](CloudRequest &r, size_t, int endpoint) {
+        memset(urlBuff, 0, MAX_URL_LEN);
+        if (createBaseUrlLink(urlBuff, MAX_URL_LEN, getUplinkEndpointInstance(endpoint),
+                              uplinkCfg.urlBatchExtension) != 0) {
+            TRK_LOG_ERR("ERROR: Failed to create the batch URL.");
+            return false;
+        }
+        r.url = urlBuff;
+        return true;
+    });
+    req->url = nullptr;
+    return (failed < 0) ? -1 : ((failed == 0) ? 0 : 1);
+}
+
+/* Send a heartbeat report to the alive URL */
+long sendHeartbeatToCloud(const char *report) {
+    if (report == nullptr || report[0] == '\0') {
+        TRK_LOG_ERR("ERROR: Invalid input params - Heartbeat not sent");
+        return -1;
+    }
+
+    char urlBuff[MAX_URL_LEN];
+    CloudRequest req;
+    int failed = performUplinkRequests(&req, 1, [&](CloudRequest &r, size_t, int endpoint) {
+        memset(urlBuff, 0, MAX_URL_LEN);
+        if (createBaseUrlLink(urlBuff, MAX_URL_LEN, getUplinkEndpointInstance(endpoint), urlCfg.urlAlive) != 0 ||
+            addBleDataToBaseUrl(urlBuff, MAX_URL_LEN, "?", 1) != 0 ||
+            addBleDataToBaseUrl(urlBuff, MAX_URL_LEN, report, strlen(report)) != 0) {
+            TRK_LOG_ERR("ERROR: Failed to create the heartbeat URL.");
+            return false;
+        }
+        r.url = urlBuff;
+        return true;
+    });
+    return (failed < 0) ? -1 : req.httpCode;
+}
+
+/* Send the data URL to the cloud */
+int sendDataUrlToCloud(const char *packetDataBuff, size_t packetDataLen) {
+    if (packetDataBuff == nullptr || packetDataLen == 0) {
+        TRK_LOG_ERR("ERROR: Invalid input params - Send URL to cloud failed");
+        return -1;
+    }
+
+    if (getUplinkTransport() != &httpUplinkTransport) {
+        string urlExtension(packetDataBuff, strnlen(packetDataBuff, packetDataLen));
+        const char *urlExtensions[1] = {urlExtension.c_str()};
+        return (sendDataUrlsToCloud(urlExtensions, 1) == 0) ? 0 : 1;
+    }
+
+    char urlBuff[MAX_URL_LEN];
+    CloudRequest req;
+    int failed = performUplinkRequests(&req, 1, [&](CloudRequest &r, size_t, int endpoint) {
+        /* Create the Cloud Data URL that contains the BLE data. */
+        memset(urlBuff, 0, MAX_URL_LEN);
+        createCloudDataUrl(urlBuff, MAX_URL_LEN, getUplinkEndpointInstance(endpoint), urlCfg.urlExtension,
+                           packetDataBuff, packetDataLen);
+        r.url = urlBuff;
+        return true;
+    });
+    return (failed == 0) ? 0 : 1;
+}
+
+/* Probe the endpoints that carried no traffic, or failed, for a probe interval */
+void probeCloudEndpoints(void) {
+    if (!initCurlConnMgr()) {
+        return;
+    }
+
+    int endpoint;
+    while (keepRunning && (endpoint = uplinkEndpointProbeDue()) != UPLINK_ENDPOINT_NONE) {
+        char urlBuff[MAX_URL_LEN];
+        memset(urlBuff, 0, MAX_URL_LEN);
+        if (createBaseUrlLink(urlBuff, MAX_URL_LEN, getUplinkEndpointInstance(endpoint), urlCfg.urlAlive) != 0) {
+            uplinkEndpointReport(endpoint, CURLE_URL_MALFORMAT, 0, 0.0);
+            continue;
+        }
+
+        CloudRequest req;
+        req.url = urlBuff;
+        req.endpoint = endpoint;
+        req.headOnly = true;
+        performCloudRequests(&req, 1);
+    }
+}
+
+void cloudCommCleanup(void) {
+    if (!curlInitialized) {
+        return;
+    }
+
+    const UplinkTransport *transport = getUplinkTransport();
+    if (transport->cleanup != nullptr) {
+        transport->cleanup();
+    }
+    logCurlConnStats();
+    for (size_t i = 0; i < CURL_MAX_PARALLEL_REQUESTS; i++) {
+        resetCurlEasyHandle(i);
+    }
+    curl_multi_cleanup(curlMulti);
+    curl_share_cleanup(curlShare);
+    curl_global_cleanup();
+    curlMulti = nullptr;
+    curlShare = nullptr;
+    curlInitialized = false;
+}
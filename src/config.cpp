@@ -1,11 +1,13 @@
 #include <libconfig.h>
 #include <stdio.h>
 #include <string>
+#include <algorithm>
 #include <stdlib.h>
 #include <limits.h>
 #include "config.h"
 #include "common.h"
 #include "cloudComm.h"
+#include "uplinkTransport.h"
 #include <sys/ioctl.h>
 #include <net/if.h>
 #include <unistd.h>
@@ -19,8 +21,43 @@ bleConnectConfig bleConnectCfg = {0};
 urlConfig urlCfg = {0};
 /* Gateway Config Parameters */
 gatewayConfig gwCfg = {0};
+/* Uplink Config Parameters */
+uplinkConfig uplinkCfg = {0};
+/* Uplink Spool Config Parameters */
+spoolConfig spoolCfg = {0};
+/* Uplink Retry Config Parameters */
+retryConfig retryCfg = {0};
+/* Heartbeat Config Parameters */
+heartbeatConfig heartbeatCfg = {0};
+/* Uplink Throttle Config Parameters */
+throttleConfig throttleCfg = {0};
+/* Uplink Rate Limit Config Parameters */
+rateLimitConfig rateLimitCfg = {0};
+/* Uplink Endpoint Config Parameters */
+endpointConfig endpointCfg = {0};
+/* Metrics Endpoint Config Parameters */
+metricsConfig metricsCfg = {0};
+/* Packet Trace Config Parameters */
+traceConfig traceCfg = {TRACE_DEF_SLOW_MSECS};
+/* Logger Config Parameters */
+logConfig logCfg = {TRK_LOG_LEVEL_INFO, LOG_DEF_RATE_LIMIT};
+/* Tape Configuration Push Parameters */
+configPushConfig configPushCfg;
 
 static char *dupOrNull(const char *str);
+static void readUplinkConfig(config_t *cfg);
+static void readSpoolConfig(config_t *cfg);
+static void readRetryConfig(config_t *cfg);
+static void readHeartbeatConfig(config_t *cfg);
+static void readThrottleConfig(config_t *cfg);
+static void readRateLimitConfig(config_t *cfg);
+static void readEndpointConfig(config_t *cfg);
+static void readMetricsConfig(config_t *cfg);
+static void readTraceConfig(config_t *cfg);
+static void readLogConfig(config_t *cfg);
+static void readBleConnectConfig(config_t *cfg);
+static void readPersistentTapeConfig(config_t *cfg);
+static void readConfigPushConfig(config_t *cfg);
 
 static char *dupOrNull(const char *str) {
     return str ? strdup(str) : NULL;
@@ -58,6 +95,432 @@ char *formatMacAddress(const char *mac) {
     return formattedMac;
 }
 
+/* Read the optional uplink settings, falling back to the defaults when absent */
+static void readUplinkConfig(config_t *cfg) {
+    const char *uplinkMode = nullptr;
+    const char *urlBatchExtension = nullptr;
+    const char *compression = nullptr;
+    const char *transport = nullptr;
+    const char *streamPath = nullptr;
+    int coalesce = UPLINK_DEF_COALESCE;
+
+    uplinkCfg.streamWindow = UPLINK_STREAM_DEF_WINDOW;
+    uplinkCfg.batchMaxRecords = UPLINK_BATCH_DEF_MAX_RECORDS;
+    uplinkCfg.batchMaxBytes = UPLINK_BATCH_DEF_MAX_BYTES;
+    uplinkCfg.batchMaxDelayMsecs = UPLINK_BATCH_DEF_MAX_DELAY_MSECS;
+
+    if (!config_lookup_string(cfg, "uplink_mode", &uplinkMode)) {
+        uplinkMode = UPLINK_MODE_SINGLE;
+    }
+    if (!config_lookup_string(cfg, "url_batch_extension", &urlBatchExtension)) {
+        urlBatchExtension = urlCfg.urlExtension;
+    }
+    config_lookup_int(cfg, "uplink_batch_max_records", &uplinkCfg.batchMaxRecords);
+    config_lookup_int(cfg, "uplink_batch_max_bytes", &uplinkCfg.batchMaxBytes);
+    config_lookup_int(cfg, "uplink_batch_max_delay_ms", &uplinkCfg.batchMaxDelayMsecs);
+    if (!config_lookup_string(cfg, "uplink_compression", &compression)) {
+        compression = "none";
+    }
+    if (!config_lookup_string(cfg, "uplink_transport", &transport)) {
+        transport = UPLINK_TRANSPORT_HTTP;
+    }
+    if (!config_lookup_string(cfg, "uplink_stream_path", &streamPath)) {
+        streamPath = UPLINK_STREAM_DEF_PATH;
+    }
+    config_lookup_int(cfg, "uplink_stream_window", &uplinkCfg.streamWindow);
+    config_lookup_bool(cfg, "uplink_coalesce", &coalesce);
+
+    /* The binary B1 format only exists as a batch body */
+    if (isCurlReqFormatB1() && strcmp(uplinkMode, UPLINK_MODE_BATCH) != 0) {
+        TRK_PRINTF("curl_req_format B1 requires batch uplink, switching uplink_mode to batch");
+        uplinkMode = UPLINK_MODE_BATCH;
+    }
+
+    uplinkCfg.uplinkMode = dupOrNull(uplinkMode);
+    uplinkCfg.compression = dupOrNull(compression);
+    uplinkCfg.urlBatchExtension = dupOrNull(urlBatchExtension);
+    uplinkCfg.transport = dupOrNull(transport);
+    uplinkCfg.streamPath = dupOrNull(streamPath);
+    uplinkCfg.coalesce = (coalesce != 0);
+
+    if (uplinkCfg.batchMaxRecords <= 0) uplinkCfg.batchMaxRecords = UPLINK_BATCH_DEF_MAX_RECORDS;
+    if (uplinkCfg.batchMaxBytes <= 0) uplinkCfg.batchMaxBytes = UPLINK_BATCH_DEF_MAX_BYTES;
+    if (uplinkCfg.batchMaxDelayMsecs < 0) uplinkCfg.batchMaxDelayMsecs = UPLINK_BATCH_DEF_MAX_DELAY_MSECS;
+    if (uplinkCfg.streamWindow <= 0) uplinkCfg.streamWindow = UPLINK_STREAM_DEF_WINDOW;
+
+    TRK_PRINTF("%-25s = %s", "uplink_mode", uplinkCfg.uplinkMode);
+    TRK_PRINTF("%-25s = %s", "uplink_coalesce", uplinkCfg.coalesce ? "true" : "false");
+    if (isUplinkBatchMode()) {
+        TRK_PRINTF("%-25s = %s", "url_batch_extension", uplinkCfg.urlBatchExtension);
+        TRK_PRINTF("%-25s = %d", "uplink_batch_max_records", uplinkCfg.batchMaxRecords);
+        TRK_PRINTF("%-25s = %d", "uplink_batch_max_bytes", uplinkCfg.batchMaxBytes);
+        TRK_PRINTF("%-25s = %d", "uplink_batch_max_delay_ms", uplinkCfg.batchMaxDelayMsecs);
+        TRK_PRINTF("%-25s = %s", "uplink_compression", uplinkCfg.compression);
+    }
+    else {
+        TRK_PRINTF("%-25s = %s", "uplink_transport", uplinkCfg.transport);
+        if (strcmp(uplinkCfg.transport, UPLINK_TRANSPORT_WEBSOCKET) == 0) {
+            TRK_PRINTF("%-25s = %s", "uplink_stream_path", uplinkCfg.streamPath);
+            TRK_PRINTF("%-25s = %d", "uplink_stream_window", uplinkCfg.streamWindow);
+        }
+        else if (strcmp(uplinkCfg.transport, UPLINK_TRANSPORT_HTTP) != 0) {
+            TRK_PRINTF("Unknown uplink_transport %s, readings go over HTTP", uplinkCfg.transport);
+        }
+    }
+}
+
+/* Read the optional spool settings, falling back to the defaults when absent */
+static void readSpoolConfig(config_t *cfg) {
+    const char *spoolDir = nullptr;
+
+    spoolCfg.segmentBytes = SPOOL_DEF_SEGMENT_BYTES;
+    spoolCfg.maxBytes = SPOOL_DEF_MAX_BYTES;
+    spoolCfg.fsyncIntervalMsecs = SPOOL_DEF_FSYNC_INTERVAL_MSECS;
+    spoolCfg.replayRate = SPOOL_DEF_REPLAY_RATE;
+
+    if (!config_lookup_string(cfg, "spool_dir", &spoolDir)) {
+        spoolDir = "";
+    }
+    config_lookup_int(cfg, "spool_segment_bytes", &spoolCfg.segmentBytes);
+    config_lookup_int(cfg, "spool_max_bytes", &spoolCfg.maxBytes);
+    config_lookup_int(cfg, "spool_fsync_interval_ms", &spoolCfg.fsyncIntervalMsecs);
+    config_lookup_int(cfg, "spool_replay_rate", &spoolCfg.replayRate);
+
+    spoolCfg.spoolDir = dupOrNull(spoolDir);
+
+    if (spoolCfg.segmentBytes <= 0) spoolCfg.segmentBytes = SPOOL_DEF_SEGMENT_BYTES;
+    if (spoolCfg.maxBytes < spoolCfg.segmentBytes) spoolCfg.maxBytes = spoolCfg.segmentBytes;
+    if (spoolCfg.fsyncIntervalMsecs <= 0) spoolCfg.fsyncIntervalMsecs = SPOOL_DEF_FSYNC_INTERVAL_MSECS;
+    if (spoolCfg.replayRate <= 0) spoolCfg.replayRate = SPOOL_DEF_REPLAY_RATE;
+
+    if (spoolCfg.spoolDir[0] != '\0') {
+        TRK_PRINTF("%-25s = %s", "spool_dir", spoolCfg.spoolDir);
+        TRK_PRINTF("%-25s = %d", "spool_max_bytes", spoolCfg.maxBytes);
+        TRK_PRINTF("%-25s = %d", "spool_fsync_interval_ms", spoolCfg.fsyncIntervalMsecs);
+        TRK_PRINTF("%-25s = %d", "spool_replay_rate", spoolCfg.replayRate);
+    }
+}
+
+/* Read the optional uplink retry and circuit breaker settings */
+static void readRetryConfig(config_t *cfg) {
+    retryCfg.maxAttempts = RETRY_DEF_MAX_ATTEMPTS;
+    retryCfg.baseMsecs = RETRY_DEF_BASE_MSECS;
+    retryCfg.maxMsecs = RETRY_DEF_MAX_MSECS;
+    retryCfg.queueMax = RETRY_DEF_QUEUE_MAX;
+    retryCfg.breakerThreshold = RETRY_DEF_BREAKER_THRESHOLD;
+    retryCfg.breakerOpenMsecs = RETRY_DEF_BREAKER_OPEN_MSECS;
+    retryCfg.breakerMaxOpenMsecs = RETRY_DEF_BREAKER_MAX_OPEN_MSECS;
+
+    config_lookup_int(cfg, "retry_max_attempts", &retryCfg.maxAttempts);
+    config_lookup_int(cfg, "retry_base_ms", &retryCfg.baseMsecs);
+    config_lookup_int(cfg, "retry_max_ms", &retryCfg.maxMsecs);
+    config_lookup_int(cfg, "retry_queue_max", &retryCfg.queueMax);
+    config_lookup_int(cfg, "breaker_threshold", &retryCfg.breakerThreshold);
+    config_lookup_int(cfg, "breaker_open_ms", &retryCfg.breakerOpenMsecs);
+    config_lookup_int(cfg, "breaker_max_open_ms", &retryCfg.breakerMaxOpenMsecs);
+
+    if (retryCfg.maxAttempts <= 0) retryCfg.maxAttempts = 1;
+    if (retryCfg.baseMsecs <= 0) retryCfg.baseMsecs = RETRY_DEF_BASE_MSECS;
+    if (retryCfg.maxMsecs < retryCfg.baseMsecs) retryCfg.maxMsecs = retryCfg.baseMsecs;
+    if (retryCfg.queueMax < 0) retryCfg.queueMax = 0;
+    if (retryCfg.breakerThreshold <= 0) retryCfg.breakerThreshold = RETRY_DEF_BREAKER_THRESHOLD;
+    if (retryCfg.breakerOpenMsecs <= 0) retryCfg.breakerOpenMsecs = RETRY_DEF_BREAKER_OPEN_MSECS;
+    if (retryCfg.breakerMaxOpenMsecs < retryCfg.breakerOpenMsecs) retryCfg.breakerMaxOpenMsecs = retryCfg.breakerOpenMsecs;
+
+    TRK_PRINTF("%-25s = %d", "retry_max_attempts", retryCfg.maxAttempts);
+    TRK_PRINTF("%-25s = %d", "breaker_threshold", retryCfg.breakerThreshold);
+}
+
+/* Read the optional heartbeat interval settings */
+static void readHeartbeatConfig(config_t *cfg) {
+    heartbeatCfg.intervalSecs = HEARTBEAT_DEF_INTERVAL_SECS;
+    heartbeatCfg.minIntervalSecs = HEARTBEAT_DEF_MIN_INTERVAL_SECS;
+    heartbeatCfg.maxIntervalSecs = HEARTBEAT_DEF_MAX_INTERVAL_SECS;
+
+    config_lookup_int(cfg, "heartbeat_interval_s", &heartbeatCfg.intervalSecs);
+    config_lookup_int(cfg, "heartbeat_min_interval_s", &heartbeatCfg.minIntervalSecs);
+    config_lookup_int(cfg, "heartbeat_max_interval_s", &heartbeatCfg.maxIntervalSecs);
+
+    if (heartbeatCfg.intervalSecs < 0) heartbeatCfg.intervalSecs = 0;
+    if (heartbeatCfg.minIntervalSecs <= 0 || heartbeatCfg.minIntervalSecs > heartbeatCfg.intervalSecs) {
+        heartbeatCfg.minIntervalSecs = heartbeatCfg.intervalSecs;
+    }
+    if (heartbeatCfg.maxIntervalSecs < heartbeatCfg.intervalSecs) heartbeatCfg.maxIntervalSecs = heartbeatCfg.intervalSecs;
+
+    TRK_PRINTF("%-25s = %d", "heartbeat_interval_s", heartbeatCfg.intervalSecs);
+}
+
+static void readThrottleConfig(config_t *cfg) {
+    throttleCfg.tapeReportIntervalSecs = THROTTLE_DEF_REPORT_INTERVAL_SECS;
+    throttleCfg.hintTtlSecs = THROTTLE_DEF_HINT_TTL_SECS;
+    throttleCfg.maxHoldSecs = THROTTLE_DEF_MAX_HOLD_SECS;
+
+    config_lookup_int(cfg, "tape_report_interval_s", &throttleCfg.tapeReportIntervalSecs);
+    config_lookup_int(cfg, "throttle_hint_ttl_s", &throttleCfg.hintTtlSecs);
+    config_lookup_int(cfg, "throttle_max_hold_s", &throttleCfg.maxHoldSecs);
+
+    if (throttleCfg.tapeReportIntervalSecs < 0) throttleCfg.tapeReportIntervalSecs = 0;
+    if (throttleCfg.hintTtlSecs <= 0) throttleCfg.hintTtlSecs = THROTTLE_DEF_HINT_TTL_SECS;
+    if (throttleCfg.maxHoldSecs < 0) throttleCfg.maxHoldSecs = 0;
+
+    TRK_PRINTF("%-25s = %d", "tape_report_interval_s", throttleCfg.tapeReportIntervalSecs);
+}
+
+static void readRateLimitConfig(config_t *cfg) {
+    rateLimitCfg.globalPerMin = RATE_DEF_GLOBAL_PER_MIN;
+    rateLimitCfg.globalBurst = RATE_DEF_GLOBAL_BURST;
+    rateLimitCfg.typePerMin = RATE_DEF_TYPE_PER_MIN;
+    rateLimitCfg.typeBurst = RATE_DEF_TYPE_BURST;
+    rateLimitCfg.tapePerMin = RATE_DEF_TAPE_PER_MIN;
+    rateLimitCfg.tapeBurst = RATE_DEF_TAPE_BURST;
+
+    config_lookup_int(cfg, "uplink_rate_global_per_min", &rateLimitCfg.globalPerMin);
+    config_lookup_int(cfg, "uplink_rate_global_burst", &rateLimitCfg.globalBurst);
+    config_lookup_int(cfg, "uplink_rate_type_per_min", &rateLimitCfg.typePerMin);
+    config_lookup_int(cfg, "uplink_rate_type_burst", &rateLimitCfg.typeBurst);
+    config_lookup_int(cfg, "uplink_rate_tape_per_min", &rateLimitCfg.tapePerMin);
+    config_lookup_int(cfg, "uplink_rate_tape_burst", &rateLimitCfg.tapeBurst);
+
+    if (rateLimitCfg.globalPerMin < 0) rateLimitCfg.globalPerMin = 0;
+    if (rateLimitCfg.typePerMin < 0) rateLimitCfg.typePerMin = 0;
+    if (rateLimitCfg.tapePerMin < 0) rateLimitCfg.tapePerMin = 0;
+    if (rateLimitCfg.globalBurst < 1) rateLimitCfg.globalBurst = 1;
+    if (rateLimitCfg.typeBurst < 1) rateLimitCfg.typeBurst = 1;
+    if (rateLimitCfg.tapeBurst < 1) rateLimitCfg.tapeBurst = 1;
+
+    TRK_PRINTF("%-25s = %d/%d/%d per min", "uplink_rate_limits", rateLimitCfg.globalPerMin, rateLimitCfg.typePerMin,
+               rateLimitCfg.tapePerMin);
+}
+
+static void readEndpointConfig(config_t *cfg) {
+    endpointCfg.failThreshold = ENDPOINT_DEF_FAIL_THRESHOLD;
+    endpointCfg.probeIntervalSecs = ENDPOINT_DEF_PROBE_INTERVAL_SECS;
+    endpointCfg.spreadPct = ENDPOINT_DEF_SPREAD_PCT;
+
+    config_lookup_int(cfg, "endpoint_fail_threshold", &endpointCfg.failThreshold);
+    config_lookup_int(cfg, "endpoint_probe_interval_s", &endpointCfg.probeIntervalSecs);
+    config_lookup_int(cfg, "endpoint_spread_pct", &endpointCfg.spreadPct);
+
+    if (endpointCfg.failThreshold < 1) endpointCfg.failThreshold = 1;
+    if (endpointCfg.probeIntervalSecs < 1) endpointCfg.probeIntervalSecs = ENDPOINT_DEF_PROBE_INTERVAL_SECS;
+    if (endpointCfg.spreadPct < 0) endpointCfg.spreadPct = 0;
+
+    /* The primary instance first, then the alternates, without duplicates */
+    urlCfg.instances.clear();
+    urlCfg.instances.push_back(urlCfg.instance);
+    config_setting_t *alternates = config_lookup(cfg, "instance_alternates");
+    int count = (alternates != NULL) ? config_setting_length(alternates) : 0;
+    for (int i = 0; i < count && urlCfg.instances.size() < UPLINK_MAX_ENDPOINTS; i++) {
+        const char *alternate = config_setting_get_string_elem(alternates, i);
+        if (alternate == NULL || alternate[0] == '\0' || strcmp(alternate, urlCfg.instance) == 0) {
+            continue;
+        }
+        urlCfg.instances.push_back(dupOrNull(alternate));
+        TRK_PRINTF("%-25s = %s", "instance_alternate", alternate);
+    }
+}
+
+/* Read the optional metrics endpoint; absent or empty leaves it disabled */
+static void readMetricsConfig(config_t *cfg) {
+    const char *listen = nullptr;
+    if (!config_lookup_string(cfg, "metrics_listen", &listen)) {
+        listen = METRICS_DEF_LISTEN;
+    }
+    metricsCfg.listen = dupOrNull(listen);
+    if (metricsCfg.listen[0] != '\0') {
+        TRK_PRINTF("%-25s = %s", "metrics_listen", metricsCfg.listen);
+    }
+}
+
+/* Read the optional slow packet trace threshold */
+static void readTraceConfig(config_t *cfg) {
+    if (!config_lookup_int(cfg, "trace_slow_ms", &traceCfg.slowMsecs) || traceCfg.slowMsecs < 0) {
+        traceCfg.slowMsecs = TRACE_DEF_SLOW_MSECS;
+    }
+    TRK_PRINTF("%-25s = %d", "trace_slow_ms", traceCfg.slowMsecs);
+}
+
+/* Read the optional logger settings, falling back to the defaults when absent */
+static void readLogConfig(config_t *cfg) {
+    const char *level = nullptr;
+    if (!config_lookup_string(cfg, "log_level", &level)) {
+        level = LOG_DEF_LEVEL;
+    }
+    logCfg.level = trkLogLevelFromName(level);
+    if (logCfg.level < 0) {
+        TRK_LOG_ERR("ERROR: log_level %s unknown, using %s", level, LOG_DEF_LEVEL);
+        level = LOG_DEF_LEVEL;
+        logCfg.level = trkLogLevelFromName(level);
+    }
+    if (!config_lookup_int(cfg, "log_rate_limit", &logCfg.rateLimit) || logCfg.rateLimit < 0) {
+        logCfg.rateLimit = LOG_DEF_RATE_LIMIT;
+    }
+    TRK_PRINTF("%-25s = %s", "log_level", level);
+    TRK_PRINTF("%-25s = %d", "log_rate_limit", logCfg.rateLimit);
+}
+
+/* Read the optional BLE connection engine settings, falling back to the defaults when absent */
+static void readBleConnectConfig(config_t *cfg) {
+    const char *logCharUuid = nullptr;
+    const char *coexPolicy = nullptr;
+    int connectEnabled = 0;
+
+    bleConnectCfg.maxParallelConnects = BLE_CONN_DEF_MAX_PARALLEL;
+    bleConnectCfg.connectTimeoutMsecs = BLE_CONN_DEF_TIMEOUT_MSECS;
+    bleConnectCfg.backoffBaseMsecs = BLE_CONN_DEF_BACKOFF_BASE_MSECS;
+    bleConnectCfg.backoffMaxMsecs = BLE_CONN_DEF_BACKOFF_MAX_MSECS;
+    bleConnectCfg.logReadTimeoutMsecs = BLE_LOG_DEF_READ_TIMEOUT_MSECS;
+    bleConnectCfg.coexPeriodMsecs = BLE_COEX_DEF_PERIOD_MSECS;
+    bleConnectCfg.coexConnectWindowMsecs = BLE_COEX_DEF_CONNECT_WINDOW_MSECS;
+    bleConnectCfg.coexMaxPauseMsecs = BLE_COEX_DEF_MAX_PAUSE_MSECS;
+    bleConnectCfg.coexRotateSecs = BLE_COEX_DEF_ROTATE_SECS;
+
+    config_lookup_bool(cfg, "ble_connect_enable", &connectEnabled);
+    config_lookup_int(cfg, "ble_connect_max_parallel", &bleConnectCfg.maxParallelConnects);
+    config_lookup_int(cfg, "ble_connect_timeout_ms", &bleConnectCfg.connectTimeoutMsecs);
+    config_lookup_int(cfg, "ble_connect_backoff_base_ms", &bleConnectCfg.backoffBaseMsecs);
+    config_lookup_int(cfg, "ble_connect_backoff_max_ms", &bleConnectCfg.backoffMaxMsecs);
+    if (!config_lookup_string(cfg, "ble_log_char_uuid", &logCharUuid)) {
+        logCharUuid = BLE_LOG_DEF_CHAR_UUID;
+    }
+    config_lookup_int(cfg, "ble_log_read_timeout_ms", &bleConnectCfg.logReadTimeoutMsecs);
+    if (!config_lookup_string(cfg, "ble_coex_policy", &coexPolicy)) {
+        coexPolicy = BLE_COEX_DEF_POLICY;
+    }
+    config_lookup_int(cfg, "ble_coex_period_ms", &bleConnectCfg.coexPeriodMsecs);
+    config_lookup_int(cfg, "ble_coex_connect_window_ms", &bleConnectCfg.coexConnectWindowMsecs);
+    config_lookup_int(cfg, "ble_coex_max_pause_ms", &bleConnectCfg.coexMaxPauseMsecs);
+    config_lookup_int(cfg, "ble_coex_rotate_s", &bleConnectCfg.coexRotateSecs);
+    bleConnectCfg.connectEnabled = (connectEnabled != 0);
+    bleConnectCfg.logCharUuid = dupOrNull(logCharUuid);
+    bleConnectCfg.coexPolicy = dupOrNull(coexPolicy);
+
+    if (bleConnectCfg.maxParallelConnects < 1) bleConnectCfg.maxParallelConnects = 1;
+    if (bleConnectCfg.connectTimeoutMsecs <= 0) bleConnectCfg.connectTimeoutMsecs = BLE_CONN_DEF_TIMEOUT_MSECS;
+    if (bleConnectCfg.backoffBaseMsecs <= 0) bleConnectCfg.backoffBaseMsecs = BLE_CONN_DEF_BACKOFF_BASE_MSECS;
+    if (bleConnectCfg.backoffMaxMsecs < bleConnectCfg.backoffBaseMsecs) {
+        bleConnectCfg.backoffMaxMsecs = bleConnectCfg.backoffBaseMsecs;
+    }
+    if (bleConnectCfg.logReadTimeoutMsecs <= 0) bleConnectCfg.logReadTimeoutMsecs = BLE_LOG_DEF_READ_TIMEOUT_MSECS;
+    if (bleConnectCfg.coexPeriodMsecs <= 0) bleConnectCfg.coexPeriodMsecs = BLE_COEX_DEF_PERIOD_MSECS;
+    if (bleConnectCfg.coexConnectWindowMsecs <= 0) bleConnectCfg.coexConnectWindowMsecs = 1;
+    if (bleConnectCfg.coexConnectWindowMsecs > bleConnectCfg.coexPeriodMsecs) {
+        bleConnectCfg.coexConnectWindowMsecs = bleConnectCfg.coexPeriodMsecs;
+    }
+    if (bleConnectCfg.coexMaxPauseMsecs < 0) bleConnectCfg.coexMaxPauseMsecs = 0;
+    if (bleConnectCfg.coexRotateSecs <= 0) bleConnectCfg.coexRotateSecs = BLE_COEX_DEF_ROTATE_SECS;
+
+    TRK_PRINTF("%-25s = %s", "ble_connect_enable", bleConnectCfg.connectEnabled ? "true" : "false");
+
+    TRK_PRINTF("%-25s = %d", "ble_connect_max_parallel", bleConnectCfg.maxParallelConnects);
+    TRK_PRINTF("%-25s = %d", "ble_connect_timeout_ms", bleConnectCfg.connectTimeoutMsecs);
+    TRK_PRINTF("%-25s = %d", "ble_connect_backoff_base_ms", bleConnectCfg.backoffBaseMsecs);
+    TRK_PRINTF("%-25s = %d", "ble_connect_backoff_max_ms", bleConnectCfg.backoffMaxMsecs);
+    TRK_PRINTF("%-25s = %s", "ble_log_char_uuid", bleConnectCfg.logCharUuid);
+    TRK_PRINTF("%-25s = %d", "ble_log_read_timeout_ms", bleConnectCfg.logReadTimeoutMsecs);
+    TRK_PRINTF("%-25s = %s", "ble_coex_policy", bleConnectCfg.coexPolicy);
+}
+
+/* Read the tapes to keep connected and their connection parameters; a tape not yet listed becomes connectable */
+static void readPersistentTapeConfig(config_t *cfg) {
+    config_setting_t *persistentTapes = config_lookup(cfg, "ble_persistent_tapes");
+    int count = (persistentTapes != NULL) ? config_setting_length(persistentTapes) : 0;
+
+    for (int i = 0; i < count; i++) {
+        config_setting_t *entry = config_setting_get_elem(persistentTapes, i);
+        const char *mac = NULL;
+        int intervalMsecs = 0;
+        int latency = 0;
+        int timeoutMsecs = 0;
+        if (entry == NULL || !config_setting_lookup_string(entry, "mac", &mac)) {
+            continue;
+        }
+        std::string macAddr = mac;
+        formatMacAddrStr(macAddr);
+        if (macAddr.empty()) continue;
+
+        config_setting_lookup_int(entry, "conn_interval_ms", &intervalMsecs);
+        config_setting_lookup_int(entry, "conn_latency", &latency);
+        config_setting_lookup_int(entry, "supervision_timeout_ms", &timeoutMsecs);
+        if (intervalMsecs != 0) {
+            intervalMsecs = std::max(BLE_CONN_INTERVAL_MIN_MSECS, std::min(intervalMsecs, BLE_CONN_INTERVAL_MAX_MSECS));
+        }
+        latency = std::max(0, std::min(latency, BLE_CONN_LATENCY_MAX));
+        if (timeoutMsecs != 0) {
+            timeoutMsecs = std::max(BLE_SUPERVISION_TIMEOUT_MIN_MSECS,
+                                    std::min(timeoutMsecs, BLE_SUPERVISION_TIMEOUT_MAX_MSECS));
+            /* The link must survive the events the tape may skip: timeout > (1 + latency) * interval * 2 */
+            int minTimeoutMsecs = (1 + latency) * intervalMsecs * 2 + 10;
+            if (timeoutMsecs < minTimeoutMsecs) {
+                timeoutMsecs = std::min(minTimeoutMsecs, BLE_SUPERVISION_TIMEOUT_MAX_MSECS);
+            }
+        }
+
+        auto &tape = bleConnectCfg.tapeList[macAddr];
+        if (!tape) {
+            tape = std::make_unique<tapeConfig>(macAddr, 0, false, false, 0, 0);
+        }
+        tape->persistent = true;
+        tape->connIntervalMsecs = (uint16_t)intervalMsecs;
+        tape->connLatency = (uint16_t)latency;
+        tape->supervisionTimeoutMsecs = (uint16_t)timeoutMsecs;
+        TRK_PRINTF("BLE Persistent ID: %s interval=%d ms latency=%d timeout=%d ms", macAddr.c_str(), intervalMsecs,
+                   latency, timeoutMsecs);
+    }
+}
+
+/* Read the configuration push job; a target not yet listed becomes connectable for the push alone */
+static void readConfigPushConfig(config_t *cfg) {
+    const char *charUuid = nullptr;
+    const char *value = nullptr;
+    const char *stateFile = nullptr;
+
+    configPushCfg.maxAttempts = BLE_PUSH_DEF_MAX_ATTEMPTS;
+    if (!config_lookup_string(cfg, "ble_config_push_char_uuid", &charUuid)) {
+        charUuid = BLE_PUSH_DEF_CHAR_UUID;
+    }
+    if (!config_lookup_string(cfg, "ble_config_push_value", &value)) {
+        value = "";
+    }
+    if (!config_lookup_string(cfg, "ble_config_push_state_file", &stateFile)) {
+        stateFile = BLE_PUSH_DEF_STATE_FILE;
+    }
+    config_lookup_int(cfg, "ble_config_push_max_attempts", &configPushCfg.maxAttempts);
+    configPushCfg.charUuid = dupOrNull(charUuid);
+    configPushCfg.value = dupOrNull(value);
+    configPushCfg.stateFile = dupOrNull(stateFile);
+    if (configPushCfg.maxAttempts < 1) configPushCfg.maxAttempts = 1;
+    if (configPushCfg.value[0] == '\0') {
+        return;
+    }
+
+    config_setting_t *targets = config_lookup(cfg, "ble_config_push_targets");
+    int count = (targets != NULL) ? config_setting_length(targets) : 0;
+    for (int i = 0; i < count; i++) {
+        const char *mac = config_setting_get_string_elem(targets, i);
+        if (mac == nullptr) continue;
+        std::string macAddr = mac;
+        formatMacAddrStr(macAddr);
+        if (macAddr.empty()) continue;
+
+        auto &tape = bleConnectCfg.tapeList[macAddr];
+        if (!tape) {
+            tape = std::make_unique<tapeConfig>(macAddr, 0, false, false, 0, 0);
+            tape->configPushOnly = true;
+        }
+        configPushCfg.targets.push_back(macAddr);
+    }
+
+    TRK_PRINTF("%-25s = %s", "ble_config_push_char_uuid", configPushCfg.charUuid);
+    TRK_PRINTF("%-25s = %zu bytes", "ble_config_push_value", strlen(configPushCfg.value) / 2);
+    TRK_PRINTF("%-25s = %zu tapes", "ble_config_push_targets", configPushCfg.targets.size());
+    TRK_PRINTF("%-25s = %s", "ble_config_push_state_file", configPushCfg.stateFile);
+    TRK_PRINTF("%-25s = %d", "ble_config_push_max_attempts", configPushCfg.maxAttempts);
+    if (!bleConnectCfg.connectEnabled) {
+        TRK_PRINTF("ble_config_push_value is set but ble_connect_enable is false: the push does not run");
+    }
+}
+
 int readSysConfigFile(void) {
     config_t cfg;
     config_init(&cfg);
@@ -117,6 +580,18 @@ int readSysConfigFile(void) {
 		TRK_PRINTF("%-25s = %s", "gwLon", gwCfg.gwLon);
 		TRK_PRINTF("%-25s = %d", "read_tape_again_delay", bleConnectCfg.readTapeAgainDelaySecs);
 
+        readUplinkConfig(&cfg);
+        readSpoolConfig(&cfg);
+        readRetryConfig(&cfg);
+        readHeartbeatConfig(&cfg);
+        readThrottleConfig(&cfg);
+        readRateLimitConfig(&cfg);
+        readEndpointConfig(&cfg);
+        readMetricsConfig(&cfg);
+        readTraceConfig(&cfg);
+        readLogConfig(&cfg);
+        readBleConnectConfig(&cfg);
+
         if (connectable_tape == NULL)
 		{
 			fprintf(stderr, "Error: 'connectable_tape' not found in the configuration file.\n");
@@ -141,6 +616,8 @@ int readSysConfigFile(void) {
             bleConnectCfg.tapeList[macAddr] = std::make_unique<tapeConfig>(macAddr, 0, false, false, 0, 0);
             TRK_PRINTF("BLE Connectable ID: %s", bleConnectCfg.tapeList[macAddr]->macAddr.c_str());
 		}
+        readPersistentTapeConfig(&cfg);
+        readConfigPushConfig(&cfg);
 		TRK_PRINTF("=======================================================================================");
     }
 	else
@@ -209,4 +686,18 @@ bool isCurlReqFormatG1(void) {
         return true;
     }
     return false;
+}
+
+bool isCurlReqFormatB1(void) {
+    if (gwCfg.curlReqFormat != nullptr && strcmp(gwCfg.curlReqFormat, "B1") == 0) {
+        return true;
+    }
+    return false;
+}
+
+bool isUplinkBatchMode(void) {
+    if (uplinkCfg.uplinkMode != nullptr && strcmp(uplinkCfg.uplinkMode, UPLINK_MODE_BATCH) == 0) {
+        return true;
+    }
+    return false;
 }
\ No newline at end of file
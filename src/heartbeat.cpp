@@ -0,0 +1,248 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/socket.h>
+#include "common.h"
+#include "config.h"
+#include "cloudComm.h"
+#include "heartbeat.h"
+#include "uplinkRetry.h"
+#include "uplinkSpool.h"
+
+#ifdef SO_MEMINFO
+#include <linux/sock_diag.h>
+#endif
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static bool heartbeatEnabled = false;
+static uint64_t heartbeatStartMsecs = 0;
+static uint64_t heartbeatIntervalStartMsecs = 0;
+static uint64_t heartbeatDueMsecs = 0;
+static uint32_t heartbeatIntervalMsecs = 0;
+static uint32_t heartbeatCount = 0;
+
+/* Pipeline counters, updated by the scan and cloud threads */
+static atomic<uint64_t> advertsSeen(0);
+static atomic<uint64_t> advertsDuplicate(0);
+static atomic<uint64_t> packetsQueued(0);
+static atomic<size_t> queueDepth(0);
+static atomic<size_t> queueDepthPeak(0);
+static atomic<uint64_t> kernelDropsClosed(0);
+static atomic<uint64_t> kernelDropsOpen(0);
+static atomic<uint32_t> scanSocketReads(0);
+
+/* Values at the start of the current interval */
+static uint64_t prevAdvertsSeen = 0;
+static uint64_t prevAdvertsDuplicate = 0;
+static uint64_t prevPacketsQueued = 0;
+static uint64_t prevKernelDrops = 0;
+
+/* Latency samples of the current interval (ring buffer once full) */
+static mutex latencyMutex;
+static vector<uint32_t> latencySamplesMsecs;
+static uint64_t latencySampleCount = 0;
+
+static uint32_t getPercentile(vector<uint32_t> &samples, uint32_t percent);
+static void scheduleNextHeartbeat(uint64_t nowMsecs, bool busy, bool unhealthy);
+
+/* ----------------- Function Definitions ---------------------- */
+void heartbeatInit(void) {
+    heartbeatEnabled = (heartbeatCfg.intervalSecs > 0 && urlCfg.urlAlive != nullptr && urlCfg.urlAlive[0] != '\0');
+    heartbeatStartMsecs = getMonotonicTimeMsecs();
+    heartbeatIntervalStartMsecs = heartbeatStartMsecs;
+    heartbeatIntervalMsecs = (uint32_t)heartbeatCfg.intervalSecs * 1000u;
+    heartbeatDueMsecs = heartbeatStartMsecs + heartbeatIntervalMsecs;
+    latencySamplesMsecs.reserve(HEARTBEAT_LATENCY_SAMPLES);
+}
+
+bool isHeartbeatEnabled(void) {
+    return heartbeatEnabled;
+}
+
+void heartbeatNoteAdvert(bool unique) {
+    advertsSeen.fetch_add(1, memory_order_relaxed);
+    if (!unique) {
+        advertsDuplicate.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void heartbeatNotePacketQueued(size_t depth) {
+    packetsQueued.fetch_add(1, memory_order_relaxed);
+    heartbeatNoteQueueDepth(depth);
+}
+
+void heartbeatNoteQueueDepth(size_t depth) {
+    queueDepth.store(depth, memory_order_relaxed);
+    size_t peak = queueDepthPeak.load(memory_order_relaxed);
+    while (depth > peak && !queueDepthPeak.compare_exchange_weak(peak, depth, memory_order_relaxed)) {
+    }
+}
+
+void heartbeatNoteUplinkLatency(double totalTimeSecs) {
+    uint32_t latencyMsecs = (uint32_t)(totalTimeSecs * 1000.0 + 0.5);
+
+    lock_guard<mutex> lock(latencyMutex);
+    if (latencySamplesMsecs.size() < HEARTBEAT_LATENCY_SAMPLES) {
+        latencySamplesMsecs.push_back(latencyMsecs);
+    }
+    else {
+        latencySamplesMsecs[latencySampleCount % HEARTBEAT_LATENCY_SAMPLES] = latencyMsecs;
+    }
+    latencySampleCount++;
+}
+
+void heartbeatSampleKernelDrops(int fd, bool closing) {
+    if (fd < 0) {
+        return;
+    }
+
+    /* Reading the counter is a syscall, only sample every few hundred reads */
+    if (!closing && (scanSocketReads.fetch_add(1, memory_order_relaxed) % HEARTBEAT_DROP_SAMPLE_READS) != 0) {
+        return;
+    }
+
+#ifdef SO_MEMINFO
+    uint32_t memInfo[SK_MEMINFO_VARS] = {0};
+    socklen_t memInfoLen = sizeof(memInfo);
+    if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, memInfo, &memInfoLen) != 0 ||
+        memInfoLen <= SK_MEMINFO_DROPS * sizeof(uint32_t)) {
+        return;
+    }
+
+    /* Events the kernel dropped because the socket receive queue was full */
+    uint64_t drops = memInfo[SK_MEMINFO_DROPS];
+    if (closing) {
+        kernelDropsClosed.fetch_add(drops, memory_order_relaxed);
+        kernelDropsOpen.store(0, memory_order_relaxed);
+        scanSocketReads.store(0, memory_order_relaxed);
+    }
+    else {
+        kernelDropsOpen.store(drops, memory_order_relaxed);
+    }
+#endif
+}
+
+bool heartbeatIsDue(void) {
+    return (heartbeatEnabled && getMonotonicTimeMsecs() >= heartbeatDueMsecs);
+}
+
+uint32_t heartbeatMsecsUntilStandalone(void) {
+    if (!heartbeatEnabled) {
+        return UINT32_MAX;
+    }
+
+    uint64_t standaloneMsecs = heartbeatDueMsecs + HEARTBEAT_PIGGYBACK_GRACE_MSECS;
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    uint32_t untilMsecs = (nowMsecs >= standaloneMsecs) ? 0 : (uint32_t)(standaloneMsecs - nowMsecs);
+    /* An open circuit breaker holds the heartbeat back until its next probe */
+    return max(untilMsecs, uplinkCircuitMsecsUntilProbe());
+}
+
+/* Caller owns samples; reorders it */
+static uint32_t getPercentile(vector<uint32_t> &samples, uint32_t percent) {
+    if (samples.empty()) {
+        return 0;
+    }
+
+    size_t idx = ((samples.size() - 1) * percent + 50u) / 100u;
+    nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return samples[idx];
+}
+
+static void scheduleNextHeartbeat(uint64_t nowMsecs, bool busy, bool unhealthy) {
+    uint32_t baseMsecs = (uint32_t)heartbeatCfg.intervalSecs * 1000u;
+    uint32_t minMsecs = (uint32_t)heartbeatCfg.minIntervalSecs * 1000u;
+    uint32_t maxMsecs = (uint32_t)heartbeatCfg.maxIntervalSecs * 1000u;
+
+    if (unhealthy) {
+        heartbeatIntervalMsecs = minMsecs;
+    }
+    else if (busy) {
+        heartbeatIntervalMsecs = baseMsecs;
+    }
+    else {
+        /* Nothing to report, back off towards the max interval */
+        heartbeatIntervalMsecs = min(max(heartbeatIntervalMsecs, baseMsecs) * 2u, maxMsecs);
+    }
+
+    heartbeatIntervalStartMsecs = nowMsecs;
+    heartbeatDueMsecs = nowMsecs + heartbeatIntervalMsecs;
+}
+
+bool heartbeatTakeReport(string &report) {
+    if (!heartbeatIsDue()) {
+        return false;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    double intervalSecs = (double)(nowMsecs - heartbeatIntervalStartMsecs) / 1000.0;
+    if (intervalSecs <= 0.0) {
+        intervalSecs = 1.0;
+    }
+
+    uint64_t seen = advertsSeen.load(memory_order_relaxed);
+    uint64_t duplicate = advertsDuplicate.load(memory_order_relaxed);
+    uint64_t queued = packetsQueued.load(memory_order_relaxed);
+    uint64_t kernelDrops = kernelDropsClosed.load(memory_order_relaxed) + kernelDropsOpen.load(memory_order_relaxed);
+    uint64_t seenDelta = seen - prevAdvertsSeen;
+    uint64_t queuedDelta = queued - prevPacketsQueued;
+    uint64_t kernelDropsDelta = (kernelDrops >= prevKernelDrops) ? (kernelDrops - prevKernelDrops) : 0;
+    double dedupRatio = (seenDelta > 0) ? (double)(duplicate - prevAdvertsDuplicate) / (double)seenDelta : 0.0;
+    prevAdvertsSeen = seen;
+    prevAdvertsDuplicate = duplicate;
+    prevPacketsQueued = queued;
+    prevKernelDrops = kernelDrops;
+
+    vector<uint32_t> samples;
+    {
+        lock_guard<mutex> lock(latencyMutex);
+        samples.swap(latencySamplesMsecs);
+        latencySamplesMsecs.reserve(HEARTBEAT_LATENCY_SAMPLES);
+        latencySampleCount = 0;
+    }
+    uint32_t p50Msecs = getPercentile(samples, 50);
+    uint32_t p99Msecs = getPercentile(samples, 99);
+
+    size_t depthPeak = queueDepthPeak.exchange(queueDepth.load(memory_order_relaxed), memory_order_relaxed);
+    UplinkRetryStats retryStats;
+    getUplinkRetryStats(&retryStats);
+
+    char reportBuff[320];
+    snprintf(reportBuff, sizeof(reportBuff),
+             "gw=%s&seq=%u&up=%llu&int=%.0f&q=%zu&qmax=%zu&pps=%.2f&dedup=%.3f&p50=%u&p99=%u&n=%zu"
+             "&kdrop=%llu&kdrop_total=%llu&rq=%zu&circ=%d&spool=%d",
+             getGwId(), ++heartbeatCount, (unsigned long long)((nowMsecs - heartbeatStartMsecs) / 1000u),
+             intervalSecs, queueDepth.load(memory_order_relaxed), depthPeak, (double)queuedDelta / intervalSecs,
+             dedupRatio, p50Msecs, p99Msecs, samples.size(), (unsigned long long)kernelDropsDelta,
+             (unsigned long long)kernelDrops, retryStats.queued, (int)retryStats.circuitState,
+             uplinkSpoolHasBacklog() ? 1 : 0);
+    report = reportBuff;
+
+    bool unhealthy = (kernelDropsDelta > 0 || retryStats.circuitState != UPLINK_CIRCUIT_CLOSED || retryStats.queued > 0);
+    scheduleNextHeartbeat(nowMsecs, queuedDelta > 0, unhealthy);
+    return true;
+}
+
+void heartbeatProcess(void) {
+    if (heartbeatMsecsUntilStandalone() != 0) {
+        return;
+    }
+
+    /* The heartbeat goes through the circuit breaker like data, and may be its probe */
+    if (!heartbeatIsDue() || !uplinkCircuitAllowRequest()) {
+        return;
+    }
+
+    string report;
+    heartbeatTakeReport(report);
+    TRK_PRINTF("Heartbeat: %s", report.c_str());
+    long httpCode = sendHeartbeatToCloud(report.c_str());
+    uplinkCircuitReport(classifyUplinkResponse(httpCode < 0 ? 0 : httpCode));
+}
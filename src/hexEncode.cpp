@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "hexEncode.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HEX_ENCODE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HEX_ENCODE_NEON
+#endif
+
+/* ----------------- Static Functions and Variables ---------------------- */
+/* Both digits of every byte value, generated at compile time */
+typedef struct HexPairTable {
+    char pairs[512];
+    constexpr HexPairTable() : pairs() {
+        const char digits[] = "0123456789ABCDEF";
+        for (int i = 0; i < 256; i++) {
+            pairs[2 * i] = digits[i >> 4];
+            pairs[2 * i + 1] = digits[i & 0x0F];
+        }
+    }
+} HexPairTable;
+
+static constexpr HexPairTable hexPairTable;
+
+static inline char *hexEncodeTable(char *out, const uint8_t *bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        memcpy(out, &hexPairTable.pairs[2u * bytes[i]], 2);
+        out += 2;
+    }
+    return out;
+}
+
+#if defined(HEX_ENCODE_SSE2)
+/* Nibbles (0..15) to ASCII: '0' + n, plus 7 more for 'A'..'F' */
+static inline __m128i hexDigitsSse2(__m128i nibbles) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8(7));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+static inline void hexSplitSse2(__m128i v, __m128i *hi, __m128i *lo) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    *hi = hexDigitsSse2(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    *lo = hexDigitsSse2(_mm_and_si128(v, mask));
+}
+#elif defined(HEX_ENCODE_NEON)
+static inline uint8x16_t hexDigitsNeon(uint8x16_t nibbles) {
+    uint8x16_t letters = vandq_u8(vcgtq_u8(nibbles, vdupq_n_u8(9)), vdupq_n_u8(7));
+    return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')), letters);
+}
+
+static inline uint8x8_t hexDigitsNeon8(uint8x8_t nibbles) {
+    uint8x8_t letters = vand_u8(vcgt_u8(nibbles, vdup_n_u8(9)), vdup_n_u8(7));
+    return vadd_u8(vadd_u8(nibbles, vdup_n_u8('0')), letters);
+}
+#endif
+
+/* ----------------- Function Definitions ---------------------- */
+char *hexEncodeUpper(char *out, const uint8_t *bytes, size_t len) {
+#if defined(HEX_ENCODE_SSE2)
+    __m128i hi, lo;
+    for (; len >= 16; len -= 16, bytes += 16, out += 32) {
+        hexSplitSse2(_mm_loadu_si128((const __m128i *)bytes), &hi, &lo);
+        /* Interleave: high digit first */
+        _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    if (len >= 8) {
+        hexSplitSse2(_mm_loadl_epi64((const __m128i *)bytes), &hi, &lo);
+        _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(hi, lo));
+        len -= 8;
+        bytes += 8;
+        out += 16;
+    }
+#elif defined(HEX_ENCODE_NEON)
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    for (; len >= 16; len -= 16, bytes += 16, out += 32) {
+        uint8x16_t v = vld1q_u8(bytes);
+        uint8x16x2_t digits = {{hexDigitsNeon(vshrq_n_u8(v, 4)), hexDigitsNeon(vandq_u8(v, mask))}};
+        /* Interleaving store: high digit first */
+        vst2q_u8((uint8_t *)out, digits);
+    }
+    if (len >= 8) {
+        uint8x8_t v = vld1_u8(bytes);
+        uint8x8x2_t digits = {{hexDigitsNeon8(vshr_n_u8(v, 4)), hexDigitsNeon8(vand_u8(v, vdup_n_u8(0x0F)))}};
+        vst2_u8((uint8_t *)out, digits);
+        len -= 8;
+        bytes += 8;
+        out += 16;
+    }
+#endif
+    return hexEncodeTable(out, bytes, len);
+}
+
+char *hexEncodeUpperScalar(char *out, const uint8_t *bytes, size_t len) {
+    return hexEncodeTable(out, bytes, len);
+}
+
+void hexEncodeBdaddr(char *out, const uint8_t *bdaddr) {
+    /* ba2str() prints the most significant byte first */
+    for (int i = 5; i >= 0; i--) {
+        memcpy(out, &hexPairTable.pairs[2u * bdaddr[i]], 2);
+        out += 2;
+    }
+    *out = '\0';
+}
+
+const char *getHexEncodeImpl(void) {
+#if defined(HEX_ENCODE_SSE2)
+    return "sse2";
+#elif defined(HEX_ENCODE_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -13,9 +13,11 @@
 #include <iomanip>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <vector>
 #include <thread>
+#include <chrono>
+#include <algorithm>
+#include <unordered_set>
 #include <cstdlib>
 #include <csignal>
 #include "ble.h"
@@ -23,14 +25,30 @@
 #include "cloudComm.h"
 #include "tapeFormat.h"
 #include "config.h"
+#include "uplinkBatch.h"
+#include "uplinkSpool.h"
+#include "uplinkRetry.h"
+#include "heartbeat.h"
+#include "bleConnSched.h"
+#include "bleArbiter.h"
+#include "urlBuilder.h"
+#include "hexEncode.h"
+#include "uplinkThrottle.h"
+#include "uplinkRateLimit.h"
+#include "uplinkEndpoint.h"
+#include "uplinkQueue.h"
+#include "metrics.h"
+#include "pktTrace.h"
 
 using namespace std;
 
 /* Global variables */
-queue<BleDataPacket> bleDataQueue;
+/* Guards the uplink queue (uplinkQueue.h) */
 mutex bleQueueMutex;
 condition_variable bleQueueCondVar;
 std::atomic<bool> keepRunning(true);
+/* Last signal that asked the program to exit, logged by main() */
+static volatile sig_atomic_t exitSignal = 0;
 
 struct BleScanOptions {
     volatile bool continuous = false;
@@ -104,12 +122,12 @@ void hciDevReset() {
     hciDevUp();
 }
 
-static bool setScanFilters(int fd) {
+static bool setScanFilters(int fd, uint16_t scanWindow) {
     uint8_t le_type = 0x00;
     // 40ms scan interval
-    uint16_t le_scan_interval = htobs(0x0040);
-    // 30ms scan window
-    uint16_t le_scan_window = htobs(0x0030);
+    uint16_t le_scan_interval = htobs(BLE_COEX_SCAN_INTERVAL);
+    // 30ms scan window at full duty, less while connects need the radio
+    uint16_t le_scan_window = htobs(scanWindow);
     // Public device address
     uint8_t le_own_bdaddr_type = 0x00;
     // No whitelist filtering — scan all devices
@@ -118,7 +136,7 @@ static bool setScanFilters(int fd) {
     int ret = hci_le_set_scan_parameters(fd, le_type, le_scan_interval, le_scan_window, le_own_bdaddr_type, le_filter,
                                          BLE_SCAN_TIME_INTERVALS_SEC);
     if (ret < 0) {
-        TRK_PRINTF("ERROR: Set scan parameters: %s", strerror(errno));
+        TRK_LOG_ERR("ERROR: Set scan parameters: %s", strerror(errno));
         return false;
     }
 
@@ -132,7 +150,7 @@ static bool configureHciFilter(int fd) {
     hci_filter_set_event(EVT_LE_META_EVENT, &filter);
 
     if (setsockopt(fd, SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) < 0) {
-        TRK_PRINTF("ERROR: Failed to set HCI socket filter: %s", strerror(errno));
+        TRK_LOG_ERR("ERROR: Failed to set HCI socket filter: %s", strerror(errno));
         return false;
     }
 
@@ -146,7 +164,7 @@ static bool enableDisableBleScan(int fd, bool enable) {
 
     int ret = hci_le_set_scan_enable(fd, le_scan_enable, le_scan_filter_dup, scan_time);
     if (ret < 0) {
-        TRK_PRINTF("ERROR: %s ble scan failed: %s", enable ? "Enable" : "Disable", strerror(errno));
+        TRK_LOG_ERR("ERROR: %s ble scan failed: %s", enable ? "Enable" : "Disable", strerror(errno));
         return false;
     }
 
@@ -157,26 +175,50 @@ static bool enableDisableBleScan(int fd, bool enable) {
     return true;
 }
 
+/*
+ * Apply the scan/connect arbiter's scan mode to the running scan. The commands go through ctlFd, a second
+ * HCI socket, as hci_send_req() would otherwise read and drop the advertising reports queued on the scan
+ * socket. The scan parameters can only change while the scan is disabled.
+ */
+static bool applyBleScanMode(int ctlFd, BleScanMode mode) {
+    if (hci_le_set_scan_enable(ctlFd, 0x00, 0x01, BLE_SCAN_TIME_INTERVALS_SEC) < 0) {
+        TRK_LOG_ERR("ERROR: Disable ble scan failed: %s", strerror(errno));
+        return false;
+    }
+    if (mode == BLE_SCAN_MODE_PAUSED) {
+        return true;
+    }
+
+    uint16_t scanWindow = (mode == BLE_SCAN_MODE_REDUCED) ? BLE_COEX_REDUCED_SCAN_WINDOW : BLE_COEX_FULL_SCAN_WINDOW;
+    if (!setScanFilters(ctlFd, scanWindow) ||
+        hci_le_set_scan_enable(ctlFd, 0x01, 0x01, BLE_SCAN_TIME_INTERVALS_SEC) < 0) {
+        TRK_LOG_ERR("ERROR: Set ble scan mode %d failed: %s", (int)mode, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 static bool initBleScan(int &fd) {
     for (uint8_t retry_count = 0; retry_count < BLE_SCAN_INIT_RETRY_LIMIT; retry_count++) {
         fd = hci_open_dev(HCI_DEV_ID);
         if (fd < 0) {
-            TRK_PRINTF("ERROR: Opening HCI device: %s", strerror(errno));
+            TRK_LOG_ERR("ERROR: Opening HCI device: %s", strerror(errno));
             SLEEP_MSECS(100);
             hciDevReset();
             continue;
         }
 
         if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
-            TRK_PRINTF("ERROR: Setting O_NONBLOCK failed: %s", strerror(errno));
+            TRK_LOG_ERR("ERROR: Setting O_NONBLOCK failed: %s", strerror(errno));
             close(fd);
             hciDevReset();
             SLEEP_MSECS(100);
             continue;
         }
 
-        if (!configureHciFilter(fd) || !setScanFilters(fd) || !enableDisableBleScan(fd, true)) {
-            TRK_PRINTF("ERROR: BLE scan setup failed, retry: %s", strerror(errno));
+        if (!configureHciFilter(fd) || !setScanFilters(fd, BLE_COEX_FULL_SCAN_WINDOW) ||
+            !enableDisableBleScan(fd, true)) {
+            TRK_LOG_ERR("ERROR: BLE scan setup failed, retry: %s", strerror(errno));
             close(fd);
             hciDevReset();
             SLEEP_MSECS(100);
@@ -186,13 +228,13 @@ static bool initBleScan(int &fd) {
         return true;
     }
 
-    TRK_PRINTF("ERROR: BLE scan init failed after all retries");
+    TRK_LOG_ERR("ERROR: BLE scan init failed after all retries");
     return false;
 }
 
 bool startBleScan(BleScanOptions &options) {
     if (bleScanState.load() != BLE_SCAN_STATE_IDLE) {
-        TRK_PRINTF("ERROR: Scan in progress");
+        TRK_LOG_ERR("ERROR: Scan in progress");
         return false;
     }
 
@@ -204,7 +246,7 @@ bool startBleScan(BleScanOptions &options) {
 
 bool stopBleScan() {
     if (bleScanState.load() != BLE_SCAN_STATE_SCANNING) {
-        TRK_PRINTF("ERROR: Scan already stopped");
+        TRK_LOG_ERR("ERROR: Scan already stopped");
         return true;
     }
 
@@ -294,22 +336,9 @@ e_QuartzEventFlag UpdateEventFlagForQuartz(uint8_t evt_flag) {
     }
 }
 
-/* Helper function */
-static void removeChar(char *str, char target) {
-    char *src = str, *dst = str;
-
-    while (*src) {
-        if (*src != target) {
-            *dst++ = *src;
-        }
-        src++;
-    }
-    *dst = '\0';
-}
-
 device_type_t getBleDataSource(le_advertising_info *info) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR: Invalid input parameters - BLE source could not be determined!");
+        TRK_LOG_ERR("ERROR: Invalid input parameters - BLE source could not be determined!");
         return DEVICE_TYPE_UNKNOWN;
     }
 
@@ -379,16 +408,11 @@ device_type_t getBleDataSource(le_advertising_info *info) {
 
 bool isValidWhiteTapeBleSource(le_advertising_info *info, device_type_t& deviceType) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR: Null Ptr - BLE source check failed!");
+        TRK_LOG_ERR("ERROR: Null Ptr - BLE source check failed!");
         return false;
     }
 
     deviceType = getBleDataSource(info);
-    char macAddr[20];
-    memset(macAddr, 0, sizeof(macAddr));
-    ba2str(&info->bdaddr, macAddr);
-    removeChar(macAddr,':');
-
     return ((deviceType == DEVICE_TYPE_WHITE) && (isBleRssiInRange(info->data[info->length]) == true));
 }
 
@@ -398,15 +422,14 @@ bool isValidWhiteTapeBleSource(le_advertising_info *info, device_type_t& deviceT
 void checkAndUpdateBleStats(le_advertising_info *info, map<string, BleScanRecord> &scanResult, device_type_t deviceType) {
 
     if (info == nullptr) {
-        TRK_PRINTF("ERROR: Null Ptr - Cannot check and update BLE stats");
+        TRK_LOG_ERR("ERROR: Null Ptr - Cannot check and update BLE stats");
         return;
     }
 
     /* Get the MAC address */
     char mac_addr[20];
     memset(mac_addr, 0, sizeof(mac_addr));
-    ba2str(&info->bdaddr, mac_addr);
-    removeChar(mac_addr,':');
+    hexEncodeBdaddr(mac_addr, info->bdaddr.b);
     int8_t tapeRssi = getTapeRssi(info);
 
     auto it = scanResult.find(mac_addr);
@@ -442,125 +465,71 @@ void printBlePacketData(BleDataPacket *bleData) {
     */
 }
 
-int createBleDataUrlExtension(char *urlDataBuff, size_t urlDataBuffLen, BleDataPacket *blePkt) {
-    if (urlDataBuff == nullptr || urlDataBuffLen < 128 || blePkt == nullptr) {
-        TRK_PRINTF("ERROR: Invalid input parameters, BLE data URL extension creation failed!");
-        return -1;
+/* Queue a spooled packet for the cloud thread */
+static void queueBleDataPacket(BleDataPacket& bleDataPkt) {
+    pktTraceStampNow(&bleDataPkt.trace, PKT_STAGE_ENQUEUE);
+
+    BleDataPacket superseded;
+    bool replaced = false;
+    {
+        lock_guard<mutex> lock(bleQueueMutex);
+        replaced = uplinkQueuePush(bleDataPkt, &superseded);
+        heartbeatNotePacketQueued(uplinkQueueDepth());
+        metricsCounterAdd(METRIC_PACKETS_QUEUED, 1);
+        metricsGaugeSet(METRIC_GAUGE_QUEUE_DEPTH, (int64_t)uplinkQueueDepth());
+        bleQueueCondVar.notify_one();
     }
-    static int seqNumber[QuartzSensor_Max] = {0};
-    uint8_t *rBuff = blePkt->bleBuff;
-    memset(urlDataBuff, 0, urlDataBuffLen);
-
-    switch(blePkt->blePktType) {
-        case QuartzSensor_TMP117: {
-            BlePacket_QuartzTMP117 *bleTmp117 = &blePkt->blePktStrct.blePkt_TMP117;
-            if (isCurlReqFormatG1() == true) {
-                snprintf(urlDataBuff, urlDataBuffLen, 
-                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
-                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
-                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
-                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
-                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_TMP117], bleTmp117->mac_addr,
-                getGwId(), time(nullptr), bleTmp117->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
-            }
-            else {
-                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
-                "&e0=%d&t0=%.2f&t1=%.2f&t1ts=%d&t2=%.2f&t2ts=%d&pid=%d&seqId=%d&tapeId=0x%04X"
-                "&bat=%.3f&clat=%s&clon=%s&st=5258", getGwId(), ++seqNumber[QuartzSensor_TMP117],
-                bleTmp117->mac_addr, getGwId(), bleTmp117->t0_ts, bleTmp117->rssi, bleTmp117->evt_flag,
-                bleTmp117->t0, bleTmp117->t1, bleTmp117->t1_ts, bleTmp117->t2, bleTmp117->t2_ts,
-                bleTmp117->pid, bleTmp117->seqId, bleTmp117->tapeId, bleTmp117->bat, gwCfg.gwLat, gwCfg.gwLon);
-            }
-            return URL_CREATE_SUCCESS;
-        }
-        case QuartzSensor_OPT3110: {
-            BlePacket_QuartzOPT3110 *bleOpt3110 = &blePkt->blePktStrct.blePkt_OPT3110;
-            if (isCurlReqFormatG1() == true) {
-                snprintf(urlDataBuff, urlDataBuffLen, 
-                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
-                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
-                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
-                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
-                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_OPT3110], bleOpt3110->mac_addr,
-                getGwId(), time(nullptr), bleOpt3110->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
-            }
-            else {
-                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
-                "&e0=%d&t0=%.2f&l0=%d&l0ts=%d&l1=%d&l1ts=%d&pid=%d&lbat=%.2f&seqId=%d"
-                "&tapeId=0x%04X&bat=%.3f&clat=%s&clon=%s&st=5258", getGwId(), ++seqNumber[QuartzSensor_OPT3110],
-                bleOpt3110->mac_addr, getGwId(), bleOpt3110->t0_ts, bleOpt3110->rssi, bleOpt3110->evt_flag,
-                bleOpt3110->t0, bleOpt3110->l0, bleOpt3110->l0_ts, bleOpt3110->l1, bleOpt3110->l1_ts, bleOpt3110->pid,
-                (((float)bleOpt3110->lime_bat)/100.0f), bleOpt3110->seqId, bleOpt3110->tapeId, bleOpt3110->bat,
-                gwCfg.gwLat, gwCfg.gwLon, getGwId());
-            }
-            return URL_CREATE_SUCCESS;
-        }
-        case QuartzSensor_IAT: {
-            BlePacket_IAT *bleIAT = &blePkt->blePktStrct.blePkt_IAT;
-            if (isCurlReqFormatG1() == true) {
-                snprintf(urlDataBuff, urlDataBuffLen, 
-                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
-                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
-                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
-                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
-                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_IAT], bleIAT->mac_addr,
-                getGwId(), time(nullptr), bleIAT->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
-            }
-            else {
-                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
-                "&e0=%d&t0=%.2f&t1=%.2f&l0=%d&l0ts=%d&a0v=%d&a0c=%d&tapeId=0x%04X"
-                "&bat=%.3f&clat=%s&clon=%s&st=5258", getGwId(), ++seqNumber[QuartzSensor_IAT],
-                bleIAT->mac_addr, getGwId(), bleIAT->t1_ts, bleIAT->rssi, bleIAT->evt_flag, bleIAT->t0, bleIAT->t1,
-                bleIAT->l0, bleIAT->l0_ts, bleIAT->a0_val, bleIAT->a0_count, bleIAT->tapeId,
-                bleIAT->bat, gwCfg.gwLat, gwCfg.gwLon);
-            }
-            return URL_CREATE_SUCCESS;
-        }
-        case QuartzSensor_DPD: {
-            BlePacket_DPD *bleDPD = &blePkt->blePktStrct.blePkt_DPD;
-            if (isCurlReqFormatG1() == true) {
-                snprintf(urlDataBuff, urlDataBuffLen, 
-                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
-                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
-                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
-                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
-                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_DPD], bleDPD->macId,
-                getGwId(), time(nullptr), bleDPD->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
-            }
-            else {
-                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
-                "&e0=%d&t0=%.2f&l0=%d&l0ts=%d&tapeId=0x%04X" "&bat=%.3f&clat=%s&clon=%s&st=5258",
-                getGwId(), ++seqNumber[QuartzSensor_DPD], bleDPD->macId, getGwId(), bleDPD->ts,
-                bleDPD->rssi, bleDPD->evtFlag, bleDPD->t0, bleDPD->l0, bleDPD->l0Ts, bleDPD->tapeId,
-                bleDPD->bat, gwCfg.gwLat, gwCfg.gwLon);
-            }
-            return URL_CREATE_SUCCESS;
-        }
-        default: {
-            return -2;
-        }
+
+    if (replaced) {
+        /* The newer reading took its place in the queue, do not replay the stale one from the spool */
+        uplinkSpoolAck(superseded.spoolId, true);
     }
 }
 
 void sendBleDataPacket(BleDataPacket& bleDataPkt) {
-    lock_guard<mutex> lock(bleQueueMutex);
-    bleDataQueue.push(bleDataPkt);
-    bleQueueCondVar.notify_one();
+    /* Store the packet before it is held or queued so that it survives a crash or a cloud outage */
+    bleDataPkt.sendAttempts = 0;
+    uplinkSpoolAppend(bleDataPkt);
+
+    /* Over the rate limits the packet is held (and coalesced) until the cloud thread releases it */
+    BleDataPacket superseded;
+    UplinkRateVerdict verdict = uplinkRateLimitAdmit(bleDataPkt, &superseded);
+    if (verdict == UPLINK_RATE_ADMITTED) {
+        queueBleDataPacket(bleDataPkt);
+    }
+    else if (verdict == UPLINK_RATE_SPILLED) {
+        /* Too many held already, hand the record back to the spool replay */
+        uplinkSpoolAck(bleDataPkt.spoolId, false);
+    }
+    /* The newer reading took the held one's place, do not replay the stale one from the spool */
+    uplinkSpoolAck(superseded.spoolId, true);
+}
+
+/* Queue the held packets whose rate limit buckets have refilled */
+static void releaseRateLimitedPackets(void) {
+    vector<BleDataPacket> blePkts;
+    if (uplinkRateLimitRelease(blePkts) > 0) {
+        for (auto &blePkt : blePkts) {
+            queueBleDataPacket(blePkt);
+        }
+    }
 }
 
 static inline void getScannedBleMacAddress(le_advertising_info *info, char *macAddr, uint8_t macAddrSize) {
     if (info == nullptr) {
         return;
     }
+    if (macAddrSize <= HEX_ENCODE_MAC_STR_LEN) {
+        return;
+    }
     memset(macAddr, 0, macAddrSize);
-    ba2str(&info->bdaddr, macAddr);
-    removeChar(macAddr,':');
+    hexEncodeBdaddr(macAddr, info->bdaddr.b);
 }
 
 /* Run the dups logic */
 bool isNotDuplicateBleData(le_advertising_info *info, map<string, BleScanRecord> &scanResult) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR: Null ptr, Cannot run redundancy checks for this BLE packet!");
+        TRK_LOG_ERR("ERROR: Null ptr, Cannot run redundancy checks for this BLE packet!");
         return false;
     }
     
@@ -578,21 +547,20 @@ bool isNotDuplicateBleData(le_advertising_info *info, map<string, BleScanRecord>
     auto it = scanResult.find(mac_addr);
     /* Check if the white tape has been scanned before or not */
     if (it == scanResult.end()) {
-        TRK_PRINTF("ERROR: Scanned white tape MAC: %s not saved in the database!", mac_addr);
+        TRK_LOG_ERR("ERROR: Scanned white tape MAC: %s not saved in the database!", mac_addr);
         return false;
     }
 
-    /* Note_SK: save the packet processing frequency/ period in the sysConfig.ini file later */
     /* The BLE data for any white tape will be processed further only if it passes both the conditions listed below:
-       1. Last prcoessed time is greater than 30 seconds.
+       1. Last prcoessed time is greater than the report interval (tape_report_interval_s, or the server's hint).
        2. BLE data is different than the last processed scan data.
     */
-    if ((time(nullptr) - it->second.lastProcTimeSecs > 30) &&
+    if ((time(nullptr) - it->second.lastProcTimeSecs > (time_t)getTapeReportIntervalSecs()) &&
         (memcmp(it->second.lastProcBleData, &info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX], WHITE_TAPE_DATA_PACKET_LEN) != 0)) {     
         /* Update the tape scan record with the new processing time and the BLE data */
         it->second.lastProcTimeSecs = time(nullptr);
         memcpy(it->second.lastProcBleData, &info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX], WHITE_TAPE_DATA_PACKET_LEN);
-        TRK_PRINTF("BLE: Dups check passed for MAC: %s, processing BLE data ...", mac_addr);
+        TRK_LOG_DBG("BLE: Dups check passed for MAC: %s, processing BLE data ...", mac_addr);
         return true;    
     }
 
@@ -602,7 +570,6 @@ bool isNotDuplicateBleData(le_advertising_info *info, map<string, BleScanRecord>
 /* BLE Thread Function */
 void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
     int fd = -1;
-    uint32_t elapsedSec = 0;
     int ret = 0;
     const uint8_t retry_delay_sec = 5;
     const uint8_t init_retry_log_throttle_sec = 30;
@@ -623,7 +590,7 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
     while (keepRunning) {
         ret = initBleScan(fd);
         if ((ret == 0) || (fd < 0)) {
-            TRK_PRINTF("ERROR: Failed to init ble scan after retries %d", init_retry_log_throttle_sec);
+            TRK_LOG_ERR("ERROR: Failed to init ble scan after retries %d", init_retry_log_throttle_sec);
             SLEEP_SECS(retry_delay_sec);
             continue;
         }
@@ -631,20 +598,40 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
         /* Set the parameters for scanning the */
         startContinuousScan(bleScanTime, bleSleepTime);
 
-        elapsedSec = 0;
         TRK_PRINTF("BLE Scan started for: %d seconds", scanOptions.scanDurationSec);
 
-        while (elapsedSec < scanOptions.scanDurationSec && keepRunning) {
+        /* Follow the arbiter's scan mode while connects share the controller */
+        int ctlFd = bleConnectCfg.connectEnabled ? hci_open_dev(HCI_DEV_ID) : -1;
+        BleScanMode appliedMode = BLE_SCAN_MODE_FULL;
+        uint64_t scanStartMsecs = getMonotonicTimeMsecs();
+        uint64_t busyStartMsecs = bleArbiterBusyMsecs();
+        uint32_t elapsedMsecs = 0;
+        while (elapsedMsecs < scanOptions.scanDurationSec * 1000u && keepRunning) {
             if (scanStopRequested.load()) {
                 break;
             }
 
-            SLEEP_SECS(1);
-            elapsedSec++;
+            if (ctlFd >= 0 && bleArbiterScanMode() != appliedMode) {
+                appliedMode = bleArbiterScanMode();
+                applyBleScanMode(ctlFd, appliedMode);
+            }
+            SLEEP_MSECS(BLE_COEX_SCAN_POLL_MSECS);
+            elapsedMsecs += BLE_COEX_SCAN_POLL_MSECS;
         }
+        if (ctlFd >= 0) {
+            if (appliedMode != BLE_SCAN_MODE_FULL) {
+                applyBleScanMode(ctlFd, BLE_SCAN_MODE_FULL);
+            }
+            hci_close_dev(ctlFd);
+        }
+        uint64_t scanMsecs = getMonotonicTimeMsecs() - scanStartMsecs;
+        uint64_t busyMsecs = bleArbiterBusyMsecs() - busyStartMsecs;
 
         TRK_PRINTF("Ble scan completed");
 
+        /* Distinct tapes heard in this cycle, the arbiter's measure of advert loss */
+        unordered_set<uint64_t> tapesHeard;
+
         uint8_t buf[HCI_MAX_EVENT_SIZE];
         while (keepRunning) {
             /* Struct to send over BLE packet data to the cloud communication thread */
@@ -656,12 +643,15 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
 
             memset(buf, 0, sizeof(buf));
             len = read(fd, buf, sizeof(buf));
+            heartbeatSampleKernelDrops(fd, false);
             if (len <= 0) {
                 break;
             } 
-            else if (len < HCI_EVENT_HDR_SIZE) {
+            uint64_t captureNsecs = pktTraceNowNsecs();
+            metricsCounterAdd(METRIC_HCI_EVENTS_READ, 1);
+            if (len < HCI_EVENT_HDR_SIZE) {
                 // incrementBleMetrics(BLE_METRIC_NUM_SCAN_ERRORS);
-                TRK_PRINTF("ERROR: Failed to read from hci");
+                TRK_LOG_ERR("ERROR: Failed to read from hci");
                 break;
             }
 
@@ -677,34 +667,54 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
 
             /* Check if the data received is for the Quartz White Tape */
             if (isValidWhiteTapeBleSource(info, deviceType) == false) {
+                metricsCounterAdd(METRIC_ADVERTS_OTHER, 1);
                 continue;
             }
+            metricsCounterAdd(METRIC_ADVERTS_WHITE_TAPE, 1);
+            uint64_t classifyNsecs = pktTraceNowNsecs();
+
+            uint64_t tapeAddr = 0;
+            memcpy(&tapeAddr, &info->bdaddr, sizeof(info->bdaddr));
+            tapesHeard.insert(tapeAddr);
 
             /* Check if the scanned tape is in the connectable BLE list */
-            //checkIfConnectableTape(info);
+            if (bleConnectCfg.connectEnabled) {
+                checkIfConnectableTape(info);
+            }
 
             /* Check and update the BLE stats for the white tape. */
             checkAndUpdateBleStats(info, scanResults, deviceType);
             
             /* Check and process the BLE data only if it passes the dups logic test. */
-            if (isNotDuplicateBleData(info, scanResults) == false) {
+            bool isNewBleData = isNotDuplicateBleData(info, scanResults);
+            heartbeatNoteAdvert(isNewBleData);
+            if (isNewBleData == false) {
+                metricsCounterAdd(METRIC_ADVERTS_DUPLICATE, 1);
                 continue;
             }
+            uint64_t dedupNsecs = pktTraceNowNsecs();
 
-            TRK_PRINTF("DBG1: Reached here after the dups check");
+            TRK_LOG_DBG("DBG1: Reached here after the dups check");
 
             /* Parse the BLE data based on the tape ID and create packet for sending data to the cloud */
+            uint64_t parseStartNsecs = metricsNowNsecs();
             parseBleDataPacket(info, &blePacketData);
+            uint64_t parseEndNsecs = metricsNowNsecs();
+            metricsObserveNsecs(METRIC_HIST_PARSE, parseEndNsecs - parseStartNsecs);
+            pktTraceBegin(&blePacketData.trace, captureNsecs);
+            pktTraceStamp(&blePacketData.trace, PKT_STAGE_CLASSIFY, classifyNsecs);
+            pktTraceStamp(&blePacketData.trace, PKT_STAGE_DEDUP, dedupNsecs);
+            pktTraceStamp(&blePacketData.trace, PKT_STAGE_PARSE, parseEndNsecs);
 
             /* Send the data to the cloud, create a queue and add data to it. 
                Cloud communication thread can communicate with the cloud and 
                send the data. */
             if (blePacketData.blePktType == QuartzSensor_TMP117) {
                 char *tapeMacAddr = blePacketData.blePktStrct.blePkt_TMP117.mac_addr;
-                TRK_PRINTF("Scanned MAC: %s", tapeMacAddr);
+                TRK_LOG_DBG("Scanned MAC: %s", tapeMacAddr);
                 if ((strcmp(tapeMacAddr, "DF0F73928136") == 0) || (strcmp(tapeMacAddr,"E897D628F980") == 0) ||
                     (strcmp(tapeMacAddr, "D0BA19AEF118") == 0) || (strcmp(tapeMacAddr,"C373E3BEC170") == 0)) {
-                    TRK_PRINTF("Sending TMP117 BLE packet for MAC:%s ...", tapeMacAddr);
+                    TRK_LOG_DBG("Sending TMP117 BLE packet for MAC:%s ...", tapeMacAddr);
                     sendBleDataPacket(blePacketData);
                 }
             //}
@@ -713,6 +723,9 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
                 blePacketData_OPT3110.blePktType = QuartzSensor_OPT3110;
                 blePacketData_IAT.blePktType = QuartzSensor_IAT;
                 blePacketData_DPD.blePktType = QuartzSensor_DPD;
+                blePacketData_OPT3110.trace = blePacketData.trace;
+                blePacketData_IAT.trace = blePacketData.trace;
+                blePacketData_DPD.trace = blePacketData.trace;
                 uint8_t tBuff[sizeof(le_advertising_info) + 256] = {0};
                 char *tapeMacAddrOpt3110 = blePacketData.blePktStrct.blePkt_OPT3110.mac_addr;
                 char *tapeMacAddrIat = blePacketData.blePktStrct.blePkt_IAT.mac_addr;
@@ -748,7 +761,7 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
                 tinfo->data[31] = 59;
                 tinfo->length = 31;
                 parseBleDataPacket(tinfo, &blePacketData_OPT3110);
-                TRK_PRINTF("Sending OPT3110 BLE packet for MAC:%s ...", tapeMacAddrOpt3110);
+                TRK_LOG_DBG("Sending OPT3110 BLE packet for MAC:%s ...", tapeMacAddrOpt3110);
                 sendBleDataPacket(blePacketData_OPT3110);
 
                 /* Create IAT info data */
@@ -780,7 +793,7 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
                 tinfo->data[31] = 60;
                 tinfo->length = 31;
                 parseBleDataPacket(tinfo, &blePacketData_IAT);
-                TRK_PRINTF("Sending IAT BLE packet for MAC:%s ...", tapeMacAddrIat);
+                TRK_LOG_DBG("Sending IAT BLE packet for MAC:%s ...", tapeMacAddrIat);
                 sendBleDataPacket(blePacketData_IAT);
 
                 /* Create DPD info data */
@@ -812,12 +825,17 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
                 tinfo->data[31] = 61;
                 tinfo->length = 31;
                 parseBleDataPacket(tinfo, &blePacketData_DPD);
-                TRK_PRINTF("Sending DPD BLE packet for MAC:%s ...", tapeMacAddrDpd);
+                TRK_LOG_DBG("Sending DPD BLE packet for MAC:%s ...", tapeMacAddrDpd);
                 sendBleDataPacket(blePacketData_DPD);
             }
         }
 
+        if (bleConnectCfg.connectEnabled) {
+            bleArbiterNoteScanCycle(scanMsecs, busyMsecs, tapesHeard.size());
+        }
+
         enableDisableBleScan(fd, false);
+        heartbeatSampleKernelDrops(fd, true);
         close(fd);
 
         if (isBleContScanEnabled() == false) {
@@ -833,42 +851,240 @@ void bleScanThreadFunc(uint32_t bleScanTime, uint32_t bleSleepTime) {
     }
 }
 
+/* Pipeline acknowledgement for every uplink record, sent on its own or as part of a batch */
+static void onUplinkRecordAck(const BleDataPacket &blePkt, UplinkResult result) {
+    static uint32_t ackedCount = 0;
+    static uint32_t rejectedCount = 0;
+
+    switch (result) {
+        case UPLINK_RESULT_ACKED:
+            uplinkSpoolAck(blePkt.spoolId, true);
+            pktTraceFinish(blePkt);
+            ackedCount++;
+            break;
+        case UPLINK_RESULT_RETRY:
+            uplinkRetryDefer(blePkt, true);
+            break;
+        case UPLINK_RESULT_REJECTED:
+        default:
+            /* Resending will not help, do not keep it in the spool */
+            uplinkSpoolAck(blePkt.spoolId, true);
+            rejectedCount++;
+            TRK_PRINTF("Uplink_Ack: record type %d rejected (acked=%u, rejected=%u)",
+                       blePkt.blePktType, ackedCount, rejectedCount);
+            break;
+    }
+}
+
+/* Send up to CURL_MAX_PARALLEL_REQUESTS packets one GET request each, multiplexed on the pooled connection */
+static void sendSingleUplinkPackets(vector<BleDataPacket> &blePkts) {
+    char dataBuffs[CURL_MAX_PARALLEL_REQUESTS][256] = {{0}};
+    const char *urlExtensions[CURL_MAX_PARALLEL_REQUESTS] = {nullptr};
+    BleDataPacket *sentPkts[CURL_MAX_PARALLEL_REQUESTS] = {nullptr};
+    long httpCodes[CURL_MAX_PARALLEL_REQUESTS] = {0};
+    size_t urlCount = 0;
+    for (auto &blePkt : blePkts) {
+        if (urlCount >= CURL_MAX_PARALLEL_REQUESTS) {
+            break;
+        }
+        /* Create the URL externsion that contains the BLE data */
+        uint64_t buildStartNsecs = metricsNowNsecs();
+        int urlCreateStatus = createBleDataUrlExtension(dataBuffs[urlCount], sizeof(dataBuffs[urlCount]), &blePkt);
+        uint64_t buildEndNsecs = metricsNowNsecs();
+        metricsObserveNsecs(METRIC_HIST_URL_BUILD, buildEndNsecs - buildStartNsecs);
+        if (urlCreateStatus == URL_CREATE_SUCCESS) {
+            pktTraceStamp(&blePkt.trace, PKT_STAGE_URL_BUILD, buildEndNsecs);
+            urlExtensions[urlCount] = dataBuffs[urlCount];
+            sentPkts[urlCount] = &blePkt;
+            urlCount++;
+        }
+        else {
+            //TRK_LOG_ERR("ERROR: Failed to create URL for BLE packet, Status: %d", urlCreateStatus);
+            /* The packet can never be sent, do not keep it in the spool */
+            uplinkSpoolAck(blePkt.spoolId, true);
+        }
+    }
+
+    if (urlCount == 0) {
+        return;
+    }
+
+    if (!uplinkCircuitAllowRequest()) {
+        for (size_t i = 0; i < urlCount; i++) {
+            uplinkRetryDefer(*sentPkts[i], false);
+        }
+        return;
+    }
+
+    /* Send the Data URLs to the cloud */
+    uint64_t sendNsecs = pktTraceNowNsecs();
+    for (size_t i = 0; i < urlCount; i++) {
+        pktTraceStamp(&sentPkts[i]->trace, PKT_STAGE_SEND, sendNsecs);
+    }
+    sendDataUrlsToCloud(urlExtensions, urlCount, httpCodes);
+    UplinkResult circuitResult = UPLINK_RESULT_RETRY;
+    for (size_t i = 0; i < urlCount; i++) {
+        UplinkResult result = classifyUplinkResponse(httpCodes[i]);
+        onUplinkRecordAck(*sentPkts[i], result);
+        if (result != UPLINK_RESULT_RETRY) {
+            circuitResult = result;
+        }
+    }
+    /* The endpoint is alive if any of the multiplexed requests got a definitive answer */
+    uplinkCircuitReport(circuitResult);
+}
+
+/* Add a packet to the uplink batch and post the batch once a flush limit is hit */
+static void addBatchUplinkPacket(BleDataPacket &blePkt) {
+    bool added = false;
+    if (uplinkBatchUsesBinary()) {
+        added = uplinkBatchAddPacket(blePkt);
+    }
+    else {
+        char dataBuff[256] = {0};
+        /* Each text batch record is the same G1/formatted string, without the leading '?' */
+        uint64_t buildStartNsecs = metricsNowNsecs();
+        int urlCreateStatus = createBleDataUrlExtension(dataBuff, sizeof(dataBuff), &blePkt);
+        metricsObserveSince(METRIC_HIST_URL_BUILD, buildStartNsecs);
+        if (urlCreateStatus == URL_CREATE_SUCCESS) {
+            added = uplinkBatchAddRecord(&dataBuff[1], strlen(&dataBuff[1]), blePkt);
+        }
+    }
+
+    if (!added) {
+        /* The packet can never be sent, do not keep it in the spool */
+        uplinkSpoolAck(blePkt.spoolId, true);
+    }
+
+    if (uplinkBatchIsDue()) {
+        uplinkBatchFlush();
+    }
+}
+
+/* Send packets through the configured uplink mode */
+static void uplinkBlePackets(vector<BleDataPacket> &blePkts, bool batchMode) {
+    if (!batchMode) {
+        sendSingleUplinkPackets(blePkts);
+        return;
+    }
+
+    for (auto &blePkt : blePkts) {
+        addBatchUplinkPacket(blePkt);
+    }
+}
+
+/* Drain the BLE data queue into the uplink. While the circuit is open or the server holds requests
+   back the readings stay in the queue, where routine ones keep coalescing, instead of piling up in
+   the retry queue and the spool. */
+static void processUplinkQueue(unique_lock<mutex> &lock, bool batchMode) {
+    while (uplinkQueueDepth() > 0 && uplinkCircuitMsecsUntilProbe() == 0) {
+        /* Fetch up to getUplinkConcurrency() BLE data packets from the queue so that
+           they can be multiplexed over the pooled cloud connection */
+        vector<BleDataPacket> blePkts;
+        uplinkQueueTake(blePkts, getUplinkConcurrency());
+        lock.unlock();
+        uint64_t dequeueNsecs = pktTraceNowNsecs();
+        for (auto &blePkt : blePkts) {
+            pktTraceStamp(&blePkt.trace, PKT_STAGE_DEQUEUE, dequeueNsecs);
+        }
+        uplinkBlePackets(blePkts, batchMode);
+        lock.lock();
+    }
+    heartbeatNoteQueueDepth(uplinkQueueDepth());
+    metricsGaugeSet(METRIC_GAUGE_QUEUE_DEPTH, (int64_t)uplinkQueueDepth());
+
+    /* The max delay may have expired while waiting for the queue */
+    if (batchMode && uplinkBatchIsDue()) {
+        lock.unlock();
+        uplinkBatchFlush();
+        lock.lock();
+    }
+}
+
+/* Resend packets whose retry backoff expired, then replay the spool backlog once the cloud is reachable */
+static void processUplinkRetries(bool spoolEnabled, bool batchMode) {
+    vector<BleDataPacket> blePkts;
+    if (uplinkCircuitMsecsUntilProbe() == 0 && uplinkRetryTakeDue(blePkts, getUplinkConcurrency()) > 0) {
+        uplinkBlePackets(blePkts, batchMode);
+    }
+
+    if (spoolEnabled) {
+        uplinkSpoolSync();
+        blePkts.clear();
+        if (keepRunning && uplinkCircuitAllowsBacklog() && uplinkSpoolHasBacklog() &&
+            uplinkSpoolReplay(blePkts, getUplinkConcurrency()) > 0) {
+            uplinkBlePackets(blePkts, batchMode);
+        }
+    }
+}
+
 /* Cloud Communication Thread Function */
 void cloudCommicationThreadFunc() {
     TRK_PRINTF("Started Cloud Communication Thread ...");
+    bool batchMode = isUplinkBatchMode();
+    if (batchMode) {
+        uplinkBatchInit(onUplinkRecordAck);
+    }
+    bool spoolEnabled = isUplinkSpoolEnabled();
+    heartbeatInit();
+
+    auto queueReady = [] {
+        return (uplinkQueueDepth() > 0 && uplinkCircuitMsecsUntilProbe() == 0) || !keepRunning;
+    };
 
     while (keepRunning) {
+        releaseRateLimitedPackets();
+
         unique_lock<mutex> lock(bleQueueMutex);
-        bleQueueCondVar.wait(lock, [] {
-            return !bleDataQueue.empty() || !keepRunning;
-        });
-
-        while (!bleDataQueue.empty()) {
-            /* Fetch the BLE data packet from the queue */
-            BleDataPacket blePkt = bleDataQueue.front();
-            bleDataQueue.pop();
-            lock.unlock();
-            char dataBuff[256] = {0};
-            /* Create the URL externsion that contains the BLE data */
-            int urlCreateStatus = createBleDataUrlExtension(dataBuff, sizeof(dataBuff), &blePkt);
-            if (urlCreateStatus == URL_CREATE_SUCCESS) {
-                /* Send the Data URL to the cloud */
-                sendDataUrlToCloud(dataBuff, strlen(dataBuff) + 1);
-            }
-            else {
-                //TRK_PRINTF("ERROR: Failed to create URL for BLE packet, Status: %d", urlCreateStatus);
-            }
-            lock.lock();
+        /* Wake up in time for the next retry (not before an open circuit probes again)
+           and to flush a partially filled batch */
+        uint32_t waitMsecs = max(uplinkRetryMsecsUntilDue(), uplinkCircuitMsecsUntilProbe());
+        if (uplinkQueueDepth() > 0) {
+            /* Readings wait in the queue for the circuit to let requests through again */
+            waitMsecs = min(waitMsecs, uplinkCircuitMsecsUntilProbe());
         }
+        if (batchMode && uplinkBatchRecordCount() > 0) {
+            waitMsecs = min(waitMsecs, uplinkBatchMsecsUntilDue());
+        }
+        if (spoolEnabled) {
+            /* Wake up in time to sync the spool and replay its backlog */
+            waitMsecs = min(waitMsecs, (uint32_t)spoolCfg.fsyncIntervalMsecs);
+        }
+        /* Wake up in time to send a heartbeat that found no data request to ride on */
+        waitMsecs = min(waitMsecs, heartbeatMsecsUntilStandalone());
+        /* Wake up in time to release packets held by the rate limits */
+        waitMsecs = min(waitMsecs, uplinkRateLimitMsecsUntilRelease());
+        /* Wake up in time to probe the idle and failed uplink endpoints */
+        waitMsecs = min(waitMsecs, uplinkEndpointMsecsUntilProbe());
+
+        if (waitMsecs != UINT32_MAX) {
+            bleQueueCondVar.wait_for(lock, chrono::milliseconds(waitMsecs), queueReady);
+        }
+        else {
+            bleQueueCondVar.wait(lock, queueReady);
+        }
+
+        processUplinkQueue(lock, batchMode);
+        lock.unlock();
+        processUplinkRetries(spoolEnabled, batchMode);
+        heartbeatProcess();
+        probeCloudEndpoints();
+    }
+
+    if (batchMode) {
+        uplinkBatchFlush();
     }
+    uplinkSpoolClose();
+    cloudCommCleanup();
 }
 
-/* Signal handler for the keyboard Interrupt */
+/* Signal handler for the keyboard Interrupt. Only async-signal-safe work here: main() logs and wakes the rest */
 void keyboardIrqHandler(int signum) {
-    TRK_PRINTF("Received signal:%d, exiting...", signum);
+    int savedErrno = errno;
+    exitSignal = signum;
     keepRunning = false;
-    bleQueueCondVar.notify_all();
-    tapeListCondVar.notify_all();
+    bleConnSchedWake();
+    errno = savedErrno;
 }
 
 void sysInit(void) {
@@ -876,18 +1092,28 @@ void sysInit(void) {
     /* Get the MAC address of the Gateway device */
     gwMacStatus = getIfaceMacAddress(); 
     if (gwMacStatus == false) {
-        TRK_PRINTF("ERROR: GW MAC not found!");
+        TRK_LOG_ERR("ERROR: GW MAC not found!");
         exit(EXIT_FAILURE);
     }
     TRK_PRINTF("GW MAC: %s", gwCfg.gwMacAddr.c_str());
     /* Read the system configuration file. */
     readSysConfigFile();
+    trkLogConfigure(logCfg.level, logCfg.rateLimit);
+    /* Compile the data URL templates for the loaded gateway configuration */
+    urlBuilderInit();
+    /* Fill the uplink rate limit buckets */
+    uplinkRateLimitInit();
+    /* Recover packets that were not acknowledged before the last shutdown */
+    uplinkSpoolInit();
 }
 
 int main(int argc, char *argv[]) {
+    /* Messages go through the logger's writer thread from here on */
+    trkLogInit();
+
     /* Check and parse the input arguments - To be removed later */
     if (argc < 3) {
-        TRK_PRINTF("ERROR: Invalid Input Parameters");
+        TRK_LOG_ERR("ERROR: Invalid Input Parameters");
         return -1;
     }
 
@@ -903,7 +1129,14 @@ int main(int argc, char *argv[]) {
     /* Create thread to communicate to the cloud */
     thread cloudCommThread(cloudCommicationThreadFunc);
     thread bleScanThread(bleScanThreadFunc, bleScanTime, bleSleepTime);
-    // thread bleConnectThread(bleConnectThreadFunc);
+    thread bleConnectThread;
+    if (bleConnectCfg.connectEnabled) {
+        bleConnectThread = thread(bleConnectThreadFunc);
+    }
+    thread metricsThread;
+    if (metricsServerInit()) {
+        metricsThread = thread(metricsServerThreadFunc);
+    }
 
     /* The main thread sleeps for 1 second and checks the running status */
     while(keepRunning) {
@@ -911,10 +1144,24 @@ int main(int argc, char *argv[]) {
         sleep(1);
     }
 
+    TRK_PRINTF("Received signal:%d, exiting...", (int)exitSignal);
+    {
+        /* Under the mutex, so the cloud thread cannot miss the wakeup between its check and its wait */
+        lock_guard<mutex> lock(bleQueueMutex);
+        bleQueueCondVar.notify_all();
+    }
     cloudCommThread.join();
     bleScanThread.join();
-    // bleConnectThread.join();
+    if (bleConnectThread.joinable()) {
+        bleConnectThread.join();
+    }
+    /* The scan thread wakes the connect thread through this eventfd: close it once both are gone */
+    bleConnSchedClose();
+    if (metricsThread.joinable()) {
+        metricsThread.join();
+    }
 
     TRK_PRINTF("Program exited cleanly");
+    trkLogShutdown();
     return 0;
 }
\ No newline at end of file
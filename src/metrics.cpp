@@ -0,0 +1,333 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "common.h"
+#include "config.h"
+#include "metrics.h"
+#include "pktTrace.h"
+
+using namespace std;
+
+typedef struct MetricDesc {
+    const char *name;
+    const char *labels;                  /* "{...}" or "" */
+    const char *help;
+} MetricDesc;
+
+/* Counters of one family are consecutive, HELP and TYPE are written for the first one */
+static const MetricDesc counterDescs[METRIC_COUNTER_COUNT] = {
+    {"trk_hci_events_read_total", "", "HCI events read from the scan socket"},
+    {"trk_adverts_classified_total", "{class=\"white_tape\"}", "Advertising reports by device class"},
+    {"trk_adverts_classified_total", "{class=\"other\"}", "Advertising reports by device class"},
+    {"trk_adverts_duplicate_total", "", "White tape reports dropped by the dups check"},
+    {"trk_packets_queued_total", "", "Packets queued for the uplink"},
+};
+
+static const MetricDesc gaugeDescs[METRIC_GAUGE_COUNT] = {
+    {"trk_uplink_queue_depth", "", "Packets waiting in the uplink queue"},
+};
+
+static const MetricDesc histogramDescs[METRIC_HISTOGRAM_COUNT] = {
+    {"trk_parse_seconds", "", "Time to parse an advert into a packet"},
+    {"trk_url_build_seconds", "", "Time to build the URL extension of a packet"},
+    {"trk_uplink_latency_seconds", "{transport=\"http\"}", "Uplink request latency"},
+    {"trk_uplink_latency_seconds", "{transport=\"stream\"}", "Uplink request latency"},
+    {"trk_packet_stage_seconds", "{stage=\"classify\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"dedup\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"parse\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"enqueue\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"dequeue\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"url_build\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"send\"}", "Packet time per pipeline stage"},
+    {"trk_packet_stage_seconds", "{stage=\"ack\"}", "Packet time per pipeline stage"},
+    {"trk_packet_e2e_seconds", "", "Packet time from the HCI read to the ack"},
+};
+
+/* Upper bounds in nanoseconds; the last bucket has no bound */
+static const uint64_t computeBoundsNsecs[METRICS_HIST_BUCKETS] = {
+    250, 500, 1000, 2000, 5000, 10000, 25000, 50000, 100000, 250000, 1000000, UINT64_MAX};
+static const uint64_t latencyBoundsNsecs[METRICS_HIST_BUCKETS] = {
+    10000000ull, 25000000ull, 50000000ull, 100000000ull, 250000000ull, 500000000ull, 1000000000ull,
+    2500000000ull, 5000000000ull, 10000000000ull, 30000000000ull, UINT64_MAX};
+/* Pipeline stages span a parse to a queue wait */
+static const uint64_t stageBoundsNsecs[METRICS_HIST_BUCKETS] = {
+    1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 50000000ull, 100000000ull, 500000000ull,
+    1000000000ull, 5000000000ull, 30000000000ull, UINT64_MAX};
+static const uint64_t *histogramBounds[METRIC_HISTOGRAM_COUNT] = {
+    computeBoundsNsecs, computeBoundsNsecs, latencyBoundsNsecs, latencyBoundsNsecs,
+    stageBoundsNsecs, stageBoundsNsecs, stageBoundsNsecs, stageBoundsNsecs, stageBoundsNsecs,
+    stageBoundsNsecs, stageBoundsNsecs, stageBoundsNsecs, latencyBoundsNsecs};
+
+typedef struct alignas(64) MetricsShard {
+    atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+    atomic<uint64_t> buckets[METRIC_HISTOGRAM_COUNT][METRICS_HIST_BUCKETS];
+    atomic<uint64_t> sumNsecs[METRIC_HISTOGRAM_COUNT];
+} MetricsShard;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static MetricsShard metricsShards[METRICS_MAX_SHARDS];
+static MetricsShard overflowShard;
+static atomic<size_t> shardsClaimed(0);
+static thread_local MetricsShard *threadShard = nullptr;
+static atomic<int64_t> gauges[METRIC_GAUGE_COUNT];
+static int listenFd = -1;
+static string unixSocketPath;
+
+static MetricsShard *getThreadShard(void);
+static inline void shardAdd(MetricsShard *shard, atomic<uint64_t> &value, uint64_t n);
+static void writeHeader(string &out, const MetricDesc *descs, size_t i, const char *type);
+static bool openListener(const char *listen);
+static void serveScrape(int fd);
+
+/* ----------------- Function Definitions ---------------------- */
+static MetricsShard *getThreadShard(void) {
+    if (threadShard == nullptr) {
+        size_t index = shardsClaimed.fetch_add(1, memory_order_relaxed);
+        threadShard = (index < METRICS_MAX_SHARDS) ? &metricsShards[index] : &overflowShard;
+    }
+    return threadShard;
+}
+
+/* A thread's own shard has a single writer: no read-modify-write needed */
+static inline void shardAdd(MetricsShard *shard, atomic<uint64_t> &value, uint64_t n) {
+    if (shard == &overflowShard) {
+        value.fetch_add(n, memory_order_relaxed);
+    }
+    else {
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+}
+
+void metricsCounterAdd(MetricCounter counter, uint64_t n) {
+    MetricsShard *shard = getThreadShard();
+    shardAdd(shard, shard->counters[counter], n);
+}
+
+void metricsGaugeSet(MetricGauge gauge, int64_t value) {
+    gauges[gauge].store(value, memory_order_relaxed);
+}
+
+void metricsObserveNsecs(MetricHistogram histogram, uint64_t nsecs) {
+    MetricsShard *shard = getThreadShard();
+    const uint64_t *bounds = histogramBounds[histogram];
+    size_t bucket = 0;
+    while (nsecs > bounds[bucket]) {
+        bucket++;
+    }
+    shardAdd(shard, shard->buckets[histogram][bucket], 1);
+    shardAdd(shard, shard->sumNsecs[histogram], nsecs);
+}
+
+static void writeHeader(string &out, const MetricDesc *descs, size_t i, const char *type) {
+    if (i > 0 && strcmp(descs[i].name, descs[i - 1].name) == 0) {
+        return;
+    }
+    out += "# HELP ";
+    out += descs[i].name;
+    out += ' ';
+    out += descs[i].help;
+    out += "\n# TYPE ";
+    out += descs[i].name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void metricsRender(string &out) {
+    size_t shards = min(shardsClaimed.load(memory_order_relaxed), (size_t)METRICS_MAX_SHARDS);
+    char line[256];
+
+    for (size_t i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        uint64_t total = overflowShard.counters[i].load(memory_order_relaxed);
+        for (size_t s = 0; s < shards; s++) {
+            total += metricsShards[s].counters[i].load(memory_order_relaxed);
+        }
+        writeHeader(out, counterDescs, i, "counter");
+        snprintf(line, sizeof(line), "%s%s %llu\n", counterDescs[i].name, counterDescs[i].labels,
+                 (unsigned long long)total);
+        out += line;
+    }
+
+    for (size_t i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        writeHeader(out, gaugeDescs, i, "gauge");
+        snprintf(line, sizeof(line), "%s%s %lld\n", gaugeDescs[i].name, gaugeDescs[i].labels,
+                 (long long)gauges[i].load(memory_order_relaxed));
+        out += line;
+    }
+
+    for (size_t i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const MetricDesc &desc = histogramDescs[i];
+        /* Labels of the family without the braces, to be joined with "le" */
+        string labels = (desc.labels[0] != '\0') ? string(desc.labels + 1, strlen(desc.labels) - 2) + "," : "";
+        uint64_t sumNsecs = overflowShard.sumNsecs[i].load(memory_order_relaxed);
+        for (size_t s = 0; s < shards; s++) {
+            sumNsecs += metricsShards[s].sumNsecs[i].load(memory_order_relaxed);
+        }
+
+        writeHeader(out, histogramDescs, i, "histogram");
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < METRICS_HIST_BUCKETS; b++) {
+            cumulative += overflowShard.buckets[i][b].load(memory_order_relaxed);
+            for (size_t s = 0; s < shards; s++) {
+                cumulative += metricsShards[s].buckets[i][b].load(memory_order_relaxed);
+            }
+            uint64_t bound = histogramBounds[i][b];
+            if (bound == UINT64_MAX) {
+                snprintf(line, sizeof(line), "%s_bucket{%sle=\"+Inf\"} %llu\n", desc.name, labels.c_str(),
+                         (unsigned long long)cumulative);
+            }
+            else {
+                snprintf(line, sizeof(line), "%s_bucket{%sle=\"%g\"} %llu\n", desc.name, labels.c_str(),
+                         (double)bound / 1e9, (unsigned long long)cumulative);
+            }
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_sum%s %.9f\n%s_count%s %llu\n", desc.name, desc.labels,
+                 (double)sumNsecs / 1e9, desc.name, desc.labels, (unsigned long long)cumulative);
+        out += line;
+    }
+}
+
+/* "unix:/path" or "host:port" */
+static bool openListener(const char *listen) {
+    size_t prefixLen = strlen(METRICS_UNIX_PREFIX);
+    if (strncmp(listen, METRICS_UNIX_PREFIX, prefixLen) == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(listen + prefixLen) >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        strcpy(addr.sun_path, listen + prefixLen);
+        /* A socket file left by an earlier run; anything else at the path is left alone and fails the bind */
+        struct stat pathStat;
+        if (lstat(addr.sun_path, &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+            unlink(addr.sun_path);
+        }
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            return false;
+        }
+        unixSocketPath = addr.sun_path;
+        return (::listen(listenFd, 4) == 0);
+    }
+
+    const char *colon = strrchr(listen, ':');
+    if (colon == nullptr) {
+        errno = EINVAL;
+        return false;
+    }
+    string host(listen, (size_t)(colon - listen));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)atoi(colon + 1));
+    if (inet_pton(AF_INET, host.empty() ? "127.0.0.1" : host.c_str(), &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        return false;
+    }
+    int reuse = 1;
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    return (listenFd >= 0 && setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+            bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && ::listen(listenFd, 4) == 0);
+}
+
+bool metricsServerInit(void) {
+    if (metricsCfg.listen == nullptr || metricsCfg.listen[0] == '\0') {
+        return false;
+    }
+    if (!openListener(metricsCfg.listen)) {
+        TRK_LOG_ERR("ERROR: Metrics endpoint %s could not be opened: %s", metricsCfg.listen, strerror(errno));
+        if (listenFd >= 0) {
+            close(listenFd);
+            listenFd = -1;
+        }
+        return false;
+    }
+    TRK_PRINTF("Metrics: serving on %s", metricsCfg.listen);
+    return true;
+}
+
+/* Read the request line and answer it; the scraper's connection is closed after one response */
+static void serveScrape(int fd) {
+    struct timeval timeout = {METRICS_REQUEST_TIMEOUT_MSECS / 1000, (METRICS_REQUEST_TIMEOUT_MSECS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[METRICS_REQUEST_MAX_LEN + 1];
+    size_t len = 0;
+    while (len < METRICS_REQUEST_MAX_LEN) {
+        ssize_t n = recv(fd, request + len, METRICS_REQUEST_MAX_LEN - len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t)n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr) {
+            break;
+        }
+    }
+    request[len] = '\0';
+
+    string body;
+    const char *status = "200 OK";
+    if (strncmp(request, "GET /metrics", 12) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        body.reserve(4096);
+        metricsRender(body);
+    }
+    else if (strncmp(request, "GET /traces", 11) == 0) {
+        pktTraceRender(body);
+    }
+    else {
+        status = "404 Not Found";
+        body = "Not found\n";
+    }
+
+    char header[160];
+    int headerLen = snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, body.size());
+    string response(header, (size_t)headerLen);
+    response += body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += (size_t)n;
+    }
+}
+
+void metricsServerThreadFunc(void) {
+    while (keepRunning && listenFd >= 0) {
+        struct pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, METRICS_POLL_MSECS) <= 0) {
+            continue;
+        }
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        serveScrape(fd);
+        close(fd);
+    }
+
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+    if (!unixSocketPath.empty()) {
+        unlink(unixSocketPath.c_str());
+    }
+}
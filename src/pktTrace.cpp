@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include "common.h"
+#include "config.h"
+#include "metrics.h"
+#include "pktTrace.h"
+
+using namespace std;
+
+/* A slow packet as it is kept for /traces */
+typedef struct SlowTrace {
+    char macAddr[20];
+    BlePacketType blePktType;
+    uint32_t sendAttempts;
+    PktTrace trace;
+} SlowTrace;
+
+static const char *stageNames[PKT_STAGE_COUNT] = {
+    "capture", "classify", "dedup", "parse", "enqueue", "dequeue", "url_build", "send", "ack"};
+
+/* ----------------- Static Functions and Variables ---------------------- */
+/* Written by the cloud thread, read by the metrics thread */
+static mutex slowTraceMutex;
+static SlowTrace slowTraces[PKT_TRACE_SLOW_KEEP];
+static size_t slowTraceCount = 0;
+static size_t slowTraceNext = 0;
+
+static void formatSlowTrace(const SlowTrace &slow, char *line, size_t lineLen);
+
+/* ----------------- Function Definitions ---------------------- */
+/* "<mac> type=<t> attempts=<n> e2e_ms=<t> <stage>_us=<t> ...", stages not reached are left out */
+static void formatSlowTrace(const SlowTrace &slow, char *line, size_t lineLen) {
+    const uint64_t *stamps = slow.trace.stampNsecs;
+    int len = snprintf(line, lineLen, "%s type=%d attempts=%u e2e_ms=%.1f", slow.macAddr, (int)slow.blePktType,
+                       slow.sendAttempts, (double)(stamps[PKT_STAGE_ACK] - stamps[PKT_STAGE_CAPTURE]) / 1e6);
+    uint64_t prevNsecs = stamps[PKT_STAGE_CAPTURE];
+    for (int stage = PKT_STAGE_CLASSIFY; stage < PKT_STAGE_COUNT && len > 0 && (size_t)len < lineLen; stage++) {
+        if (stamps[stage] == 0) {
+            continue;
+        }
+        len += snprintf(line + len, lineLen - (size_t)len, " %s_us=%.1f", stageNames[stage],
+                        (double)(stamps[stage] - prevNsecs) / 1e3);
+        prevNsecs = stamps[stage];
+    }
+}
+
+void pktTraceFinish(const BleDataPacket &blePkt) {
+    if (blePkt.trace.stampNsecs[PKT_STAGE_CAPTURE] == 0) {
+        return;
+    }
+    PktTrace trace = blePkt.trace;
+    trace.stampNsecs[PKT_STAGE_ACK] = pktTraceNowNsecs();
+
+    /* A stage is timed from the last stage before it that was stamped */
+    uint64_t prevNsecs = trace.stampNsecs[PKT_STAGE_CAPTURE];
+    for (int stage = PKT_STAGE_CLASSIFY; stage < PKT_STAGE_COUNT; stage++) {
+        uint64_t stampNsecs = trace.stampNsecs[stage];
+        if (stampNsecs == 0 || stampNsecs < prevNsecs) {
+            continue;
+        }
+        metricsObserveNsecs((MetricHistogram)(METRIC_HIST_STAGE_CLASSIFY + stage - PKT_STAGE_CLASSIFY),
+                            stampNsecs - prevNsecs);
+        prevNsecs = stampNsecs;
+    }
+    uint64_t e2eNsecs = trace.stampNsecs[PKT_STAGE_ACK] - trace.stampNsecs[PKT_STAGE_CAPTURE];
+    metricsObserveNsecs(METRIC_HIST_PACKET_E2E, e2eNsecs);
+
+    if (traceCfg.slowMsecs <= 0 || e2eNsecs < (uint64_t)traceCfg.slowMsecs * 1000000u) {
+        return;
+    }
+    SlowTrace slow;
+    const char *macAddr = getBlePacketMacAddr(blePkt);
+    snprintf(slow.macAddr, sizeof(slow.macAddr), "%s", (macAddr != nullptr) ? macAddr : "?");
+    slow.blePktType = blePkt.blePktType;
+    slow.sendAttempts = blePkt.sendAttempts;
+    slow.trace = trace;
+    {
+        lock_guard<mutex> lock(slowTraceMutex);
+        slowTraces[slowTraceNext] = slow;
+        slowTraceNext = (slowTraceNext + 1) % PKT_TRACE_SLOW_KEEP;
+        slowTraceCount = min(slowTraceCount + 1, (size_t)PKT_TRACE_SLOW_KEEP);
+    }
+
+    char line[512];
+    formatSlowTrace(slow, line, sizeof(line));
+    TRK_PRINTF("Trace: slow packet %s", line);
+}
+
+void pktTraceRender(string &out) {
+    char line[512];
+    lock_guard<mutex> lock(slowTraceMutex);
+    for (size_t i = 1; i <= slowTraceCount; i++) {
+        size_t index = (slowTraceNext + PKT_TRACE_SLOW_KEEP - i) % PKT_TRACE_SLOW_KEEP;
+        formatSlowTrace(slowTraces[index], line, sizeof(line));
+        out += line;
+        out += '\n';
+    }
+}
@@ -1,6 +1,7 @@
 #include "tapeFormat.h"
 #include "common.h"
 #include "config.h"
+#include "hexEncode.h"
 
 static void parseBleAdvData_QuartzTMP117(le_advertising_info *info, BlePacket_QuartzTMP117 *blePkt);
 static void parseBleAdvData_QuartzOPT3110(le_advertising_info *info, BlePacket_QuartzOPT3110 *blePkt);
@@ -10,7 +11,6 @@ static uint8_t getEvtFlag_QuartzTMP117(le_advertising_info *info);
 static uint8_t getEvtFlag_QuartzOPT3110(le_advertising_info *info);
 static uint8_t getEvtFlag_QuartzIAT(le_advertising_info *info);
 static uint8_t getEvtFlag_QuartzDPD(le_advertising_info *info);
-static void removeChar(char *str, char target);
 
 inline uint16_t getTapeId(le_advertising_info *info) {
     uint8_t startIdx = QUARTZ_BLE_ADV_PKT_TAPE_ID_IDX;
@@ -47,20 +47,23 @@ static inline bool isQuartzSensorBleData(BlePacketType blePktType) {
 
 void parseBleDataPacket(le_advertising_info *info, BleDataPacket *bleDataPkt) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR: nullptr - Could not parse BLE adv data to BLE data packet.");
+        TRK_LOG_ERR("ERROR: nullptr - Could not parse BLE adv data to BLE data packet.");
         exit(EXIT_ERR_NULL_PTR);
     }
 
     /* Determine the BLE packet type based on the tapeID */
+    bleDataPkt->pktFlags = 0;
+    bleDataPkt->captureTs = (uint32_t)getEpochTimeSecs();
     bleDataPkt->blePktType = getBlePacketType(info);
-    TRK_PRINTF("DBG3: Get BLE Packet Type: %d", bleDataPkt->blePktType);
+    TRK_LOG_DBG("DBG3: Get BLE Packet Type: %d", bleDataPkt->blePktType);
 
     /* If not Quartz sensor type, do not parse the BLE data packet */
     if (isQuartzSensorBleData(bleDataPkt->blePktType) == false) {
         return;
     }
 
-    if (isCurlReqFormatG1() == true) {
+    /* G1 and B1 both carry the raw tape payload */
+    if (isCurlReqFormatG1() == true || isCurlReqFormatB1() == true) {
         memcpy(bleDataPkt->bleBuff, &info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX], WHITE_TAPE_DATA_PACKET_LEN);
     }
 
@@ -78,34 +81,20 @@ void parseBleDataPacket(le_advertising_info *info, BleDataPacket *bleDataPkt) {
             parseBleAdvData_QuartzDPD(info, &bleDataPkt->blePktStrct.blePkt_DPD);
             break;
         default:
-            //TRK_PRINTF("ERROR: Unknown BLE packet type detected");
+            //TRK_LOG_ERR("ERROR: Unknown BLE packet type detected");
             break;
     }
 }
 
-/* Helper function */
-static void removeChar(char *str, char target) {
-    char *src = str, *dst = str;
-
-    while (*src) {
-        if (*src != target) {
-            *dst++ = *src;
-        }
-        src++;
-    }
-    *dst = '\0';
-}
-
 static void parseBleAdvData_QuartzTMP117(le_advertising_info *info, BlePacket_QuartzTMP117 *blePkt) {
     if (info == nullptr || blePkt == nullptr) {
-        TRK_PRINTF("ERROR: nullptr - Could not parse BLE adv data to TMP117 BLE data packet.");
+        TRK_LOG_ERR("ERROR: nullptr - Could not parse BLE adv data to TMP117 BLE data packet.");
         exit(EXIT_ERR_NULL_PTR);
     }
 
     /* MAC Address */
     memset(blePkt->mac_addr, 0, sizeof(blePkt->mac_addr));
-    ba2str(&info->bdaddr, blePkt->mac_addr);
-    removeChar(blePkt->mac_addr,':');
+    hexEncodeBdaddr(blePkt->mac_addr, info->bdaddr.b);
 
     /* Process and save the BLE info data - 24 bytes */
     blePkt->fid = getFid(info);
@@ -126,25 +115,27 @@ static void parseBleAdvData_QuartzTMP117(le_advertising_info *info, BlePacket_Qu
 
 static void parseBleAdvData_QuartzOPT3110(le_advertising_info *info, BlePacket_QuartzOPT3110 *blePkt) {
     if (info == nullptr || blePkt == nullptr) {
-        TRK_PRINTF("ERROR: nullptr - Could not parse BLE adv data to OPT3110 BLE data packet.");
+        TRK_LOG_ERR("ERROR: nullptr - Could not parse BLE adv data to OPT3110 BLE data packet.");
         exit(EXIT_ERR_NULL_PTR);
     }
 
-    TRK_PRINTF("Parsing OPT3110 BLE Adv Data ...");
+    TRK_LOG_DBG("Parsing OPT3110 BLE Adv Data ...");
 
     /* MAC Address */
     memset(blePkt->mac_addr, 0, sizeof(blePkt->mac_addr));
-    ba2str(&info->bdaddr, blePkt->mac_addr);
-    removeChar(blePkt->mac_addr,':');
+    hexEncodeBdaddr(blePkt->mac_addr, info->bdaddr.b);
 
     /* Process and save the BLE info data - 24 bytes */
     blePkt->fid = getFid(info);
     blePkt->evt_flag = getEvtFlag_QuartzOPT3110(info);
     blePkt->t0 = getTemperatureData(info, QUARTZ_OPT3110_BLE_ADV_PKT_T0_OFFSET);
     blePkt->t0_ts = getTimestampU16(info, QUARTZ_OPT3110_BLE_ADV_PKT_T0_TS_OFFSET);
-    blePkt->l0 = getTemperatureData(info, QUARTZ_OPT3110_BLE_ADV_PKT_L0_OFFSET);
+    /* Light is decoded like a temperature and truncated to whole units */
+    blePkt->l0 = (uint16_t)(getTemperatureData(info, QUARTZ_OPT3110_BLE_ADV_PKT_L0_OFFSET) /
+                            TAPE_TEMP_CENTI_PER_DEGREE);
     blePkt->l0_ts = getTimestampU16(info, QUARTZ_OPT3110_BLE_ADV_PKT_L0_TS_OFFSET);
-    blePkt->l1 = getTemperatureData(info, QUARTZ_OPT3110_BLE_ADV_PKT_L1_OFFSET);
+    blePkt->l1 = (uint16_t)(getTemperatureData(info, QUARTZ_OPT3110_BLE_ADV_PKT_L1_OFFSET) /
+                            TAPE_TEMP_CENTI_PER_DEGREE);
     blePkt->l1_ts = getTimestampU16(info, QUARTZ_OPT3110_BLE_ADV_PKT_L1_TS_OFFSET);
     blePkt->pid = getLimePid(info, QUARTZ_OPT3110_BLE_ADV_PKT_LIME_PID_OFFSET);
     blePkt->lime_bat = getLimeBat(info);
@@ -156,20 +147,19 @@ static void parseBleAdvData_QuartzOPT3110(le_advertising_info *info, BlePacket_Q
 
 static void parseBleAdvData_QuartzIAT(le_advertising_info *info, BlePacket_IAT *blePkt) {
     if (info == nullptr || blePkt == nullptr) {
-        TRK_PRINTF("ERROR: nullptr - Could not parse BLE adv data to OPT3110 BLE data packet.");
+        TRK_LOG_ERR("ERROR: nullptr - Could not parse BLE adv data to OPT3110 BLE data packet.");
         exit(EXIT_ERR_NULL_PTR);
     }
 
     /* MAC Address */
     memset(blePkt->mac_addr, 0, sizeof(blePkt->mac_addr));
-    ba2str(&info->bdaddr, blePkt->mac_addr);
-    removeChar(blePkt->mac_addr,':');
+    hexEncodeBdaddr(blePkt->mac_addr, info->bdaddr.b);
 
     /* Process and save the BLE info data - 24 bytes */
     blePkt->fid = getFid(info);
     blePkt->evt_flag = getEvtFlag_QuartzIAT(info);
-    blePkt->t0 = (float)info->data[QUARTZ_IAT_BLE_ADV_PKT_T0_OFFSET];
-    blePkt->t1 = (float)info->data[QUARTZ_IAT_BLE_ADV_PKT_T1_OFFSET];
+    blePkt->t0 = (int16_t)(info->data[QUARTZ_IAT_BLE_ADV_PKT_T0_OFFSET] * TAPE_TEMP_CENTI_PER_DEGREE);
+    blePkt->t1 = (int16_t)(info->data[QUARTZ_IAT_BLE_ADV_PKT_T1_OFFSET] * TAPE_TEMP_CENTI_PER_DEGREE);
     blePkt->t1_ts = getTimestampU32(info, QUARTZ_IAT_BLE_ADV_PKT_T1_TS_OFFSET);
     blePkt->l0 = getLightData(info, QUARTZ_IAT_BLE_ADV_PKT_L0_OFFSET);
     blePkt->l0_ts = getTimestampU32(info, QUARTZ_IAT_BLE_ADV_PKT_L0_TS_OFFSET);
@@ -183,20 +173,19 @@ static void parseBleAdvData_QuartzIAT(le_advertising_info *info, BlePacket_IAT *
 
 static void parseBleAdvData_QuartzDPD(le_advertising_info *info, BlePacket_DPD *blePkt) {
     if (info == nullptr || blePkt == nullptr) {
-        TRK_PRINTF("ERROR: nullptr - Could not parse BLE adv data to OPT3110 BLE data packet.");
+        TRK_LOG_ERR("ERROR: nullptr - Could not parse BLE adv data to OPT3110 BLE data packet.");
         exit(EXIT_ERR_NULL_PTR);
     }
 
     /* MAC Address */
     memset(blePkt->macId, 0, sizeof(blePkt->macId));
-    ba2str(&info->bdaddr, blePkt->macId);
-    removeChar(blePkt->macId,':');
+    hexEncodeBdaddr(blePkt->macId, info->bdaddr.b);
 
     /* Process and save the BLE info data - 24 bytes */
     blePkt->fid = getFid(info);
     blePkt->evtFlag = getEvtFlag_QuartzDPD(info);
     memcpy(&blePkt->tagMacId[0], &info->data[3], 6);
-    blePkt->t0 = (float)info->data[QUARTZ_DPD_BLE_ADV_PKT_T0_OFFSET];
+    blePkt->t0 = (int16_t)(info->data[QUARTZ_DPD_BLE_ADV_PKT_T0_OFFSET] * TAPE_TEMP_CENTI_PER_DEGREE);
     blePkt->l0 = getLightData(info, QUARTZ_DPD_BLE_ADV_PKT_L0_OFFSET);
     blePkt->l0Ts = getTimestampU32(info, QUARTZ_DPD_BLE_ADV_PKT_A0_OFFSET);
     blePkt->ts = getTimestampU32(info, QUARTZ_DPD_BLE_ADV_PKT_TS_OFFSET);
@@ -207,7 +196,7 @@ static void parseBleAdvData_QuartzDPD(le_advertising_info *info, BlePacket_DPD *
 
 static uint8_t getEvtFlag_QuartzTMP117(le_advertising_info *info) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR - Null ptr. Cannot get TMP117 BLE Evt Flag");
+        TRK_LOG_ERR("ERROR - Null ptr. Cannot get TMP117 BLE Evt Flag");
         return 0;
     }
     uint8_t blePktEvtFlag = info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX + QUARTZ_BLE_ADV_PKT_EVT_FLAG_OFFSET];
@@ -216,7 +205,7 @@ static uint8_t getEvtFlag_QuartzTMP117(le_advertising_info *info) {
 
 static uint8_t getEvtFlag_QuartzOPT3110(le_advertising_info *info) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR - Null ptr. Cannot get OPT3110 BLE Evt Flag");
+        TRK_LOG_ERR("ERROR - Null ptr. Cannot get OPT3110 BLE Evt Flag");
         return 0;
     }
     uint8_t blePktEvtFlag = info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX + QUARTZ_BLE_ADV_PKT_EVT_FLAG_OFFSET];
@@ -225,7 +214,7 @@ static uint8_t getEvtFlag_QuartzOPT3110(le_advertising_info *info) {
 
 static uint8_t getEvtFlag_QuartzIAT(le_advertising_info *info) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR - Null ptr. Cannot get IAT BLE Evt Flag");
+        TRK_LOG_ERR("ERROR - Null ptr. Cannot get IAT BLE Evt Flag");
         return 0;
     }
     uint8_t blePktEvtFlag = info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX + QUARTZ_BLE_ADV_PKT_EVT_FLAG_OFFSET];
@@ -234,7 +223,7 @@ static uint8_t getEvtFlag_QuartzIAT(le_advertising_info *info) {
 
 static uint8_t getEvtFlag_QuartzDPD(le_advertising_info *info) {
     if (info == nullptr) {
-        TRK_PRINTF("ERROR - Null ptr. Cannot get DPD BLE Evt Flag");
+        TRK_LOG_ERR("ERROR - Null ptr. Cannot get DPD BLE Evt Flag");
         return 0;
     }
     uint8_t blePktEvtFlag = info->data[QUARTZ_BLE_ADV_PKT_DATA_START_IDX + QUARTZ_BLE_ADV_PKT_EVT_FLAG_OFFSET];
@@ -0,0 +1,516 @@
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <strings.h>
+#include "trkLog.h"
+
+using namespace std;
+
+/* Ring of one thread: the thread writes at tail, the writer thread reads at head */
+typedef struct TrkLogRing {
+    alignas(64) atomic<uint64_t> head;
+    alignas(64) atomic<uint64_t> tail;
+    uint64_t reserveTail;                /* Producer only: tail after the pending reservation */
+    atomic<uint64_t> dropped;            /* Producer writes, writer reads */
+    alignas(64) uint64_t droppedReported; /* Writer only */
+    alignas(8) uint8_t buff[TRK_LOG_RING_BYTES];
+} TrkLogRing;
+
+typedef enum TrkLogReservation {
+    TRK_LOG_RESERVED_NONE = 0,
+    TRK_LOG_RESERVED_RING,
+    TRK_LOG_RESERVED_SYNC
+} TrkLogReservation;
+
+/* A formatted message of the writer, sorted by its time before the write */
+typedef struct TrkLogLine {
+    uint64_t nsecs;
+    size_t offset;
+    size_t len;
+} TrkLogLine;
+
+/* Reads the binary arguments of a record in order; missing or mismatched ones read as 0 or "" */
+typedef struct TrkLogArgReader {
+    const uint8_t *p;
+    const uint8_t *end;
+} TrkLogArgReader;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+atomic<int> trkLogLevel(TRK_LOG_LEVEL_INFO);
+
+static atomic<uint32_t> logRateLimit(0);
+static atomic<TrkLogRing *> logRings[TRK_LOG_MAX_RINGS];
+static atomic<uint32_t> logRingCount(0);
+static atomic<bool> logAsync(false);
+static bool logWriterStop = false;
+static bool logAtExitSet = false;
+static mutex logWriterMutex;
+static condition_variable logWriterCondVar;
+static mutex logOutputMutex;
+static thread logWriterThread;
+
+static thread_local TrkLogRing *threadRing = nullptr;
+static thread_local bool threadRingDenied = false;
+static thread_local TrkLogReservation threadReservation = TRK_LOG_RESERVED_NONE;
+static thread_local vector<uint8_t> threadSyncBuff;
+
+static TrkLogRing *getThreadRing(void);
+static uint8_t readArgTag(TrkLogArgReader *reader, uint64_t *bits, const uint8_t **str, uint32_t *strLen);
+static int64_t readIntArg(TrkLogArgReader *reader);
+static double readDoubleArg(TrkLogArgReader *reader);
+static string readStrArg(TrkLogArgReader *reader);
+static void formatRecord(const TrkLogRecord *record, const uint8_t *args, string &out);
+static void writeOutput(const string &out);
+static size_t drainRings(string &out);
+static void logWriterThreadFunc(void);
+
+/* ----------------- Function Definitions ---------------------- */
+/* Claim a ring for the calling thread on its first message; threads past TRK_LOG_MAX_RINGS stay synchronous */
+static TrkLogRing *getThreadRing(void) {
+    if (threadRing != nullptr || threadRingDenied) {
+        return threadRing;
+    }
+    uint32_t index = logRingCount.fetch_add(1, memory_order_relaxed);
+    if (index >= TRK_LOG_MAX_RINGS) {
+        threadRingDenied = true;
+        return nullptr;
+    }
+    TrkLogRing *ring = new TrkLogRing();
+    logRings[index].store(ring, memory_order_release);
+    threadRing = ring;
+    return ring;
+}
+
+int trkLogLevelFromName(const char *name) {
+    static const char *levelNames[] = {"error", "warn", "info", "debug"};
+    if (name == nullptr) {
+        return -1;
+    }
+    for (int level = TRK_LOG_LEVEL_ERROR; level <= TRK_LOG_LEVEL_DEBUG; level++) {
+        if (strcasecmp(name, levelNames[level]) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+void trkLogConfigure(int level, int rateLimit) {
+    trkLogLevel.store(min(max(level, TRK_LOG_LEVEL_ERROR), TRK_LOG_LEVEL_DEBUG), memory_order_relaxed);
+    logRateLimit.store((uint32_t)max(rateLimit, 0), memory_order_relaxed);
+}
+
+bool trkLogAdmit(TrkLogSite *site, uint32_t *suppressed) {
+    uint32_t limit = logRateLimit.load(memory_order_relaxed);
+    if (limit != 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        uint32_t nowSecs = (uint32_t)ts.tv_sec;
+        uint32_t windowSecs = site->windowSecs.load(memory_order_relaxed);
+        if (nowSecs - windowSecs >= TRK_LOG_RATE_WINDOW_SECS &&
+            site->windowSecs.compare_exchange_strong(windowSecs, nowSecs, memory_order_relaxed)) {
+            site->windowCount.store(0, memory_order_relaxed);
+        }
+        if (site->windowCount.fetch_add(1, memory_order_relaxed) >= limit) {
+            site->suppressed.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+    }
+    *suppressed = 0;
+    if (site->suppressed.load(memory_order_relaxed) != 0) {
+        *suppressed = site->suppressed.exchange(0, memory_order_relaxed);
+    }
+    return true;
+}
+
+uint8_t *trkLogReserve(size_t len) {
+    /* A signal handler interrupting a message of its own thread; the ring is mid-write */
+    if (threadReservation != TRK_LOG_RESERVED_NONE) {
+        if (threadRing != nullptr) {
+            threadRing->dropped.store(threadRing->dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        }
+        return nullptr;
+    }
+
+    TrkLogRing *ring = logAsync.load(memory_order_acquire) ? getThreadRing() : nullptr;
+    if (ring == nullptr || len > TRK_LOG_RING_BYTES / 4) {
+        threadSyncBuff.resize(len);
+        threadReservation = TRK_LOG_RESERVED_SYNC;
+        return threadSyncBuff.data();
+    }
+
+    uint64_t tail = ring->tail.load(memory_order_relaxed);
+    uint64_t head = ring->head.load(memory_order_acquire);
+    size_t pos = (size_t)(tail % TRK_LOG_RING_BYTES);
+    size_t pad = (pos + len > TRK_LOG_RING_BYTES) ? (TRK_LOG_RING_BYTES - pos) : 0;
+    if (TRK_LOG_RING_BYTES - (tail - head) < pad + len) {
+        ring->dropped.store(ring->dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        return nullptr;
+    }
+    /* A record never wraps: the rest of the buffer becomes a pad record */
+    if (pad != 0) {
+        uint32_t padLen = (uint32_t)pad | TRK_LOG_RECORD_PAD;
+        memcpy(&ring->buff[pos], &padLen, sizeof(padLen));
+        tail += pad;
+    }
+    ring->reserveTail = tail + len;
+    threadReservation = TRK_LOG_RESERVED_RING;
+    return &ring->buff[tail % TRK_LOG_RING_BYTES];
+}
+
+void trkLogCommit(void) {
+    if (threadReservation == TRK_LOG_RESERVED_RING) {
+        threadReservation = TRK_LOG_RESERVED_NONE;
+        threadRing->tail.store(threadRing->reserveTail, memory_order_release);
+        return;
+    }
+
+    TrkLogRecord record;
+    memcpy(&record, threadSyncBuff.data(), sizeof(record));
+    string out;
+    formatRecord(&record, threadSyncBuff.data() + sizeof(record), out);
+    threadReservation = TRK_LOG_RESERVED_NONE;
+    writeOutput(out);
+}
+
+/* Next argument: its tag, and the value or the string bytes; 0xFF once the arguments run out */
+static uint8_t readArgTag(TrkLogArgReader *reader, uint64_t *bits, const uint8_t **str, uint32_t *strLen) {
+    if (reader->p >= reader->end) {
+        return 0xFF;
+    }
+    uint8_t tag = *reader->p++;
+    if (tag == TRK_LOG_ARG_STR) {
+        memcpy(strLen, reader->p, sizeof(*strLen));
+        reader->p += sizeof(*strLen);
+        *str = reader->p;
+        if (*strLen != TRK_LOG_NULL_STR) {
+            reader->p += *strLen;
+        }
+    }
+    else {
+        memcpy(bits, reader->p, sizeof(*bits));
+        reader->p += sizeof(*bits);
+    }
+    return tag;
+}
+
+static int64_t readIntArg(TrkLogArgReader *reader) {
+    uint64_t bits = 0;
+    const uint8_t *str = nullptr;
+    uint32_t strLen = 0;
+    uint8_t tag = readArgTag(reader, &bits, &str, &strLen);
+    if (tag == TRK_LOG_ARG_DOUBLE) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return (int64_t)value;
+    }
+    return (tag == TRK_LOG_ARG_STR || tag == 0xFF) ? 0 : (int64_t)bits;
+}
+
+static double readDoubleArg(TrkLogArgReader *reader) {
+    uint64_t bits = 0;
+    const uint8_t *str = nullptr;
+    uint32_t strLen = 0;
+    uint8_t tag = readArgTag(reader, &bits, &str, &strLen);
+    if (tag == TRK_LOG_ARG_DOUBLE) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    if (tag == TRK_LOG_ARG_INT) {
+        return (double)(int64_t)bits;
+    }
+    return (tag == TRK_LOG_ARG_UINT) ? (double)bits : 0.0;
+}
+
+static string readStrArg(TrkLogArgReader *reader) {
+    uint64_t bits = 0;
+    const uint8_t *str = nullptr;
+    uint32_t strLen = 0;
+    if (readArgTag(reader, &bits, &str, &strLen) != TRK_LOG_ARG_STR) {
+        return string();
+    }
+    return (strLen == TRK_LOG_NULL_STR) ? string("(null)") : string((const char *)str, strLen);
+}
+
+/* snprintf one conversion with its '*' width and precision, growing past the stack buffer when needed */
+template <typename T>
+static void appendConversion(string &out, const char *spec, const int *stars, int starCount, T value) {
+    auto format = [&](char *buff, size_t len) {
+        if (starCount == 2) {
+            return snprintf(buff, len, spec, stars[0], stars[1], value);
+        }
+        if (starCount == 1) {
+            return snprintf(buff, len, spec, stars[0], value);
+        }
+        return snprintf(buff, len, spec, value);
+    };
+
+    char buff[256];
+    int len = format(buff, sizeof(buff));
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len < sizeof(buff)) {
+        out.append(buff, (size_t)len);
+        return;
+    }
+    size_t offset = out.size();
+    out.resize(offset + (size_t)len + 1);
+    format(&out[offset], (size_t)len + 1);
+    out.resize(offset + (size_t)len);
+}
+
+/* printf the record: every conversion is formatted by snprintf with the type its length modifier implies */
+static void formatRecord(const TrkLogRecord *record, const uint8_t *args, string &out) {
+    TrkLogArgReader reader = {args, args + record->argsLen};
+    const char *f = record->site->fmt;
+
+    while (*f != '\0') {
+        if (*f != '%') {
+            const char *next = strchr(f, '%');
+            size_t len = (next != nullptr) ? (size_t)(next - f) : strlen(f);
+            out.append(f, len);
+            f += len;
+            continue;
+        }
+        if (f[1] == '%') {
+            out.push_back('%');
+            f += 2;
+            continue;
+        }
+
+        char spec[32];
+        size_t specLen = 0;
+        int stars[2];
+        int starCount = 0;
+        spec[specLen++] = *f++;
+        while (*f != '\0' && strchr("-+ #0", *f) != nullptr && specLen < 8) {
+            spec[specLen++] = *f++;
+        }
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*f != '.') {
+                    break;
+                }
+                spec[specLen++] = *f++;
+            }
+            if (*f == '*') {
+                stars[starCount++] = (int)readIntArg(&reader);
+                spec[specLen++] = *f++;
+            }
+            while (isdigit((unsigned char)*f) && specLen < 20) {
+                spec[specLen++] = *f++;
+            }
+        }
+
+        /* Integers travel as 64 bit values; truncate them as printf would for the length modifier */
+        int bits = 32;
+        if (*f == 'h') {
+            bits = (f[1] == 'h') ? 8 : 16;
+            f += (f[1] == 'h') ? 2 : 1;
+        }
+        else if (*f == 'l') {
+            bits = 64;
+            f += (f[1] == 'l') ? 2 : 1;
+        }
+        else if (*f == 'z' || *f == 'j' || *f == 't') {
+            bits = 64;
+            f++;
+        }
+        else if (*f == 'L') {
+            f++;
+        }
+
+        char conv = *f;
+        if (conv == '\0') {
+            break;
+        }
+        f++;
+        uint64_t mask = (bits == 64) ? ~0ull : ((1ull << bits) - 1);
+
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                int64_t value = readIntArg(&reader);
+                if (bits < 64) {
+                    value = (int64_t)((uint64_t)value << (64 - bits)) >> (64 - bits);
+                }
+                memcpy(&spec[specLen], "ll", 2);
+                spec[specLen + 2] = conv;
+                spec[specLen + 3] = '\0';
+                appendConversion(out, spec, stars, starCount, (long long)value);
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                uint64_t value = (uint64_t)readIntArg(&reader) & mask;
+                memcpy(&spec[specLen], "ll", 2);
+                spec[specLen + 2] = conv;
+                spec[specLen + 3] = '\0';
+                appendConversion(out, spec, stars, starCount, (unsigned long long)value);
+                break;
+            }
+            case 'c': {
+                spec[specLen] = conv;
+                spec[specLen + 1] = '\0';
+                appendConversion(out, spec, stars, starCount, (int)readIntArg(&reader));
+                break;
+            }
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                spec[specLen] = conv;
+                spec[specLen + 1] = '\0';
+                appendConversion(out, spec, stars, starCount, readDoubleArg(&reader));
+                break;
+            }
+            case 's': {
+                spec[specLen] = conv;
+                spec[specLen + 1] = '\0';
+                string value = readStrArg(&reader);
+                appendConversion(out, spec, stars, starCount, value.c_str());
+                break;
+            }
+            case 'p': {
+                spec[specLen] = conv;
+                spec[specLen + 1] = '\0';
+                appendConversion(out, spec, stars, starCount, (void *)(uintptr_t)readIntArg(&reader));
+                break;
+            }
+            default:
+                /* %n and unknown conversions print nothing */
+                break;
+        }
+    }
+
+    if (record->suppressed != 0) {
+        char note[64];
+        snprintf(note, sizeof(note), " (%u similar messages suppressed)", record->suppressed);
+        out.append(note);
+    }
+    out.push_back('\n');
+}
+
+/* One write for a batch of lines; also keeps synchronous lines from splitting a batch */
+static void writeOutput(const string &out) {
+    if (out.empty()) {
+        return;
+    }
+    lock_guard<mutex> lock(logOutputMutex);
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+}
+
+/* Format every record waiting in the rings into out, in time order. Returns the number of messages. */
+static size_t drainRings(string &out) {
+    string text;
+    vector<TrkLogLine> lines;
+    uint32_t ringCount = min(logRingCount.load(memory_order_acquire), TRK_LOG_MAX_RINGS);
+
+    for (uint32_t i = 0; i < ringCount; i++) {
+        TrkLogRing *ring = logRings[i].load(memory_order_acquire);
+        if (ring == nullptr) {
+            continue;
+        }
+        uint64_t head = ring->head.load(memory_order_relaxed);
+        uint64_t tail = ring->tail.load(memory_order_acquire);
+        while (head != tail) {
+            const uint8_t *p = &ring->buff[head % TRK_LOG_RING_BYTES];
+            uint32_t len;
+            memcpy(&len, p, sizeof(len));
+            if ((len & TRK_LOG_RECORD_PAD) != 0) {
+                head += len & ~TRK_LOG_RECORD_PAD;
+                continue;
+            }
+            TrkLogRecord record;
+            memcpy(&record, p, sizeof(record));
+            size_t offset = text.size();
+            formatRecord(&record, p + sizeof(record), text);
+            lines.push_back({record.nsecs, offset, text.size() - offset});
+            head += len;
+        }
+        ring->head.store(head, memory_order_release);
+
+        uint64_t dropped = ring->dropped.load(memory_order_relaxed);
+        if (dropped != ring->droppedReported) {
+            char note[80];
+            int len = snprintf(note, sizeof(note), "Log: %llu messages dropped on a full ring\n",
+                               (unsigned long long)(dropped - ring->droppedReported));
+            ring->droppedReported = dropped;
+            lines.push_back({trkLogNowNsecs(), text.size(), (size_t)len});
+            text.append(note, (size_t)len);
+        }
+    }
+
+    stable_sort(lines.begin(), lines.end(), [](const TrkLogLine &a, const TrkLogLine &b) {
+        return a.nsecs < b.nsecs;
+    });
+    out.clear();
+    for (const TrkLogLine &line : lines) {
+        out.append(text, line.offset, line.len);
+    }
+    return lines.size();
+}
+
+static void logWriterThreadFunc(void) {
+    string out;
+    unique_lock<mutex> lock(logWriterMutex);
+    while (!logWriterStop) {
+        lock.unlock();
+        drainRings(out);
+        writeOutput(out);
+        lock.lock();
+        logWriterCondVar.wait_for(lock, chrono::milliseconds(TRK_LOG_WRITER_POLL_MSECS),
+                                  [] { return logWriterStop; });
+    }
+    lock.unlock();
+    drainRings(out);
+    writeOutput(out);
+}
+
+void trkLogInit(void) {
+    if (logWriterThread.joinable()) {
+        return;
+    }
+    logWriterStop = false;
+    logWriterThread = thread(logWriterThreadFunc);
+    logAsync.store(true, memory_order_release);
+    if (!logAtExitSet) {
+        logAtExitSet = true;
+        atexit(trkLogShutdown);
+    }
+}
+
+void trkLogShutdown(void) {
+    if (!logWriterThread.joinable() || logWriterThread.get_id() == this_thread::get_id()) {
+        return;
+    }
+    logAsync.store(false, memory_order_release);
+    {
+        lock_guard<mutex> lock(logWriterMutex);
+        logWriterStop = true;
+    }
+    logWriterCondVar.notify_all();
+    logWriterThread.join();
+
+    /* Messages reserved just before the switch to synchronous writes */
+    string out;
+    drainRings(out);
+    writeOutput(out);
+}
@@ -0,0 +1,224 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "cloudComm.h"
+#include "uplinkBatch.h"
+#include "uplinkCodec.h"
+#include "uplinkThrottle.h"
+#include "pktTrace.h"
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static string batchBody;
+static vector<BleDataPacket> batchRecords;
+static uint64_t batchOpenedMsecs = 0;
+static uint32_t batchCount = 0;
+static UplinkAckCallback uplinkAckCb = nullptr;
+/* Binary batch state: timestamps of the first and the latest record */
+static uint32_t batchBaseTs = 0;
+static uint32_t batchPrevTs = 0;
+/* Set once the server refuses B1 with HTTP 415, batches fall back to G1 text */
+static bool b1Rejected = false;
+/* Format of the records in the current batch, fixed by its first record */
+static bool batchBinary = false;
+static UplinkCompression uplinkCompression = UPLINK_COMPRESSION_NONE;
+static string batchPayload;
+
+static vector<bool> parseBatchNacks(const string &response, size_t recordCount);
+
+void uplinkBatchInit(UplinkAckCallback ackCb) {
+    uplinkAckCb = ackCb;
+    batchBody.clear();
+    batchBody.reserve((size_t)uplinkCfg.batchMaxBytes);
+    batchRecords.clear();
+    batchRecords.reserve((size_t)uplinkCfg.batchMaxRecords);
+    uplinkCompression = parseUplinkCompression(uplinkCfg.compression);
+}
+
+bool uplinkBatchAddRecord(const char *record, size_t recordLen, const BleDataPacket &blePkt) {
+    if (record == nullptr || recordLen == 0) {
+        TRK_LOG_ERR("ERROR: Invalid input params - Record not added to the uplink batch");
+        return false;
+    }
+
+    /* Every record is terminated by the separator */
+    if (recordLen + 1 > (size_t)uplinkCfg.batchMaxBytes) {
+        TRK_LOG_ERR("ERROR: Record of %zu bytes exceeds uplink_batch_max_bytes", recordLen);
+        return false;
+    }
+
+    if (!batchRecords.empty() && (batchBinary || (batchBody.size() + recordLen + 1 > (size_t)uplinkCfg.batchMaxBytes))) {
+        uplinkBatchFlush();
+    }
+
+    if (batchRecords.empty()) {
+        batchOpenedMsecs = getMonotonicTimeMsecs();
+        batchBinary = false;
+    }
+
+    batchBody.append(record, recordLen);
+    batchBody.push_back(UPLINK_BATCH_RECORD_SEPARATOR);
+    batchRecords.push_back(blePkt);
+    pktTraceStampNow(&batchRecords.back().trace, PKT_STAGE_URL_BUILD);
+    return true;
+}
+
+bool uplinkBatchUsesBinary(void) {
+    return (isCurlReqFormatB1() && !b1Rejected);
+}
+
+bool uplinkBatchAddPacket(const BleDataPacket &blePkt) {
+    uint8_t record[B1_MAX_RECORD_LEN];
+    /* The time of the reading, not of the batching: a retried or replayed packet keeps it */
+    uint32_t ts = (blePkt.captureTs != 0) ? blePkt.captureTs : (uint32_t)getEpochTimeSecs();
+
+    if (!batchRecords.empty() && (!batchBinary || (batchBody.size() + B1_MAX_RECORD_LEN > (size_t)uplinkCfg.batchMaxBytes))) {
+        uplinkBatchFlush();
+    }
+
+    if (batchRecords.empty()) {
+        batchOpenedMsecs = getMonotonicTimeMsecs();
+        batchBaseTs = ts;
+        batchPrevTs = ts;
+        batchBinary = true;
+    }
+
+    size_t recordLen = encodeB1Record(record, blePkt, ts, batchPrevTs);
+    if (recordLen == 0) {
+        return false;
+    }
+
+    batchPrevTs = ts;
+    batchBody.append((const char *)record, recordLen);
+    batchRecords.push_back(blePkt);
+    pktTraceStampNow(&batchRecords.back().trace, PKT_STAGE_URL_BUILD);
+    return true;
+}
+
+bool uplinkBatchIsDue(void) {
+    if (batchRecords.empty()) {
+        return false;
+    }
+
+    /* The server may cap the batch below uplink_batch_max_records */
+    return ((batchRecords.size() >= getUplinkBatchMaxRecords()) ||
+            (batchBody.size() >= (size_t)uplinkCfg.batchMaxBytes) ||
+            (uplinkBatchMsecsUntilDue() == 0));
+}
+
+uint32_t uplinkBatchMsecsUntilDue(void) {
+    if (batchRecords.empty()) {
+        return (uint32_t)uplinkCfg.batchMaxDelayMsecs;
+    }
+
+    uint64_t elapsedMsecs = getMonotonicTimeMsecs() - batchOpenedMsecs;
+    if (elapsedMsecs >= (uint64_t)uplinkCfg.batchMaxDelayMsecs) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)uplinkCfg.batchMaxDelayMsecs - elapsedMsecs);
+}
+
+size_t uplinkBatchRecordCount(void) {
+    return batchRecords.size();
+}
+
+/* Parse the optional "nack=<idx>,<idx>,..." list from the batch response */
+static vector<bool> parseBatchNacks(const string &response, size_t recordCount) {
+    vector<bool> nacked(recordCount, false);
+
+    /* Only a whole key counts, not one that ends in "nack=" */
+    size_t pos = findCloudBodyKey(response, UPLINK_BATCH_NACK_KEY);
+    if (pos == string::npos) {
+        return nacked;
+    }
+
+    const char *p = response.c_str() + pos;
+    while (*p != '\0') {
+        char *end = nullptr;
+        unsigned long idx = strtoul(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        if (idx < recordCount) {
+            nacked[idx] = true;
+        }
+        if (*end != ',') {
+            break;
+        }
+        p = end + 1;
+    }
+
+    return nacked;
+}
+
+int uplinkBatchFlush(void) {
+    if (batchRecords.empty()) {
+        return -1;
+    }
+
+    if (!uplinkCircuitAllowRequest()) {
+        for (auto &blePkt : batchRecords) {
+            uplinkRetryDefer(blePkt, false);
+        }
+        batchBody.clear();
+        batchRecords.clear();
+        return 1;
+    }
+
+    /* Binary batches get the gateway header once, in front of all records */
+    bool binaryBatch = batchBinary;
+    const string *payload = &batchBody;
+    if (binaryBatch) {
+        batchPayload.clear();
+        encodeB1BatchHeader(batchPayload, batchBaseTs, (uint32_t)batchRecords.size());
+        batchPayload.append(batchBody);
+        payload = &batchPayload;
+    }
+
+    string compressedPayload;
+    UplinkCompression applied = compressUplinkPayload(uplinkCompression, *payload, compressedPayload);
+    if (applied != UPLINK_COMPRESSION_NONE) {
+        payload = &compressedPayload;
+    }
+
+    uint64_t sendNsecs = pktTraceNowNsecs();
+    for (auto &blePkt : batchRecords) {
+        pktTraceStamp(&blePkt.trace, PKT_STAGE_SEND, sendNsecs);
+    }
+
+    CloudRequest req;
+    int ret = postDataBatchToCloud(&req, payload->data(), payload->size(),
+                                   binaryBatch ? B1_CONTENT_TYPE : UPLINK_BATCH_CONTENT_TYPE,
+                                   getUplinkContentEncoding(applied));
+    bool batchAccepted = (ret == 0 && req.httpCode == 200);
+    UplinkResult batchResult = classifyUplinkResponse(req.httpCode);
+
+    TRK_PRINTF("Uplink_Batch %u: %zu records, %zu bytes (%zu on wire), HTTP %ld", ++batchCount,
+               batchRecords.size(), batchBody.size(), payload->size(), req.httpCode);
+
+    if (binaryBatch && req.httpCode == 415) {
+        TRK_PRINTF("Uplink_Batch: server does not accept B1, falling back to G1 text batches");
+        b1Rejected = true;
+        /* The records themselves are fine, resend them as text */
+        batchResult = UPLINK_RESULT_RETRY;
+    }
+    uplinkCircuitReport(batchResult);
+
+    /* Hand the per-record result back to the pipeline */
+    vector<bool> nacked = parseBatchNacks(req.response, batchRecords.size());
+    if (uplinkAckCb != nullptr) {
+        for (size_t i = 0; i < batchRecords.size(); i++) {
+            /* Records the server nacked in an accepted batch are retried */
+            uplinkAckCb(batchRecords[i], (batchAccepted && !nacked[i]) ? UPLINK_RESULT_ACKED :
+                                         (batchAccepted ? UPLINK_RESULT_RETRY : batchResult));
+        }
+    }
+
+    batchBody.clear();
+    batchRecords.clear();
+    return batchAccepted ? 0 : 1;
+}
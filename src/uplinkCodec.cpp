@@ -0,0 +1,142 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <zlib.h>
+#ifdef UPLINK_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "common.h"
+#include "config.h"
+#include "cloudComm.h"
+#include "uplinkCodec.h"
+#include "urlBuilder.h"
+
+using namespace std;
+
+#define UPLINK_DEFLATE_LEVEL                      (6)
+#define UPLINK_ZSTD_LEVEL                         (3)
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static int8_t getBlePacketRssi(const BleDataPacket &blePkt);
+static int32_t parseCoordinateMicroDeg(const char *coordinate);
+
+size_t encodeVarintU32(uint8_t *out, uint32_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+size_t encodeVarintS32(uint8_t *out, int32_t value) {
+    /* Zigzag: small negative numbers map to small unsigned numbers */
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    return encodeVarintU32(out, zigzag);
+}
+
+static int32_t parseCoordinateMicroDeg(const char *coordinate) {
+    if (coordinate == nullptr) {
+        return 0;
+    }
+    return (int32_t)(strtod(coordinate, nullptr) * 1000000.0);
+}
+
+void encodeB1BatchHeader(string &out, uint32_t baseTs, uint32_t recordCount) {
+    uint8_t buff[5];
+    const char *gwId = getGwId();
+    size_t gwIdLen = (gwId != nullptr) ? strlen(gwId) : 0;
+
+    out.push_back(B1_MAGIC_0);
+    out.push_back(B1_MAGIC_1);
+    out.push_back((char)B1_FORMAT_VERSION);
+    out.append((const char *)buff, encodeVarintU32(buff, (uint32_t)gwIdLen));
+    out.append(gwId != nullptr ? gwId : "", gwIdLen);
+    out.append((const char *)buff, encodeVarintS32(buff, parseCoordinateMicroDeg(gwCfg.gwLat)));
+    out.append((const char *)buff, encodeVarintS32(buff, parseCoordinateMicroDeg(gwCfg.gwLon)));
+    out.append((const char *)buff, encodeVarintU32(buff, baseTs));
+    out.append((const char *)buff, encodeVarintU32(buff, recordCount));
+}
+
+static int8_t getBlePacketRssi(const BleDataPacket &blePkt) {
+    switch (blePkt.blePktType) {
+        case QuartzSensor_TMP117:  return blePkt.blePktStrct.blePkt_TMP117.rssi;
+        case QuartzSensor_OPT3110: return blePkt.blePktStrct.blePkt_OPT3110.rssi;
+        case QuartzSensor_IAT:     return blePkt.blePktStrct.blePkt_IAT.rssi;
+        case QuartzSensor_DPD:     return blePkt.blePktStrct.blePkt_DPD.rssi;
+        default:                   return 0;
+    }
+}
+
+size_t encodeB1Record(uint8_t *out, const BleDataPacket &blePkt, uint32_t ts, uint32_t prevTs) {
+    const char *macAddr = getBlePacketMacAddr(blePkt);
+    if (out == nullptr || macAddr == nullptr) {
+        return 0;
+    }
+
+    size_t len = 0;
+    /* MAC string is 12 hex digits without separators */
+    for (size_t i = 0; i < MAC_ADDR_LEN; i++) {
+        char byteStr[3] = {macAddr[2 * i], macAddr[2 * i + 1], '\0'};
+        out[len++] = (uint8_t)strtoul(byteStr, nullptr, 16);
+    }
+    len += encodeVarintS32(&out[len], (int32_t)(ts - prevTs));
+    len += encodeVarintU32(&out[len], (uint32_t)getNextUplinkSeqNumber(blePkt.blePktType));
+    out[len++] = (uint8_t)blePkt.blePktType;
+    out[len++] = (uint8_t)getBlePacketRssi(blePkt);
+    memcpy(&out[len], blePkt.bleBuff, WHITE_TAPE_DATA_PACKET_LEN);
+    len += WHITE_TAPE_DATA_PACKET_LEN;
+    return len;
+}
+
+UplinkCompression parseUplinkCompression(const char *name) {
+    if (name == nullptr) {
+        return UPLINK_COMPRESSION_NONE;
+    }
+    if (strcmp(name, "deflate") == 0) {
+        return UPLINK_COMPRESSION_DEFLATE;
+    }
+    if (strcmp(name, "zstd") == 0) {
+        return UPLINK_COMPRESSION_ZSTD;
+    }
+    return UPLINK_COMPRESSION_NONE;
+}
+
+const char *getUplinkContentEncoding(UplinkCompression compression) {
+    switch (compression) {
+        case UPLINK_COMPRESSION_DEFLATE: return "deflate";
+        case UPLINK_COMPRESSION_ZSTD:    return "zstd";
+        default:                         return nullptr;
+    }
+}
+
+UplinkCompression compressUplinkPayload(UplinkCompression compression, const string &in, string &out) {
+    if (in.empty() || compression == UPLINK_COMPRESSION_NONE) {
+        return UPLINK_COMPRESSION_NONE;
+    }
+
+#ifdef UPLINK_HAVE_ZSTD
+    if (compression == UPLINK_COMPRESSION_ZSTD) {
+        out.resize(ZSTD_compressBound(in.size()));
+        size_t outLen = ZSTD_compress(&out[0], out.size(), in.data(), in.size(), UPLINK_ZSTD_LEVEL);
+        if (ZSTD_isError(outLen)) {
+            TRK_LOG_ERR("ERROR: zstd compression failed: %s", ZSTD_getErrorName(outLen));
+            return UPLINK_COMPRESSION_NONE;
+        }
+        out.resize(outLen);
+        return UPLINK_COMPRESSION_ZSTD;
+    }
+#endif
+
+    /* HTTP "deflate" is the zlib stream format produced by compress2() */
+    uLongf outLen = compressBound((uLong)in.size());
+    out.resize(outLen);
+    if (compress2((Bytef *)&out[0], &outLen, (const Bytef *)in.data(), (uLong)in.size(),
+                  UPLINK_DEFLATE_LEVEL) != Z_OK) {
+        TRK_LOG_ERR("ERROR: deflate compression failed");
+        return UPLINK_COMPRESSION_NONE;
+    }
+    out.resize(outLen);
+    return UPLINK_COMPRESSION_DEFLATE;
+}
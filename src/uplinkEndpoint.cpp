@@ -0,0 +1,184 @@
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "uplinkEndpoint.h"
+
+using namespace std;
+
+typedef struct UplinkEndpoint {
+    const char *instance;
+    double latencyMsecs;                 /* Weighted average response time, 0 until the first response */
+    uint32_t consecutiveFailures;
+    bool healthy;
+    uint64_t lastUsedMsecs;              /* Last request or probe */
+    uint64_t failedAtMsecs;              /* When it left the rotation, or failed its last probe */
+    uint64_t requests;
+    uint64_t failures;
+} UplinkEndpoint;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static vector<UplinkEndpoint> uplinkEndpoints;
+static size_t spreadCursor = 0;
+
+static bool isValidEndpoint(int endpoint);
+static uint64_t getProbeDueMsecs(const UplinkEndpoint &ep);
+
+/* ----------------- Function Definitions ---------------------- */
+static bool isValidEndpoint(int endpoint) {
+    return (endpoint >= 0 && (size_t)endpoint < uplinkEndpoints.size());
+}
+
+static uint64_t getProbeDueMsecs(const UplinkEndpoint &ep) {
+    uint64_t intervalMsecs = (uint64_t)endpointCfg.probeIntervalSecs * 1000u;
+    return (ep.healthy ? ep.lastUsedMsecs : max(ep.failedAtMsecs, ep.lastUsedMsecs)) + intervalMsecs;
+}
+
+void uplinkEndpointInit(void) {
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    uplinkEndpoints.clear();
+    for (const char *instance : urlCfg.instances) {
+        if (instance != nullptr) {
+            uplinkEndpoints.push_back({instance, 0.0, 0, true, nowMsecs, 0, 0, 0});
+        }
+    }
+    /* Before the config is read (benchmarks), the plain instance is the only endpoint */
+    if (uplinkEndpoints.empty() && urlCfg.instance != nullptr) {
+        uplinkEndpoints.push_back({urlCfg.instance, 0.0, 0, true, nowMsecs, 0, 0, 0});
+    }
+    spreadCursor = 0;
+}
+
+size_t getUplinkEndpointCount(void) {
+    return uplinkEndpoints.size();
+}
+
+const char *getUplinkEndpointInstance(int endpoint) {
+    return isValidEndpoint(endpoint) ? uplinkEndpoints[endpoint].instance : nullptr;
+}
+
+int uplinkEndpointSelect(void) {
+    if (uplinkEndpoints.size() <= 1) {
+        return uplinkEndpoints.empty() ? UPLINK_ENDPOINT_NONE : 0;
+    }
+
+    int best = UPLINK_ENDPOINT_NONE;
+    for (size_t i = 0; i < uplinkEndpoints.size(); i++) {
+        const UplinkEndpoint &ep = uplinkEndpoints[i];
+        if (ep.healthy && (best == UPLINK_ENDPOINT_NONE || ep.latencyMsecs < uplinkEndpoints[best].latencyMsecs)) {
+            best = (int)i;
+        }
+    }
+
+    if (best == UPLINK_ENDPOINT_NONE) {
+        /* All failed: the one that failed longest ago is the most likely to have recovered */
+        best = 0;
+        for (size_t i = 1; i < uplinkEndpoints.size(); i++) {
+            if (uplinkEndpoints[i].failedAtMsecs < uplinkEndpoints[best].failedAtMsecs) {
+                best = (int)i;
+            }
+        }
+        return best;
+    }
+
+    /* Spread the load over the endpoints about as fast as the best one; unmeasured ones (0) go first */
+    double limitMsecs = uplinkEndpoints[best].latencyMsecs * (1.0 + (double)endpointCfg.spreadPct / 100.0);
+    int candidates[UPLINK_MAX_ENDPOINTS];
+    size_t count = 0;
+    for (size_t i = 0; i < uplinkEndpoints.size() && count < UPLINK_MAX_ENDPOINTS; i++) {
+        if (uplinkEndpoints[i].healthy && uplinkEndpoints[i].latencyMsecs <= limitMsecs) {
+            candidates[count++] = (int)i;
+        }
+    }
+    return candidates[spreadCursor++ % count];
+}
+
+int uplinkEndpointSelectFailover(int failedEndpoint) {
+    int best = UPLINK_ENDPOINT_NONE;
+    for (size_t i = 0; i < uplinkEndpoints.size(); i++) {
+        const UplinkEndpoint &ep = uplinkEndpoints[i];
+        if ((int)i != failedEndpoint && ep.healthy &&
+            (best == UPLINK_ENDPOINT_NONE || ep.latencyMsecs < uplinkEndpoints[best].latencyMsecs)) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+bool isUplinkEndpointFailure(int curlCode, long httpCode) {
+    return (curlCode != 0 || httpCode == 0 || httpCode >= 500);
+}
+
+void uplinkEndpointReport(int endpoint, int curlCode, long httpCode, double totalTimeSecs) {
+    if (!isValidEndpoint(endpoint)) {
+        return;
+    }
+
+    UplinkEndpoint &ep = uplinkEndpoints[endpoint];
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    ep.lastUsedMsecs = nowMsecs;
+    ep.requests++;
+
+    if (isUplinkEndpointFailure(curlCode, httpCode)) {
+        ep.failures++;
+        ep.consecutiveFailures++;
+        if (!ep.healthy) {
+            /* A failed probe restarts the probe interval */
+            ep.failedAtMsecs = nowMsecs;
+        }
+        else if (ep.consecutiveFailures >= (uint32_t)endpointCfg.failThreshold) {
+            ep.healthy = false;
+            ep.failedAtMsecs = nowMsecs;
+            TRK_PRINTF("Uplink_Endpoint: %s out of rotation after %u failures (curl=%d, http=%ld)",
+                       ep.instance, ep.consecutiveFailures, curlCode, httpCode);
+        }
+        return;
+    }
+
+    double latencyMsecs = totalTimeSecs * 1000.0;
+    ep.latencyMsecs = (ep.latencyMsecs == 0.0) ? latencyMsecs :
+                      (ep.latencyMsecs + UPLINK_ENDPOINT_LATENCY_WEIGHT * (latencyMsecs - ep.latencyMsecs));
+    ep.consecutiveFailures = 0;
+    if (!ep.healthy) {
+        ep.healthy = true;
+        TRK_PRINTF("Uplink_Endpoint: %s back in rotation (%.0f ms)", ep.instance, latencyMsecs);
+    }
+}
+
+int uplinkEndpointProbeDue(void) {
+    if (uplinkEndpoints.size() <= 1) {
+        return UPLINK_ENDPOINT_NONE;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    for (size_t i = 0; i < uplinkEndpoints.size(); i++) {
+        if (nowMsecs >= getProbeDueMsecs(uplinkEndpoints[i])) {
+            return (int)i;
+        }
+    }
+    return UPLINK_ENDPOINT_NONE;
+}
+
+uint32_t uplinkEndpointMsecsUntilProbe(void) {
+    if (uplinkEndpoints.size() <= 1) {
+        return UINT32_MAX;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    uint64_t waitMsecs = UINT32_MAX;
+    for (const auto &ep : uplinkEndpoints) {
+        uint64_t dueMsecs = getProbeDueMsecs(ep);
+        waitMsecs = min(waitMsecs, (dueMsecs > nowMsecs) ? (dueMsecs - nowMsecs) : 0);
+    }
+    return (uint32_t)waitMsecs;
+}
+
+void logUplinkEndpoints(void) {
+    for (const auto &ep : uplinkEndpoints) {
+        TRK_PRINTF("Uplink_Endpoint: %s %s latency=%.0f ms requests=%llu failures=%llu", ep.instance,
+                   ep.healthy ? "healthy" : "failed", ep.latencyMsecs, (unsigned long long)ep.requests,
+                   (unsigned long long)ep.failures);
+    }
+}
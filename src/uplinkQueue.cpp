@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "uplinkQueue.h"
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+/* Readings in order of their slot; queuedPackets[i] has sequence headSeq + i */
+static deque<BleDataPacket> queuedPackets;
+static uint64_t headSeq = 0;
+/* Sequence of the unsent routine reading of each tape MAC + device type */
+static unordered_map<string, uint64_t> routineSlots;
+static UplinkQueueStats queueStats = {0};
+
+static string getTapeKey(const char *mac, const BleDataPacket &blePkt);
+
+/* ----------------- Function Definitions ---------------------- */
+bool isRoutineBlePacket(const BleDataPacket &blePkt) {
+    /* A backfilled log record is history, a newer reading does not replace it */
+    if ((blePkt.pktFlags & BLE_PKT_FLAG_BACKFILL) != 0) {
+        return false;
+    }
+    switch (getBlePacketEvtFlag(blePkt)) {
+        case NormalMode:
+        case HeartbeatMode:
+        case TemperatureHeartbeatMode:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static string getTapeKey(const char *mac, const BleDataPacket &blePkt) {
+    return string(mac) + "/" + to_string((int)blePkt.blePktType);
+}
+
+bool uplinkQueuePush(const BleDataPacket &blePkt, BleDataPacket *superseded) {
+    queueStats.queued++;
+
+    const char *mac = getBlePacketMacAddr(blePkt);
+    if (uplinkCfg.coalesce && mac != nullptr && isRoutineBlePacket(blePkt)) {
+        string key = getTapeKey(mac, blePkt);
+        auto slotIt = routineSlots.find(key);
+        if (slotIt != routineSlots.end()) {
+            /* Only the newest reading is worth sending; it keeps the older one's place in line */
+            BleDataPacket &slot = queuedPackets[slotIt->second - headSeq];
+            if (superseded != nullptr) {
+                *superseded = slot;
+            }
+            slot = blePkt;
+            queueStats.coalesced++;
+            if ((queueStats.coalesced % UPLINK_QUEUE_LOG_INTERVAL) == 1) {
+                TRK_PRINTF("Uplink_Queue: queued=%llu coalesced=%llu depth=%zu max_depth=%zu",
+                           (unsigned long long)queueStats.queued, (unsigned long long)queueStats.coalesced,
+                           queuedPackets.size(), queueStats.maxDepth);
+            }
+            return true;
+        }
+        routineSlots.emplace(key, headSeq + queuedPackets.size());
+    }
+
+    queuedPackets.push_back(blePkt);
+    queueStats.maxDepth = max(queueStats.maxDepth, queuedPackets.size());
+    return false;
+}
+
+size_t uplinkQueueTake(vector<BleDataPacket> &blePkts, size_t maxCount) {
+    size_t taken = 0;
+    while (!queuedPackets.empty() && taken < maxCount) {
+        const BleDataPacket &blePkt = queuedPackets.front();
+        const char *mac = getBlePacketMacAddr(blePkt);
+        if (!routineSlots.empty() && mac != nullptr) {
+            /* Once sent, the tape's next routine reading needs a slot of its own */
+            auto slotIt = routineSlots.find(getTapeKey(mac, blePkt));
+            if (slotIt != routineSlots.end() && slotIt->second == headSeq) {
+                routineSlots.erase(slotIt);
+            }
+        }
+        blePkts.push_back(blePkt);
+        queuedPackets.pop_front();
+        headSeq++;
+        taken++;
+    }
+    queueStats.taken += taken;
+    return taken;
+}
+
+size_t uplinkQueueDepth(void) {
+    return queuedPackets.size();
+}
+
+void getUplinkQueueStats(UplinkQueueStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    *stats = queueStats;
+    stats->depth = queuedPackets.size();
+}
@@ -0,0 +1,272 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "uplinkQueue.h"
+#include "uplinkRateLimit.h"
+
+/* A bucket counts RATE_UNITS_PER_TOKEN units per token, so a rate in packets per
+   minute refills exactly perMin units per millisecond, without rounding drift */
+#define RATE_UNITS_PER_TOKEN                      (60000u)
+/* Idle (full) tape buckets are dropped once there are more than this */
+#define RATE_MAX_IDLE_TAPE_BUCKETS                (1024u)
+
+using namespace std;
+
+typedef struct TokenBucket {
+    uint64_t units;
+    uint64_t refillMsecs;
+} TokenBucket;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static mutex rateMutex;
+static TokenBucket globalBucket;
+static TokenBucket typeBuckets[QuartzSensor_Max];
+static unordered_map<string, TokenBucket> tapeBuckets;
+
+/* Held packets in order of arrival, keyed by tape MAC + device type */
+typedef struct HeldPacket {
+    string key;
+    BleDataPacket blePkt;
+} HeldPacket;
+
+/* Every packet of a key has the same tape and device type */
+typedef struct HeldKey {
+    uint32_t count;
+    string mac;
+    BlePacketType blePktType;
+} HeldKey;
+
+static list<HeldPacket> heldPackets;
+/* The held routine reading of each key, replaced by a newer one */
+static unordered_map<string, list<HeldPacket>::iterator> heldRoutine;
+static unordered_map<string, HeldKey> heldKeys;
+static UplinkRateLimitStats rateStats = {0};
+
+static void refillBucket(TokenBucket &bucket, int perMin, int burst, uint64_t nowMsecs);
+static uint64_t getBucketMsecsUntilToken(const TokenBucket &bucket, int perMin);
+static TokenBucket &getTapeBucket(const string &mac, uint64_t nowMsecs);
+static uint64_t getTapeMsecsUntilToken(const string &mac, uint64_t nowMsecs);
+static bool takeTokens(const BleDataPacket &blePkt, TokenBucket &tapeBucket, uint64_t nowMsecs);
+
+/* ----------------- Function Definitions ---------------------- */
+static void refillBucket(TokenBucket &bucket, int perMin, int burst, uint64_t nowMsecs) {
+    if (perMin > 0 && nowMsecs > bucket.refillMsecs) {
+        uint64_t capacity = (uint64_t)burst * RATE_UNITS_PER_TOKEN;
+        bucket.units = min(capacity, bucket.units + (nowMsecs - bucket.refillMsecs) * (uint64_t)perMin);
+    }
+    bucket.refillMsecs = nowMsecs;
+}
+
+static uint64_t getBucketMsecsUntilToken(const TokenBucket &bucket, int perMin) {
+    if (perMin <= 0 || bucket.units >= RATE_UNITS_PER_TOKEN) {
+        return 0;
+    }
+    return (RATE_UNITS_PER_TOKEN - bucket.units + (uint64_t)perMin - 1) / (uint64_t)perMin;
+}
+
+static TokenBucket &getTapeBucket(const string &mac, uint64_t nowMsecs) {
+    auto it = tapeBuckets.find(mac);
+    if (it != tapeBuckets.end()) {
+        refillBucket(it->second, rateLimitCfg.tapePerMin, rateLimitCfg.tapeBurst, nowMsecs);
+        return it->second;
+    }
+
+    if (tapeBuckets.size() >= RATE_MAX_IDLE_TAPE_BUCKETS) {
+        /* A full bucket carries no state, it is recreated full on the next packet */
+        for (auto bucketIt = tapeBuckets.begin(); bucketIt != tapeBuckets.end();) {
+            refillBucket(bucketIt->second, rateLimitCfg.tapePerMin, rateLimitCfg.tapeBurst, nowMsecs);
+            if (bucketIt->second.units >= (uint64_t)rateLimitCfg.tapeBurst * RATE_UNITS_PER_TOKEN) {
+                bucketIt = tapeBuckets.erase(bucketIt);
+            }
+            else {
+                ++bucketIt;
+            }
+        }
+    }
+
+    TokenBucket bucket = {(uint64_t)rateLimitCfg.tapeBurst * RATE_UNITS_PER_TOKEN, nowMsecs};
+    return tapeBuckets.emplace(mac, bucket).first->second;
+}
+
+/* Like getTapeBucket() but never adds a bucket; a tape without one has a full bucket */
+static uint64_t getTapeMsecsUntilToken(const string &mac, uint64_t nowMsecs) {
+    auto it = tapeBuckets.find(mac);
+    if (it == tapeBuckets.end()) {
+        return 0;
+    }
+    refillBucket(it->second, rateLimitCfg.tapePerMin, rateLimitCfg.tapeBurst, nowMsecs);
+    return getBucketMsecsUntilToken(it->second, rateLimitCfg.tapePerMin);
+}
+
+/* Takes one token from each level if all of them have one */
+static bool takeTokens(const BleDataPacket &blePkt, TokenBucket &tapeBucket, uint64_t nowMsecs) {
+    TokenBucket &typeBucket = typeBuckets[blePkt.blePktType];
+    refillBucket(globalBucket, rateLimitCfg.globalPerMin, rateLimitCfg.globalBurst, nowMsecs);
+    refillBucket(typeBucket, rateLimitCfg.typePerMin, rateLimitCfg.typeBurst, nowMsecs);
+
+    if (getBucketMsecsUntilToken(globalBucket, rateLimitCfg.globalPerMin) > 0 ||
+        getBucketMsecsUntilToken(typeBucket, rateLimitCfg.typePerMin) > 0 ||
+        getBucketMsecsUntilToken(tapeBucket, rateLimitCfg.tapePerMin) > 0) {
+        return false;
+    }
+
+    if (rateLimitCfg.globalPerMin > 0) {
+        globalBucket.units -= RATE_UNITS_PER_TOKEN;
+    }
+    if (rateLimitCfg.typePerMin > 0) {
+        typeBucket.units -= RATE_UNITS_PER_TOKEN;
+    }
+    if (rateLimitCfg.tapePerMin > 0) {
+        tapeBucket.units -= RATE_UNITS_PER_TOKEN;
+    }
+    return true;
+}
+
+void uplinkRateLimitInit(void) {
+    lock_guard<mutex> lock(rateMutex);
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    globalBucket = {(uint64_t)rateLimitCfg.globalBurst * RATE_UNITS_PER_TOKEN, nowMsecs};
+    for (auto &bucket : typeBuckets) {
+        bucket = {(uint64_t)rateLimitCfg.typeBurst * RATE_UNITS_PER_TOKEN, nowMsecs};
+    }
+    tapeBuckets.clear();
+}
+
+UplinkRateVerdict uplinkRateLimitAdmit(const BleDataPacket &blePkt, BleDataPacket *superseded) {
+    if (superseded != nullptr) {
+        superseded->spoolId = 0;
+    }
+    if (rateLimitCfg.globalPerMin == 0 && rateLimitCfg.typePerMin == 0 && rateLimitCfg.tapePerMin == 0) {
+        return UPLINK_RATE_ADMITTED;
+    }
+
+    /* A log backfill is read once per connection and must get through whole */
+    const char *mac = getBlePacketMacAddr(blePkt);
+    if (mac == nullptr || (blePkt.pktFlags & BLE_PKT_FLAG_BACKFILL) != 0) {
+        return UPLINK_RATE_ADMITTED;
+    }
+
+    lock_guard<mutex> lock(rateMutex);
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    string key = string(mac) + "/" + to_string((int)blePkt.blePktType);
+
+    /* A tape with a held reading waits its turn, otherwise it could overtake it */
+    auto keyIt = heldKeys.find(key);
+    if (keyIt == heldKeys.end() && takeTokens(blePkt, getTapeBucket(mac, nowMsecs), nowMsecs)) {
+        rateStats.admitted++;
+        return UPLINK_RATE_ADMITTED;
+    }
+
+    auto routineIt = heldRoutine.find(key);
+    if (isRoutineBlePacket(blePkt) && routineIt != heldRoutine.end()) {
+        /* Only the newest routine reading is worth sending; it keeps the older one's place in line */
+        if (superseded != nullptr) {
+            *superseded = routineIt->second->blePkt;
+        }
+        routineIt->second->blePkt = blePkt;
+        rateStats.held++;
+        rateStats.coalesced++;
+    }
+    else if ((keyIt != heldKeys.end() && keyIt->second.count >= UPLINK_RATE_MAX_HELD_PER_KEY) ||
+             heldPackets.size() >= UPLINK_RATE_MAX_HELD) {
+        /* The packet is already on disk, the spool replay sends it once the uplink catches up */
+        rateStats.spilled++;
+        if ((rateStats.spilled % UPLINK_RATE_LOG_INTERVAL) == 1) {
+            TRK_LOG_WARN("Uplink_Rate: hold cap reached for %s, spilled=%llu pending=%zu", key.c_str(),
+                         (unsigned long long)rateStats.spilled, heldPackets.size());
+        }
+        return UPLINK_RATE_SPILLED;
+    }
+    else {
+        /* Events and violations are held each on their own and never replaced */
+        heldPackets.push_back({key, blePkt});
+        if (keyIt == heldKeys.end()) {
+            keyIt = heldKeys.emplace(key, HeldKey{0, mac, blePkt.blePktType}).first;
+        }
+        keyIt->second.count++;
+        if (isRoutineBlePacket(blePkt)) {
+            heldRoutine[key] = prev(heldPackets.end());
+        }
+        rateStats.held++;
+    }
+
+    if ((rateStats.held % UPLINK_RATE_LOG_INTERVAL) == 1) {
+        TRK_PRINTF("Uplink_Rate: held=%llu coalesced=%llu released=%llu pending=%zu",
+                   (unsigned long long)rateStats.held, (unsigned long long)rateStats.coalesced,
+                   (unsigned long long)rateStats.released, heldPackets.size());
+    }
+    return UPLINK_RATE_HELD;
+}
+
+size_t uplinkRateLimitRelease(vector<BleDataPacket> &blePkts) {
+    lock_guard<mutex> lock(rateMutex);
+    if (heldPackets.empty()) {
+        return 0;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    size_t released = 0;
+    /* Tapes whose oldest held packet is still short of tokens; their later packets wait behind it */
+    unordered_set<string> blockedKeys;
+    for (auto it = heldPackets.begin(); it != heldPackets.end();) {
+        const BleDataPacket &blePkt = it->blePkt;
+        if (blockedKeys.count(it->key) > 0 ||
+            !takeTokens(blePkt, getTapeBucket(getBlePacketMacAddr(blePkt), nowMsecs), nowMsecs)) {
+            blockedKeys.insert(it->key);
+            ++it;
+            continue;
+        }
+
+        blePkts.push_back(blePkt);
+        auto routineIt = heldRoutine.find(it->key);
+        if (routineIt != heldRoutine.end() && routineIt->second == it) {
+            heldRoutine.erase(routineIt);
+        }
+        auto keyIt = heldKeys.find(it->key);
+        if (--keyIt->second.count == 0) {
+            heldKeys.erase(keyIt);
+        }
+        it = heldPackets.erase(it);
+        released++;
+    }
+    rateStats.released += released;
+    return released;
+}
+
+uint32_t uplinkRateLimitMsecsUntilRelease(void) {
+    lock_guard<mutex> lock(rateMutex);
+    if (heldPackets.empty()) {
+        return UINT32_MAX;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    refillBucket(globalBucket, rateLimitCfg.globalPerMin, rateLimitCfg.globalBurst, nowMsecs);
+    uint64_t globalWait = getBucketMsecsUntilToken(globalBucket, rateLimitCfg.globalPerMin);
+    uint64_t waitMsecs = UINT32_MAX;
+    /* Only the oldest packet of a key can be released next, and it shares its buckets with the rest of the key */
+    for (auto &heldKey : heldKeys) {
+        TokenBucket &typeBucket = typeBuckets[heldKey.second.blePktType];
+        refillBucket(typeBucket, rateLimitCfg.typePerMin, rateLimitCfg.typeBurst, nowMsecs);
+        waitMsecs = min(waitMsecs, max({globalWait, getBucketMsecsUntilToken(typeBucket, rateLimitCfg.typePerMin),
+                                        getTapeMsecsUntilToken(heldKey.second.mac, nowMsecs)}));
+    }
+    return (uint32_t)waitMsecs;
+}
+
+void getUplinkRateLimitStats(UplinkRateLimitStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    lock_guard<mutex> lock(rateMutex);
+    *stats = rateStats;
+    stats->pending = heldPackets.size();
+}
@@ -0,0 +1,250 @@
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <algorithm>
+#include "common.h"
+#include "config.h"
+#include "uplinkQueue.h"
+#include "uplinkRetry.h"
+#include "uplinkSpool.h"
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+typedef struct RetryEntry {
+    BleDataPacket blePkt;
+    uint64_t dueMsecs;
+} RetryEntry;
+
+static deque<RetryEntry> retryQueue;
+static UplinkRetryStats retryStats = {};
+static mt19937 retryRng(random_device{}());
+
+static UplinkCircuitState circuitState = UPLINK_CIRCUIT_CLOSED;
+static uint32_t circuitFailures = 0;
+static uint32_t circuitOpenMsecs = 0;
+static uint64_t circuitProbeAtMsecs = 0;
+/* Set by a server Retry-After: nothing is sent before this time */
+static uint64_t serverHoldUntilMsecs = 0;
+
+static const char *getCircuitStateName(UplinkCircuitState state);
+static void openCircuit(uint64_t nowMsecs);
+
+/* ----------------- Function Definitions ---------------------- */
+UplinkResult classifyUplinkResponse(long httpCode) {
+    if (httpCode == 200) {
+        return UPLINK_RESULT_ACKED;
+    }
+    /* No response (timeout, DNS, connect, TLS), request timeout, throttled or server side failure */
+    if (httpCode == 0 || httpCode == 408 || httpCode == 429 || (httpCode >= 500 && httpCode <= 599)) {
+        return UPLINK_RESULT_RETRY;
+    }
+    return UPLINK_RESULT_REJECTED;
+}
+
+uint32_t getRetryBackoffMsecs(uint32_t attempt, uint32_t baseMsecs, uint32_t maxMsecs) {
+    uint64_t ceilingMsecs = baseMsecs;
+    for (uint32_t i = 0; i < attempt && ceilingMsecs < maxMsecs; i++) {
+        ceilingMsecs <<= 1;
+    }
+    ceilingMsecs = min(ceilingMsecs, (uint64_t)maxMsecs);
+
+    uniform_int_distribution<uint32_t> jitter(0, (uint32_t)ceilingMsecs);
+    return jitter(retryRng);
+}
+
+static const char *getCircuitStateName(UplinkCircuitState state) {
+    switch (state) {
+        case UPLINK_CIRCUIT_CLOSED:
+            return "closed";
+        case UPLINK_CIRCUIT_OPEN:
+            return "open";
+        case UPLINK_CIRCUIT_HALF_OPEN:
+            return "half-open";
+        default:
+            return "unknown";
+    }
+}
+
+static void openCircuit(uint64_t nowMsecs) {
+    /* The first open period is breaker_open_ms, every failed probe doubles it */
+    if (circuitState == UPLINK_CIRCUIT_HALF_OPEN) {
+        circuitOpenMsecs = min(circuitOpenMsecs * 2u, (uint32_t)retryCfg.breakerMaxOpenMsecs);
+    }
+    else {
+        circuitOpenMsecs = (uint32_t)retryCfg.breakerOpenMsecs;
+    }
+
+    /* Spread the probes of a gateway fleet that lost the endpoint at the same time */
+    uint32_t openMsecs = circuitOpenMsecs / 2u + getRetryBackoffMsecs(0, circuitOpenMsecs / 2u, circuitOpenMsecs);
+    circuitProbeAtMsecs = nowMsecs + openMsecs;
+    circuitState = UPLINK_CIRCUIT_OPEN;
+    retryStats.circuitOpens++;
+    TRK_PRINTF("Uplink_Retry: circuit open after %u failures, next probe in %u ms", circuitFailures, openMsecs);
+}
+
+void uplinkCircuitHoldOff(uint32_t holdMsecs) {
+    uint64_t untilMsecs = getMonotonicTimeMsecs() + holdMsecs;
+    if (untilMsecs > serverHoldUntilMsecs) {
+        serverHoldUntilMsecs = untilMsecs;
+        retryStats.serverHolds++;
+        TRK_PRINTF("Uplink_Retry: server asked to hold off for %u ms", holdMsecs);
+    }
+}
+
+bool uplinkCircuitAllowRequest(void) {
+    if (getMonotonicTimeMsecs() < serverHoldUntilMsecs) {
+        return false;
+    }
+
+    switch (circuitState) {
+        case UPLINK_CIRCUIT_CLOSED:
+            return true;
+        case UPLINK_CIRCUIT_OPEN:
+            if (getMonotonicTimeMsecs() < circuitProbeAtMsecs) {
+                return false;
+            }
+            circuitState = UPLINK_CIRCUIT_HALF_OPEN;
+            TRK_PRINTF("Uplink_Retry: circuit %s, sending a probe", getCircuitStateName(circuitState));
+            return true;
+        case UPLINK_CIRCUIT_HALF_OPEN:
+        default:
+            return false;
+    }
+}
+
+void uplinkCircuitReport(UplinkResult result) {
+    if (result != UPLINK_RESULT_RETRY) {
+        /* Any definitive answer means the endpoint is alive */
+        if (circuitState != UPLINK_CIRCUIT_CLOSED) {
+            TRK_PRINTF("Uplink_Retry: probe succeeded, circuit closed");
+        }
+        circuitState = UPLINK_CIRCUIT_CLOSED;
+        circuitFailures = 0;
+        return;
+    }
+
+    circuitFailures++;
+    if (circuitState == UPLINK_CIRCUIT_HALF_OPEN ||
+        (circuitState == UPLINK_CIRCUIT_CLOSED && circuitFailures >= (uint32_t)retryCfg.breakerThreshold)) {
+        openCircuit(getMonotonicTimeMsecs());
+    }
+}
+
+bool uplinkCircuitAllowsBacklog(void) {
+    if (getMonotonicTimeMsecs() < serverHoldUntilMsecs) {
+        return false;
+    }
+    if (circuitState == UPLINK_CIRCUIT_OPEN) {
+        return (getMonotonicTimeMsecs() >= circuitProbeAtMsecs);
+    }
+    return (circuitState == UPLINK_CIRCUIT_CLOSED && circuitFailures == 0);
+}
+
+uint32_t uplinkCircuitMsecsUntilProbe(void) {
+    uint64_t allowedAtMsecs = serverHoldUntilMsecs;
+    if (circuitState == UPLINK_CIRCUIT_OPEN) {
+        allowedAtMsecs = max(allowedAtMsecs, circuitProbeAtMsecs);
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    if (nowMsecs >= allowedAtMsecs) {
+        return 0;
+    }
+    return (uint32_t)min(allowedAtMsecs - nowMsecs, (uint64_t)UINT32_MAX - 1u);
+}
+
+void uplinkRetryDefer(const BleDataPacket &blePkt, bool sent) {
+    RetryEntry entry;
+    entry.blePkt = blePkt;
+    uint64_t spoolId = entry.blePkt.spoolId;
+    if (sent) {
+        entry.blePkt.sendAttempts++;
+    }
+
+    if (entry.blePkt.sendAttempts >= (uint32_t)retryCfg.maxAttempts) {
+        /* Acknowledged so the spool stops replaying it */
+        uplinkSpoolAck(spoolId, true);
+        retryStats.expired++;
+        return;
+    }
+
+    if (spoolId != 0) {
+        /* Held back without a send: the spool keeps its own copy and replays it once the circuit is healthy */
+        if (!sent) {
+            uplinkSpoolAck(spoolId, false);
+            retryStats.retried++;
+            return;
+        }
+        uplinkSpoolSetAttempts(spoolId, entry.blePkt.sendAttempts);
+    }
+
+    /* Bounded: the oldest routine reading makes room, events and violations only go when there is none.
+       A spooled packet that does not fit goes back to the spool. */
+    if (retryQueue.size() >= (size_t)retryCfg.queueMax) {
+        auto victim = find_if(retryQueue.begin(), retryQueue.end(),
+                              [](const RetryEntry &queued) { return isRoutineBlePacket(queued.blePkt); });
+        if (retryQueue.empty() || (victim == retryQueue.end() && isRoutineBlePacket(entry.blePkt))) {
+            uplinkSpoolAck(spoolId, false);
+            retryStats.overflowed += (spoolId == 0) ? 1 : 0;
+            return;
+        }
+        if (victim == retryQueue.end()) {
+            victim = retryQueue.begin();
+        }
+        uplinkSpoolAck(victim->blePkt.spoolId, false);
+        retryStats.overflowed += (victim->blePkt.spoolId == 0) ? 1 : 0;
+        retryQueue.erase(victim);
+    }
+
+    entry.dueMsecs = getMonotonicTimeMsecs() +
+                     getRetryBackoffMsecs(entry.blePkt.sendAttempts, (uint32_t)retryCfg.baseMsecs,
+                                          (uint32_t)retryCfg.maxMsecs);
+    entry.dueMsecs = max(entry.dueMsecs, serverHoldUntilMsecs);
+    retryQueue.push_back(entry);
+    retryStats.retried++;
+}
+
+size_t uplinkRetryTakeDue(vector<BleDataPacket> &out, size_t maxCount) {
+    size_t taken = 0;
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+
+    for (auto it = retryQueue.begin(); it != retryQueue.end() && taken < maxCount;) {
+        if (it->dueMsecs <= nowMsecs) {
+            out.push_back(it->blePkt);
+            it = retryQueue.erase(it);
+            taken++;
+        }
+        else {
+            ++it;
+        }
+    }
+    return taken;
+}
+
+uint32_t uplinkRetryMsecsUntilDue(void) {
+    if (retryQueue.empty()) {
+        return UINT32_MAX;
+    }
+
+    uint64_t dueMsecs = UINT64_MAX;
+    for (auto &entry : retryQueue) {
+        dueMsecs = min(dueMsecs, entry.dueMsecs);
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    if (dueMsecs <= nowMsecs) {
+        return 0;
+    }
+    return (uint32_t)min(dueMsecs - nowMsecs, (uint64_t)UINT32_MAX - 1u);
+}
+
+void getUplinkRetryStats(UplinkRetryStats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+
+    *stats = retryStats;
+    stats->queued = retryQueue.size();
+    stats->circuitState = circuitState;
+}
@@ -0,0 +1,658 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <string>
+#include <deque>
+#include <set>
+#include <unordered_set>
+#include <algorithm>
+#include <mutex>
+#include <type_traits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "common.h"
+#include "config.h"
+#include "uplinkSpool.h"
+#include "pktTrace.h"
+
+using namespace std;
+
+#define SPOOL_ACK_FILE_NAME                       "spool.ack"
+#define SPOOL_SEGMENT_NAME_FMT                    "seg_%08u.log"
+#define SPOOL_PATH_LEN                            (512)
+
+static_assert(is_trivially_copyable<BleDataPacket>::value, "BleDataPacket is spooled as raw bytes");
+
+typedef struct SpoolSegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t payloadLen;                 /* sizeof(BleDataPacket) of the writer */
+    uint32_t reserved;
+} SpoolSegmentHeader;
+
+typedef struct SpoolRecordHeader {
+    uint32_t payloadLen;
+    uint32_t crc;
+    uint64_t id;
+    uint32_t sendAttempts;               /* Rewritten in place after a failed send; not covered by the crc */
+    uint32_t reserved;
+} SpoolRecordHeader;
+
+typedef struct SpoolSegment {
+    uint32_t seq;                        /* Segment file sequence number */
+    uint64_t firstId;                    /* First record id, 0 if the segment is empty */
+    uint64_t lastId;                     /* Last record id, 0 if the segment is empty */
+    size_t bytes;                        /* Valid bytes, including the segment header */
+    int attemptsFd;                      /* Non-append descriptor for attempt count updates, -1 until the first */
+} SpoolSegment;
+
+#define SPOOL_FRAME_LEN                           (sizeof(SpoolRecordHeader) + sizeof(BleDataPacket))
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static mutex spoolMutex;
+static bool spoolEnabled = false;
+static deque<SpoolSegment> spoolSegments;
+static int spoolWriteFd = -1;
+static vector<int> spoolUnsyncedFds;     /* Rolled over segments waiting for fdatasync before close */
+static bool spoolDirty = false;
+static uint64_t spoolNextId = 1;
+static uint64_t spoolAckLowWater = 1;    /* Every id below this is acknowledged */
+static uint64_t spoolPersistedLowWater = 1;
+static set<uint64_t> spoolAckedAbove;    /* Acknowledged ids at or above the low-water mark */
+static unordered_set<uint64_t> spoolInFlight;
+static uint64_t spoolReplayCursorId = 0;
+static uint64_t spoolReplayRewinds = 0;     /* Bumped whenever a nack moves the replay cursor back */
+static bool spoolReplayPending = false;
+static uint64_t spoolLastSyncMsecs = 0;
+static double spoolReplayTokens = 0.0;
+static uint64_t spoolReplayRefillMsecs = 0;
+static uint64_t spoolDroppedRecords = 0;
+
+static bool createSpoolDir(const char *dir);
+static void getSpoolPath(char *path, size_t pathLen, const char *fileName);
+static void getSegmentPath(char *path, size_t pathLen, uint32_t seq);
+static bool openNewSegment(uint32_t seq);
+static bool recoverSegment(SpoolSegment &segment, bool isLastSegment);
+static void advanceLowWater(void);
+static void trimSegments(void);
+static void persistAckMark(uint64_t lowWater);
+static uint64_t readAckMark(void);
+static SpoolSegment *findSegment(uint64_t spoolId);
+
+/* mkdir -p: a fresh device may lack the parents of spool_dir as well */
+static bool createSpoolDir(const char *dir) {
+    char path[SPOOL_PATH_LEN];
+    if (snprintf(path, sizeof(path), "%s", dir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    for (char *p = path + 1; ; p++) {
+        if (*p != '/' && *p != '\0') {
+            continue;
+        }
+        char sep = *p;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (sep == '\0') {
+            break;
+        }
+        *p = sep;
+    }
+    return true;
+}
+
+static void getSpoolPath(char *path, size_t pathLen, const char *fileName) {
+    snprintf(path, pathLen, "%s/%s", spoolCfg.spoolDir, fileName);
+}
+
+static void getSegmentPath(char *path, size_t pathLen, uint32_t seq) {
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), SPOOL_SEGMENT_NAME_FMT, seq);
+    getSpoolPath(path, pathLen, fileName);
+}
+
+static uint32_t getRecordCrc(const SpoolRecordHeader &hdr, const uint8_t *payload) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *)&hdr.id, sizeof(hdr.id));
+    crc = crc32(crc, (const Bytef *)payload, hdr.payloadLen);
+    return (uint32_t)crc;
+}
+
+/* Caller holds spoolMutex */
+static bool openNewSegment(uint32_t seq) {
+    char path[SPOOL_PATH_LEN];
+    getSegmentPath(path, sizeof(path), seq);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        TRK_LOG_ERR("ERROR: Spool segment %s could not be created: %s", path, strerror(errno));
+        return false;
+    }
+
+    SpoolSegmentHeader hdr = {SPOOL_SEGMENT_MAGIC, SPOOL_SEGMENT_VERSION, (uint32_t)sizeof(BleDataPacket), 0};
+    if (write(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        TRK_LOG_ERR("ERROR: Spool segment %s header write failed: %s", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return false;
+    }
+
+    if (spoolWriteFd >= 0) {
+        spoolUnsyncedFds.push_back(spoolWriteFd);
+    }
+    spoolWriteFd = fd;
+    spoolSegments.push_back({seq, 0, 0, sizeof(hdr), -1});
+    spoolDirty = true;
+    return true;
+}
+
+/* Validate the records of an existing segment; torn tail records are cut off */
+static bool recoverSegment(SpoolSegment &segment, bool isLastSegment) {
+    char path[SPOOL_PATH_LEN];
+    getSegmentPath(path, sizeof(path), segment.seq);
+
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    SpoolSegmentHeader hdr;
+    if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) || hdr.magic != SPOOL_SEGMENT_MAGIC ||
+        hdr.version != SPOOL_SEGMENT_VERSION || hdr.payloadLen != sizeof(BleDataPacket)) {
+        TRK_PRINTF("Spool: segment %s has an incompatible format, discarding", path);
+        close(fd);
+        return false;
+    }
+
+    uint8_t frame[SPOOL_FRAME_LEN];
+    off_t offset = sizeof(hdr);
+    while (pread(fd, frame, SPOOL_FRAME_LEN, offset) == (ssize_t)SPOOL_FRAME_LEN) {
+        SpoolRecordHeader recHdr;
+        memcpy(&recHdr, frame, sizeof(recHdr));
+        if (recHdr.payloadLen != sizeof(BleDataPacket) ||
+            recHdr.crc != getRecordCrc(recHdr, &frame[sizeof(recHdr)])) {
+            break;
+        }
+        if (segment.firstId == 0) {
+            segment.firstId = recHdr.id;
+        }
+        segment.lastId = recHdr.id;
+        offset += SPOOL_FRAME_LEN;
+    }
+
+    struct stat st;
+    if (isLastSegment && fstat(fd, &st) == 0 && st.st_size > offset) {
+        TRK_PRINTF("Spool: truncating %lld torn bytes from %s", (long long)(st.st_size - offset), path);
+        if (ftruncate(fd, offset) != 0) {
+            TRK_LOG_ERR("ERROR: Spool truncate failed: %s", strerror(errno));
+        }
+    }
+
+    segment.bytes = (size_t)offset;
+    close(fd);
+    return true;
+}
+
+static uint64_t readAckMark(void) {
+    char path[SPOOL_PATH_LEN];
+    getSpoolPath(path, sizeof(path), SPOOL_ACK_FILE_NAME);
+
+    FILE *fp = fopen(path, "r");
+    if (fp == nullptr) {
+        return 1;
+    }
+
+    unsigned long long lowWater = 1;
+    if (fscanf(fp, "%llu", &lowWater) != 1 || lowWater == 0) {
+        lowWater = 1;
+    }
+    fclose(fp);
+    return (uint64_t)lowWater;
+}
+
+/* Write the ack mark to a temp file and rename it over the old one */
+static void persistAckMark(uint64_t lowWater) {
+    char path[SPOOL_PATH_LEN];
+    char tmpPath[SPOOL_PATH_LEN];
+    getSpoolPath(path, sizeof(path), SPOOL_ACK_FILE_NAME);
+    getSpoolPath(tmpPath, sizeof(tmpPath), SPOOL_ACK_FILE_NAME ".tmp");
+
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        TRK_LOG_ERR("ERROR: Spool ack mark could not be written: %s", strerror(errno));
+        return;
+    }
+
+    char buff[32];
+    int len = snprintf(buff, sizeof(buff), "%llu\n", (unsigned long long)lowWater);
+    bool ok = (write(fd, buff, (size_t)len) == len) && (fdatasync(fd) == 0);
+    close(fd);
+
+    if (!ok || rename(tmpPath, path) != 0) {
+        TRK_LOG_ERR("ERROR: Spool ack mark update failed: %s", strerror(errno));
+        return;
+    }
+    spoolPersistedLowWater = lowWater;
+}
+
+bool uplinkSpoolInit(void) {
+    if (spoolCfg.spoolDir == nullptr || spoolCfg.spoolDir[0] == '\0') {
+        TRK_PRINTF("Spool: disabled");
+        return false;
+    }
+
+    if (!createSpoolDir(spoolCfg.spoolDir)) {
+        TRK_LOG_ERR("ERROR: Spool directory %s could not be created: %s", spoolCfg.spoolDir, strerror(errno));
+        return false;
+    }
+
+    lock_guard<mutex> lock(spoolMutex);
+    spoolAckLowWater = readAckMark();
+    spoolPersistedLowWater = spoolAckLowWater;
+
+    /* Collect the existing segments in sequence order */
+    vector<uint32_t> seqs;
+    DIR *dir = opendir(spoolCfg.spoolDir);
+    if (dir == nullptr) {
+        TRK_LOG_ERR("ERROR: Spool directory %s could not be opened: %s", spoolCfg.spoolDir, strerror(errno));
+        return false;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        unsigned int seq = 0;
+        if (sscanf(entry->d_name, SPOOL_SEGMENT_NAME_FMT, &seq) == 1) {
+            seqs.push_back(seq);
+        }
+    }
+    closedir(dir);
+    sort(seqs.begin(), seqs.end());
+
+    uint32_t nextSeq = 1;
+    uint64_t backlog = 0;
+    for (size_t i = 0; i < seqs.size(); i++) {
+        char path[SPOOL_PATH_LEN];
+        SpoolSegment segment = {seqs[i], 0, 0, 0, -1};
+        nextSeq = seqs[i] + 1;
+
+        if (!recoverSegment(segment, i == seqs.size() - 1) || segment.lastId < spoolAckLowWater) {
+            getSegmentPath(path, sizeof(path), segment.seq);
+            unlink(path);
+            continue;
+        }
+
+        spoolNextId = max(spoolNextId, segment.lastId + 1);
+        backlog += segment.lastId - max(segment.firstId, spoolAckLowWater) + 1;
+        spoolSegments.push_back(segment);
+    }
+    spoolNextId = max(spoolNextId, spoolAckLowWater);
+
+    /* Appends always go to a fresh segment */
+    if (!openNewSegment(nextSeq)) {
+        return false;
+    }
+
+    if (backlog > 0) {
+        spoolReplayPending = true;
+        spoolReplayCursorId = spoolAckLowWater;
+    }
+
+    spoolLastSyncMsecs = getMonotonicTimeMsecs();
+    spoolReplayRefillMsecs = spoolLastSyncMsecs;
+    spoolEnabled = true;
+    TRK_PRINTF("Spool: ready in %s, %zu segments, backlog=%llu records, next id=%llu", spoolCfg.spoolDir,
+               spoolSegments.size(), (unsigned long long)backlog, (unsigned long long)spoolNextId);
+    return true;
+}
+
+bool isUplinkSpoolEnabled(void) {
+    return spoolEnabled;
+}
+
+bool uplinkSpoolAppend(BleDataPacket &blePkt) {
+    blePkt.spoolId = 0;
+    if (!spoolEnabled) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(spoolMutex);
+    SpoolSegment *segment = &spoolSegments.back();
+    if (segment->firstId != 0 && segment->bytes + SPOOL_FRAME_LEN > (size_t)spoolCfg.segmentBytes) {
+        if (!openNewSegment(segment->seq + 1)) {
+            return false;
+        }
+        segment = &spoolSegments.back();
+    }
+
+    uint8_t frame[SPOOL_FRAME_LEN];
+    SpoolRecordHeader recHdr;
+    recHdr.payloadLen = sizeof(BleDataPacket);
+    recHdr.id = spoolNextId;
+    recHdr.sendAttempts = blePkt.sendAttempts;
+    recHdr.reserved = 0;
+    blePkt.spoolId = recHdr.id;
+    memcpy(&frame[sizeof(recHdr)], &blePkt, sizeof(BleDataPacket));
+    recHdr.crc = getRecordCrc(recHdr, &frame[sizeof(recHdr)]);
+    memcpy(frame, &recHdr, sizeof(recHdr));
+
+    /* One write() per record; durability comes from the batched fdatasync in uplinkSpoolSync() */
+    if (write(spoolWriteFd, frame, SPOOL_FRAME_LEN) != (ssize_t)SPOOL_FRAME_LEN) {
+        TRK_LOG_ERR("ERROR: Spool append failed: %s", strerror(errno));
+        /* Drop a partial frame so record offsets in the segment stay fixed size */
+        if (ftruncate(spoolWriteFd, (off_t)segment->bytes) != 0) {
+            TRK_LOG_ERR("ERROR: Spool truncate failed: %s", strerror(errno));
+        }
+        blePkt.spoolId = 0;
+        return false;
+    }
+
+    spoolNextId++;
+    if (segment->firstId == 0) {
+        segment->firstId = recHdr.id;
+    }
+    segment->lastId = recHdr.id;
+    segment->bytes += SPOOL_FRAME_LEN;
+    spoolInFlight.insert(recHdr.id);
+    spoolDirty = true;
+    return true;
+}
+
+/* Caller holds spoolMutex */
+static void advanceLowWater(void) {
+    while (!spoolAckedAbove.empty() && *spoolAckedAbove.begin() <= spoolAckLowWater) {
+        if (*spoolAckedAbove.begin() == spoolAckLowWater) {
+            spoolAckLowWater++;
+        }
+        spoolAckedAbove.erase(spoolAckedAbove.begin());
+    }
+}
+
+void uplinkSpoolAck(uint64_t spoolId, bool acked) {
+    if (!spoolEnabled || spoolId == 0) {
+        return;
+    }
+
+    lock_guard<mutex> lock(spoolMutex);
+    spoolInFlight.erase(spoolId);
+    if (spoolId < spoolAckLowWater) {
+        return;
+    }
+
+    if (acked) {
+        spoolAckedAbove.insert(spoolId);
+        advanceLowWater();
+        return;
+    }
+
+    /* Leave the record on disk and let the replay cursor pick it up again */
+    if (!spoolReplayPending || spoolId < spoolReplayCursorId) {
+        spoolReplayCursorId = spoolId;
+        spoolReplayRewinds++;
+    }
+    spoolReplayPending = true;
+}
+
+/* Caller holds spoolMutex */
+static SpoolSegment *findSegment(uint64_t spoolId) {
+    for (auto &segment : spoolSegments) {
+        if (segment.firstId != 0 && spoolId >= segment.firstId && spoolId <= segment.lastId) {
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+void uplinkSpoolSetAttempts(uint64_t spoolId, uint32_t sendAttempts) {
+    if (!spoolEnabled || spoolId == 0) {
+        return;
+    }
+
+    lock_guard<mutex> lock(spoolMutex);
+    SpoolSegment *segment = findSegment(spoolId);
+    if (spoolId < spoolAckLowWater || segment == nullptr) {
+        return;
+    }
+
+    /* Not the append descriptor: O_APPEND would send the pwrite to the end of the file. Opened once per
+       segment and kept until the segment is trimmed, so a failed send costs one pwrite under the lock. */
+    if (segment->attemptsFd < 0) {
+        char path[SPOOL_PATH_LEN];
+        getSegmentPath(path, sizeof(path), segment->seq);
+        segment->attemptsFd = open(path, O_WRONLY | O_CLOEXEC);
+        if (segment->attemptsFd < 0) {
+            TRK_LOG_ERR("ERROR: Spool segment %s could not be opened: %s", path, strerror(errno));
+            return;
+        }
+    }
+
+    /* One aligned 4 byte write, so a crash leaves the old or the new count and never a torn record */
+    off_t offset = sizeof(SpoolSegmentHeader) + (off_t)(spoolId - segment->firstId) * (off_t)SPOOL_FRAME_LEN +
+                   (off_t)offsetof(SpoolRecordHeader, sendAttempts);
+    if (pwrite(segment->attemptsFd, &sendAttempts, sizeof(sendAttempts), offset) != (ssize_t)sizeof(sendAttempts)) {
+        TRK_LOG_ERR("ERROR: Spool attempt count update failed: %s", strerror(errno));
+    }
+}
+
+/* Caller holds spoolMutex. Drops acknowledged segments and enforces spool_max_bytes. */
+static void trimSegments(void) {
+    size_t totalBytes = 0;
+    for (const auto &segment : spoolSegments) {
+        totalBytes += segment.bytes;
+    }
+
+    while (spoolSegments.size() > 1) {
+        SpoolSegment &oldest = spoolSegments.front();
+        bool fullyAcked = (oldest.lastId < spoolAckLowWater);
+        bool overLimit = (totalBytes > (size_t)spoolCfg.maxBytes);
+        if (!fullyAcked && !overLimit) {
+            break;
+        }
+
+        if (!fullyAcked) {
+            /* Out of space: the oldest unacknowledged records are lost */
+            uint64_t lost = oldest.lastId - max(oldest.firstId, spoolAckLowWater) + 1;
+            spoolDroppedRecords += lost;
+            TRK_PRINTF("Spool: over spool_max_bytes, dropping %llu records (total dropped %llu)",
+                       (unsigned long long)lost, (unsigned long long)spoolDroppedRecords);
+            spoolAckLowWater = oldest.lastId + 1;
+            advanceLowWater();
+        }
+
+        char path[SPOOL_PATH_LEN];
+        getSegmentPath(path, sizeof(path), oldest.seq);
+        if (oldest.attemptsFd >= 0) {
+            close(oldest.attemptsFd);
+        }
+        unlink(path);
+        totalBytes -= oldest.bytes;
+        spoolSegments.pop_front();
+    }
+}
+
+void uplinkSpoolSync(void) {
+    if (!spoolEnabled) {
+        return;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    if (nowMsecs - spoolLastSyncMsecs < (uint64_t)spoolCfg.fsyncIntervalMsecs) {
+        return;
+    }
+    spoolLastSyncMsecs = nowMsecs;
+
+    vector<int> fdsToSync;
+    int writeFd = -1;
+    uint64_t lowWater = 0;
+    {
+        lock_guard<mutex> lock(spoolMutex);
+        if (!spoolDirty && spoolUnsyncedFds.empty() && spoolAckLowWater == spoolPersistedLowWater) {
+            return;
+        }
+        fdsToSync.swap(spoolUnsyncedFds);
+        if (spoolDirty) {
+            writeFd = dup(spoolWriteFd);
+        }
+        spoolDirty = false;
+        lowWater = spoolAckLowWater;
+    }
+
+    /* fdatasync runs outside the lock so appends from the scan thread never wait for the disk */
+    for (int fd : fdsToSync) {
+        fdatasync(fd);
+        close(fd);
+    }
+    if (writeFd >= 0) {
+        fdatasync(writeFd);
+        close(writeFd);
+    }
+
+    if (lowWater != spoolPersistedLowWater) {
+        persistAckMark(lowWater);
+    }
+
+    lock_guard<mutex> lock(spoolMutex);
+    trimSegments();
+}
+
+size_t uplinkSpoolReplay(vector<BleDataPacket> &out, size_t maxCount) {
+    if (!spoolEnabled || maxCount == 0) {
+        return 0;
+    }
+
+    /* Refill the replay token bucket (burst of one second worth of records) */
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    spoolReplayTokens = min((double)spoolCfg.replayRate,
+                            spoolReplayTokens + (double)(nowMsecs - spoolReplayRefillMsecs) *
+                            (double)spoolCfg.replayRate / 1000.0);
+    spoolReplayRefillMsecs = nowMsecs;
+    maxCount = min(maxCount, (size_t)spoolReplayTokens);
+    if (maxCount == 0) {
+        return 0;
+    }
+
+    unique_lock<mutex> lock(spoolMutex);
+    if (!spoolReplayPending) {
+        return 0;
+    }
+
+    size_t replayed = 0;
+    size_t scanned = 0;
+    uint64_t rewinds = spoolReplayRewinds;
+    uint64_t cursorId = max(spoolReplayCursorId, spoolAckLowWater);
+    bool reachedEnd = true;
+
+    for (size_t i = 0; i < spoolSegments.size() && replayed < maxCount; i++) {
+        SpoolSegment segment = spoolSegments[i];
+        if (segment.lastId == 0 || segment.lastId < cursorId) {
+            continue;
+        }
+
+        char path[SPOOL_PATH_LEN];
+        getSegmentPath(path, sizeof(path), segment.seq);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        /* Records are fixed size, so the cursor maps straight to an offset */
+        uint64_t startId = max(cursorId, segment.firstId);
+        off_t offset = sizeof(SpoolSegmentHeader) + (off_t)(startId - segment.firstId) * (off_t)SPOOL_FRAME_LEN;
+        uint8_t frame[SPOOL_FRAME_LEN];
+        lock.unlock();
+
+        while (replayed < maxCount && scanned < SPOOL_REPLAY_SCAN_LIMIT && (size_t)offset < segment.bytes &&
+               pread(fd, frame, SPOOL_FRAME_LEN, offset) == (ssize_t)SPOOL_FRAME_LEN) {
+            SpoolRecordHeader recHdr;
+            memcpy(&recHdr, frame, sizeof(recHdr));
+            offset += SPOOL_FRAME_LEN;
+            scanned++;
+            cursorId = recHdr.id + 1;
+
+            if (recHdr.crc != getRecordCrc(recHdr, &frame[sizeof(recHdr)])) {
+                continue;
+            }
+
+            lock_guard<mutex> recLock(spoolMutex);
+            if (recHdr.id < spoolAckLowWater || spoolAckedAbove.count(recHdr.id) > 0 ||
+                spoolInFlight.count(recHdr.id) > 0) {
+                continue;
+            }
+
+            BleDataPacket blePkt;
+            memcpy(&blePkt, &frame[sizeof(recHdr)], sizeof(BleDataPacket));
+            blePkt.spoolId = recHdr.id;
+            blePkt.sendAttempts = recHdr.sendAttempts;
+            /* Its capture time is of the run that spooled it */
+            pktTraceClear(&blePkt.trace);
+            spoolInFlight.insert(recHdr.id);
+            out.push_back(blePkt);
+            replayed++;
+        }
+
+        close(fd);
+        lock.lock();
+        if (scanned >= SPOOL_REPLAY_SCAN_LIMIT || replayed >= maxCount) {
+            reachedEnd = false;
+            break;
+        }
+    }
+
+    /* If a nack moved the cursor back while the lock was released, keep its position */
+    if (spoolReplayRewinds == rewinds) {
+        if (reachedEnd) {
+            /* Full pass done; stays idle until the next nack */
+            spoolReplayPending = false;
+            spoolReplayCursorId = spoolAckLowWater;
+        }
+        else {
+            spoolReplayCursorId = cursorId;
+        }
+    }
+
+    spoolReplayTokens -= (double)replayed;
+    if (replayed > 0) {
+        TRK_PRINTF("Spool: replaying %zu records, low-water id=%llu", replayed,
+                   (unsigned long long)spoolAckLowWater);
+    }
+    return replayed;
+}
+
+bool uplinkSpoolHasBacklog(void) {
+    if (!spoolEnabled) {
+        return false;
+    }
+    lock_guard<mutex> lock(spoolMutex);
+    return spoolReplayPending;
+}
+
+void uplinkSpoolClose(void) {
+    if (!spoolEnabled) {
+        return;
+    }
+
+    /* Force the final sync regardless of the interval */
+    spoolLastSyncMsecs = 0;
+    {
+        lock_guard<mutex> lock(spoolMutex);
+        spoolDirty = true;
+    }
+    uplinkSpoolSync();
+
+    lock_guard<mutex> lock(spoolMutex);
+    close(spoolWriteFd);
+    spoolWriteFd = -1;
+    for (auto &segment : spoolSegments) {
+        if (segment.attemptsFd >= 0) {
+            close(segment.attemptsFd);
+            segment.attemptsFd = -1;
+        }
+    }
+    spoolEnabled = false;
+}
@@ -0,0 +1,607 @@
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <curl/curl.h>
+#include "common.h"
+#include "config.h"
+#include "cloudComm.h"
+#include "heartbeat.h"
+#include "metrics.h"
+#include "uplinkEndpoint.h"
+#include "uplinkStream.h"
+#include "uplinkTransport.h"
+
+/* RFC 6455 opcodes and header bits */
+#define WS_OPCODE_CONT                            (0x0)
+#define WS_OPCODE_TEXT                            (0x1)
+#define WS_OPCODE_CLOSE                           (0x8)
+#define WS_OPCODE_PING                            (0x9)
+#define WS_OPCODE_PONG                            (0xA)
+#define WS_FRAME_FIN                              (0x80)
+#define WS_FRAME_MASKED                           (0x80)
+/* Appended to Sec-WebSocket-Key to derive Sec-WebSocket-Accept */
+#define WS_ACCEPT_GUID                            "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+/* Longest "<seq> " prefix of a reading frame */
+#define WS_READING_SEQ_MAX_LEN                    (21u)
+
+using namespace std;
+
+/* Readings of one sendDataUrls() call; reading k carries sequence number firstSeq + k */
+typedef struct StreamRound {
+    vector<size_t> readings;             /* Index into urlExtensions/httpCodes of each reading */
+    vector<uint64_t> sentMsecs;
+    long *httpCodes;
+    uint64_t firstSeq;
+    size_t answered;
+} StreamRound;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static CURL *streamCurl = nullptr;
+static int streamEndpoint = UPLINK_ENDPOINT_NONE;
+static uint64_t streamNextSeq = 1;
+static uint64_t streamReconnectAtMsecs = 0;
+static uint32_t streamReconnectDelayMsecs = UPLINK_STREAM_RECONNECT_MIN_MSECS;
+static string streamRxBuff;              /* Received bytes not yet parsed into frames */
+static string streamRxMessage;           /* Text message being reassembled from its fragments */
+static mt19937 streamRng(random_device{}());
+static UplinkStreamStats streamStats = {0};
+
+static bool splitInstanceUrl(const char *instance, string &host, string &path);
+static string encodeBase64(const uint8_t *data, size_t len);
+static void computeSha1(const uint8_t *data, size_t len, uint8_t digest[20]);
+static bool checkAcceptHeader(const string &head, const string &key);
+static bool waitStreamSocket(short events, uint64_t deadlineMsecs);
+static bool sendStreamBytes(const char *data, size_t len);
+static bool sendStreamFrame(uint8_t opcode, const char *payload, size_t len);
+static bool receiveStreamBytes(void);
+static bool upgradeStream(const string &host, const string &path, uint64_t deadlineMsecs, long *httpCode);
+static bool connectStream(void);
+static void closeStream(bool afterError);
+static bool sendStreamReading(StreamRound &round, size_t k, const char *urlExtension);
+static void answerStreamReading(StreamRound &round, uint64_t seq, long httpCode);
+static void handleStreamMessage(StreamRound &round, const string &message);
+static bool readStreamFrames(StreamRound &round);
+static void logStreamStats(void);
+static int streamSendDataUrls(const char *const *urlExtensions, size_t count, long *httpCodes);
+static void streamCleanup(void);
+
+const UplinkTransport wsUplinkTransport = {UPLINK_TRANSPORT_WEBSOCKET, streamSendDataUrls, streamCleanup};
+
+/* ----------------- Function Definitions ---------------------- */
+/* "https://host:port/base" gives host "host:port" and path "/base" + uplink_stream_path */
+static bool splitInstanceUrl(const char *instance, string &host, string &path) {
+    const char *hostStart = (instance != nullptr) ? strstr(instance, "://") : nullptr;
+    if (hostStart == nullptr) {
+        return false;
+    }
+
+    hostStart += 3;
+    const char *pathStart = strchr(hostStart, '/');
+    host.assign(hostStart, (pathStart != nullptr) ? (size_t)(pathStart - hostStart) : strlen(hostStart));
+    path = (pathStart != nullptr) ? pathStart : "";
+    path += (uplinkCfg.streamPath != nullptr) ? uplinkCfg.streamPath : UPLINK_STREAM_DEF_PATH;
+    return !host.empty();
+}
+
+static string encodeBase64(const uint8_t *data, size_t len) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string out;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t n = ((uint32_t)data[i] << 16) | ((i + 1 < len) ? ((uint32_t)data[i + 1] << 8) : 0) |
+                     ((i + 2 < len) ? data[i + 2] : 0);
+        out += alphabet[(n >> 18) & 0x3F];
+        out += alphabet[(n >> 12) & 0x3F];
+        out += (i + 1 < len) ? alphabet[(n >> 6) & 0x3F] : '=';
+        out += (i + 2 < len) ? alphabet[n & 0x3F] : '=';
+    }
+    return out;
+}
+
+static inline uint32_t rotl32(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+/* FIPS 180-1 SHA-1, only for the handshake check, so no crypto library is linked for it */
+static void computeSha1(const uint8_t *data, size_t len, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u};
+    vector<uint8_t> msg(data, data + len);
+    msg.push_back(0x80);
+    while ((msg.size() % 64) != 56) {
+        msg.push_back(0);
+    }
+    uint64_t bitLen = (uint64_t)len * 8u;
+    for (int i = 7; i >= 0; i--) {
+        msg.push_back((uint8_t)(bitLen >> (i * 8)));
+    }
+
+    for (size_t block = 0; block < msg.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t *p = &msg[block + (size_t)i * 4];
+            w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999u;
+            }
+            else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1u;
+            }
+            else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDCu;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6u;
+            }
+            uint32_t temp = rotl32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl32(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(h[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+/* Sec-WebSocket-Accept of the response head must be base64(SHA-1(key + GUID)) */
+static bool checkAcceptHeader(const string &head, const string &key) {
+    static const char name[] = "\r\nsec-websocket-accept:";
+    string lowerHead(head);
+    transform(lowerHead.begin(), lowerHead.end(), lowerHead.begin(), [](unsigned char c) { return tolower(c); });
+    size_t pos = lowerHead.find(name);
+    if (pos == string::npos) {
+        return false;
+    }
+
+    pos += strlen(name);
+    size_t end = head.find("\r\n", pos);
+    string value = head.substr(pos, (end != string::npos) ? end - pos : string::npos);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t") + 1);
+
+    string keyGuid = key + WS_ACCEPT_GUID;
+    uint8_t digest[20];
+    computeSha1((const uint8_t *)keyGuid.data(), keyGuid.size(), digest);
+    return (value == encodeBase64(digest, sizeof(digest)));
+}
+
+/* Waits at most CURL_MULTI_POLL_TIMEOUT_MSECS for events; false once the deadline has passed or on error */
+static bool waitStreamSocket(short events, uint64_t deadlineMsecs) {
+    curl_socket_t sock = CURL_SOCKET_BAD;
+    if (curl_easy_getinfo(streamCurl, CURLINFO_ACTIVESOCKET, &sock) != CURLE_OK || sock == CURL_SOCKET_BAD) {
+        return false;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    if (nowMsecs >= deadlineMsecs) {
+        return false;
+    }
+
+    struct pollfd pfd = {sock, events, 0};
+    int ready = poll(&pfd, 1, (int)min(deadlineMsecs - nowMsecs, (uint64_t)CURL_MULTI_POLL_TIMEOUT_MSECS));
+    return (ready > 0 || (ready == 0 && getMonotonicTimeMsecs() < deadlineMsecs));
+}
+
+static bool sendStreamBytes(const char *data, size_t len) {
+    uint64_t deadlineMsecs = getMonotonicTimeMsecs() + UPLINK_STREAM_ACK_TIMEOUT_MSECS;
+    while (len > 0) {
+        size_t sent = 0;
+        CURLcode res = curl_easy_send(streamCurl, data, len, &sent);
+        if (res == CURLE_OK) {
+            data += sent;
+            len -= sent;
+            streamStats.bytesSent += sent;
+        }
+        else if (res != CURLE_AGAIN || !waitStreamSocket(POLLOUT, deadlineMsecs)) {
+            TRK_PRINTF("Uplink_Stream: send failed: %s", curl_easy_strerror(res));
+            return false;
+        }
+    }
+    return true;
+}
+
+/* A client frame: FIN, opcode, length and a masking key, then the masked payload */
+static bool sendStreamFrame(uint8_t opcode, const char *payload, size_t len) {
+    char frame[UPLINK_STREAM_MAX_FRAME_LEN + 8];
+    if (len > UPLINK_STREAM_MAX_FRAME_LEN) {
+        return false;
+    }
+
+    size_t pos = 0;
+    frame[pos++] = (char)(WS_FRAME_FIN | opcode);
+    if (len < 126) {
+        frame[pos++] = (char)(WS_FRAME_MASKED | len);
+    }
+    else {
+        frame[pos++] = (char)(WS_FRAME_MASKED | 126);
+        frame[pos++] = (char)(len >> 8);
+        frame[pos++] = (char)(len & 0xFF);
+    }
+
+    uint32_t maskKey = streamRng();
+    uint8_t mask[4];
+    memcpy(mask, &maskKey, sizeof(mask));
+    memcpy(&frame[pos], mask, sizeof(mask));
+    pos += sizeof(mask);
+    for (size_t i = 0; i < len; i++) {
+        frame[pos + i] = (char)(payload[i] ^ mask[i % 4]);
+    }
+    return sendStreamBytes(frame, pos + len);
+}
+
+/* Appends whatever has arrived to streamRxBuff; returns false once the connection is closed or broken */
+static bool receiveStreamBytes(void) {
+    char buff[4096];
+    while (true) {
+        size_t nread = 0;
+        CURLcode res = curl_easy_recv(streamCurl, buff, sizeof(buff), &nread);
+        if (res == CURLE_AGAIN) {
+            return true;
+        }
+        if (res != CURLE_OK || nread == 0) {
+            TRK_PRINTF("Uplink_Stream: receive failed: %s", (res != CURLE_OK) ? curl_easy_strerror(res) : "closed");
+            return false;
+        }
+        streamRxBuff.append(buff, nread);
+        streamStats.bytesReceived += nread;
+    }
+}
+
+/* Sends the HTTP/1.1 upgrade request and waits for the 101 response header, with the accept key of our key */
+static bool upgradeStream(const string &host, const string &path, uint64_t deadlineMsecs, long *httpCode) {
+    uint8_t keyBytes[16];
+    for (auto &b : keyBytes) {
+        b = (uint8_t)streamRng();
+    }
+
+    string key = encodeBase64(keyBytes, sizeof(keyBytes));
+    string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\n"
+                     "Upgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 13\r\n"
+                     "Sec-WebSocket-Key: " + key + "\r\n"
+                     "X-Trk-Gw-Id: " + ((getGwId() != nullptr) ? getGwId() : "") + "\r\n\r\n";
+    if (!sendStreamBytes(request.data(), request.size())) {
+        return false;
+    }
+
+    size_t headEnd;
+    while ((headEnd = streamRxBuff.find("\r\n\r\n")) == string::npos) {
+        if (streamRxBuff.size() > CLOUD_RESPONSE_MAX_LEN || !waitStreamSocket(POLLIN, deadlineMsecs) ||
+            !receiveStreamBytes()) {
+            return false;
+        }
+    }
+
+    /* Frames the server sent right behind the header stay in streamRxBuff */
+    sscanf(streamRxBuff.c_str(), "HTTP/%*s %ld", httpCode);
+    string head = streamRxBuff.substr(0, headEnd + 2);
+    streamRxBuff.erase(0, headEnd + 4);
+    if (*httpCode != 101) {
+        return false;
+    }
+    if (!checkAcceptHeader(head, key)) {
+        TRK_PRINTF("Uplink_Stream: Sec-WebSocket-Accept does not match the key, upgrade rejected");
+        return false;
+    }
+    return true;
+}
+
+static bool connectStream(void) {
+    if (streamCurl != nullptr) {
+        return true;
+    }
+
+    uint64_t nowMsecs = getMonotonicTimeMsecs();
+    if (nowMsecs < streamReconnectAtMsecs) {
+        return false;
+    }
+
+    int endpoint = uplinkEndpointSelect();
+    const char *instance = getUplinkEndpointInstance(endpoint);
+    string host;
+    string path;
+    if (!splitInstanceUrl(instance, host, path)) {
+        TRK_PRINTF("Uplink_Stream: no stream URL for endpoint %d", endpoint);
+        streamReconnectAtMsecs = nowMsecs + UPLINK_STREAM_RECONNECT_MAX_MSECS;
+        return false;
+    }
+
+    /* CONNECT_ONLY stops after TCP and, for https:// instances, TLS: the stream is wss:// on the same port */
+    CURLcode res = CURLE_FAILED_INIT;
+    streamCurl = curl_easy_init();
+    if (streamCurl != nullptr &&
+        curl_easy_setopt(streamCurl, CURLOPT_URL, instance) == CURLE_OK &&
+        curl_easy_setopt(streamCurl, CURLOPT_CONNECT_ONLY, 1L) == CURLE_OK &&
+        curl_easy_setopt(streamCurl, CURLOPT_CONNECTTIMEOUT, (long)CURL_REQUEST_TIMEOUT_SECS) == CURLE_OK &&
+        curl_easy_setopt(streamCurl, CURLOPT_NOSIGNAL, 1L) == CURLE_OK &&
+        curl_easy_setopt(streamCurl, CURLOPT_TCP_NODELAY, 1L) == CURLE_OK &&
+        curl_easy_setopt(streamCurl, CURLOPT_TCP_KEEPALIVE, 1L) == CURLE_OK) {
+        res = curl_easy_perform(streamCurl);
+    }
+
+    long httpCode = 0;
+    streamRxBuff.clear();
+    streamRxMessage.clear();
+    uint64_t deadlineMsecs = getMonotonicTimeMsecs() + (uint64_t)CURL_REQUEST_TIMEOUT_SECS * 1000u;
+    bool upgraded = (res == CURLE_OK && upgradeStream(host, path, deadlineMsecs, &httpCode));
+    double connectSecs = (double)(getMonotonicTimeMsecs() - nowMsecs) / 1000.0;
+
+    /* A server that answered but refused the upgrade is alive; that is a stream problem, not an endpoint one */
+    uplinkEndpointReport(endpoint, (httpCode > 0) ? CURLE_OK : ((res != CURLE_OK) ? res : CURLE_RECV_ERROR),
+                         httpCode, connectSecs);
+
+    if (!upgraded) {
+        TRK_PRINTF("Uplink_Stream: connect to %s%s failed: %s (http=%ld), HTTP carries the readings for %u ms",
+                   host.c_str(), path.c_str(), (res != CURLE_OK) ? curl_easy_strerror(res) : "no upgrade",
+                   httpCode, streamReconnectDelayMsecs);
+        curl_easy_cleanup(streamCurl);
+        streamCurl = nullptr;
+        streamStats.connectFailures++;
+        streamReconnectAtMsecs = nowMsecs + streamReconnectDelayMsecs;
+        streamReconnectDelayMsecs = min(streamReconnectDelayMsecs * 2, UPLINK_STREAM_RECONNECT_MAX_MSECS);
+        return false;
+    }
+
+    streamStats.connects++;
+    streamEndpoint = endpoint;
+    streamReconnectDelayMsecs = UPLINK_STREAM_RECONNECT_MIN_MSECS;
+    TRK_PRINTF("Uplink_Stream: connected to %s%s in %.3f s, window=%d", host.c_str(), path.c_str(), connectSecs,
+               uplinkCfg.streamWindow);
+    return true;
+}
+
+static void closeStream(bool afterError) {
+    if (streamCurl == nullptr) {
+        return;
+    }
+
+    if (!afterError) {
+        sendStreamFrame(WS_OPCODE_CLOSE, "", 0);
+    }
+    else {
+        streamStats.disconnects++;
+    }
+    curl_easy_cleanup(streamCurl);
+    streamCurl = nullptr;
+    streamEndpoint = UPLINK_ENDPOINT_NONE;
+    streamRxBuff.clear();
+    streamRxMessage.clear();
+}
+
+static bool sendStreamReading(StreamRound &round, size_t k, const char *urlExtension) {
+    char message[UPLINK_STREAM_MAX_FRAME_LEN];
+    const char *query = (urlExtension[0] == '?') ? &urlExtension[1] : urlExtension;
+    int len = snprintf(message, sizeof(message), "%llu %s", (unsigned long long)(round.firstSeq + k), query);
+    if (len <= 0 || (size_t)len >= sizeof(message)) {
+        TRK_PRINTF("Uplink_Stream: reading too long for a frame (%zu bytes)", strlen(query));
+        return false;
+    }
+
+    if (!sendStreamFrame(WS_OPCODE_TEXT, message, (size_t)len)) {
+        return false;
+    }
+    round.sentMsecs[k] = getMonotonicTimeMsecs();
+    streamStats.readings++;
+    return true;
+}
+
+static void answerStreamReading(StreamRound &round, uint64_t seq, long httpCode) {
+    size_t k = (size_t)(seq - round.firstSeq);
+    long &readingCode = round.httpCodes[round.readings[k]];
+    if (readingCode != 0 || round.sentMsecs[k] == 0) {
+        return;
+    }
+
+    double ackSecs = (double)(getMonotonicTimeMsecs() - round.sentMsecs[k]) / 1000.0;
+    readingCode = httpCode;
+    round.answered++;
+    streamStats.acked++;
+    streamStats.ackSecsTotal += ackSecs;
+    heartbeatNoteUplinkLatency(ackSecs);
+    metricsObserveNsecs(METRIC_HIST_STREAM_ACK, (uint64_t)(ackSecs * 1e9));
+}
+
+/* Acknowledgements outside this round (late ones from an earlier round) are ignored */
+static void handleStreamMessage(StreamRound &round, const string &message) {
+    unsigned long long seq = 0;
+    long httpCode = 0;
+    uint64_t lastSeq = round.firstSeq + round.readings.size() - 1;
+
+    if (sscanf(message.c_str(), "ack %llu", &seq) == 1) {
+        for (uint64_t s = round.firstSeq; s <= min((uint64_t)seq, lastSeq); s++) {
+            answerStreamReading(round, s, 200);
+        }
+    }
+    else if (sscanf(message.c_str(), "nack %llu %ld", &seq, &httpCode) == 2) {
+        if (seq >= round.firstSeq && seq <= lastSeq && httpCode > 0) {
+            answerStreamReading(round, seq, httpCode);
+        }
+    }
+    else {
+        TRK_PRINTF("Uplink_Stream: unexpected message: %.64s", message.c_str());
+    }
+}
+
+/* Handles every complete frame received so far; returns false once the connection is unusable */
+static bool readStreamFrames(StreamRound &round) {
+    if (!receiveStreamBytes()) {
+        return false;
+    }
+
+    while (streamRxBuff.size() >= 2) {
+        const uint8_t *p = (const uint8_t *)streamRxBuff.data();
+        uint8_t opcode = p[0] & 0x0F;
+        bool fin = (p[0] & WS_FRAME_FIN) != 0;
+        size_t len = p[1] & 0x7F;
+        size_t headLen = 2;
+        /* Server frames are never masked, and acknowledgements never need 64 bit lengths */
+        if (len == 127 || (p[1] & WS_FRAME_MASKED)) {
+            TRK_PRINTF("Uplink_Stream: unsupported frame from the server");
+            return false;
+        }
+        if (len == 126) {
+            if (streamRxBuff.size() < 4) {
+                break;
+            }
+            len = ((size_t)p[2] << 8) | p[3];
+            headLen = 4;
+        }
+        if (streamRxBuff.size() < headLen + len) {
+            break;
+        }
+
+        string payload = streamRxBuff.substr(headLen, len);
+        streamRxBuff.erase(0, headLen + len);
+
+        if (opcode == WS_OPCODE_CLOSE) {
+            TRK_PRINTF("Uplink_Stream: closed by the server");
+            return false;
+        }
+        if (opcode == WS_OPCODE_PING) {
+            if (!sendStreamFrame(WS_OPCODE_PONG, payload.data(), min(payload.size(), (size_t)125))) {
+                return false;
+            }
+            continue;
+        }
+        if (opcode != WS_OPCODE_TEXT && opcode != WS_OPCODE_CONT) {
+            continue;
+        }
+
+        if (streamRxMessage.size() + payload.size() <= UPLINK_STREAM_MAX_FRAME_LEN) {
+            streamRxMessage += payload;
+        }
+        if (fin) {
+            handleStreamMessage(round, streamRxMessage);
+            streamRxMessage.clear();
+        }
+    }
+    return true;
+}
+
+static void logStreamStats(void) {
+    double avgAckMsecs = (streamStats.acked > 0) ?
+                         (streamStats.ackSecsTotal * 1000.0 / (double)streamStats.acked) : 0.0;
+    TRK_PRINTF("Uplink_Stream: readings=%llu, acked=%llu, avg_ack=%.1f ms, connects=%llu, connect_failures=%llu, "
+               "disconnects=%llu, bytes_out=%llu, bytes_in=%llu",
+               (unsigned long long)streamStats.readings, (unsigned long long)streamStats.acked, avgAckMsecs,
+               (unsigned long long)streamStats.connects, (unsigned long long)streamStats.connectFailures,
+               (unsigned long long)streamStats.disconnects, (unsigned long long)streamStats.bytesSent,
+               (unsigned long long)streamStats.bytesReceived);
+}
+
+static int streamSendDataUrls(const char *const *urlExtensions, size_t count, long *httpCodes) {
+    if (urlExtensions == nullptr || count == 0 || httpCodes == nullptr) {
+        TRK_LOG_ERR("ERROR: Invalid input params - Stream readings not sent");
+        return -1;
+    }
+
+    StreamRound round;
+    round.httpCodes = httpCodes;
+    round.answered = 0;
+    for (size_t i = 0; i < count; i++) {
+        httpCodes[i] = 0;
+        if (urlExtensions[i] == nullptr) {
+            continue;
+        }
+        /* A reading too long for a frame keeps status 0 and goes over HTTP; the stream stays up */
+        if (strlen(urlExtensions[i]) + WS_READING_SEQ_MAX_LEN >= UPLINK_STREAM_MAX_FRAME_LEN) {
+            TRK_PRINTF("Uplink_Stream: reading too long for a frame (%zu bytes), sent over HTTP",
+                       strlen(urlExtensions[i]));
+            continue;
+        }
+        round.readings.push_back(i);
+    }
+    if (round.readings.empty() || !connectStream()) {
+        return (int)count;
+    }
+
+    size_t readingCount = round.readings.size();
+    uint64_t prevReadings = streamStats.readings;
+    size_t window = (size_t)((uplinkCfg.streamWindow > 0) ? uplinkCfg.streamWindow : UPLINK_STREAM_DEF_WINDOW);
+    round.firstSeq = streamNextSeq;
+    round.sentMsecs.assign(readingCount, 0);
+    streamNextSeq += readingCount;
+
+    /* Send while the window has room, otherwise wait for acknowledgements; any progress restarts the timeout */
+    uint64_t deadlineMsecs = getMonotonicTimeMsecs() + UPLINK_STREAM_ACK_TIMEOUT_MSECS;
+    size_t sent = 0;
+    size_t answered = 0;
+    bool connected = true;
+    while (connected && keepRunning && round.answered < readingCount) {
+        if (sent < readingCount && (sent - round.answered) < window) {
+            connected = sendStreamReading(round, sent, urlExtensions[round.readings[sent]]);
+            sent++;
+            continue;
+        }
+
+        connected = readStreamFrames(round);
+        if (round.answered != answered) {
+            answered = round.answered;
+            deadlineMsecs = getMonotonicTimeMsecs() + UPLINK_STREAM_ACK_TIMEOUT_MSECS;
+        }
+        bool windowOpen = (sent < readingCount && (sent - round.answered) < window);
+        if (connected && round.answered < readingCount && !windowOpen && !waitStreamSocket(POLLIN, deadlineMsecs)) {
+            TRK_PRINTF("Uplink_Stream: %zu of %zu readings not acknowledged", readingCount - round.answered,
+                       readingCount);
+            connected = false;
+        }
+    }
+
+    if ((streamStats.readings / UPLINK_STREAM_LOG_INTERVAL) != (prevReadings / UPLINK_STREAM_LOG_INTERVAL)) {
+        logStreamStats();
+    }
+
+    /* The endpoint scoring sees the stream as one request per round */
+    int endpoint = streamEndpoint;
+    if (!connected) {
+        closeStream(true);
+    }
+    if (round.answered > 0) {
+        double roundSecs = (double)(getMonotonicTimeMsecs() - round.sentMsecs[0]) / 1000.0;
+        uplinkEndpointReport(endpoint, CURLE_OK, 200, roundSecs);
+    }
+    else if (!connected) {
+        uplinkEndpointReport(endpoint, CURLE_RECV_ERROR, 0, 0.0);
+    }
+    return (int)(count - round.answered);
+}
+
+static void streamCleanup(void) {
+    if (streamStats.connects > 0 || streamStats.connectFailures > 0) {
+        logStreamStats();
+    }
+    closeStream(false);
+}
+
+void getUplinkStreamStats(UplinkStreamStats *stats) {
+    if (stats != nullptr) {
+        *stats = streamStats;
+    }
+}
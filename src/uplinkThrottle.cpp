@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include "common.h"
+#include "config.h"
+#include "cloudComm.h"
+#include "uplinkRetry.h"
+#include "uplinkThrottle.h"
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+/* A server hint, 0 while absent; written by the cloud thread, read by both threads */
+typedef struct ThrottleHint {
+    const char *name;
+    atomic<uint32_t> value;
+    atomic<uint64_t> expiresMsecs;
+} ThrottleHint;
+
+static ThrottleHint concurrencyHint = {"concurrency", {0}, {0}};
+static ThrottleHint batchMaxHint = {"batch_max", {0}, {0}};
+static ThrottleHint reportIntervalHint = {"report_interval", {0}, {0}};
+
+static uint32_t getHintValue(const ThrottleHint &hint);
+static void setHintValue(ThrottleHint &hint, int32_t value);
+
+/* ----------------- Function Definitions ---------------------- */
+static uint32_t getHintValue(const ThrottleHint &hint) {
+    uint32_t value = hint.value.load(memory_order_relaxed);
+    if (value == 0 || getMonotonicTimeMsecs() >= hint.expiresMsecs.load(memory_order_relaxed)) {
+        return 0;
+    }
+    return value;
+}
+
+static void setHintValue(ThrottleHint &hint, int32_t value) {
+    if (value < 0) {
+        return;
+    }
+
+    /* Refreshing the same value only extends its lifetime */
+    if ((uint32_t)value != getHintValue(hint)) {
+        TRK_PRINTF("Uplink_Throttle: server hint %s=%d%s", hint.name, value, (value == 0) ? " (cleared)" : "");
+    }
+    hint.expiresMsecs.store(getMonotonicTimeMsecs() + (uint64_t)throttleCfg.hintTtlSecs * 1000u,
+                            memory_order_relaxed);
+    hint.value.store((uint32_t)value, memory_order_relaxed);
+}
+
+void uplinkThrottleApplyHints(const CloudResponseHints &hints) {
+    if (hints.retryAfterSecs >= 0) {
+        uint32_t holdSecs = min((uint32_t)hints.retryAfterSecs, (uint32_t)throttleCfg.maxHoldSecs);
+        if (holdSecs > 0) {
+            uplinkCircuitHoldOff(holdSecs * 1000u);
+        }
+    }
+
+    setHintValue(concurrencyHint, hints.concurrency);
+    setHintValue(batchMaxHint, hints.batchMaxRecords);
+    setHintValue(reportIntervalHint, hints.reportIntervalSecs);
+}
+
+size_t getUplinkConcurrency(void) {
+    uint32_t hint = getHintValue(concurrencyHint);
+    return (hint == 0) ? CURL_MAX_PARALLEL_REQUESTS : min((size_t)hint, (size_t)CURL_MAX_PARALLEL_REQUESTS);
+}
+
+size_t getUplinkBatchMaxRecords(void) {
+    uint32_t hint = getHintValue(batchMaxHint);
+    size_t maxRecords = (size_t)uplinkCfg.batchMaxRecords;
+    return (hint == 0) ? maxRecords : min((size_t)hint, maxRecords);
+}
+
+uint32_t getTapeReportIntervalSecs(void) {
+    return max(getHintValue(reportIntervalHint), (uint32_t)throttleCfg.tapeReportIntervalSecs);
+}
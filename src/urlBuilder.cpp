@@ -0,0 +1,596 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <cstddef>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "cloudComm.h"
+#include "urlBuilder.h"
+#include "hexEncode.h"
+
+using namespace std;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+typedef enum UrlOpType {
+    URL_OP_LITERAL = 0,                  /* Constant segment from the literal pool */
+    URL_OP_STR,                          /* NUL terminated char array field */
+    URL_OP_I8,                           /* int8_t field as %d */
+    URL_OP_U8,                           /* uint8_t field as %d */
+    URL_OP_U16,                          /* uint16_t field as %d */
+    URL_OP_I32,                          /* 32-bit field as %d */
+    URL_OP_HEX16,                        /* uint16_t field as %04X */
+    URL_OP_CENTI_I16,                    /* int16_t field in hundredths, arg decimals */
+    URL_OP_CENTI_U8,                     /* uint8_t field in hundredths, arg decimals */
+    URL_OP_DECI_U8,                      /* uint8_t field in tenths, arg decimals */
+    URL_OP_HEX_BYTES,                    /* arg bytes as upper case hex */
+    URL_OP_SEQ,                          /* Per packet type sequence number */
+    URL_OP_NOW                           /* Current epoch seconds as %ld */
+} UrlOpType;
+
+typedef struct UrlTemplateOp {
+    uint8_t type;                        /* UrlOpType */
+    uint8_t arg;                         /* Byte count, decimals or string capacity */
+    uint16_t offset;                     /* Offset in the literal pool or in BleDataPacket */
+    uint16_t len;                        /* Literal length, or the longest output of a field */
+} UrlTemplateOp;
+
+typedef struct UrlTemplate {
+    UrlTemplateOp ops[URL_TEMPLATE_MAX_OPS];
+    size_t opCount;
+    char literals[URL_TEMPLATE_MAX_LITERALS];
+    size_t literalsLen;
+    size_t maxLen;                       /* Longest possible output, without the terminator */
+} UrlTemplate;
+
+typedef struct UrlField {
+    const char *name;
+    UrlOpType type;
+    uint16_t offset;
+    uint8_t arg;
+} UrlField;
+
+#define URL_PKT_FIELD(pkt, member)          (uint16_t)offsetof(BleDataPacket, blePktStrct.pkt.member)
+#define URL_BLE_BUFF_OFFSET                 (uint16_t)offsetof(BleDataPacket, bleBuff)
+#define URL_ARRAY_LEN(arr)                  (sizeof(arr) / sizeof((arr)[0]))
+#define URL_FIXED_MAX_DECIMALS             (6u)
+/* printf conversions of the fixed-point readings, %.2f for 0.01 units and %.3f for 0.1 units */
+#define URL_CENTI_FMT                       "%s%d.%02d"
+#define URL_CENTI_ARGS(v)                   (((v) < 0) ? "-" : ""), abs((int)(v)) / 100, abs((int)(v)) % 100
+#define URL_DECI_FMT                        "%d.%d00"
+#define URL_DECI_ARGS(v)                    (int)(v) / 10, (int)(v) % 10
+
+static const UrlField urlCommonFields[] = {
+    {"seq", URL_OP_SEQ, 0, 0},
+    {"now", URL_OP_NOW, 0, 0},
+    {"g1", URL_OP_HEX_BYTES, URL_BLE_BUFF_OFFSET, WHITE_TAPE_DATA_PACKET_LEN},
+    {"st", URL_OP_HEX_BYTES, URL_BLE_BUFF_OFFSET, 2},
+};
+
+static const UrlField urlTmp117Fields[] = {
+    {"mac", URL_OP_STR, URL_PKT_FIELD(blePkt_TMP117, mac_addr), sizeof(BlePacket_QuartzTMP117::mac_addr)},
+    {"rssi", URL_OP_I8, URL_PKT_FIELD(blePkt_TMP117, rssi), 0},
+    {"e0", URL_OP_U8, URL_PKT_FIELD(blePkt_TMP117, evt_flag), 0},
+    {"t0", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_TMP117, t0), 2},
+    {"t0_ts", URL_OP_U16, URL_PKT_FIELD(blePkt_TMP117, t0_ts), 0},
+    {"t1", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_TMP117, t1), 2},
+    {"t1_ts", URL_OP_U16, URL_PKT_FIELD(blePkt_TMP117, t1_ts), 0},
+    {"t2", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_TMP117, t2), 2},
+    {"t2_ts", URL_OP_U16, URL_PKT_FIELD(blePkt_TMP117, t2_ts), 0},
+    {"pid", URL_OP_I32, URL_PKT_FIELD(blePkt_TMP117, pid), 0},
+    {"seqId", URL_OP_U16, URL_PKT_FIELD(blePkt_TMP117, seqId), 0},
+    {"tapeId", URL_OP_HEX16, URL_PKT_FIELD(blePkt_TMP117, tapeId), 0},
+    {"bat", URL_OP_DECI_U8, URL_PKT_FIELD(blePkt_TMP117, bat), 3},
+};
+
+static const UrlField urlOpt3110Fields[] = {
+    {"mac", URL_OP_STR, URL_PKT_FIELD(blePkt_OPT3110, mac_addr), sizeof(BlePacket_QuartzOPT3110::mac_addr)},
+    {"rssi", URL_OP_I8, URL_PKT_FIELD(blePkt_OPT3110, rssi), 0},
+    {"e0", URL_OP_U8, URL_PKT_FIELD(blePkt_OPT3110, evt_flag), 0},
+    {"t0", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_OPT3110, t0), 2},
+    {"t0_ts", URL_OP_U16, URL_PKT_FIELD(blePkt_OPT3110, t0_ts), 0},
+    {"l0", URL_OP_U16, URL_PKT_FIELD(blePkt_OPT3110, l0), 0},
+    {"l0_ts", URL_OP_U16, URL_PKT_FIELD(blePkt_OPT3110, l0_ts), 0},
+    {"l1", URL_OP_U16, URL_PKT_FIELD(blePkt_OPT3110, l1), 0},
+    {"l1_ts", URL_OP_U16, URL_PKT_FIELD(blePkt_OPT3110, l1_ts), 0},
+    {"pid", URL_OP_I32, URL_PKT_FIELD(blePkt_OPT3110, pid), 0},
+    {"lbat", URL_OP_CENTI_U8, URL_PKT_FIELD(blePkt_OPT3110, lime_bat), 2},
+    {"seqId", URL_OP_U16, URL_PKT_FIELD(blePkt_OPT3110, seqId), 0},
+    {"tapeId", URL_OP_HEX16, URL_PKT_FIELD(blePkt_OPT3110, tapeId), 0},
+    {"bat", URL_OP_DECI_U8, URL_PKT_FIELD(blePkt_OPT3110, bat), 3},
+};
+
+static const UrlField urlIatFields[] = {
+    {"mac", URL_OP_STR, URL_PKT_FIELD(blePkt_IAT, mac_addr), sizeof(BlePacket_IAT::mac_addr)},
+    {"rssi", URL_OP_I8, URL_PKT_FIELD(blePkt_IAT, rssi), 0},
+    {"e0", URL_OP_U8, URL_PKT_FIELD(blePkt_IAT, evt_flag), 0},
+    {"t0", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_IAT, t0), 2},
+    {"t1", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_IAT, t1), 2},
+    {"t1_ts", URL_OP_I32, URL_PKT_FIELD(blePkt_IAT, t1_ts), 0},
+    {"l0", URL_OP_U16, URL_PKT_FIELD(blePkt_IAT, l0), 0},
+    {"l0_ts", URL_OP_I32, URL_PKT_FIELD(blePkt_IAT, l0_ts), 0},
+    {"a0v", URL_OP_I8, URL_PKT_FIELD(blePkt_IAT, a0_val), 0},
+    {"a0c", URL_OP_U8, URL_PKT_FIELD(blePkt_IAT, a0_count), 0},
+    {"tapeId", URL_OP_HEX16, URL_PKT_FIELD(blePkt_IAT, tapeId), 0},
+    {"bat", URL_OP_DECI_U8, URL_PKT_FIELD(blePkt_IAT, bat), 3},
+};
+
+static const UrlField urlDpdFields[] = {
+    {"mac", URL_OP_STR, URL_PKT_FIELD(blePkt_DPD, macId), sizeof(BlePacket_DPD::macId)},
+    {"rssi", URL_OP_I8, URL_PKT_FIELD(blePkt_DPD, rssi), 0},
+    {"e0", URL_OP_U8, URL_PKT_FIELD(blePkt_DPD, evtFlag), 0},
+    {"t0", URL_OP_CENTI_I16, URL_PKT_FIELD(blePkt_DPD, t0), 2},
+    {"ts", URL_OP_U16, URL_PKT_FIELD(blePkt_DPD, ts), 0},
+    {"l0", URL_OP_U16, URL_PKT_FIELD(blePkt_DPD, l0), 0},
+    {"l0_ts", URL_OP_I32, URL_PKT_FIELD(blePkt_DPD, l0Ts), 0},
+    {"tapeId", URL_OP_HEX16, URL_PKT_FIELD(blePkt_DPD, tapeId), 0},
+    {"bat", URL_OP_DECI_U8, URL_PKT_FIELD(blePkt_DPD, bat), 3},
+};
+
+/* G1 record, the same for every packet type */
+static const char *urlG1Template =
+    "?G1={g1}&rid={gw}&C={seq}&id={mac}&type={gw}&ts={now}&rssi0={rssi}&clat={lat}&clon={lon}&st={st}";
+
+/* Formatted records, indexed by BlePacketType */
+static const char *urlFormattedTemplates[QuartzSensor_Max] = {
+    nullptr,
+    "?rid={gw}&C={seq}&id={mac}&type={gw}&ts={t0_ts}&rssi={rssi}&e0={e0}&t0={t0}&t1={t1}&t1ts={t1_ts}"
+    "&t2={t2}&t2ts={t2_ts}&pid={pid}&seqId={seqId}&tapeId=0x{tapeId}&bat={bat}&clat={lat}&clon={lon}&st=5258",
+    "?rid={gw}&C={seq}&id={mac}&type={gw}&ts={t0_ts}&rssi={rssi}&e0={e0}&t0={t0}&l0={l0}&l0ts={l0_ts}"
+    "&l1={l1}&l1ts={l1_ts}&pid={pid}&lbat={lbat}&seqId={seqId}&tapeId=0x{tapeId}&bat={bat}&clat={lat}&clon={lon}"
+    "&st=5258",
+    "?rid={gw}&C={seq}&id={mac}&type={gw}&ts={t1_ts}&rssi={rssi}&e0={e0}&t0={t0}&t1={t1}&l0={l0}&l0ts={l0_ts}"
+    "&a0v={a0v}&a0c={a0c}&tapeId=0x{tapeId}&bat={bat}&clat={lat}&clon={lon}&st=5258",
+    "?rid={gw}&C={seq}&id={mac}&type={gw}&ts={ts}&rssi={rssi}&e0={e0}&t0={t0}&l0={l0}&l0ts={l0_ts}"
+    "&tapeId=0x{tapeId}&bat={bat}&clat={lat}&clon={lon}&st=5258",
+};
+
+static const char urlDecPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static UrlTemplate urlTemplates[QuartzSensor_Max];
+static bool urlTemplatesReady = false;
+static int urlSeqNumbers[QuartzSensor_Max] = {0};
+/* instance + url_extension of every uplink endpoint, joined once */
+static char urlDataBases[UPLINK_MAX_ENDPOINTS][MAX_URL_LEN];
+static size_t urlDataBaseLens[UPLINK_MAX_ENDPOINTS] = {0};
+
+static bool addUrlTemplateLiteral(UrlTemplate *tmpl, const char *text, size_t len);
+static bool addUrlTemplateField(UrlTemplate *tmpl, const UrlField *field);
+static const UrlField *findUrlField(const char *name, size_t nameLen, const UrlField *fields, size_t fieldCount);
+static bool compileUrlTemplate(UrlTemplate *tmpl, const char *src, const UrlField *fields, size_t fieldCount);
+
+/* ----------------- Formatters ---------------------- */
+/* Writes v in decimal and returns the position after the last digit */
+static inline char *appendUint64(char *p, uint64_t v) {
+    char tmp[20];
+    char *t = tmp + sizeof(tmp);
+    while (v >= 100) {
+        uint32_t pair = (uint32_t)(v % 100u) * 2u;
+        v /= 100u;
+        *--t = urlDecPairs[pair + 1];
+        *--t = urlDecPairs[pair];
+    }
+    if (v >= 10) {
+        *--t = urlDecPairs[v * 2u + 1];
+        *--t = urlDecPairs[v * 2u];
+    }
+    else {
+        *--t = (char)('0' + v);
+    }
+
+    size_t len = (size_t)(tmp + sizeof(tmp) - t);
+    memcpy(p, t, len);
+    return p + len;
+}
+
+static inline char *appendInt64(char *p, int64_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        return appendUint64(p, (uint64_t)0 - (uint64_t)v);
+    }
+    return appendUint64(p, (uint64_t)v);
+}
+
+/*
+    Fixed-point value in 1/scale units (scale 10 or 100) with decimals >= the
+    digits of scale, the integer equivalent of %.<decimals>f.
+*/
+static inline char *appendFixedPoint(char *p, int32_t value, uint32_t scale, uint8_t decimals) {
+    if (value < 0) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    p = appendUint64(p, (uint32_t)value / scale);
+    *p++ = '.';
+    uint32_t frac = (uint32_t)value % scale;
+    for (uint32_t div = scale / 10u; div > 0; div /= 10u, decimals--) {
+        *p++ = (char)('0' + (frac / div) % 10u);
+    }
+    for (; decimals > 0; decimals--) {
+        *p++ = '0';
+    }
+    return p;
+}
+
+/* ----------------- Template Compiler ---------------------- */
+static bool addUrlTemplateLiteral(UrlTemplate *tmpl, const char *text, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+    if (tmpl->literalsLen + len > URL_TEMPLATE_MAX_LITERALS) {
+        return false;
+    }
+
+    memcpy(&tmpl->literals[tmpl->literalsLen], text, len);
+    /* Adjacent constant text is pre-joined into one segment */
+    if (tmpl->opCount > 0 && tmpl->ops[tmpl->opCount - 1].type == URL_OP_LITERAL) {
+        tmpl->ops[tmpl->opCount - 1].len += (uint16_t)len;
+    }
+    else {
+        if (tmpl->opCount >= URL_TEMPLATE_MAX_OPS) {
+            return false;
+        }
+        tmpl->ops[tmpl->opCount++] = {URL_OP_LITERAL, 0, (uint16_t)tmpl->literalsLen, (uint16_t)len};
+    }
+    tmpl->literalsLen += len;
+    tmpl->maxLen += len;
+    return true;
+}
+
+static bool addUrlTemplateField(UrlTemplate *tmpl, const UrlField *field) {
+    if (tmpl->opCount >= URL_TEMPLATE_MAX_OPS) {
+        return false;
+    }
+
+    size_t maxLen = 0;
+    switch (field->type) {
+        case URL_OP_STR:       maxLen = field->arg - 1u; break;
+        case URL_OP_I8:        maxLen = 4; break;
+        case URL_OP_U8:        maxLen = 3; break;
+        case URL_OP_U16:       maxLen = 5; break;
+        case URL_OP_I32:       maxLen = 11; break;
+        case URL_OP_HEX16:     maxLen = 4; break;
+        case URL_OP_CENTI_I16: maxLen = 4u + field->arg; break;
+        case URL_OP_CENTI_U8:  maxLen = 2u + field->arg; break;
+        case URL_OP_DECI_U8:   maxLen = 3u + field->arg; break;
+        case URL_OP_HEX_BYTES: maxLen = 2u * field->arg; break;
+        case URL_OP_SEQ:       maxLen = 11; break;
+        case URL_OP_NOW:       maxLen = 20; break;
+        default:
+            return false;
+    }
+
+    bool isFixedPoint = (field->type == URL_OP_CENTI_I16 || field->type == URL_OP_CENTI_U8 ||
+                         field->type == URL_OP_DECI_U8);
+    uint8_t minDecimals = (field->type == URL_OP_DECI_U8) ? 1 : 2;
+    if (isFixedPoint && (field->arg < minDecimals || field->arg > URL_FIXED_MAX_DECIMALS)) {
+        return false;
+    }
+    tmpl->ops[tmpl->opCount++] = {(uint8_t)field->type, field->arg, field->offset, (uint16_t)maxLen};
+    tmpl->maxLen += maxLen;
+    return true;
+}
+
+static const UrlField *findUrlField(const char *name, size_t nameLen, const UrlField *fields, size_t fieldCount) {
+    for (size_t i = 0; i < fieldCount; i++) {
+        if (strlen(fields[i].name) == nameLen && strncmp(fields[i].name, name, nameLen) == 0) {
+            return &fields[i];
+        }
+    }
+    return nullptr;
+}
+
+static bool compileUrlTemplate(UrlTemplate *tmpl, const char *src, const UrlField *fields, size_t fieldCount) {
+    memset(tmpl, 0, sizeof(*tmpl));
+
+    const char *p = src;
+    while (*p != '\0') {
+        const char *open = strchr(p, '{');
+        if (open == nullptr) {
+            return addUrlTemplateLiteral(tmpl, p, strlen(p));
+        }
+
+        const char *close = strchr(open, '}');
+        if (close == nullptr || !addUrlTemplateLiteral(tmpl, p, (size_t)(open - p))) {
+            return false;
+        }
+
+        const char *name = open + 1;
+        size_t nameLen = (size_t)(close - name);
+        bool added = false;
+        const UrlField *field = nullptr;
+        if (nameLen == 2 && strncmp(name, "gw", 2) == 0) {
+            added = addUrlTemplateLiteral(tmpl, getGwId(), strlen(getGwId()));
+        }
+        else if (nameLen == 3 && strncmp(name, "lat", 3) == 0) {
+            added = addUrlTemplateLiteral(tmpl, gwCfg.gwLat, strlen(gwCfg.gwLat));
+        }
+        else if (nameLen == 3 && strncmp(name, "lon", 3) == 0) {
+            added = addUrlTemplateLiteral(tmpl, gwCfg.gwLon, strlen(gwCfg.gwLon));
+        }
+        else if ((field = findUrlField(name, nameLen, urlCommonFields, URL_ARRAY_LEN(urlCommonFields))) != nullptr ||
+                 (field = findUrlField(name, nameLen, fields, fieldCount)) != nullptr) {
+            added = addUrlTemplateField(tmpl, field);
+        }
+
+        if (!added) {
+            TRK_LOG_ERR("ERROR: URL template field {%.*s} unknown or template too long", (int)nameLen, name);
+            return false;
+        }
+        p = close + 1;
+    }
+    return true;
+}
+
+bool urlBuilderInit(void) {
+    static const struct {
+        const UrlField *fields;
+        size_t count;
+    } typeFields[QuartzSensor_Max] = {
+        {nullptr, 0},
+        {urlTmp117Fields, URL_ARRAY_LEN(urlTmp117Fields)},
+        {urlOpt3110Fields, URL_ARRAY_LEN(urlOpt3110Fields)},
+        {urlIatFields, URL_ARRAY_LEN(urlIatFields)},
+        {urlDpdFields, URL_ARRAY_LEN(urlDpdFields)},
+    };
+
+    urlTemplatesReady = false;
+    if (getGwId() == nullptr || gwCfg.gwLat == nullptr || gwCfg.gwLon == nullptr) {
+        TRK_LOG_ERR("ERROR: Gateway config missing, URL templates not compiled");
+        return false;
+    }
+
+    /* B1 falls back to G1 text records when the server does not accept the binary format */
+    bool isG1Record = isCurlReqFormatG1() || isCurlReqFormatB1();
+    for (int type = QuartzSensor_TMP117; type < QuartzSensor_Max; type++) {
+        const char *src = isG1Record ? urlG1Template : urlFormattedTemplates[type];
+        if (!compileUrlTemplate(&urlTemplates[type], src, typeFields[type].fields, typeFields[type].count)) {
+            return false;
+        }
+    }
+
+    /* Same order as the uplink endpoints: urlCfg.instances, or the plain instance before the config is read */
+    vector<const char *> instances = urlCfg.instances;
+    if (instances.empty()) {
+        instances.push_back(urlCfg.instance);
+    }
+    for (size_t i = 0; i < UPLINK_MAX_ENDPOINTS; i++) {
+        urlDataBaseLens[i] = 0;
+        if (i < instances.size() && instances[i] != nullptr && urlCfg.urlExtension != nullptr) {
+            int len = snprintf(urlDataBases[i], sizeof(urlDataBases[i]), "%s%s", instances[i], urlCfg.urlExtension);
+            if (len > 0 && (size_t)len < sizeof(urlDataBases[i])) {
+                urlDataBaseLens[i] = (size_t)len;
+            }
+        }
+    }
+
+    urlTemplatesReady = true;
+    return true;
+}
+
+/* ----------------- Builders ---------------------- */
+int createBleDataUrlExtension(char *urlDataBuff, size_t urlDataBuffLen, BleDataPacket *blePkt) {
+    if (urlDataBuff == nullptr || urlDataBuffLen < 128 || blePkt == nullptr) {
+        TRK_LOG_ERR("ERROR: Invalid input parameters, BLE data URL extension creation failed!");
+        return -1;
+    }
+
+    if (blePkt->blePktType <= QuartzSensor_Unknown || blePkt->blePktType >= QuartzSensor_Max) {
+        return -2;
+    }
+
+    const UrlTemplate *tmpl = &urlTemplates[blePkt->blePktType];
+    if (!urlTemplatesReady) {
+        return createBleDataUrlExtensionSnprintf(urlDataBuff, urlDataBuffLen, blePkt);
+    }
+
+    const uint8_t *pkt = (const uint8_t *)blePkt;
+    int *seqNumber = &urlSeqNumbers[blePkt->blePktType];
+    int prevSeqNumber = *seqNumber;
+    char *p = urlDataBuff;
+    /* Worst case fits: no per-op bounds checks */
+    bool checkBounds = (tmpl->maxLen >= urlDataBuffLen);
+    for (size_t i = 0; i < tmpl->opCount; i++) {
+        const UrlTemplateOp &op = tmpl->ops[i];
+        const uint8_t *field = pkt + op.offset;
+        if (checkBounds && (size_t)(urlDataBuff + urlDataBuffLen - p) <= op.len) {
+            /* The record may not fit, the snprintf path truncates it like before */
+            *seqNumber = prevSeqNumber;
+            return createBleDataUrlExtensionSnprintf(urlDataBuff, urlDataBuffLen, blePkt);
+        }
+        switch (op.type) {
+            case URL_OP_LITERAL:
+                memcpy(p, &tmpl->literals[op.offset], op.len);
+                p += op.len;
+                break;
+            case URL_OP_STR: {
+                size_t len = strnlen((const char *)field, op.arg);
+                memcpy(p, field, len);
+                p += len;
+                break;
+            }
+            case URL_OP_I8:
+                p = appendInt64(p, *(const int8_t *)field);
+                break;
+            case URL_OP_U8:
+                p = appendUint64(p, *field);
+                break;
+            case URL_OP_U16: {
+                uint16_t v;
+                memcpy(&v, field, sizeof(v));
+                p = appendUint64(p, v);
+                break;
+            }
+            case URL_OP_I32: {
+                int32_t v;
+                memcpy(&v, field, sizeof(v));
+                p = appendInt64(p, v);
+                break;
+            }
+            case URL_OP_HEX16: {
+                uint16_t v;
+                memcpy(&v, field, sizeof(v));
+                uint8_t bytes[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+                p = hexEncodeUpper(p, bytes, sizeof(bytes));
+                break;
+            }
+            case URL_OP_CENTI_I16: {
+                int16_t v;
+                memcpy(&v, field, sizeof(v));
+                p = appendFixedPoint(p, v, 100u, op.arg);
+                break;
+            }
+            case URL_OP_CENTI_U8:
+                p = appendFixedPoint(p, *field, 100u, op.arg);
+                break;
+            case URL_OP_DECI_U8:
+                p = appendFixedPoint(p, *field, 10u, op.arg);
+                break;
+            case URL_OP_HEX_BYTES:
+                p = hexEncodeUpper(p, field, op.arg);
+                break;
+            case URL_OP_SEQ:
+                p = appendInt64(p, ++(*seqNumber));
+                break;
+            case URL_OP_NOW:
+                p = appendInt64(p, (int64_t)time(nullptr));
+                break;
+            default:
+                break;
+        }
+    }
+    *p = '\0';
+    return URL_CREATE_SUCCESS;
+}
+
+size_t buildCloudDataUrl(char *urlBuff, size_t urlBuffLen, const char *urlExtension, size_t urlExtensionLen,
+                         int endpoint) {
+    if (urlBuff == nullptr || urlExtension == nullptr || endpoint < 0 || (size_t)endpoint >= UPLINK_MAX_ENDPOINTS) {
+        return 0;
+    }
+
+    size_t baseLen = urlDataBaseLens[endpoint];
+    if (baseLen == 0 || baseLen + urlExtensionLen + 1 > urlBuffLen) {
+        return 0;
+    }
+
+    memcpy(urlBuff, urlDataBases[endpoint], baseLen);
+    memcpy(&urlBuff[baseLen], urlExtension, urlExtensionLen);
+    urlBuff[baseLen + urlExtensionLen] = '\0';
+    return baseLen + urlExtensionLen;
+}
+
+int getNextUplinkSeqNumber(BlePacketType blePktType) {
+    return ++urlSeqNumbers[blePktType];
+}
+
+int createBleDataUrlExtensionSnprintf(char *urlDataBuff, size_t urlDataBuffLen, BleDataPacket *blePkt) {
+    if (urlDataBuff == nullptr || urlDataBuffLen < 128 || blePkt == nullptr) {
+        TRK_LOG_ERR("ERROR: Invalid input parameters, BLE data URL extension creation failed!");
+        return -1;
+    }
+    int *seqNumber = urlSeqNumbers;
+    uint8_t *rBuff = blePkt->bleBuff;
+    /* B1 falls back to G1 text records when the server does not accept the binary format */
+    bool isG1Record = isCurlReqFormatG1() || isCurlReqFormatB1();
+    memset(urlDataBuff, 0, urlDataBuffLen);
+
+    switch(blePkt->blePktType) {
+        case QuartzSensor_TMP117: {
+            BlePacket_QuartzTMP117 *bleTmp117 = &blePkt->blePktStrct.blePkt_TMP117;
+            if (isG1Record == true) {
+                snprintf(urlDataBuff, urlDataBuffLen, 
+                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
+                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
+                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
+                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
+                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_TMP117], bleTmp117->mac_addr,
+                getGwId(), time(nullptr), bleTmp117->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
+            }
+            else {
+                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
+                "&e0=%d&t0=" URL_CENTI_FMT "&t1=" URL_CENTI_FMT "&t1ts=%d&t2=" URL_CENTI_FMT "&t2ts=%d&pid=%d&seqId=%d"
+                "&tapeId=0x%04X&bat=" URL_DECI_FMT "&clat=%s&clon=%s&st=5258", getGwId(),
+                ++seqNumber[QuartzSensor_TMP117], bleTmp117->mac_addr, getGwId(), bleTmp117->t0_ts, bleTmp117->rssi,
+                bleTmp117->evt_flag, URL_CENTI_ARGS(bleTmp117->t0), URL_CENTI_ARGS(bleTmp117->t1), bleTmp117->t1_ts,
+                URL_CENTI_ARGS(bleTmp117->t2), bleTmp117->t2_ts, bleTmp117->pid, bleTmp117->seqId, bleTmp117->tapeId,
+                URL_DECI_ARGS(bleTmp117->bat), gwCfg.gwLat, gwCfg.gwLon);
+            }
+            return URL_CREATE_SUCCESS;
+        }
+        case QuartzSensor_OPT3110: {
+            BlePacket_QuartzOPT3110 *bleOpt3110 = &blePkt->blePktStrct.blePkt_OPT3110;
+            if (isG1Record == true) {
+                snprintf(urlDataBuff, urlDataBuffLen, 
+                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
+                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
+                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
+                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
+                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_OPT3110], bleOpt3110->mac_addr,
+                getGwId(), time(nullptr), bleOpt3110->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
+            }
+            else {
+                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
+                "&e0=%d&t0=" URL_CENTI_FMT "&l0=%d&l0ts=%d&l1=%d&l1ts=%d&pid=%d&lbat=" URL_CENTI_FMT "&seqId=%d"
+                "&tapeId=0x%04X&bat=" URL_DECI_FMT "&clat=%s&clon=%s&st=5258", getGwId(),
+                ++seqNumber[QuartzSensor_OPT3110], bleOpt3110->mac_addr, getGwId(), bleOpt3110->t0_ts, bleOpt3110->rssi,
+                bleOpt3110->evt_flag, URL_CENTI_ARGS(bleOpt3110->t0), bleOpt3110->l0, bleOpt3110->l0_ts, bleOpt3110->l1,
+                bleOpt3110->l1_ts, bleOpt3110->pid, URL_CENTI_ARGS(bleOpt3110->lime_bat), bleOpt3110->seqId,
+                bleOpt3110->tapeId, URL_DECI_ARGS(bleOpt3110->bat), gwCfg.gwLat, gwCfg.gwLon);
+            }
+            return URL_CREATE_SUCCESS;
+        }
+        case QuartzSensor_IAT: {
+            BlePacket_IAT *bleIAT = &blePkt->blePktStrct.blePkt_IAT;
+            if (isG1Record == true) {
+                snprintf(urlDataBuff, urlDataBuffLen, 
+                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
+                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
+                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
+                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
+                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_IAT], bleIAT->mac_addr,
+                getGwId(), time(nullptr), bleIAT->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
+            }
+            else {
+                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
+                "&e0=%d&t0=" URL_CENTI_FMT "&t1=" URL_CENTI_FMT "&l0=%d&l0ts=%d&a0v=%d&a0c=%d&tapeId=0x%04X"
+                "&bat=" URL_DECI_FMT "&clat=%s&clon=%s&st=5258", getGwId(), ++seqNumber[QuartzSensor_IAT],
+                bleIAT->mac_addr, getGwId(), bleIAT->t1_ts, bleIAT->rssi, bleIAT->evt_flag,
+                URL_CENTI_ARGS(bleIAT->t0), URL_CENTI_ARGS(bleIAT->t1),
+                bleIAT->l0, bleIAT->l0_ts, bleIAT->a0_val, bleIAT->a0_count, bleIAT->tapeId,
+                URL_DECI_ARGS(bleIAT->bat), gwCfg.gwLat, gwCfg.gwLon);
+            }
+            return URL_CREATE_SUCCESS;
+        }
+        case QuartzSensor_DPD: {
+            BlePacket_DPD *bleDPD = &blePkt->blePktStrct.blePkt_DPD;
+            if (isG1Record == true) {
+                snprintf(urlDataBuff, urlDataBuffLen, 
+                "?G1=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X"
+                "&rid=%s&C=%d&id=%s&type=%s&ts=%ld&rssi0=%d" "&clat=%s&clon=%s&st=%02X%02X", rBuff[0], rBuff[1],
+                rBuff[2], rBuff[3], rBuff[4], rBuff[5], rBuff[6], rBuff[7], rBuff[8], rBuff[9], rBuff[10], rBuff[11],
+                rBuff[12], rBuff[13], rBuff[14], rBuff[15], rBuff[16], rBuff[17], rBuff[18], rBuff[19], rBuff[20],
+                rBuff[21], rBuff[22], rBuff[23], getGwId(), ++seqNumber[QuartzSensor_DPD], bleDPD->macId,
+                getGwId(), time(nullptr), bleDPD->rssi, gwCfg.gwLat, gwCfg.gwLon, rBuff[0], rBuff[1]);
+            }
+            else {
+                snprintf(urlDataBuff, urlDataBuffLen, "?rid=%s&C=%d&id=%s&type=%s&ts=%d&rssi=%d"
+                "&e0=%d&t0=" URL_CENTI_FMT "&l0=%d&l0ts=%d&tapeId=0x%04X&bat=" URL_DECI_FMT "&clat=%s&clon=%s"
+                "&st=5258",
+                getGwId(), ++seqNumber[QuartzSensor_DPD], bleDPD->macId, getGwId(), bleDPD->ts,
+                bleDPD->rssi, bleDPD->evtFlag, URL_CENTI_ARGS(bleDPD->t0), bleDPD->l0, bleDPD->l0Ts, bleDPD->tapeId,
+                URL_DECI_ARGS(bleDPD->bat), gwCfg.gwLat, gwCfg.gwLon);
+            }
+            return URL_CREATE_SUCCESS;
+        }
+        default: {
+            return -2;
+        }
+    }
+}
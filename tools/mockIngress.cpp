@@ -0,0 +1,633 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <deque>
+#include <getopt.h>
+#include <poll.h>
+#include <unistd.h>
+#include <strings.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/*
+    Local stand-in for the cloud ingress, for measuring the gateway's upload
+    capacity without touching the configured instance.
+
+    Serves the three pages the gateway uses, matched on the end of the request
+    path so an instance prefix such as /ingress/v1 does not matter:
+        url_extension          GET  data URLs          (default /proxencoded)
+        url_batch_extension    POST batches            (default /proxencoded/batch)
+        url_alive              GET  heartbeats         (default /heartbeat)
+        uplink_stream_path     WebSocket stream        (default /proxencoded/stream)
+    Any other path gets a 404. Connections are HTTP/1.1 keep-alive, one thread
+    each; there is no TLS, so point the instance at http://127.0.0.1:<port>.
+
+    Every request is delayed by --latency-ms (+/- --jitter-ms), paced to at
+    most --max-rps accepted requests per second across all connections, and
+    fails with --error-code at --error-rate. On the stream the same applies to
+    every reading frame, answered with "ack <seq>" or "nack <seq> <code>" (see
+    uplinkStream.h); readings whose delay has passed share one cumulative ack.
+    Counters are printed every --stats-secs and on exit (SIGINT/SIGTERM).
+
+    Build with: make mock-ingress
+*/
+#define MOCK_DEF_PORT                             (18080)
+#define MOCK_DEF_ERROR_CODE                       (503)
+#define MOCK_MAX_HEADER_LEN                       (16384u)
+#define MOCK_MAX_BODY_LEN                         (4u * 1024u * 1024u)
+#define MOCK_LISTEN_BACKLOG                       (64)
+#define MOCK_WS_GUID                              "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define MOCK_WS_MAX_FRAME_LEN                     (65536u)
+
+using namespace std;
+
+typedef struct MockConfig {
+    int port = MOCK_DEF_PORT;
+    uint32_t latencyMsecs = 0;           /* Added to every response */
+    uint32_t jitterMsecs = 0;            /* Uniform +/- around latencyMsecs */
+    double errorRate = 0.0;              /* Share of requests answered with errorCode, 0..1 */
+    int errorCode = MOCK_DEF_ERROR_CODE;
+    uint32_t retryAfterSecs = 0;         /* Retry-After sent with the errors, 0 for none */
+    double maxRps = 0.0;                 /* Accepted requests per second, 0 for unlimited */
+    uint32_t statsSecs = 0;              /* Periodic counter print, 0 for exit only */
+    string dataPath = "/proxencoded";
+    string batchPath = "/proxencoded/batch";
+    string alivePath = "/heartbeat";
+    string streamPath = "/proxencoded/stream";
+} MockConfig;
+
+typedef enum MockRoute {
+    MOCK_ROUTE_DATA,
+    MOCK_ROUTE_BATCH,
+    MOCK_ROUTE_ALIVE,
+    MOCK_ROUTE_STREAM,
+    MOCK_ROUTE_UNKNOWN,
+    MOCK_ROUTE_COUNT
+} MockRoute;
+
+/* ----------------- Static Functions and Variables ---------------------- */
+static MockConfig mockCfg;
+static volatile sig_atomic_t mockRunning = 1;
+static int listenFd = -1;
+
+static atomic<uint64_t> routeRequests[MOCK_ROUTE_COUNT];
+static atomic<uint64_t> errorResponses(0);
+static atomic<uint64_t> bytesReceived(0);
+static atomic<uint64_t> streamReadings(0);
+static atomic<uint64_t> connectionsAccepted(0);
+static atomic<uint32_t> connectionsOpen(0);
+
+/* Pacing for --max-rps: the next free request slot, in microseconds */
+static mutex paceMutex;
+static uint64_t paceNextUsecs = 0;
+
+static uint64_t getMockTimeUsecs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000u) + ((uint64_t)ts.tv_nsec / 1000u);
+}
+
+static void sleepUsecs(uint64_t usecs) {
+    struct timespec ts = {(time_t)(usecs / 1000000u), (long)((usecs % 1000000u) * 1000u)};
+    nanosleep(&ts, nullptr);
+}
+
+/* Waits for the next request slot under --max-rps */
+static void paceRequest(void) {
+    if (mockCfg.maxRps <= 0.0) {
+        return;
+    }
+
+    uint64_t slotUsecs = (uint64_t)(1000000.0 / mockCfg.maxRps);
+    uint64_t startUsecs;
+    {
+        lock_guard<mutex> lock(paceMutex);
+        uint64_t now = getMockTimeUsecs();
+        startUsecs = max(now, paceNextUsecs);
+        paceNextUsecs = startUsecs + slotUsecs;
+    }
+
+    uint64_t now = getMockTimeUsecs();
+    if (startUsecs > now) {
+        sleepUsecs(startUsecs - now);
+    }
+}
+
+static bool pathEndsWith(const string &path, const string &suffix) {
+    return (path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+static MockRoute getRoute(const string &method, string path) {
+    path = path.substr(0, path.find('?'));
+    if (method == "GET" && pathEndsWith(path, mockCfg.streamPath)) {
+        return MOCK_ROUTE_STREAM;
+    }
+    /* The batch page extends the data page, so it is matched first */
+    if (method == "POST" && pathEndsWith(path, mockCfg.batchPath)) {
+        return MOCK_ROUTE_BATCH;
+    }
+    if (pathEndsWith(path, mockCfg.dataPath)) {
+        return MOCK_ROUTE_DATA;
+    }
+    if (pathEndsWith(path, mockCfg.alivePath)) {
+        return MOCK_ROUTE_ALIVE;
+    }
+    return MOCK_ROUTE_UNKNOWN;
+}
+
+static bool sendAll(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool sendResponse(int fd, int code, const char *reason, const char *body, bool keepAlive) {
+    char head[256];
+    int len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n",
+                       code, reason, strlen(body));
+    if (code == mockCfg.errorCode && mockCfg.retryAfterSecs > 0) {
+        len += snprintf(head + len, sizeof(head) - len, "Retry-After: %u\r\n", mockCfg.retryAfterSecs);
+    }
+    len += snprintf(head + len, sizeof(head) - len, "Connection: %s\r\n\r\n", keepAlive ? "keep-alive" : "close");
+    return (sendAll(fd, head, (size_t)len) && sendAll(fd, body, strlen(body)));
+}
+
+/* Value of a header in the raw header block, empty if absent */
+static string getHeader(const string &head, const char *name) {
+    size_t nameLen = strlen(name);
+    size_t pos = head.find("\r\n");
+    while (pos != string::npos && pos + 2 < head.size()) {
+        size_t line = pos + 2;
+        size_t end = head.find("\r\n", line);
+        if (end == string::npos) {
+            end = head.size();
+        }
+        if (end - line > nameLen && head[line + nameLen] == ':' &&
+            strncasecmp(head.c_str() + line, name, nameLen) == 0) {
+            size_t value = head.find_first_not_of(' ', line + nameLen + 1);
+            return (value == string::npos || value >= end) ? string() : head.substr(value, end - value);
+        }
+        pos = end;
+    }
+    return string();
+}
+
+static uint32_t rotl32(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+/* SHA-1 of the input, base64 encoded: the Sec-WebSocket-Accept of RFC 6455 */
+static string getSha1Base64(const string &input) {
+    uint32_t h[5] = {0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u};
+    string msg = input + '\x80';
+    while ((msg.size() % 64) != 56) {
+        msg += '\0';
+    }
+    uint64_t bits = (uint64_t)input.size() * 8u;
+    for (int i = 7; i >= 0; i--) {
+        msg += (char)(bits >> (i * 8));
+    }
+
+    for (size_t off = 0; off < msg.size(); off += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t *p = (const uint8_t *)&msg[off + (size_t)i * 4];
+            w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999u;
+            }
+            else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1u;
+            }
+            else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDCu;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6u;
+            }
+            uint32_t t = rotl32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl32(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    uint8_t digest[20];
+    for (int i = 0; i < 20; i++) {
+        digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string out;
+    for (int i = 0; i < 20; i += 3) {
+        uint32_t n = ((uint32_t)digest[i] << 16) | ((i + 1 < 20) ? ((uint32_t)digest[i + 1] << 8) : 0) |
+                     ((i + 2 < 20) ? digest[i + 2] : 0);
+        out += alphabet[(n >> 18) & 0x3F];
+        out += alphabet[(n >> 12) & 0x3F];
+        out += (i + 1 < 20) ? alphabet[(n >> 6) & 0x3F] : '=';
+        out += (i + 2 < 20) ? alphabet[n & 0x3F] : '=';
+    }
+    return out;
+}
+
+/* Unmasked server frame; opcode 0x1 text, 0x8 close, 0xA pong */
+static bool sendWsFrame(int fd, uint8_t opcode, const string &payload) {
+    string frame;
+    frame += (char)(0x80 | opcode);
+    if (payload.size() < 126) {
+        frame += (char)payload.size();
+    }
+    else {
+        frame += (char)126;
+        frame += (char)(payload.size() >> 8);
+        frame += (char)(payload.size() & 0xFF);
+    }
+    frame += payload;
+    return sendAll(fd, frame.data(), frame.size());
+}
+
+/*
+    Parses one client frame from the front of buff. Returns the frame length,
+    0 if buff does not hold a whole frame yet, or -1 for a frame we refuse.
+*/
+static long parseWsFrame(const string &buff, uint8_t *opcode, string &payload) {
+    if (buff.size() < 2) {
+        return 0;
+    }
+
+    const uint8_t *p = (const uint8_t *)buff.data();
+    uint64_t len = p[1] & 0x7F;
+    size_t headLen = 2;
+    if (len == 126) {
+        if (buff.size() < 4) {
+            return 0;
+        }
+        len = ((uint64_t)p[2] << 8) | p[3];
+        headLen = 4;
+    }
+    else if (len == 127) {
+        return -1;
+    }
+    if (!(p[1] & 0x80) || len > MOCK_WS_MAX_FRAME_LEN) {
+        return -1;
+    }
+    if (buff.size() < headLen + 4 + len) {
+        return 0;
+    }
+
+    const uint8_t *mask = p + headLen;
+    payload.resize(len);
+    for (size_t i = 0; i < len; i++) {
+        payload[i] = (char)(p[headLen + 4 + i] ^ mask[i % 4]);
+    }
+    *opcode = p[0] & 0x0F;
+    return (long)(headLen + 4 + len);
+}
+
+/* Sends the answers that are due, folding runs of acks into one cumulative ack */
+static bool sendDueWsAnswers(int fd, deque<pair<uint64_t, string>> &answers) {
+    uint64_t nowUsecs = getMockTimeUsecs();
+    string pendingAck;
+    while (!answers.empty() && answers.front().first <= nowUsecs) {
+        const string &answer = answers.front().second;
+        if (answer.compare(0, 4, "ack ") == 0) {
+            pendingAck = answer;
+        }
+        else if ((!pendingAck.empty() && !sendWsFrame(fd, 0x1, pendingAck)) || !sendWsFrame(fd, 0x1, answer)) {
+            return false;
+        }
+        else {
+            pendingAck.clear();
+        }
+        answers.pop_front();
+    }
+    return (pendingAck.empty() || sendWsFrame(fd, 0x1, pendingAck));
+}
+
+/* Serves an upgraded stream connection until the client closes it */
+static void handleStream(int fd, string &buff, mt19937 &rng) {
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    deque<pair<uint64_t, string>> answers;
+    char chunk[4096];
+
+    while (mockRunning) {
+        uint8_t opcode = 0;
+        string payload;
+        long frameLen;
+        while ((frameLen = parseWsFrame(buff, &opcode, payload)) > 0) {
+            buff.erase(0, (size_t)frameLen);
+            bytesReceived += (uint64_t)frameLen;
+            if (opcode == 0x8) {
+                sendWsFrame(fd, 0x8, string());
+                return;
+            }
+            if (opcode == 0x9) {
+                sendWsFrame(fd, 0xA, payload);
+                continue;
+            }
+            if (opcode != 0x1) {
+                continue;
+            }
+
+            streamReadings++;
+            unsigned long long seq = strtoull(payload.c_str(), nullptr, 10);
+            paceRequest();
+            double jitter = (unit(rng) * 2.0 - 1.0) * (double)mockCfg.jitterMsecs;
+            uint64_t dueUsecs = getMockTimeUsecs() +
+                                (uint64_t)(max(0.0, (double)mockCfg.latencyMsecs + jitter) * 1000.0);
+            char answer[64];
+            if (mockCfg.errorRate > 0.0 && unit(rng) < mockCfg.errorRate) {
+                errorResponses++;
+                snprintf(answer, sizeof(answer), "nack %llu %d", seq, mockCfg.errorCode);
+            }
+            else {
+                snprintf(answer, sizeof(answer), "ack %llu", seq);
+            }
+            answers.emplace_back(max(dueUsecs, answers.empty() ? 0 : answers.back().first), answer);
+        }
+        if (frameLen < 0 || !sendDueWsAnswers(fd, answers)) {
+            return;
+        }
+
+        int timeoutMsecs = 1000;
+        if (!answers.empty()) {
+            uint64_t nowUsecs = getMockTimeUsecs();
+            uint64_t dueUsecs = answers.front().first;
+            timeoutMsecs = (dueUsecs > nowUsecs) ? (int)((dueUsecs - nowUsecs + 999) / 1000) : 0;
+        }
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeoutMsecs) > 0) {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                return;
+            }
+            buff.append(chunk, (size_t)got);
+        }
+    }
+}
+
+static void handleConnection(int fd) {
+    connectionsOpen++;
+    mt19937 rng((uint32_t)getMockTimeUsecs() ^ (uint32_t)fd);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    string buff;
+    char chunk[4096];
+    bool keepAlive = true;
+
+    while (mockRunning && keepAlive) {
+        /* Read one request: the header block, then Content-Length bytes of body */
+        size_t headEnd;
+        while ((headEnd = buff.find("\r\n\r\n")) == string::npos) {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0 || buff.size() > MOCK_MAX_HEADER_LEN) {
+                keepAlive = false;
+                break;
+            }
+            buff.append(chunk, (size_t)got);
+        }
+        if (!keepAlive) {
+            break;
+        }
+
+        string head = buff.substr(0, headEnd);
+        size_t bodyLen = strtoul(getHeader(head, "Content-Length").c_str(), nullptr, 10);
+        if (bodyLen > MOCK_MAX_BODY_LEN) {
+            sendResponse(fd, 413, "Payload Too Large", "too large", false);
+            break;
+        }
+        while (buff.size() < headEnd + 4 + bodyLen) {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                keepAlive = false;
+                break;
+            }
+            buff.append(chunk, (size_t)got);
+        }
+        if (!keepAlive) {
+            break;
+        }
+        bytesReceived += headEnd + 4 + bodyLen;
+        buff.erase(0, headEnd + 4 + bodyLen);
+
+        char method[16] = {0};
+        char path[MOCK_MAX_HEADER_LEN] = {0};
+        char version[16] = {0};
+        if (sscanf(head.c_str(), "%15s %16383s %15s", method, path, version) != 3) {
+            sendResponse(fd, 400, "Bad Request", "bad request", false);
+            break;
+        }
+        keepAlive = (strcasecmp(getHeader(head, "Connection").c_str(), "close") != 0);
+
+        MockRoute route = getRoute(method, path);
+        routeRequests[route]++;
+
+        string wsKey = getHeader(head, "Sec-WebSocket-Key");
+        if (route == MOCK_ROUTE_STREAM && strcasecmp(getHeader(head, "Upgrade").c_str(), "websocket") == 0 &&
+            !wsKey.empty()) {
+            string accept = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                            "Sec-WebSocket-Accept: " + getSha1Base64(wsKey + MOCK_WS_GUID) + "\r\n\r\n";
+            if (sendAll(fd, accept.data(), accept.size())) {
+                handleStream(fd, buff, rng);
+            }
+            break;
+        }
+
+        paceRequest();
+        if (mockCfg.latencyMsecs > 0 || mockCfg.jitterMsecs > 0) {
+            double jitter = (unit(rng) * 2.0 - 1.0) * (double)mockCfg.jitterMsecs;
+            sleepUsecs((uint64_t)(max(0.0, (double)mockCfg.latencyMsecs + jitter) * 1000.0));
+        }
+
+        bool sent;
+        if (route == MOCK_ROUTE_UNKNOWN || route == MOCK_ROUTE_STREAM) {
+            sent = sendResponse(fd, 404, "Not Found", "not found", keepAlive);
+        }
+        else if (mockCfg.errorRate > 0.0 && unit(rng) < mockCfg.errorRate) {
+            errorResponses++;
+            sent = sendResponse(fd, mockCfg.errorCode, "Mock Error", "error", keepAlive);
+        }
+        else {
+            sent = sendResponse(fd, 200, "OK", "ok", keepAlive);
+        }
+        if (!sent) {
+            break;
+        }
+    }
+
+    close(fd);
+    connectionsOpen--;
+}
+
+static void printStats(void) {
+    printf("Mock_Ingress: data=%llu batch=%llu alive=%llu streams=%llu stream_readings=%llu unknown=%llu "
+           "errors=%llu rx_bytes=%llu connections=%llu open=%u\n",
+           (unsigned long long)routeRequests[MOCK_ROUTE_DATA].load(),
+           (unsigned long long)routeRequests[MOCK_ROUTE_BATCH].load(),
+           (unsigned long long)routeRequests[MOCK_ROUTE_ALIVE].load(),
+           (unsigned long long)routeRequests[MOCK_ROUTE_STREAM].load(), (unsigned long long)streamReadings.load(),
+           (unsigned long long)routeRequests[MOCK_ROUTE_UNKNOWN].load(),
+           (unsigned long long)errorResponses.load(), (unsigned long long)bytesReceived.load(),
+           (unsigned long long)connectionsAccepted.load(), connectionsOpen.load());
+    fflush(stdout);
+}
+
+static void statsThreadFunc(void) {
+    while (mockRunning) {
+        for (uint32_t i = 0; i < mockCfg.statsSecs * 10u && mockRunning; i++) {
+            sleepUsecs(100000u);
+        }
+        if (mockRunning) {
+            printStats();
+        }
+    }
+}
+
+static void signalHandler(int signum) {
+    (void)signum;
+    mockRunning = 0;
+    /* Unblocks accept() */
+    shutdown(listenFd, SHUT_RDWR);
+}
+
+static void printUsage(const char *prog) {
+    printf("Usage: %s [options]\n"
+           "  --port N            listen port on 127.0.0.1 (default %d)\n"
+           "  --latency-ms N      response delay\n"
+           "  --jitter-ms N       uniform +/- added to the delay\n"
+           "  --error-rate R      share of requests that fail, 0..1\n"
+           "  --error-code N      status of the failed requests (default %d)\n"
+           "  --retry-after N     Retry-After seconds sent with the failures\n"
+           "  --max-rps R         accepted requests per second, 0 = unlimited\n"
+           "  --stats-secs N      print the counters every N seconds\n"
+           "  --data-path P       url_extension page (default /proxencoded)\n"
+           "  --batch-path P      url_batch_extension page (default /proxencoded/batch)\n"
+           "  --alive-path P      url_alive page (default /heartbeat)\n"
+           "  --stream-path P     uplink_stream_path WebSocket (default /proxencoded/stream)\n",
+           prog, MOCK_DEF_PORT, MOCK_DEF_ERROR_CODE);
+}
+
+static bool parseArgs(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"port", required_argument, nullptr, 'p'},
+        {"latency-ms", required_argument, nullptr, 'l'},
+        {"jitter-ms", required_argument, nullptr, 'j'},
+        {"error-rate", required_argument, nullptr, 'e'},
+        {"error-code", required_argument, nullptr, 'c'},
+        {"retry-after", required_argument, nullptr, 'r'},
+        {"max-rps", required_argument, nullptr, 'm'},
+        {"stats-secs", required_argument, nullptr, 's'},
+        {"data-path", required_argument, nullptr, 'D'},
+        {"batch-path", required_argument, nullptr, 'B'},
+        {"alive-path", required_argument, nullptr, 'A'},
+        {"stream-path", required_argument, nullptr, 'S'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:l:j:e:c:r:m:s:D:B:A:S:h", options, nullptr)) != -1) {
+        switch (opt) {
+            case 'p': mockCfg.port = atoi(optarg); break;
+            case 'l': mockCfg.latencyMsecs = (uint32_t)strtoul(optarg, nullptr, 10); break;
+            case 'j': mockCfg.jitterMsecs = (uint32_t)strtoul(optarg, nullptr, 10); break;
+            case 'e': mockCfg.errorRate = min(max(atof(optarg), 0.0), 1.0); break;
+            case 'c': mockCfg.errorCode = atoi(optarg); break;
+            case 'r': mockCfg.retryAfterSecs = (uint32_t)strtoul(optarg, nullptr, 10); break;
+            case 'm': mockCfg.maxRps = max(atof(optarg), 0.0); break;
+            case 's': mockCfg.statsSecs = (uint32_t)strtoul(optarg, nullptr, 10); break;
+            case 'D': mockCfg.dataPath = optarg; break;
+            case 'B': mockCfg.batchPath = optarg; break;
+            case 'A': mockCfg.alivePath = optarg; break;
+            case 'S': mockCfg.streamPath = optarg; break;
+            default:
+                printUsage(argv[0]);
+                return false;
+        }
+    }
+    return (mockCfg.port > 0 && mockCfg.port < 65536);
+}
+
+/* ----------------- Function Definitions ---------------------- */
+int main(int argc, char *argv[]) {
+    if (!parseArgs(argc, argv)) {
+        return 1;
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)mockCfg.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listenFd < 0 || bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, MOCK_LISTEN_BACKLOG) != 0) {
+        perror("Mock_Ingress: listen failed");
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signalHandler;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    printf("Mock_Ingress: listening on http://127.0.0.1:%d latency=%ums jitter=%ums error_rate=%.3f max_rps=%.1f\n",
+           mockCfg.port, mockCfg.latencyMsecs, mockCfg.jitterMsecs, mockCfg.errorRate, mockCfg.maxRps);
+    fflush(stdout);
+
+    if (mockCfg.statsSecs > 0) {
+        thread(statsThreadFunc).detach();
+    }
+
+    while (mockRunning) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        connectionsAccepted++;
+        thread(handleConnection, fd).detach();
+    }
+
+    close(listenFd);
+    printStats();
+    return 0;
+}